@@ -0,0 +1,854 @@
+// Implementation of the Adaptive Balanced Binary Search Tree.
+//
+// Exactly one representation holds the keys at any time. Every public
+// operation bumps a counter in the current window; the window is closed
+// after ADAPTIVE_WINDOW operations, at which point the cost model below
+// estimates what the window would have cost under each representation.
+// If another representation is sufficiently cheaper for several windows
+// in a row, and the saving over the next few windows covers the
+// estimated cost of moving with room to spare, the keys are extracted in
+// order and rebuilt in the new representation. Decisions depend only on
+// the counters, never on the clock, so a given sequence of operations
+// always migrates at the same points.
+//
+// The only clock reads are at window boundaries, so the counters cost a
+// few increments per operation.
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adaptiveBST.h"
+#include "bBST.h"
+#include "List.h"
+#include "roaringSet.h"
+
+// A migration must make the window at least this much cheaper...
+#define ADAPTIVE_GAIN 0.75
+// ...and pay for itself within this many windows...
+#define ADAPTIVE_HORIZON 4
+// ...ADAPTIVE_MARGIN times over, since the estimates can be out by half
+#define ADAPTIVE_MARGIN 2
+// ...and have been the best engine for this many windows in a row, so
+// that one unusual window does not cause a move and a move back
+#define ADAPTIVE_CONFIRM 2
+
+typedef enum engine
+{
+	ENGINE_AVL,
+	ENGINE_SNAPSHOT,
+	ENGINE_BITMAP,
+	NUM_ENGINES,
+} Engine;
+
+static const char *EngineNames[NUM_ENGINES] = {"avl", "snapshot", "bitmap"};
+
+// Operation mix of one window
+struct workload
+{
+	long reads;
+	long writes;
+	long kths;
+	long kthWalk;
+	long ranges;
+	double rangeSpan;
+};
+
+// A migration whose payoff is measured over the ADAPTIVE_HORIZON windows
+// it was meant to pay for, since one window is too short to time
+// reliably
+struct pending
+{
+	bool active;
+	Engine from;
+	Engine to;
+	double nsBefore;
+	double nsMigrate;
+	double nsAfter;
+	int windowsAfter;
+};
+
+struct adaptiveTree
+{
+	Engine engine;
+	int size;
+
+	// Only the field for the current engine is in use
+	Tree avl;
+	int *keys;
+	int capacity;
+	RoaringSet bitmap;
+
+	struct workload window;
+	long ops;
+	long windows;
+	// The engine the last windows favoured, for how many in a row, and
+	// the total of their measured ns/op
+	Engine candidate;
+	int streak;
+	double nsStreak;
+	struct timespec windowStart;
+	struct pending pending;
+	FILE *log;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void Tick(AdaptiveTree t);
+static void EndWindow(AdaptiveTree t);
+static void LogPayoff(AdaptiveTree t);
+static double EngineCost(Engine e, struct workload *w, double n, double density);
+static double MigrationCost(Engine from, Engine to, double n, double density);
+static double KeyDensity(AdaptiveTree t);
+static void Migrate(AdaptiveTree t, Engine to);
+static void FreeEngine(AdaptiveTree t);
+static void NodeCollect(Node n, int *out, int *count);
+static Node NodeBuild(const int *keys, int lo, int hi);
+static int LowerBound(const int *keys, int size, int key);
+static bool SnapshotInsert(AdaptiveTree t, int key);
+static bool SnapshotDelete(AdaptiveTree t, int key);
+static double Elapsed(struct timespec *from, struct timespec *to);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty tree, backed by an AVL tree.
+ */
+AdaptiveTree AdaptiveTreeNew(void)
+{
+	AdaptiveTree t = malloc(sizeof(*t));
+
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc AdaptiveTree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(t, 0, sizeof(*t));
+	t->engine = ENGINE_AVL;
+	t->avl = TreeNew();
+	t->log = stderr;
+	clock_gettime(CLOCK_MONOTONIC, &t->windowStart);
+
+	return t;
+}
+
+/**
+ * Frees all memory allocated for the given tree.
+ */
+void AdaptiveTreeFree(AdaptiveTree t)
+{
+	if (t == NULL)
+		return;
+
+	FreeEngine(t);
+	free(t);
+}
+
+/**
+ * Sets the stream migration decisions are logged to.
+ */
+void AdaptiveTreeSetLog(AdaptiveTree t, FILE *log)
+{
+	if (t != NULL)
+		t->log = log;
+}
+
+/**
+ * Returns the name of the representation currently in use.
+ */
+const char *AdaptiveTreeEngine(AdaptiveTree t)
+{
+	return (t == NULL) ? NULL : EngineNames[t->engine];
+}
+
+/**
+ * Returns the number of keys in the tree.
+ */
+int AdaptiveTreeSize(AdaptiveTree t)
+{
+	return (t == NULL) ? 0 : t->size;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches the tree for a given key.
+ */
+bool AdaptiveTreeSearch(AdaptiveTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	bool found;
+	if (t->engine == ENGINE_AVL)
+		found = TreeSearch(t->avl, key);
+	else if (t->engine == ENGINE_SNAPSHOT)
+	{
+		int i = LowerBound(t->keys, t->size, key);
+		found = i < t->size && t->keys[i] == key;
+	}
+	else
+		found = RoaringSetSearch(t->bitmap, key);
+
+	t->window.reads++;
+	Tick(t);
+	return found;
+}
+
+/**
+ * Inserts the given key into the tree.
+ */
+bool AdaptiveTreeInsert(AdaptiveTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	bool inserted;
+	if (t->engine == ENGINE_AVL)
+		inserted = TreeInsert(t->avl, key);
+	else if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		inserted = false;
+	}
+	else
+	{
+		if (t->engine == ENGINE_SNAPSHOT)
+			inserted = SnapshotInsert(t, key);
+		else
+			inserted = RoaringSetInsert(t->bitmap, key);
+
+		if (!inserted)
+			fprintf(stderr, "Value %d already Exists in Tree\n", key);
+	}
+
+	if (inserted)
+		t->size++;
+
+	t->window.writes++;
+	Tick(t);
+	return inserted;
+}
+
+/**
+ * Deletes the given key from the tree if it is present.
+ */
+bool AdaptiveTreeDelete(AdaptiveTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	bool deleted;
+	if (t->engine == ENGINE_AVL)
+		deleted = TreeDelete(t->avl, key);
+	else if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't accept UNDEFINED as input\n");
+		deleted = false;
+	}
+	else
+	{
+		if (t->engine == ENGINE_SNAPSHOT)
+			deleted = SnapshotDelete(t, key);
+		else
+			deleted = RoaringSetDelete(t->bitmap, key);
+
+		if (!deleted)
+			fprintf(stderr, "Value to Delete not in Tree\n");
+	}
+
+	if (deleted)
+		t->size--;
+
+	t->window.writes++;
+	Tick(t);
+	return deleted;
+}
+
+/**
+ * Insert a key into the sorted array, keeping it sorted
+ */
+static bool SnapshotInsert(AdaptiveTree t, int key)
+{
+	int i = LowerBound(t->keys, t->size, key);
+	if (i < t->size && t->keys[i] == key)
+		return false;
+
+	if (t->size == t->capacity)
+	{
+		int capacity = max(16, t->capacity * 2);
+		int *keys = realloc(t->keys, capacity * sizeof(int));
+
+		if (keys == NULL)
+		{
+			fprintf(stderr, "Could not grow Snapshot\n");
+			exit(EXIT_FAILURE);
+		}
+
+		t->keys = keys;
+		t->capacity = capacity;
+	}
+
+	memmove(&t->keys[i + 1], &t->keys[i], (t->size - i) * sizeof(int));
+	t->keys[i] = key;
+	return true;
+}
+
+/**
+ * Remove a key from the sorted array
+ */
+static bool SnapshotDelete(AdaptiveTree t, int key)
+{
+	int i = LowerBound(t->keys, t->size, key);
+	if (i == t->size || t->keys[i] != key)
+		return false;
+
+	memmove(&t->keys[i], &t->keys[i + 1], (t->size - i - 1) * sizeof(int));
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a list containing all the keys in the tree in ascending order.
+ */
+List AdaptiveTreeToList(AdaptiveTree t)
+{
+	if (t == NULL)
+		return ListNew();
+
+	List l;
+	if (t->engine == ENGINE_AVL)
+		l = TreeToList(t->avl);
+	else if (t->engine == ENGINE_SNAPSHOT)
+	{
+		l = ListNew();
+		for (int i = 0; i < t->size; i++)
+			ListAppend(l, t->keys[i]);
+	}
+	else
+		l = RoaringSetToList(t->bitmap);
+
+	t->window.ranges++;
+	t->window.rangeSpan += (double)UINT_MAX;
+	Tick(t);
+	return l;
+}
+
+/**
+ * Returns the k-th smallest key in the tree.
+ */
+int AdaptiveTreeKthSmallest(AdaptiveTree t, int k)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	int key;
+	if (k < 1 || k > t->size)
+		key = UNDEFINED;
+	else if (t->engine == ENGINE_AVL)
+		key = TreeKthSmallest(t->avl, k);
+	else if (t->engine == ENGINE_SNAPSHOT)
+		key = t->keys[k - 1];
+	else
+		key = RoaringSetKthSmallest(t->bitmap, k);
+
+	t->window.kths++;
+	t->window.kthWalk += k;
+	Tick(t);
+	return key;
+}
+
+/**
+ * Returns the k-th largest key in the tree.
+ */
+int AdaptiveTreeKthLargest(AdaptiveTree t, int k)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	int key;
+	if (k < 1 || k > t->size)
+		key = UNDEFINED;
+	else if (t->engine == ENGINE_AVL)
+		key = TreeKthLargest(t->avl, k);
+	else if (t->engine == ENGINE_SNAPSHOT)
+		key = t->keys[t->size - k];
+	else
+		key = RoaringSetKthLargest(t->bitmap, k);
+
+	t->window.kths++;
+	t->window.kthWalk += k;
+	Tick(t);
+	return key;
+}
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ */
+int AdaptiveTreeFloor(AdaptiveTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	int result;
+	if (t->engine == ENGINE_AVL)
+		result = TreeFloor(t->avl, key);
+	else if (t->engine == ENGINE_SNAPSHOT)
+	{
+		// Index of the first key greater than the given value
+		int i = (key == INT_MAX) ? t->size : LowerBound(t->keys, t->size, key + 1);
+		result = (i == 0) ? UNDEFINED : t->keys[i - 1];
+	}
+	else
+		result = RoaringSetFloor(t->bitmap, key);
+
+	t->window.reads++;
+	Tick(t);
+	return result;
+}
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ */
+int AdaptiveTreeCeiling(AdaptiveTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	int result;
+	if (t->engine == ENGINE_AVL)
+		result = TreeCeiling(t->avl, key);
+	else if (t->engine == ENGINE_SNAPSHOT)
+	{
+		int i = LowerBound(t->keys, t->size, key);
+		result = (i == t->size) ? UNDEFINED : t->keys[i];
+	}
+	else
+		result = RoaringSetCeiling(t->bitmap, key);
+
+	t->window.reads++;
+	Tick(t);
+	return result;
+}
+
+/**
+ * Searches for all keys between the two given keys (inclusive).
+ */
+List AdaptiveTreeSearchBetween(AdaptiveTree t, int lower, int upper)
+{
+	if (t == NULL)
+		return ListNew();
+
+	List l;
+	if (t->engine == ENGINE_AVL)
+		l = TreeSearchBetween(t->avl, lower, upper);
+	else if (t->engine == ENGINE_SNAPSHOT)
+	{
+		l = ListNew();
+		for (int i = LowerBound(t->keys, t->size, lower);
+			 i < t->size && t->keys[i] <= upper; i++)
+			ListAppend(l, t->keys[i]);
+	}
+	else
+		l = RoaringSetSearchBetween(t->bitmap, lower, upper);
+
+	t->window.ranges++;
+	if (upper >= lower)
+		t->window.rangeSpan += (double)upper - lower + 1;
+	Tick(t);
+	return l;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Migration decisions
+
+/**
+ * Count one operation and close the window once it is full
+ */
+static void Tick(AdaptiveTree t)
+{
+	if (++t->ops == ADAPTIVE_WINDOW)
+		EndWindow(t);
+}
+
+/**
+ * Measure the window that just ended, log the payoff of the previous
+ * migration, and migrate if the cost model favours another engine
+ */
+static void EndWindow(AdaptiveTree t)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double nsPerOp = Elapsed(&t->windowStart, &now) / t->ops;
+	t->windows++;
+
+	if (t->pending.active)
+	{
+		t->pending.nsAfter += nsPerOp;
+		if (++t->pending.windowsAfter == ADAPTIVE_HORIZON)
+			LogPayoff(t);
+	}
+
+	double n = t->size;
+	double density = KeyDensity(t);
+	double cost[NUM_ENGINES];
+	for (Engine e = 0; e < NUM_ENGINES; e++)
+		cost[e] = EngineCost(e, &t->window, n, density);
+
+	// Every cost is in before comparing, the current engine may come last
+	Engine best = t->engine;
+	for (Engine e = 0; e < NUM_ENGINES; e++)
+		if (cost[e] < cost[best])
+			best = e;
+
+	double saving = (cost[t->engine] - cost[best]) * ADAPTIVE_HORIZON;
+	double moving = MigrationCost(t->engine, best, n, density);
+
+	bool worthIt = best != t->engine && cost[best] < cost[t->engine] * ADAPTIVE_GAIN &&
+				   saving > moving * ADAPTIVE_MARGIN;
+	if (!worthIt)
+	{
+		t->streak = 0;
+	}
+	else if (t->streak > 0 && best == t->candidate)
+	{
+		t->streak++;
+		t->nsStreak += nsPerOp;
+	}
+	else
+	{
+		t->candidate = best;
+		t->streak = 1;
+		t->nsStreak = nsPerOp;
+	}
+
+	if (worthIt && t->streak >= ADAPTIVE_CONFIRM)
+	{
+		if (t->log != NULL)
+		{
+			struct workload *w = &t->window;
+			fprintf(t->log, "adaptive: window %ld: %ld reads, %ld writes, "
+					"%ld kth, %ld ranges; n = %d, density %.3g; est. ns/op "
+					"avl %.1f, snapshot %.1f, bitmap %.1f; migrating %s -> %s "
+					"(est. %.1f us)\n",
+					t->windows, w->reads, w->writes, w->kths, w->ranges,
+					t->size, density, cost[ENGINE_AVL] / t->ops,
+					cost[ENGINE_SNAPSHOT] / t->ops, cost[ENGINE_BITMAP] / t->ops,
+					EngineNames[t->engine], EngineNames[best], moving / 1000);
+		}
+
+		// A move before the last one has been measured cuts it short
+		if (t->pending.active)
+			LogPayoff(t);
+
+		struct timespec done;
+		t->pending = (struct pending){
+			.active = true,
+			.from = t->engine,
+			.to = best,
+			.nsBefore = t->nsStreak / t->streak,
+		};
+		Migrate(t, best);
+		t->streak = 0;
+		clock_gettime(CLOCK_MONOTONIC, &done);
+		t->pending.nsMigrate = Elapsed(&now, &done);
+		now = done;
+	}
+
+	memset(&t->window, 0, sizeof(t->window));
+	t->ops = 0;
+	t->windowStart = now;
+}
+
+/**
+ * Log how the windows since the last migration compare with the windows
+ * that led to it
+ */
+static void LogPayoff(AdaptiveTree t)
+{
+	struct pending *p = &t->pending;
+	p->active = false;
+	if (t->log == NULL || p->windowsAfter == 0)
+		return;
+
+	double nsAfter = p->nsAfter / p->windowsAfter;
+	fprintf(t->log, "adaptive: payoff %s -> %s: %.1f ns/op before, "
+			"%.1f ns/op over %d windows after, migration %.1f us, ",
+			EngineNames[p->from], EngineNames[p->to], p->nsBefore, nsAfter,
+			p->windowsAfter, p->nsMigrate / 1000);
+	if (nsAfter < p->nsBefore)
+		fprintf(t->log, "break-even after %.0f ops\n",
+				p->nsMigrate / (p->nsBefore - nsAfter));
+	else
+		fprintf(t->log, "no gain\n");
+}
+
+/**
+ * Estimated nanoseconds the given engine would take to run a workload.
+ *
+ * The constants are fitted to the lookups/sec and writes/sec columns of
+ * engineBench for the pointer, sorted and roaring engines, at n =
+ * 10^3..10^6 with spreads of 2, 16 and 1000, on an x86 core with a 1-2
+ * MB L2 (ns per operation):
+ *
+ *   n        avl read/write  snapshot read/write  array bitmap read/write
+ *   10^3        42 / 203          22 / 88               106 / 130
+ *   10^4        67 / 303          33 / 305              125 / 180
+ *   10^5       238 / 839          49 / 5600             170 / 260
+ *   10^6       891 / 1806        224 / 83800            246 / 385
+ *
+ * A tree level costs a few ns while the levels fit in cache and several
+ * times that once they do not, so the tree and array searches grow
+ * faster past a knee in log n. Writes to a tree search twice and malloc
+ * or free a node. memmove runs at about 64 bytes per ns in L1, 36 in L2
+ * and 24 beyond. The containers of a RoaringSet are searched with a
+ * branching binary search, which mispredicts about once per step.
+ */
+static double EngineCost(Engine e, struct workload *w, double n, double density)
+{
+	double lg = log2(n + 2);
+	// Expected keys in a range, and in each 65536 key container
+	double m = (w->ranges == 0) ? 0 : fmin(n, w->rangeSpan / w->ranges * density);
+	double chunk = fmax(1, fmin(n, 65536 * density));
+	double chunks = fmax(1, n / chunk);
+	double span = (w->ranges == 0) ? 0 : w->rangeSpan / w->ranges;
+	double walk = (w->kths == 0) ? 0 : (double)w->kthWalk / w->kths;
+
+	double read, write, kth, range;
+	switch (e)
+	{
+	case ENGINE_AVL:
+		read = 8 + 3 * lg + 12 * fmax(0, lg - 11) + 170 * fmax(0, lg - 16);
+		write = 120 + 2.2 * read;
+		kth = 5 + 5 * walk;
+		range = read + 25 * m;
+		break;
+	case ENGINE_SNAPSHOT:
+	{
+		// An insert or delete moves half the array on average
+		double bytesPerNs = (n <= 16384) ? 64 : (n <= 262144) ? 36 : 24;
+		read = 1 + 2.2 * lg + 4 * fmax(0, lg - 13) + 70 * fmax(0, lg - 18);
+		write = 20 + read + 2 * n / bytesPerNs;
+		kth = 2;
+		range = read + 21 * m;
+		break;
+	}
+	default:
+		// Array containers binary search and shift, bitmaps are O(1).
+		// A write that adds or empties a container shifts the
+		// container index, which happens about once per chunk writes.
+		read = 8 + 10 * log2(chunks + 1) + (chunk <= 4096 ? 10 * log2(chunk + 1) : 0);
+		write = 20 + read + (chunk <= 4096 ? chunk / 32 : 0) + chunks * 1.25 / chunk;
+		kth = chunks + 256;
+		range = read + 21 * m + fmin(span / 64, chunks * 1024) / 4;
+		break;
+	}
+
+	return w->reads * read + w->writes * write + w->kths * kth +
+		   w->ranges * range;
+}
+
+/**
+ * Estimated nanoseconds to move n keys from one engine to another
+ */
+static double MigrationCost(Engine from, Engine to, double n, double density)
+{
+	// Walking and freeing a pointer tree misses cache on every node
+	static const double extract[NUM_ENGINES] = {60, 0.5, 2};
+	static const double build[NUM_ENGINES] = {150, 0.5, 10};
+
+	// Sparse bitmaps pay a container allocation for every few keys
+	double chunk = fmax(1, fmin(n, 65536 * density));
+	double alloc = (to == ENGINE_BITMAP) ? 400 / chunk : 0;
+
+	return n * (extract[from] + build[to] + alloc);
+}
+
+/**
+ * Fraction of the integers between the smallest and largest key that
+ * are in the tree
+ */
+static double KeyDensity(AdaptiveTree t)
+{
+	if (t->size < 2)
+		return 0;
+
+	int lo, hi;
+	if (t->engine == ENGINE_AVL)
+	{
+		lo = TreeCeiling(t->avl, INT_MIN + 1);
+		hi = TreeFloor(t->avl, INT_MAX);
+	}
+	else if (t->engine == ENGINE_SNAPSHOT)
+	{
+		lo = t->keys[0];
+		hi = t->keys[t->size - 1];
+	}
+	else
+	{
+		lo = RoaringSetKthSmallest(t->bitmap, 1);
+		hi = RoaringSetKthLargest(t->bitmap, 1);
+	}
+
+	return t->size / ((double)hi - lo + 1);
+}
+
+/**
+ * Move every key into a new representation
+ */
+static void Migrate(AdaptiveTree t, Engine to)
+{
+	// Extract the keys in order
+	int *keys;
+	if (t->engine == ENGINE_SNAPSHOT)
+	{
+		keys = t->keys;
+		t->keys = NULL;
+	}
+	else
+	{
+		keys = malloc(max(1, t->size) * sizeof(int));
+		if (keys == NULL)
+		{
+			fprintf(stderr, "Could not malloc Migration Buffer\n");
+			exit(EXIT_FAILURE);
+		}
+
+		int count = 0;
+		if (t->engine == ENGINE_AVL)
+			NodeCollect(t->avl->root, keys, &count);
+		else
+			RoaringSetToArray(t->bitmap, keys);
+	}
+
+	FreeEngine(t);
+	t->engine = to;
+
+	// Rebuild in the new representation
+	if (to == ENGINE_SNAPSHOT)
+	{
+		t->keys = keys;
+		t->capacity = max(1, t->size);
+		return;
+	}
+
+	if (to == ENGINE_AVL)
+	{
+		t->avl = TreeNew();
+		t->avl->root = NodeBuild(keys, 0, t->size - 1);
+	}
+	else
+	{
+		t->bitmap = RoaringSetNew();
+		for (int i = 0; i < t->size; i++)
+			RoaringSetInsert(t->bitmap, keys[i]);
+		RoaringSetRunOptimize(t->bitmap);
+	}
+
+	free(keys);
+}
+
+/**
+ * Free the representation currently in use
+ */
+static void FreeEngine(AdaptiveTree t)
+{
+	TreeFree(t->avl);
+	free(t->keys);
+	RoaringSetFree(t->bitmap);
+	t->avl = NULL;
+	t->keys = NULL;
+	t->capacity = 0;
+	t->bitmap = NULL;
+}
+
+/**
+ * In order copy the keys of a subtree into an array
+ */
+static void NodeCollect(Node n, int *out, int *count)
+{
+	if (n == NULL)
+		return;
+
+	NodeCollect(n->left, out, count);
+	out[(*count)++] = n->key;
+	NodeCollect(n->right, out, count);
+}
+
+/**
+ * Build a perfectly balanced AVL subtree from sorted keys[lo..hi]
+ */
+static Node NodeBuild(const int *keys, int lo, int hi)
+{
+	if (lo > hi)
+		return NULL;
+
+	Node n = malloc(sizeof(*n));
+
+	if (n == NULL)
+	{
+		fprintf(stderr, "Could not malloc Node\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int mid = lo + (hi - lo) / 2;
+	n->key = keys[mid];
+	n->left = NodeBuild(keys, lo, mid - 1);
+	n->right = NodeBuild(keys, mid + 1, hi);
+
+	int left = (n->left == NULL) ? -1 : n->left->height;
+	int right = (n->right == NULL) ? -1 : n->right->height;
+	n->height = 1 + max(left, right);
+
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Returns the index of the first key not less than the given key,
+ * without a data dependent branch in the loop
+ */
+static int LowerBound(const int *keys, int size, int key)
+{
+	if (size == 0)
+		return 0;
+
+	const int *base = keys;
+	int n = size;
+
+	while (n > 1)
+	{
+		int half = n / 2;
+		base = (base[half] < key) ? base + half : base;
+		n -= half;
+	}
+
+	return (int)(base - keys) + (base[0] < key);
+}
+
+/**
+ * Returns the nanoseconds between two times
+ */
+static double Elapsed(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1e9 + (to->tv_nsec - from->tv_nsec);
+}
+
+/**
+ * Returns the maximum of two integers
+ */
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
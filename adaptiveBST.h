@@ -0,0 +1,138 @@
+// Operations on Adaptive Balanced Binary Search Trees.
+// A set of integers that keeps cheap counters of how it is being used
+// (reads, writes, k-th queries, range queries and their spans, and the
+// density of the keys) and migrates between three representations when
+// a simple cost model says another one will pay for the move:
+//
+//   avl      - the mutable AVL tree from bBST.c
+//   snapshot - a frozen sorted array: binary search, O(1) k-th, but
+//              every write shifts half the array
+//   bitmap   - a RoaringSet, for dense keysets
+//
+// The counters are examined every ADAPTIVE_WINDOW operations, and a
+// migration needs the same engine to come out ahead for consecutive
+// windows. Each migration is logged with the counters and cost estimates
+// that caused it, and the windows after it log the measured payoff.
+
+#ifndef ADAPTIVE_TREE_H
+#define ADAPTIVE_TREE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bBST.h"
+#include "List.h"
+
+// Number of operations between two migration decisions
+#define ADAPTIVE_WINDOW 4096
+
+typedef struct adaptiveTree *AdaptiveTree;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of keys in the
+// tree, and are for the representation currently in use. Every
+// ADAPTIVE_WINDOW operations one operation may also pay O(n log n) for
+// a migration.
+
+/**
+ * Creates a new empty tree, backed by an AVL tree.
+ * Migration decisions are logged to stderr.
+ * The time complexity of this function is O(1).
+ */
+AdaptiveTree AdaptiveTreeNew(void);
+
+/**
+ * Frees all memory allocated for the given tree.
+ * The time complexity of this function is O(n).
+ */
+void AdaptiveTreeFree(AdaptiveTree t);
+
+/**
+ * Sets the stream migration decisions are logged to.
+ * NULL turns logging off.
+ */
+void AdaptiveTreeSetLog(AdaptiveTree t, FILE *log);
+
+/**
+ * Returns the name of the representation currently in use:
+ * "avl", "snapshot" or "bitmap".
+ */
+const char *AdaptiveTreeEngine(AdaptiveTree t);
+
+/**
+ * Returns the number of keys in the tree.
+ * The time complexity of this function is O(1).
+ */
+int AdaptiveTreeSize(AdaptiveTree t);
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ * The time complexity of this function is O(log n).
+ */
+bool AdaptiveTreeSearch(AdaptiveTree t, int key);
+
+/**
+ * Inserts the given key into the tree.
+ * Returns true if the key was inserted successfully, or false if the
+ * key was already present in the tree.
+ * The time complexity of this function is O(log n), or O(n) while the
+ * tree is a snapshot.
+ */
+bool AdaptiveTreeInsert(AdaptiveTree t, int key);
+
+/**
+ * Deletes the given key from the tree if it is present.
+ * Returns true if the key was deleted successfully, or false if the key
+ * was not present in the tree.
+ * The time complexity of this function is O(log n), or O(n) while the
+ * tree is a snapshot.
+ */
+bool AdaptiveTreeDelete(AdaptiveTree t, int key);
+
+/**
+ * Creates a list containing all the keys in the given tree in ascending
+ * order.
+ * The time complexity of this function is O(n).
+ */
+List AdaptiveTreeToList(AdaptiveTree t);
+
+/**
+ * Returns the k-th smallest key in the tree.
+ * Returns UNDEFINED if k is not between 1 and the number of nodes.
+ * The time complexity of this function is O(log n + k), or O(1) while
+ * the tree is a snapshot.
+ */
+int AdaptiveTreeKthSmallest(AdaptiveTree t, int k);
+
+/**
+ * Returns the k-th largest key in the tree.
+ * Returns UNDEFINED if k is not between 1 and the number of nodes.
+ * The time complexity of this function is O(log n + k), or O(1) while
+ * the tree is a snapshot.
+ */
+int AdaptiveTreeKthLargest(AdaptiveTree t, int k);
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int AdaptiveTreeFloor(AdaptiveTree t, int key);
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int AdaptiveTreeCeiling(AdaptiveTree t, int key);
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in order in a list.
+ * The time complexity of this function is O(log n + m), where m is the
+ * length of the returned list.
+ */
+List AdaptiveTreeSearchBetween(AdaptiveTree t, int lower, int upper);
+
+#endif
@@ -0,0 +1,261 @@
+// Migration decision checker for the Adaptive Tree.
+// Fills an AdaptiveTree, runs fixed read/write mixes through it a whole
+// number of ADAPTIVE_WINDOW windows at a time and fails if the engine it
+// ends up on is not the one the cost model should pick, or if a
+// migration lost or invented a key.
+//
+// Decisions are made from operation counts, not timings, so the results
+// do not depend on the machine. A write deletes a random key or puts the
+// last deleted one back, which keeps the size and key range steady.
+//
+// Usage: ./adaptiveCheck [-s seed] [-v]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adaptiveBST.h"
+
+#define MAX_PHASES 12
+
+typedef struct phase
+{
+	int windows;
+	// Percentage of the operations that are writes
+	int writePct;
+	const char *expect;
+} Phase;
+
+typedef struct scenario
+{
+	const char *name;
+	int n;
+	// Keys are multiples of spread
+	int spread;
+	Phase phases[MAX_PHASES];
+} Scenario;
+
+static const Scenario Scenarios[] = {
+	{"small sparse, read only", 2000, 1000, {{8, 0, "snapshot"}}},
+	{"large sparse, write heavy", 50000, 1000, {{8, 57, "avl"}}},
+	{"large dense, read only", 50000, 1, {{8, 0, "bitmap"}}},
+	// Sparse array containers take writes for less than the tree does
+	{"read only, then write heavy", 20000, 1000,
+	 {{8, 0, "snapshot"}, {8, 57, "bitmap"}}},
+	// One window of each is never enough to confirm a move either way
+	{"alternating mixes", 20480, 1000,
+	 {{1, 0, "avl"}, {1, 75, "avl"}, {1, 0, "avl"}, {1, 75, "avl"},
+	  {1, 0, "avl"}, {1, 75, "avl"}, {1, 0, "avl"}, {1, 75, "avl"}}},
+	// Too big for the saving to pay for the move within the horizon
+	{"huge sparse, read only", 200000, 1000, {{8, 0, "avl"}}},
+};
+
+#define NUM_SCENARIOS (int)(sizeof(Scenarios) / sizeof(Scenarios[0]))
+
+typedef struct workload
+{
+	AdaptiveTree t;
+	int *keys;
+	int n;
+	int spread;
+	// Key taken out by the last delete, or -1 if it is back in
+	int held;
+	long ops;
+	unsigned int state;
+} Workload;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool runScenario(const Scenario *sc, unsigned int seed, bool verbose);
+static void fill(Workload *w);
+static void runOps(Workload *w, long ops, int writePct);
+static void writeKey(Workload *w);
+static bool sameKeys(Workload *w);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	unsigned int seed = 1;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-v") == 0)
+			verbose = true;
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-s seed] [-v]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int failures = 0;
+	for (int i = 0; i < NUM_SCENARIOS; i++)
+		failures += !runScenario(&Scenarios[i], (seed == 0) ? 1 : seed, verbose);
+
+	if (failures > 0)
+	{
+		printf("%d of %d scenarios failed\n", failures, NUM_SCENARIOS);
+		return EXIT_FAILURE;
+	}
+
+	printf("All %d scenarios passed\n", NUM_SCENARIOS);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Fill a tree and run each phase of a scenario, checking the engine at
+ * the end of every phase and the keys at the end of the scenario
+ */
+static bool runScenario(const Scenario *sc, unsigned int seed, bool verbose)
+{
+	Workload w = {
+		.t = AdaptiveTreeNew(),
+		.keys = malloc(sizeof(int) * sc->n),
+		.n = sc->n,
+		.spread = sc->spread,
+		.held = -1,
+		.ops = 0,
+		.state = seed,
+	};
+
+	if (w.keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	AdaptiveTreeSetLog(w.t, verbose ? stdout : NULL);
+	fill(&w);
+
+	bool ok = true;
+	const char *engine = AdaptiveTreeEngine(w.t);
+	for (int p = 0; p < MAX_PHASES && sc->phases[p].windows > 0; p++)
+	{
+		const Phase *ph = &sc->phases[p];
+		runOps(&w, (long)ph->windows * ADAPTIVE_WINDOW, ph->writePct);
+
+		engine = AdaptiveTreeEngine(w.t);
+		if (strcmp(engine, ph->expect) != 0)
+		{
+			printf("FAIL %-28s phase %d: %d%% writes at n = %d ended on %s, "
+				   "expected %s\n",
+				   sc->name, p + 1, ph->writePct, sc->n, engine, ph->expect);
+			ok = false;
+		}
+	}
+
+	// The searches may close further windows, so this comes last
+	if (!sameKeys(&w))
+	{
+		printf("FAIL %-28s keys differ from the reference after migrating\n",
+			   sc->name);
+		ok = false;
+	}
+
+	if (ok)
+		printf("PASS %-28s n = %d, ended on %s\n", sc->name, sc->n, engine);
+
+	AdaptiveTreeFree(w.t);
+	free(w.keys);
+	return ok;
+}
+
+/**
+ * Insert n multiples of spread in random order, then pad with writes
+ * up to the end of a window, so that every phase starts on a window
+ */
+static void fill(Workload *w)
+{
+	for (int i = 0; i < w->n; i++)
+		w->keys[i] = i * w->spread;
+	for (int i = w->n - 1; i > 0; i--)
+	{
+		int j = (int)(NextRandom(&w->state) % (unsigned int)(i + 1));
+		int tmp = w->keys[i];
+		w->keys[i] = w->keys[j];
+		w->keys[j] = tmp;
+	}
+
+	for (int i = 0; i < w->n; i++)
+		AdaptiveTreeInsert(w->t, w->keys[i]);
+	w->ops = w->n;
+
+	while (w->ops % ADAPTIVE_WINDOW != 0)
+		writeKey(w);
+}
+
+/**
+ * Run the given number of operations, each a write with probability
+ * writePct percent and otherwise a search anywhere in the key range
+ */
+static void runOps(Workload *w, long ops, int writePct)
+{
+	unsigned int range = (unsigned int)w->n * w->spread;
+
+	for (long i = 0; i < ops; i++)
+	{
+		if ((int)(NextRandom(&w->state) % 100) < writePct)
+		{
+			writeKey(w);
+		}
+		else
+		{
+			AdaptiveTreeSearch(w->t, (int)(NextRandom(&w->state) % range));
+			w->ops++;
+		}
+	}
+}
+
+/**
+ * Delete a random key, or put back the one deleted last
+ */
+static void writeKey(Workload *w)
+{
+	if (w->held >= 0)
+	{
+		AdaptiveTreeInsert(w->t, w->keys[w->held]);
+		w->held = -1;
+	}
+	else
+	{
+		w->held = (int)(NextRandom(&w->state) % (unsigned int)w->n);
+		AdaptiveTreeDelete(w->t, w->keys[w->held]);
+	}
+	w->ops++;
+}
+
+/**
+ * Whether the tree holds exactly the reference keys
+ */
+static bool sameKeys(Workload *w)
+{
+	int expected = w->n - (w->held >= 0);
+	if (AdaptiveTreeSize(w->t) != expected)
+		return false;
+
+	for (int i = 0; i < w->n; i++)
+		if (i != w->held && !AdaptiveTreeSearch(w->t, w->keys[i]))
+			return false;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,614 @@
+// Implementation of the Augmented Balanced Binary Search Tree.
+//
+// Every node caches the height, size, key sum and key set hash of its
+// subtree. They are recomputed from the children by Update, which is
+// called on each node of the path an insertion or deletion changed,
+// bottom up, and on the nodes a rotation moves, so they are right again
+// before any caller sees the tree.
+//
+// The smallest and largest keys of a subtree are not kept, as they are
+// its leftmost and rightmost nodes, which a range query passes on its
+// way anyway.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "augBST.h"
+#include "List.h"
+
+typedef struct augNode *AugNode;
+
+// What a range query adds up
+typedef struct summary
+{
+	AugAggregate aggregate;
+	uint64_t hash;
+} Summary;
+
+struct augNode
+{
+	int key;
+	int height;
+	int size;
+	long long sum;
+	uint64_t hash;
+	AugNode left;
+	AugNode right;
+};
+
+struct augTree
+{
+	AugNode root;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void FreeNode(AugNode n);
+static AugNode NodeCreate(int k);
+static AugNode NodeInsert(AugNode curr, AugNode n);
+static AugNode NodeDelete(AugNode curr, int key);
+static AugNode Rebalance(AugNode n);
+static AugNode RotateLeft(AugNode n);
+static AugNode RotateRight(AugNode n);
+static void Update(AugNode n);
+static int Height(AugNode n);
+static int Size(AugNode n);
+static long long Sum(AugNode n);
+static uint64_t Hash(AugNode n);
+static int GetBalance(AugNode n);
+static void NodeToList(List l, AugNode curr);
+static void NodeBetween(AugNode curr, long long lower, long long upper, List l, int *count);
+static Summary RangeSummary(AugTree t, long long lower, long long upper);
+static void AddKey(Summary *s, AugNode n);
+static void AddSubtree(Summary *s, AugNode n);
+static int NodeDiff(AugNode a, long long lower, long long upper, AugTree b, List onlyA,
+					List onlyB);
+static uint64_t KeyHash(int key);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty tree.
+ */
+AugTree AugTreeNew(void)
+{
+	AugTree t = malloc(sizeof(*t));
+
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc AugTree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t->root = NULL;
+	return t;
+}
+
+/**
+ * Frees all memory allocated for the given tree.
+ */
+void AugTreeFree(AugTree t)
+{
+	if (t == NULL)
+		return;
+
+	FreeNode(t->root);
+	free(t);
+}
+
+static void FreeNode(AugNode n)
+{
+	if (n == NULL)
+		return;
+
+	FreeNode(n->left);
+	FreeNode(n->right);
+	free(n);
+}
+
+/**
+ * Returns the number of keys in the tree.
+ */
+int AugTreeSize(AugTree t)
+{
+	return (t == NULL) ? 0 : Size(t->root);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ */
+bool AugTreeSearch(AugTree t, int key)
+{
+	if (t == NULL || key == UNDEFINED)
+		return false;
+
+	AugNode curr = t->root;
+	while (curr != NULL && curr->key != key)
+		curr = (key > curr->key) ? curr->right : curr->left;
+
+	return curr != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Inserts the given key into the tree.
+ */
+bool AugTreeInsert(AugTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	if (AugTreeSearch(t, key))
+	{
+		fprintf(stderr, "Value %d already Exists in Tree\n", key);
+		return false;
+	}
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return false;
+	}
+
+	t->root = NodeInsert(t->root, NodeCreate(key));
+	return true;
+}
+
+/**
+ * Create New node and set all properties
+ */
+static AugNode NodeCreate(int k)
+{
+	AugNode n = malloc(sizeof(*n));
+
+	if (n == NULL)
+	{
+		fprintf(stderr, "Could not malloc Node\n");
+		exit(EXIT_FAILURE);
+	}
+
+	n->key = k;
+	n->left = NULL;
+	n->right = NULL;
+	Update(n);
+	return n;
+}
+
+/**
+ * Search for correct position to insert new node
+ * Balance tree if necessary
+ */
+static AugNode NodeInsert(AugNode curr, AugNode n)
+{
+	if (curr == NULL)
+		return n;
+
+	if (curr->key > n->key)
+		curr->left = NodeInsert(curr->left, n);
+	else
+		curr->right = NodeInsert(curr->right, n);
+
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Deletes the given key from the tree if it is present.
+ */
+bool AugTreeDelete(AugTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't accept UNDEFINED as input\n");
+		return false;
+	}
+
+	if (!AugTreeSearch(t, key))
+	{
+		fprintf(stderr, "Value to Delete not in Tree\n");
+		return false;
+	}
+
+	t->root = NodeDelete(t->root, key);
+	return true;
+}
+
+/**
+ * Search for the node to delete
+ * Balance the tree if necessary
+ */
+static AugNode NodeDelete(AugNode curr, int key)
+{
+	if (curr == NULL)
+		return NULL;
+
+	if (key > curr->key)
+	{
+		curr->right = NodeDelete(curr->right, key);
+	}
+	else if (key < curr->key)
+	{
+		curr->left = NodeDelete(curr->left, key);
+	}
+	else if (curr->left == NULL || curr->right == NULL)
+	{
+		// Zero or one child, splice the node out
+		AugNode child = (curr->left == NULL) ? curr->right : curr->left;
+		free(curr);
+		return child;
+	}
+	else
+	{
+		// Two children, replace with the smallest key on the right. The
+		// key changes, so the sum and hash are recomputed by Rebalance
+		// below.
+		AugNode min = curr->right;
+		while (min->left != NULL)
+			min = min->left;
+
+		curr->key = min->key;
+		curr->right = NodeDelete(curr->right, curr->key);
+	}
+
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Update the augmented fields of a node and rotate it if it is
+ * unbalanced
+ */
+static AugNode Rebalance(AugNode n)
+{
+	Update(n);
+	int balance = GetBalance(n);
+
+	// Left Left and Left Right cases
+	if (balance > 1)
+	{
+		if (GetBalance(n->left) < 0)
+			n->left = RotateLeft(n->left);
+		return RotateRight(n);
+	}
+
+	// Right Right and Right Left cases
+	if (balance < -1)
+	{
+		if (GetBalance(n->right) > 0)
+			n->right = RotateRight(n->right);
+		return RotateLeft(n);
+	}
+
+	return n;
+}
+
+/**
+ * A rotation changes the subtrees of the two nodes it moves and of no
+ * other, so only they are updated, the lower one first
+ */
+static AugNode RotateLeft(AugNode n)
+{
+	AugNode y = n->right;
+	n->right = y->left;
+	y->left = n;
+
+	Update(n);
+	Update(y);
+	return y;
+}
+
+static AugNode RotateRight(AugNode n)
+{
+	AugNode y = n->left;
+	n->left = y->right;
+	y->right = n;
+
+	Update(n);
+	Update(y);
+	return y;
+}
+
+/**
+ * Recompute the height, size, sum and hash of a node from its children
+ */
+static void Update(AugNode n)
+{
+	n->height = 1 + max(Height(n->left), Height(n->right));
+	n->size = 1 + Size(n->left) + Size(n->right);
+	n->sum = Sum(n->left) + n->key + Sum(n->right);
+	n->hash = Hash(n->left) + KeyHash(n->key) + Hash(n->right);
+}
+
+static int Height(AugNode n)
+{
+	return (n == NULL) ? -1 : n->height;
+}
+
+static int Size(AugNode n)
+{
+	return (n == NULL) ? 0 : n->size;
+}
+
+static long long Sum(AugNode n)
+{
+	return (n == NULL) ? 0 : n->sum;
+}
+
+static uint64_t Hash(AugNode n)
+{
+	return (n == NULL) ? 0 : n->hash;
+}
+
+static int GetBalance(AugNode n)
+{
+	return Height(n->left) - Height(n->right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a list containing all the keys in the given tree in ascending
+ * order.
+ */
+List AugTreeToList(AugTree t)
+{
+	List l = ListNew();
+	if (t == NULL)
+		return l;
+
+	NodeToList(l, t->root);
+	return l;
+}
+
+static void NodeToList(List l, AugNode curr)
+{
+	if (curr == NULL)
+		return;
+
+	NodeToList(l, curr->left);
+	ListAppend(l, curr->key);
+	NodeToList(l, curr->right);
+}
+
+/**
+ * Append the keys of a subtree between lower and upper to a list, and
+ * count them
+ */
+static void NodeBetween(AugNode curr, long long lower, long long upper, List l, int *count)
+{
+	if (curr == NULL)
+		return;
+
+	if (curr->key > lower)
+		NodeBetween(curr->left, lower, upper, l, count);
+	if (curr->key >= lower && curr->key <= upper)
+	{
+		if (l != NULL)
+			ListAppend(l, curr->key);
+		(*count)++;
+	}
+	if (curr->key < upper)
+		NodeBetween(curr->right, lower, upper, l, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the k-th smallest key in the tree.
+ * The sizes say which side of each node the key is on, so this walks a
+ * single path.
+ */
+int AugTreeKthSmallest(AugTree t, int k)
+{
+	if (t == NULL || k < 1 || k > Size(t->root))
+		return UNDEFINED;
+
+	AugNode curr = t->root;
+	for (;;)
+	{
+		int left = Size(curr->left);
+		if (k == left + 1)
+			return curr->key;
+
+		if (k <= left)
+		{
+			curr = curr->left;
+		}
+		else
+		{
+			k -= left + 1;
+			curr = curr->right;
+		}
+	}
+}
+
+/**
+ * Returns the number of keys between the two given keys (inclusive).
+ */
+int AugTreeRangeCount(AugTree t, int lower, int upper)
+{
+	return RangeSummary(t, lower, upper).aggregate.count;
+}
+
+/**
+ * Returns the number, sum, smallest and largest of the keys between the
+ * two given keys (inclusive).
+ */
+AugAggregate AugTreeAggregateBetween(AugTree t, int lower, int upper)
+{
+	return RangeSummary(t, lower, upper).aggregate;
+}
+
+/**
+ * Returns the hash of the keys in the tree.
+ */
+uint64_t AugTreeHash(AugTree t)
+{
+	return (t == NULL) ? 0 : Hash(t->root);
+}
+
+/**
+ * Returns the hash of the keys between the two given keys (inclusive).
+ */
+uint64_t AugTreeRangeHash(AugTree t, int lower, int upper)
+{
+	return RangeSummary(t, lower, upper).hash;
+}
+
+/**
+ * Add up the keys between lower and upper. Below the first node in the
+ * range the paths to lower and upper part, and every subtree hung off
+ * them on the inside is in the range whole. The last node in the range
+ * on the path to lower is the smallest key, and on the path to upper
+ * the largest. Bounds are long long so that one past either end of int
+ * still fits.
+ */
+static Summary RangeSummary(AugTree t, long long lower, long long upper)
+{
+	Summary s = {.aggregate = {.min = UNDEFINED, .max = UNDEFINED}};
+	if (t == NULL || lower > upper)
+		return s;
+
+	AugNode split = t->root;
+	while (split != NULL && (split->key < lower || split->key > upper))
+		split = (split->key < lower) ? split->right : split->left;
+	if (split == NULL)
+		return s;
+
+	AddKey(&s, split);
+	s.aggregate.min = s.aggregate.max = split->key;
+
+	for (AugNode curr = split->left; curr != NULL;)
+	{
+		if (curr->key >= lower)
+		{
+			AddKey(&s, curr);
+			AddSubtree(&s, curr->right);
+			s.aggregate.min = curr->key;
+			curr = curr->left;
+		}
+		else
+		{
+			curr = curr->right;
+		}
+	}
+
+	for (AugNode curr = split->right; curr != NULL;)
+	{
+		if (curr->key <= upper)
+		{
+			AddKey(&s, curr);
+			AddSubtree(&s, curr->left);
+			s.aggregate.max = curr->key;
+			curr = curr->right;
+		}
+		else
+		{
+			curr = curr->left;
+		}
+	}
+
+	return s;
+}
+
+static void AddKey(Summary *s, AugNode n)
+{
+	s->aggregate.count++;
+	s->aggregate.sum += n->key;
+	s->hash += KeyHash(n->key);
+}
+
+static void AddSubtree(Summary *s, AugNode n)
+{
+	if (n == NULL)
+		return;
+
+	s->aggregate.count += n->size;
+	s->aggregate.sum += n->sum;
+	s->hash += n->hash;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Finds the keys that are in one tree but not the other.
+ * The two trees need not have the same shape, so a subtree of a is
+ * compared with the range of keys it covers in b rather than with a
+ * subtree of b.
+ */
+int AugTreeDiff(AugTree a, AugTree b, List onlyA, List onlyB)
+{
+	if (a == NULL || b == NULL)
+		return 0;
+
+	return NodeDiff(a->root, (long long)UNDEFINED + 1, INT_MAX, b, onlyA, onlyB);
+}
+
+/**
+ * Compare the subtree curr of a, whose keys all lie between lower and
+ * upper, with the keys of b in that range
+ */
+static int NodeDiff(AugNode curr, long long lower, long long upper, AugTree b, List onlyA,
+					List onlyB)
+{
+	if (lower > upper)
+		return 0;
+
+	// Everything of b in the range is missing from a
+	if (curr == NULL)
+	{
+		int count = 0;
+		if (b->root != NULL)
+			NodeBetween(b->root, lower, upper, onlyB, &count);
+		return count;
+	}
+
+	Summary s = RangeSummary(b, lower, upper);
+	if (s.aggregate.count == curr->size && s.hash == curr->hash)
+		return 0;
+
+	// Left first, so that both lists come out in ascending order
+	int found = NodeDiff(curr->left, lower, (long long)curr->key - 1, b, onlyA, onlyB);
+	if (!AugTreeSearch(b, curr->key))
+	{
+		if (onlyA != NULL)
+			ListAppend(onlyA, curr->key);
+		found++;
+	}
+	return found + NodeDiff(curr->right, (long long)curr->key + 1, upper, b, onlyA, onlyB);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Mix a key into 64 bits (the splitmix64 finaliser). It is a bijection,
+ * so no two keys hash the same, and every bit of the key affects every
+ * bit of the hash, so sums of different sets rarely meet.
+ */
+static uint64_t KeyHash(int key)
+{
+	uint64_t z = (uint32_t)key + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
@@ -0,0 +1,135 @@
+// Operations on Augmented Balanced Binary Search Trees.
+// An AVL tree whose nodes also hold the size of their subtree, the sum
+// of its keys and a hash of its key set. The hash of a set is the sum,
+// modulo 2^64, of a mixed 64-bit hash of each key, so it depends only on
+// which keys are in the set and not on the shape of the tree holding
+// them. Two trees built in
+// different orders, or one rebuilt from a snapshot, hash the same.
+//
+// The size, sum and hash of the keys in any range are found in O(log n)
+// from the subtrees hung off the two paths to its ends, so statistics
+// over a range cost the same however many keys it holds. AugTreeDiff
+// uses that to compare two trees: a subtree of one whose hash matches
+// the same key range of the other is skipped whole, so the work done
+// grows with the number of differences and only logarithmically with n.
+//
+// The hash is not cryptographic. It tells replicas apart after faults,
+// not after someone chose keys to collide.
+
+#ifndef AUG_TREE_H
+#define AUG_TREE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bBST.h"
+#include "List.h"
+
+typedef struct augTree *AugTree;
+
+typedef struct augAggregate
+{
+	int count;
+	long long sum;
+	// UNDEFINED if count is 0
+	int min;
+	int max;
+} AugAggregate;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of nodes in the
+// tree, unless otherwise specified.
+
+/**
+ * Creates a new empty tree.
+ * The time complexity of this function is O(1).
+ */
+AugTree AugTreeNew(void);
+
+/**
+ * Frees all memory allocated for the given tree.
+ * The time complexity of this function is O(n).
+ */
+void AugTreeFree(AugTree t);
+
+/**
+ * Returns the number of keys in the tree.
+ * The time complexity of this function is O(1).
+ */
+int AugTreeSize(AugTree t);
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ * The time complexity of this function is O(log n).
+ */
+bool AugTreeSearch(AugTree t, int key);
+
+/**
+ * Inserts the given key into the tree.
+ * Returns true if the key was inserted successfully, or false if the
+ * key was already present in the tree.
+ * The time complexity of this function is O(log n).
+ */
+bool AugTreeInsert(AugTree t, int key);
+
+/**
+ * Deletes the given key from the tree if it is present.
+ * Returns true if the key was deleted successfully, or false if the key
+ * was not present in the tree.
+ * The time complexity of this function is O(log n).
+ */
+bool AugTreeDelete(AugTree t, int key);
+
+/**
+ * Creates a list containing all the keys in the given tree in ascending
+ * order.
+ * The time complexity of this function is O(n).
+ */
+List AugTreeToList(AugTree t);
+
+/**
+ * Returns the k-th smallest key in the tree.
+ * Returns UNDEFINED if k is not between 1 and the number of nodes.
+ * The time complexity of this function is O(log n).
+ */
+int AugTreeKthSmallest(AugTree t, int k);
+
+/**
+ * Returns the number of keys between the two given keys (inclusive).
+ * The time complexity of this function is O(log n).
+ */
+int AugTreeRangeCount(AugTree t, int lower, int upper);
+
+/**
+ * Returns the number, sum, smallest and largest of the keys between the
+ * two given keys (inclusive).
+ * The time complexity of this function is O(log n).
+ */
+AugAggregate AugTreeAggregateBetween(AugTree t, int lower, int upper);
+
+/**
+ * Returns the hash of the keys in the tree. Trees holding the same keys
+ * have the same hash, however they were built.
+ * The time complexity of this function is O(1).
+ */
+uint64_t AugTreeHash(AugTree t);
+
+/**
+ * Returns the hash of the keys between the two given keys (inclusive),
+ * which is the hash a tree holding just those keys would have.
+ * The time complexity of this function is O(log n).
+ */
+uint64_t AugTreeRangeHash(AugTree t, int lower, int upper);
+
+/**
+ * Finds the keys that are in one tree but not the other. Keys only in a
+ * are appended to onlyA and keys only in b to onlyB, in ascending
+ * order; either list may be NULL.
+ * Returns the number of keys found.
+ * The time complexity of this function is O(d log^2 n + 1), where d is
+ * the number of keys found and n the size of the larger tree.
+ */
+int AugTreeDiff(AugTree a, AugTree b, List onlyA, List onlyB);
+
+#endif
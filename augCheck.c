@@ -0,0 +1,308 @@
+// Differential checker for the range queries of Augmented Trees.
+// Keeps an AugTree and a plain array of the same keys through rounds of
+// random inserts and deletes, and after each round compares
+// AugTreeRangeCount, AugTreeAggregateBetween and AugTreeRangeHash over
+// random ranges with a scan of the array. The reference hash of a range
+// is AugTreeHash of a tree built from just the keys the scan found.
+//
+// Ranges are drawn to hit the edge cases as well as the middle: bounds
+// on a key and one either side of it, empty ranges between two keys,
+// inverted bounds, and the ends of int.
+//
+// Usage: ./augCheck [-n max keys] [-r rounds] [-q queries] [-s seed]
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "augBST.h"
+#include "bBST.h"
+
+#define DEFAULT_MAX_KEYS 2000
+#define DEFAULT_ROUNDS 20
+#define DEFAULT_QUERIES 300
+// Keys are drawn from [-KEYSPACE, KEYSPACE), plus the ends of int
+#define KEYSPACE 5000
+
+typedef struct reference
+{
+	int *keys;
+	int size;
+} Reference;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void Update(AugTree t, Reference *ref, int maxKeys, unsigned int *state);
+static bool CheckRange(AugTree t, Reference *ref, int lower, int upper);
+static void RandomRange(Reference *ref, unsigned int *state, int *lower, int *upper);
+static int RandomKey(unsigned int *state);
+static int Nudge(int key, unsigned int *state);
+static int Find(Reference *ref, int key);
+static int orderIncreasing(const void *a, const void *b);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int maxKeys = DEFAULT_MAX_KEYS;
+	int rounds = DEFAULT_ROUNDS;
+	int queries = DEFAULT_QUERIES;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			maxKeys = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			rounds = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+			queries = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-n max keys] [-r rounds] [-q queries] [-s seed]\n",
+					argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (maxKeys < 1 || maxKeys > 2 * KEYSPACE || rounds < 1 || queries < 1)
+	{
+		fprintf(stderr, "Need 1 <= max keys <= %d and at least 1 round and query\n",
+				2 * KEYSPACE);
+		return EXIT_FAILURE;
+	}
+
+	unsigned int state = (seed == 0) ? 1 : seed;
+	AugTree t = AugTreeNew();
+	Reference ref = {.keys = malloc((maxKeys + 2) * sizeof(int)), .size = 0};
+	if (ref.keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	long checked = 0;
+	int failures = 0;
+	for (int round = 0; round < rounds && failures == 0; round++)
+	{
+		Update(t, &ref, maxKeys, &state);
+
+		if (AugTreeSize(t) != ref.size)
+		{
+			printf("FAIL round %d: tree has %d keys, reference %d\n", round,
+				   AugTreeSize(t), ref.size);
+			failures++;
+			break;
+		}
+
+		for (int q = 0; q < queries; q++)
+		{
+			int lower, upper;
+			RandomRange(&ref, &state, &lower, &upper);
+			if (!CheckRange(t, &ref, lower, upper) && ++failures == 10)
+				break;
+			checked++;
+		}
+
+		// The whole tree and an inverted range over everything
+		failures += !CheckRange(t, &ref, INT_MIN, INT_MAX);
+		failures += !CheckRange(t, &ref, INT_MAX, INT_MIN);
+		checked += 2;
+	}
+
+	AugTreeFree(t);
+	free(ref.keys);
+
+	if (failures > 0)
+	{
+		printf("%d ranges failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All %ld ranges matched over %d rounds\n", checked, rounds);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Insert and delete random keys in both the tree and the reference
+ * until the size reaches a random target, so that some rounds mostly
+ * insert and others mostly delete. The reference is left sorted.
+ */
+static void Update(AugTree t, Reference *ref, int maxKeys, unsigned int *state)
+{
+	int target = (int)(NextRandom(state) % (unsigned int)(maxKeys + 1));
+
+	for (int tries = 0; ref->size != target && tries < 4 * maxKeys; tries++)
+	{
+		if (ref->size < target)
+		{
+			// Duplicates are skipped, AugTreeInsert complains about them
+			int key = RandomKey(state);
+			if (Find(ref, key) >= 0)
+				continue;
+
+			if (!AugTreeInsert(t, key))
+				printf("FAIL insert %d returned false\n", key);
+			ref->keys[ref->size++] = key;
+		}
+		else
+		{
+			int i = (int)(NextRandom(state) % (unsigned int)ref->size);
+			if (!AugTreeDelete(t, ref->keys[i]))
+				printf("FAIL delete %d returned false\n", ref->keys[i]);
+			ref->keys[i] = ref->keys[--ref->size];
+		}
+	}
+
+	qsort(ref->keys, ref->size, sizeof(int), orderIncreasing);
+}
+
+/**
+ * Compare every range query of the tree with a scan of the reference
+ */
+static bool CheckRange(AugTree t, Reference *ref, int lower, int upper)
+{
+	AugAggregate want = {.count = 0, .sum = 0, .min = UNDEFINED, .max = UNDEFINED};
+	AugTree subset = AugTreeNew();
+
+	for (int i = 0; i < ref->size; i++)
+	{
+		int key = ref->keys[i];
+		if (key < lower || key > upper)
+			continue;
+
+		if (want.count == 0)
+			want.min = key;
+		want.max = key;
+		want.count++;
+		want.sum += key;
+		AugTreeInsert(subset, key);
+	}
+
+	uint64_t wantHash = AugTreeHash(subset);
+	AugTreeFree(subset);
+
+	AugAggregate got = AugTreeAggregateBetween(t, lower, upper);
+	int count = AugTreeRangeCount(t, lower, upper);
+	uint64_t hash = AugTreeRangeHash(t, lower, upper);
+
+	if (got.count == want.count && got.sum == want.sum && got.min == want.min &&
+		got.max == want.max && count == want.count && hash == wantHash)
+		return true;
+
+	printf("FAIL [%d, %d]: count %d/%d, sum %lld, min %d, max %d, hash %016llx; "
+		   "expected count %d, sum %lld, min %d, max %d, hash %016llx\n",
+		   lower, upper, got.count, count, got.sum, got.min, got.max,
+		   (unsigned long long)hash, want.count, want.sum, want.min, want.max,
+		   (unsigned long long)wantHash);
+	return false;
+}
+
+/**
+ * Pick the bounds of a range, most of the time near keys of the tree so
+ * that both inclusive ends are exercised
+ */
+static void RandomRange(Reference *ref, unsigned int *state, int *lower, int *upper)
+{
+	int a = RandomKey(state);
+	int b = RandomKey(state);
+
+	if (ref->size > 0)
+	{
+		int i = (int)(NextRandom(state) % (unsigned int)ref->size);
+		int j = (int)(NextRandom(state) % (unsigned int)ref->size);
+		switch (NextRandom(state) % 6)
+		{
+		case 0:
+			// On two keys
+			a = ref->keys[i];
+			b = ref->keys[j];
+			break;
+		case 1:
+			// One inside and one outside each end
+			a = Nudge(ref->keys[i], state);
+			b = Nudge(ref->keys[j], state);
+			break;
+		case 2:
+			// Strictly between two neighbouring keys, often empty
+			if (i + 1 < ref->size)
+			{
+				a = ref->keys[i] + 1;
+				b = ref->keys[i + 1] - 1;
+			}
+			break;
+		case 3:
+			// A single key
+			a = b = ref->keys[i];
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Ordered most of the time, inverted otherwise
+	bool inverted = NextRandom(state) % 8 == 0;
+	*lower = (a <= b) != inverted ? a : b;
+	*upper = (a <= b) != inverted ? b : a;
+}
+
+/**
+ * A key from the keyspace, or now and then one of the ends of int
+ */
+static int RandomKey(unsigned int *state)
+{
+	switch (NextRandom(state) % 64)
+	{
+	case 0:
+		return INT_MAX;
+	case 1:
+		return INT_MIN + 1;
+	default:
+		return (int)(NextRandom(state) % (2 * KEYSPACE)) - KEYSPACE;
+	}
+}
+
+/**
+ * The key itself or one either side of it, within int
+ */
+static int Nudge(int key, unsigned int *state)
+{
+	long long nudged = (long long)key + (int)(NextRandom(state) % 3) - 1;
+	return (nudged < INT_MIN) ? INT_MIN : (nudged > INT_MAX) ? INT_MAX : (int)nudged;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Find(Reference *ref, int key)
+{
+	for (int i = 0; i < ref->size; i++)
+		if (ref->keys[i] == key)
+			return i;
+	return -1;
+}
+
+static int orderIncreasing(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,250 @@
+// Side by side comparison of bbst::avl_set and bbst::avl_map (bbst.hpp)
+// with std::set and std::map, and for int keys with the C tree (bBST.h)
+// and map (bMap.h) as well. Every container gets the same shuffled
+// keyset and the same queries, and reports the memory used per key and
+// the insert, lookup, floor and erase throughput. Floors go through
+// upper_bound on every C++ container, the way std::set users find them.
+//
+// Usage: ./avlMapBench [n] [lookups] [seed]
+//
+// Keys are even, and queries are drawn from the whole key range, so
+// roughly half of the lookups miss.
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+extern "C"
+{
+#include "bBST.h"
+#include "bMap.h"
+}
+
+#include "bbst.hpp"
+
+#define DEFAULT_N 1000000
+#define DEFAULT_LOOKUPS 2000000
+
+// The C containers, with the interface the C++ ones share
+struct CTree
+{
+	Tree t = TreeNew();
+	~CTree() { TreeFree(t); }
+	bool insert(int key) { return TreeInsert(t, key); }
+	bool contains(int key) const { return TreeSearch(t, key); }
+	bool floor(int key, int &found) const
+	{
+		found = TreeFloor(t, key);
+		return found != UNDEFINED;
+	}
+	bool erase(int key) { return TreeDelete(t, key); }
+};
+
+struct CMap
+{
+	Map m = MapNew(sizeof(int));
+	~CMap() { MapFree(m); }
+	bool insert(int key) { return MapPut(m, key, &key, sizeof(key)); }
+	bool contains(int key) const { return MapGet(m, key, nullptr) != nullptr; }
+	bool floor(int key, int &found) const
+	{
+		MapEntry e;
+		if (!MapFloorEntry(m, key, &e))
+			return false;
+		found = e.key;
+		return true;
+	}
+	bool erase(int key) { return MapDelete(m, key); }
+};
+
+// Any std::set or std::map like container
+template <class Container, bool IsMap>
+struct Std
+{
+	using Key = typename Container::key_type;
+	Container c;
+
+	bool insert(const Key &key)
+	{
+		if constexpr (IsMap)
+			return c.try_emplace(key, typename Container::mapped_type()).second;
+		else
+			return c.insert(key).second;
+	}
+
+	bool contains(const Key &key) const { return c.find(key) != c.end(); }
+
+	bool floor(const Key &key, Key &found) const
+	{
+		auto it = c.upper_bound(key);
+		if (it == c.begin())
+			return false;
+		--it;
+		if constexpr (IsMap)
+			found = it->first;
+		else
+			found = *it;
+		return true;
+	}
+
+	bool erase(const Key &key) { return c.erase(key) == 1; }
+};
+
+template <class Container, class Key>
+static void runContainer(const char *name, Container &&container, const std::vector<Key> &keys,
+						 const std::vector<Key> &queries);
+static size_t heapInUse();
+static double now();
+static unsigned int nextRandom(unsigned int *state);
+
+int main(int argc, char **argv)
+{
+	int n = (argc > 1) ? atoi(argv[1]) : DEFAULT_N;
+	int nqueries = (argc > 2) ? atoi(argv[2]) : DEFAULT_LOOKUPS;
+	unsigned int seed = (argc > 3) ? (unsigned int)atoi(argv[3]) : 1;
+
+	if (seed == 0)
+		seed = 1;
+
+	if (n <= 0 || nqueries <= 0 || n > INT_MAX / 2)
+	{
+		fprintf(stderr, "Usage: %s [n] [lookups] [seed]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Even numbers in shuffled order, so there are no duplicates
+	std::vector<int> keys(n);
+	for (int i = 0; i < n; i++)
+		keys[i] = 2 * i;
+	for (int i = n - 1; i > 0; i--)
+		std::swap(keys[i], keys[nextRandom(&seed) % (unsigned int)(i + 1)]);
+
+	std::vector<int> queries(nqueries);
+	for (int i = 0; i < nqueries; i++)
+		queries[i] = (int)(nextRandom(&seed) % (2U * n));
+
+	// The same keys spread over 64 bits, and as strings that sort the
+	// same way
+	std::vector<long long> wideKeys(keys.begin(), keys.end());
+	std::vector<long long> wideQueries(queries.begin(), queries.end());
+	for (auto &k : wideKeys)
+		k *= 1LL << 30;
+	for (auto &q : wideQueries)
+		q *= 1LL << 30;
+
+	std::vector<std::string> stringKeys;
+	std::vector<std::string> stringQueries;
+	char buffer[32];
+	for (int k : keys)
+	{
+		snprintf(buffer, sizeof(buffer), "user:%010d", k);
+		stringKeys.push_back(buffer);
+	}
+	for (int q : queries)
+	{
+		snprintf(buffer, sizeof(buffer), "user:%010d", q);
+		stringQueries.push_back(buffer);
+	}
+
+	printf("%-28s %10s %10s %12s %12s %12s %12s\n", "container", "keys", "bytes/key",
+		   "inserts/sec", "lookups/sec", "floors/sec", "erases/sec");
+
+	runContainer("bBST.h Tree", CTree(), keys, queries);
+	runContainer("bbst::avl_set<int>", Std<bbst::avl_set<int>, false>(), keys, queries);
+	runContainer("std::set<int>", Std<std::set<int>, false>(), keys, queries);
+	runContainer("bMap.h Map int", CMap(), keys, queries);
+	runContainer("bbst::avl_map<int, int>", Std<bbst::avl_map<int, int>, true>(), keys, queries);
+	runContainer("std::map<int, int>", Std<std::map<int, int>, true>(), keys, queries);
+	runContainer("bbst::avl_map<int64, int64>", Std<bbst::avl_map<long long, long long>, true>(),
+				 wideKeys, wideQueries);
+	runContainer("std::map<int64, int64>", Std<std::map<long long, long long>, true>(), wideKeys,
+				 wideQueries);
+	runContainer("bbst::avl_map<string, int>", Std<bbst::avl_map<std::string, int>, true>(),
+				 stringKeys, stringQueries);
+	runContainer("std::map<string, int>", Std<std::map<std::string, int>, true>(), stringKeys,
+				 stringQueries);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Inserts every key, looks up and takes the floor of every query, then
+ * erases every key, and prints a row of the table
+ */
+template <class Container, class Key>
+static void runContainer(const char *name, Container &&container, const std::vector<Key> &keys,
+						 const std::vector<Key> &queries)
+{
+	size_t before = heapInUse();
+	double start = now();
+	int inserted = 0;
+	for (const Key &k : keys)
+		inserted += container.insert(k);
+	double insertElapsed = now() - start;
+	size_t bytes = heapInUse() - before;
+
+	start = now();
+	int found = 0;
+	for (const Key &q : queries)
+		found += container.contains(q);
+	double lookupElapsed = now() - start;
+
+	start = now();
+	int floors = 0;
+	Key floorKey{};
+	for (const Key &q : queries)
+		floors += container.floor(q, floorKey);
+	double floorElapsed = now() - start;
+
+	start = now();
+	int erased = 0;
+	for (const Key &k : keys)
+		erased += container.erase(k);
+	double eraseElapsed = now() - start;
+
+	printf("%-28s %10d %10.2f %12.0f %12.0f %12.0f %12.0f   (%d hits, %d floors, %d erased)\n",
+		   name, inserted, (double)bytes / inserted, keys.size() / insertElapsed,
+		   queries.size() / lookupElapsed, queries.size() / floorElapsed, keys.size() / eraseElapsed,
+		   found, floors, erased);
+}
+
+/* Helper Functions */
+
+/**
+ * Returns the number of bytes currently allocated on the heap,
+ * including allocator overhead
+ */
+static size_t heapInUse()
+{
+#ifdef __GLIBC__
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int nextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -12,6 +12,10 @@
 */
 ////////////////////////////////////////////////////////////////////////
 
+#include <string.h>
+
+#include "bBSTStats.h"
+
 ////////////////////////////////////////////////////////////////////////
 
 // Auxiliary function prototypes
@@ -95,6 +99,7 @@ static void FreeNode(Node n)
 	Node right = n->right;
 
 	free(n);
+	STATS_INC(frees);
 
 	FreeNode(left);
 	FreeNode(right);
@@ -129,6 +134,8 @@ static bool NodeSearch(Node n, int k)
 	if (n == NULL)
 		return false;
 
+	STATS_VISIT();
+
 	if (n->key == k)
 		return true;
 
@@ -149,9 +156,12 @@ bool TreeInsert(Tree t, int key)
 	if (t == NULL)
 		return false;
 
+	STATS_INC(inserts);
+
 	// Check if key already exists in tree
 	if (TreeSearch(t, key))
 	{
+		STATS_INC(duplicates);
 		fprintf(stderr, "Value %d already Exists in Tree\n", key);
 		return false;
 	}
@@ -173,7 +183,9 @@ bool TreeInsert(Tree t, int key)
 	}
 
 	// Insert new node into tree
+	STATS_RETRACE_BEGIN();
 	t->root = NodeInsert(t->root, new);
+	STATS_RETRACE_END();
 	return true;
 }
 
@@ -190,6 +202,8 @@ static Node NodeCreate(int k)
 		exit(EXIT_FAILURE);
 	}
 
+	STATS_INC(allocs);
+
 	n->key = k;
 	n->left = NULL;
 	n->right = NULL;
@@ -208,6 +222,8 @@ static Node NodeInsert(Node curr, Node n)
 	if (curr == NULL)
 		return n;
 
+	STATS_VISIT();
+
 	// Search for the correct position in the BST
 	if (curr->key > n->key)
 		curr->left = NodeInsert(curr->left, n);
@@ -243,11 +259,15 @@ static Node BalanceTree(Node curr, Node n, bool (*CheckCase)(Node, int))
 			{
 				y = z->left;
 				x = y->left;
+				STATS_ROTATE(ROTATE_LEFT_LEFT);
+				STATS_RETRACE(true);
 				return LeftLeftCase(x, y, z);
 			}
 
 			y = z->left;
 			x = y->right;
+			STATS_ROTATE(ROTATE_LEFT_RIGHT);
+			STATS_RETRACE(true);
 			return LeftRightCase(x, y, z);
 		} // Right cases if balance factor is less than -1
 		else
@@ -257,17 +277,23 @@ static Node BalanceTree(Node curr, Node n, bool (*CheckCase)(Node, int))
 			{
 				y = z->right;
 				x = y->right;
+				STATS_ROTATE(ROTATE_RIGHT_RIGHT);
+				STATS_RETRACE(true);
 				return RightRightCase(x, y, z);
 			}
 
 			y = z->right;
 			x = y->left;
+			STATS_ROTATE(ROTATE_RIGHT_LEFT);
+			STATS_RETRACE(true);
 			return RightLeftCase(x, y, z);
 		}
 	}
 
 	// Update current node's height
+	int oldHeight = curr->height;
 	UpdateHeight(curr);
+	STATS_RETRACE(curr->height != oldHeight);
 	return curr;
 }
 
@@ -376,8 +402,13 @@ bool TreeDelete(Tree t, int key)
 	if (t == NULL)
 		return false;
 
+	STATS_INC(deletes);
+
 	if (t->root == NULL)
+	{
+		STATS_INC(misses);
 		return false;
+	}
 
 	if (key == UNDEFINED)
 	{
@@ -388,12 +419,15 @@ bool TreeDelete(Tree t, int key)
 	// Can't delete if not in tree
 	if (!TreeSearch(t, key))
 	{
+		STATS_INC(misses);
 		fprintf(stderr, "Value to Delete not in Tree\n");
 		return false;
 	}
 
 	// Delete the node
+	STATS_RETRACE_BEGIN();
 	t->root = NodeDelete(t->root, key);
+	STATS_RETRACE_END();
 	return true;
 }
 
@@ -406,6 +440,8 @@ static Node NodeDelete(Node curr, int key)
 	if (curr == NULL)
 		return NULL;
 
+	STATS_VISIT();
+
 	// Search for node to be deleted
 	if (key > curr->key)
 		curr->right = NodeDelete(curr->right, key);
@@ -434,6 +470,7 @@ static Node GetNextNode(Node n)
 		// If no right child, replace with left child even if NULL
 		Node tempLeft = n->left;
 		free(n);
+		STATS_INC(frees);
 		return tempLeft;
 	}
 	else if (n->left == NULL)
@@ -441,6 +478,7 @@ static Node GetNextNode(Node n)
 		// If Only right child, replace with right child
 		Node tempRight = n->right;
 		free(n);
+		STATS_INC(frees);
 		return tempRight;
 	}
 
@@ -490,6 +528,8 @@ static void NodeToList(List l, Node curr)
 	if (curr == NULL)
 		return;
 
+	STATS_VISIT();
+
 	NodeToList(l, curr->left);
 	ListAppend(l, curr->key);
 	NodeToList(l, curr->right);
@@ -530,6 +570,8 @@ static Node NodeKthSmallest(Node curr, int k, int *count)
 	if (curr == NULL)
 		return NULL;
 
+	STATS_VISIT();
+
 	// In-order traverse through BST
 	Node left = NodeKthSmallest(curr->left, k, count);
 
@@ -576,6 +618,8 @@ static Node NodeKthLargest(Node curr, int k, int *count)
 	if (curr == NULL)
 		return NULL;
 
+	STATS_VISIT();
+
 	// Reach the largest node in the BST
 	Node right = NodeKthLargest(curr->right, k, count);
 
@@ -622,6 +666,8 @@ static Node NodeLCA(Node curr, int a, int b)
 	if (curr == NULL)
 		return NULL;
 
+	STATS_VISIT();
+
 	// Check if a and b are on different sides of the tree
 	bool ALeft = a < curr->key;
 	bool BLeft = b < curr->key;
@@ -662,6 +708,8 @@ static Node NodeFloor(Node curr, int key)
 	if (curr == NULL)
 		return NULL;
 
+	STATS_VISIT();
+
 	// Floor should return key if it is found
 	if (curr->key == key)
 		return curr;
@@ -699,6 +747,8 @@ static Node NodeCeiling(Node curr, int key)
 	if (curr == NULL)
 		return NULL;
 
+	STATS_VISIT();
+
 	// Return key if it is found in BST
 	if (curr->key == key)
 		return curr;
@@ -743,6 +793,8 @@ static void NodeSearchBetween(Node curr, int lower, int upper, List l)
 	if (curr == NULL)
 		return;
 
+	STATS_VISIT();
+
 	// Conditions to check if between lower and upper range
 	bool isAbove = curr->key >= lower;
 	bool isBelow = curr->key <= upper;
@@ -766,6 +818,47 @@ static void NodeSearchBetween(Node curr, int lower, int upper, List l)
 
 ////////////////////////////////////////////////////////////////////////
 
+#ifdef BBST_STATS
+TreeStats TreeStatsCounters;
+unsigned long TreeStatsRetrace;
+#endif
+
+/**
+ * Returns true if the instrumentation counters are compiled in.
+ */
+bool TreeStatsEnabled(void)
+{
+#ifdef BBST_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Copies the counters accumulated since the last reset.
+ */
+void TreeStatsGet(TreeStats *stats)
+{
+#ifdef BBST_STATS
+	*stats = TreeStatsCounters;
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+/**
+ * Sets every counter back to zero.
+ */
+void TreeStatsReset(void)
+{
+#ifdef BBST_STATS
+	memset(&TreeStatsCounters, 0, sizeof(TreeStatsCounters));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////
+
 /* Helper Functions */
 
 /**
@@ -0,0 +1,544 @@
+// Implementation of the Balanced Binary Search Tree of 64-bit keys.
+//
+// The tree keeps its size, so a duplicate insert is found on the way
+// down rather than by a search before it, and Tree64Size and the bounds
+// check of the k-th queries are O(1). A node with its 64-bit key is the
+// same 32 bytes as struct node.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bBST64.h"
+
+typedef struct node64 *Node64;
+
+struct node64
+{
+	int64_t key;
+	Node64 left;
+	Node64 right;
+	int height;
+};
+
+struct tree64
+{
+	Node64 root;
+	size_t size;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void FreeNode(Node64 n);
+static Node64 NodeCreate(int64_t k);
+static Node64 NodeInsert(Node64 curr, int64_t key, bool *inserted);
+static Node64 NodeDelete(Node64 curr, int64_t key, bool *deleted);
+static Node64 Rebalance(Node64 n);
+static Node64 RotateLeft(Node64 n);
+static Node64 RotateRight(Node64 n);
+static void UpdateHeight(Node64 n);
+static int Height(Node64 n);
+static int GetBalance(Node64 n);
+static void NodeToArray(Node64 curr, int64_t *keys, size_t *count);
+static Node64 NodeKthSmallest(Node64 curr, size_t k, size_t *count);
+static Node64 NodeKthLargest(Node64 curr, size_t k, size_t *count);
+static bool NodeSearchBetween(Node64 curr, int64_t lower, int64_t upper, Tree64Visitor visit,
+							  void *arg, size_t *count);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty tree.
+ */
+Tree64 Tree64New(void)
+{
+	Tree64 t = malloc(sizeof(*t));
+
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc Tree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t->root = NULL;
+	t->size = 0;
+	return t;
+}
+
+/**
+ * Frees all memory allocated for the given tree.
+ */
+void Tree64Free(Tree64 t)
+{
+	if (t == NULL)
+		return;
+
+	FreeNode(t->root);
+	free(t);
+}
+
+static void FreeNode(Node64 n)
+{
+	if (n == NULL)
+		return;
+
+	FreeNode(n->left);
+	FreeNode(n->right);
+	free(n);
+}
+
+/**
+ * Returns the number of keys in the tree.
+ */
+size_t Tree64Size(Tree64 t)
+{
+	return (t == NULL) ? 0 : t->size;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches the tree for a given key.
+ */
+bool Tree64Search(Tree64 t, int64_t key)
+{
+	if (t == NULL)
+		return false;
+
+	Node64 curr = t->root;
+	while (curr != NULL)
+	{
+		if (curr->key == key)
+			return true;
+		curr = (key > curr->key) ? curr->right : curr->left;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Inserts the given key into the tree.
+ */
+bool Tree64Insert(Tree64 t, int64_t key)
+{
+	if (t == NULL)
+		return false;
+
+	bool inserted = false;
+	t->root = NodeInsert(t->root, key, &inserted);
+	if (inserted)
+		t->size++;
+	return inserted;
+}
+
+/**
+ * Create New node and set all properties
+ */
+static Node64 NodeCreate(int64_t k)
+{
+	Node64 n = malloc(sizeof(*n));
+
+	if (n == NULL)
+	{
+		fprintf(stderr, "Could not malloc Node\n");
+		exit(EXIT_FAILURE);
+	}
+
+	n->key = k;
+	n->left = NULL;
+	n->right = NULL;
+	n->height = 0;
+	return n;
+}
+
+/**
+ * Search for the position of the key and insert a new node there,
+ * unless the key is already present
+ * Balance tree if necessary
+ */
+static Node64 NodeInsert(Node64 curr, int64_t key, bool *inserted)
+{
+	if (curr == NULL)
+	{
+		*inserted = true;
+		return NodeCreate(key);
+	}
+
+	if (key == curr->key)
+		return curr;
+
+	if (key < curr->key)
+		curr->left = NodeInsert(curr->left, key, inserted);
+	else
+		curr->right = NodeInsert(curr->right, key, inserted);
+
+	// Nothing below changed, so nothing needs rebalancing
+	if (!*inserted)
+		return curr;
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Deletes the given key from the tree.
+ */
+bool Tree64Delete(Tree64 t, int64_t key)
+{
+	if (t == NULL)
+		return false;
+
+	bool deleted = false;
+	t->root = NodeDelete(t->root, key, &deleted);
+	if (deleted)
+		t->size--;
+	return deleted;
+}
+
+/**
+ * Search for the node to delete
+ * Balance the tree if necessary
+ */
+static Node64 NodeDelete(Node64 curr, int64_t key, bool *deleted)
+{
+	if (curr == NULL)
+		return NULL;
+
+	if (key < curr->key)
+	{
+		curr->left = NodeDelete(curr->left, key, deleted);
+	}
+	else if (key > curr->key)
+	{
+		curr->right = NodeDelete(curr->right, key, deleted);
+	}
+	else if (curr->left == NULL || curr->right == NULL)
+	{
+		// Zero or one child, splice the node out
+		Node64 child = (curr->left == NULL) ? curr->right : curr->left;
+		free(curr);
+		*deleted = true;
+		return child;
+	}
+	else
+	{
+		// Two children, take the successor's key and delete it instead
+		Node64 next = curr->right;
+		while (next->left != NULL)
+			next = next->left;
+		curr->key = next->key;
+		curr->right = NodeDelete(curr->right, next->key, deleted);
+	}
+
+	if (!*deleted)
+		return curr;
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Update the height of a node and rotate it if it is unbalanced
+ */
+static Node64 Rebalance(Node64 n)
+{
+	UpdateHeight(n);
+	int balance = GetBalance(n);
+
+	// Left Left and Left Right cases
+	if (balance > 1)
+	{
+		if (GetBalance(n->left) < 0)
+			n->left = RotateLeft(n->left);
+		return RotateRight(n);
+	}
+
+	// Right Right and Right Left cases
+	if (balance < -1)
+	{
+		if (GetBalance(n->right) > 0)
+			n->right = RotateRight(n->right);
+		return RotateLeft(n);
+	}
+
+	return n;
+}
+
+static Node64 RotateLeft(Node64 n)
+{
+	Node64 y = n->right;
+	n->right = y->left;
+	y->left = n;
+
+	UpdateHeight(n);
+	UpdateHeight(y);
+	return y;
+}
+
+static Node64 RotateRight(Node64 n)
+{
+	Node64 y = n->left;
+	n->left = y->right;
+	y->right = n;
+
+	UpdateHeight(n);
+	UpdateHeight(y);
+	return y;
+}
+
+static void UpdateHeight(Node64 n)
+{
+	n->height = 1 + max(Height(n->left), Height(n->right));
+}
+
+static int Height(Node64 n)
+{
+	return (n == NULL) ? -1 : n->height;
+}
+
+static int GetBalance(Node64 n)
+{
+	return Height(n->left) - Height(n->right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Copies all the keys in the tree into an array in ascending order.
+ */
+size_t Tree64ToArray(Tree64 t, int64_t *keys)
+{
+	size_t count = 0;
+	if (t != NULL)
+		NodeToArray(t->root, keys, &count);
+	return count;
+}
+
+static void NodeToArray(Node64 curr, int64_t *keys, size_t *count)
+{
+	if (curr == NULL)
+		return;
+
+	NodeToArray(curr->left, keys, count);
+	keys[(*count)++] = curr->key;
+	NodeToArray(curr->right, keys, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Finds the k-th smallest key in the tree.
+ */
+bool Tree64KthSmallest(Tree64 t, size_t k, int64_t *result)
+{
+	if (t == NULL || k < 1 || k > t->size)
+		return false;
+
+	size_t count = 0;
+	*result = NodeKthSmallest(t->root, k, &count)->key;
+	return true;
+}
+
+/**
+ * In order traverse through BST to find the kth smallest node
+ */
+static Node64 NodeKthSmallest(Node64 curr, size_t k, size_t *count)
+{
+	if (curr == NULL)
+		return NULL;
+
+	Node64 left = NodeKthSmallest(curr->left, k, count);
+	if (left != NULL)
+		return left;
+
+	if (++(*count) == k)
+		return curr;
+
+	return NodeKthSmallest(curr->right, k, count);
+}
+
+/**
+ * Finds the k-th largest key in the tree.
+ */
+bool Tree64KthLargest(Tree64 t, size_t k, int64_t *result)
+{
+	if (t == NULL || k < 1 || k > t->size)
+		return false;
+
+	size_t count = 0;
+	*result = NodeKthLargest(t->root, k, &count)->key;
+	return true;
+}
+
+/**
+ * Reverse in order traverse through BST to find the kth largest node
+ */
+static Node64 NodeKthLargest(Node64 curr, size_t k, size_t *count)
+{
+	if (curr == NULL)
+		return NULL;
+
+	Node64 right = NodeKthLargest(curr->right, k, count);
+	if (right != NULL)
+		return right;
+
+	if (++(*count) == k)
+		return curr;
+
+	return NodeKthLargest(curr->left, k, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Finds the least common ancestor of two keys.
+ */
+bool Tree64LCA(Tree64 t, int64_t a, int64_t b, int64_t *result)
+{
+	if (!Tree64Search(t, a) || !Tree64Search(t, b))
+		return false;
+
+	// Both keys are present, so the paths to them split at the LCA, or
+	// one of them is found first
+	Node64 curr = t->root;
+	while (true)
+	{
+		if (a < curr->key && b < curr->key)
+			curr = curr->left;
+		else if (a > curr->key && b > curr->key)
+			curr = curr->right;
+		else
+			break;
+	}
+
+	*result = curr->key;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Finds the largest key less than or equal to the given value.
+ */
+bool Tree64Floor(Tree64 t, int64_t key, int64_t *result)
+{
+	if (t == NULL)
+		return false;
+
+	// The last node we turned right at is the best floor so far
+	Node64 floor = NULL;
+	Node64 curr = t->root;
+	while (curr != NULL)
+	{
+		if (curr->key == key)
+		{
+			floor = curr;
+			break;
+		}
+
+		if (curr->key > key)
+		{
+			curr = curr->left;
+		}
+		else
+		{
+			floor = curr;
+			curr = curr->right;
+		}
+	}
+
+	if (floor == NULL)
+		return false;
+
+	*result = floor->key;
+	return true;
+}
+
+/**
+ * Finds the smallest key greater than or equal to the given value.
+ */
+bool Tree64Ceiling(Tree64 t, int64_t key, int64_t *result)
+{
+	if (t == NULL)
+		return false;
+
+	Node64 ceiling = NULL;
+	Node64 curr = t->root;
+	while (curr != NULL)
+	{
+		if (curr->key == key)
+		{
+			ceiling = curr;
+			break;
+		}
+
+		if (curr->key < key)
+		{
+			curr = curr->right;
+		}
+		else
+		{
+			ceiling = curr;
+			curr = curr->left;
+		}
+	}
+
+	if (ceiling == NULL)
+		return false;
+
+	*result = ceiling->key;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Calls visit on each key between the two given keys.
+ */
+size_t Tree64SearchBetween(Tree64 t, int64_t lower, int64_t upper, Tree64Visitor visit,
+						   void *arg)
+{
+	size_t count = 0;
+	if (t != NULL && lower <= upper)
+		NodeSearchBetween(t->root, lower, upper, visit, arg, &count);
+	return count;
+}
+
+/**
+ * In order traverse the part of a subtree in the range. Returns false
+ * once the visitor has asked to stop.
+ */
+static bool NodeSearchBetween(Node64 curr, int64_t lower, int64_t upper, Tree64Visitor visit,
+							  void *arg, size_t *count)
+{
+	if (curr == NULL)
+		return true;
+
+	if (curr->key > lower && !NodeSearchBetween(curr->left, lower, upper, visit, arg, count))
+		return false;
+
+	if (curr->key >= lower && curr->key <= upper)
+	{
+		(*count)++;
+		if (!visit(curr->key, arg))
+			return false;
+	}
+
+	if (curr->key < upper)
+		return NodeSearchBetween(curr->right, lower, upper, visit, arg, count);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
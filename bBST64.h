@@ -0,0 +1,130 @@
+// Operations on Balanced Binary Search Trees of 64-bit keys.
+// An AVL tree like the one in bBST.h, but with int64_t keys and no
+// reserved value: every key from INT64_MIN to INT64_MAX can be stored,
+// so 64-bit IDs, timestamps and hashes go in as they are.
+//
+// Instead of returning UNDEFINED when there is no answer, queries return
+// whether they found one and write it through an out-parameter, which is
+// left alone otherwise. Nothing on the search, insert or delete paths
+// compares a key against a sentinel, and duplicate inserts and missing
+// deletes are reported only through the return value.
+
+#ifndef TREE64_H
+#define TREE64_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct tree64 *Tree64;
+
+/**
+ * Called by Tree64SearchBetween for each key in the range, in ascending
+ * order. Returns false to stop the iteration.
+ */
+typedef bool (*Tree64Visitor)(int64_t key, void *arg);
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of nodes in the
+// tree, unless otherwise specified.
+
+/**
+ * Creates a new empty tree.
+ * The time complexity of this function is O(1).
+ */
+Tree64 Tree64New(void);
+
+/**
+ * Frees all memory allocated for the given tree.
+ * The time complexity of this function is O(n).
+ */
+void Tree64Free(Tree64 t);
+
+/**
+ * Returns the number of keys in the tree.
+ * The time complexity of this function is O(1).
+ */
+size_t Tree64Size(Tree64 t);
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ * The time complexity of this function is O(log n).
+ */
+bool Tree64Search(Tree64 t, int64_t key);
+
+/**
+ * Inserts the given key into the tree.
+ * Returns true if the key was inserted, or false if it was already
+ * present in the tree.
+ * The time complexity of this function is O(log n).
+ */
+bool Tree64Insert(Tree64 t, int64_t key);
+
+/**
+ * Deletes the given key from the tree if it is present.
+ * Returns true if the key was deleted, or false if it was not present.
+ * The time complexity of this function is O(log n).
+ */
+bool Tree64Delete(Tree64 t, int64_t key);
+
+/**
+ * Copies all the keys in the tree into keys, in ascending order. keys
+ * must have room for Tree64Size(t) keys.
+ * Returns the number of keys copied.
+ * The time complexity of this function is O(n).
+ */
+size_t Tree64ToArray(Tree64 t, int64_t *keys);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Finds the k-th smallest key in the tree, k = 1 being the smallest.
+ * Returns false, leaving result alone, if k is not between 1 and the
+ * number of keys in the tree.
+ * The time complexity of this function is O(log n + k).
+ */
+bool Tree64KthSmallest(Tree64 t, size_t k, int64_t *result);
+
+/**
+ * Finds the k-th largest key in the tree, k = 1 being the largest.
+ * Returns false, leaving result alone, if k is not between 1 and the
+ * number of keys in the tree.
+ * The time complexity of this function is O(log n + k).
+ */
+bool Tree64KthLargest(Tree64 t, size_t k, int64_t *result);
+
+/**
+ * Finds the least common ancestor of two keys, a and b, either of which
+ * may be the larger, and either of which may be the LCA.
+ * Returns false, leaving result alone, if a or b is not in the tree.
+ * The time complexity of this function is O(log n).
+ */
+bool Tree64LCA(Tree64 t, int64_t a, int64_t b, int64_t *result);
+
+/**
+ * Finds the largest key less than or equal to the given value.
+ * Returns false, leaving result alone, if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+bool Tree64Floor(Tree64 t, int64_t key, int64_t *result);
+
+/**
+ * Finds the smallest key greater than or equal to the given value.
+ * Returns false, leaving result alone, if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+bool Tree64Ceiling(Tree64 t, int64_t key, int64_t *result);
+
+/**
+ * Calls visit on each key between the two given keys (inclusive), in
+ * ascending order, until it returns false. The tree must not be changed
+ * during the iteration.
+ * Returns the number of keys visited.
+ * The time complexity of this function is O(log n + m), where m is the
+ * number of keys visited.
+ */
+size_t Tree64SearchBetween(Tree64 t, int64_t lower, int64_t upper, Tree64Visitor visit,
+						   void *arg);
+
+#endif
@@ -0,0 +1,378 @@
+// Implementation of the Balanced Binary Search Tree Queue.
+//
+// The cache holds the smallest and largest keys rather than their
+// nodes, since TreeDelete may move a key from one node to another and
+// free the node it came from.
+//
+// The pops work on the nodes of the Tree directly, with the same
+// rotations as bBST.c. Removing the smallest key only ever unlinks the
+// leftmost node, whose right child, if any, is a leaf, so the new
+// smallest key is that leaf or the node above, both at hand in the same
+// pass. Removing a batch drops whole left subtrees, which can leave a
+// node's two sides far apart in height, so each node kept on the way
+// back up is joined to what is left below it instead of rotated once.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bBSTQueue.h"
+#include "bBST.h"
+
+struct treeQueue
+{
+	Tree t;
+	// UNDEFINED while the queue is empty
+	int min;
+	int max;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static Node RemoveMin(Node curr, Node parent, Node *min, Node *next);
+static Node RemoveMax(Node curr, Node parent, Node *max, Node *next);
+static Node DropSmallest(Node curr, int k, int *keys, int *count);
+static Node Join(Node left, Node mid, Node right);
+static Node Rebalance(Node n);
+static Node RotateLeft(Node n);
+static Node RotateRight(Node n);
+static void UpdateHeight(Node n);
+static int Height(Node n);
+static int GetBalance(Node n);
+static int Leftmost(Node n);
+static int Rightmost(Node n);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty queue.
+ */
+TreeQueue TreeQueueNew(void)
+{
+	TreeQueue q = malloc(sizeof(*q));
+
+	if (q == NULL)
+	{
+		fprintf(stderr, "Could not malloc Queue\n");
+		exit(EXIT_FAILURE);
+	}
+
+	q->t = TreeNew();
+	q->min = UNDEFINED;
+	q->max = UNDEFINED;
+	return q;
+}
+
+/**
+ * Frees all memory allocated for the given queue.
+ */
+void TreeQueueFree(TreeQueue q)
+{
+	if (q == NULL)
+		return;
+
+	TreeFree(q->t);
+	free(q);
+}
+
+/**
+ * Returns the tree holding the keys of the queue.
+ */
+Tree TreeQueueTree(TreeQueue q)
+{
+	return (q == NULL) ? NULL : q->t;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Inserts the given key into the queue.
+ */
+bool TreeQueueInsert(TreeQueue q, int key)
+{
+	if (q == NULL || !TreeInsert(q->t, key))
+		return false;
+
+	if (q->min == UNDEFINED || key < q->min)
+		q->min = key;
+	if (q->max == UNDEFINED || key > q->max)
+		q->max = key;
+	return true;
+}
+
+/**
+ * Deletes the given key from the queue.
+ */
+bool TreeQueueDelete(TreeQueue q, int key)
+{
+	if (q == NULL || !TreeDelete(q->t, key))
+		return false;
+
+	// Only losing an end moves the cache, and the new end is a walk down
+	// a spine away
+	if (key == q->min)
+		q->min = Leftmost(q->t->root);
+	if (key == q->max)
+		q->max = Rightmost(q->t->root);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the smallest key in the queue.
+ */
+int TreeQueueMin(TreeQueue q)
+{
+	return (q == NULL) ? UNDEFINED : q->min;
+}
+
+/**
+ * Returns the largest key in the queue.
+ */
+int TreeQueueMax(TreeQueue q)
+{
+	return (q == NULL) ? UNDEFINED : q->max;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Removes and returns the smallest key in the queue.
+ */
+int TreeQueuePopMin(TreeQueue q)
+{
+	if (q == NULL || q->t->root == NULL)
+		return UNDEFINED;
+
+	Node min;
+	Node next;
+	q->t->root = RemoveMin(q->t->root, NULL, &min, &next);
+
+	int key = min->key;
+	free(min);
+
+	q->min = (next == NULL) ? UNDEFINED : next->key;
+	if (q->t->root == NULL)
+		q->max = UNDEFINED;
+	return key;
+}
+
+/**
+ * Unlink the leftmost node of a subtree, returning the rest balanced.
+ * next is set to the node holding the smallest key left, which is the
+ * right child of the leftmost node or else its parent.
+ */
+static Node RemoveMin(Node curr, Node parent, Node *min, Node *next)
+{
+	if (curr->left == NULL)
+	{
+		*min = curr;
+		*next = (curr->right != NULL) ? curr->right : parent;
+		return curr->right;
+	}
+
+	curr->left = RemoveMin(curr->left, curr, min, next);
+	return Rebalance(curr);
+}
+
+/**
+ * Removes and returns the largest key in the queue.
+ */
+int TreeQueuePopMax(TreeQueue q)
+{
+	if (q == NULL || q->t->root == NULL)
+		return UNDEFINED;
+
+	Node max;
+	Node next;
+	q->t->root = RemoveMax(q->t->root, NULL, &max, &next);
+
+	int key = max->key;
+	free(max);
+
+	q->max = (next == NULL) ? UNDEFINED : next->key;
+	if (q->t->root == NULL)
+		q->min = UNDEFINED;
+	return key;
+}
+
+/**
+ * Mirror image of RemoveMin
+ */
+static Node RemoveMax(Node curr, Node parent, Node *max, Node *next)
+{
+	if (curr->right == NULL)
+	{
+		*max = curr;
+		*next = (curr->left != NULL) ? curr->left : parent;
+		return curr->left;
+	}
+
+	curr->right = RemoveMax(curr->right, curr, max, next);
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Removes the k smallest keys in the queue.
+ */
+int TreeQueuePopMinBatch(TreeQueue q, int k, int *keys)
+{
+	if (q == NULL || k <= 0)
+		return 0;
+
+	int count = 0;
+	q->t->root = DropSmallest(q->t->root, k, keys, &count);
+
+	q->min = Leftmost(q->t->root);
+	if (q->t->root == NULL)
+		q->max = UNDEFINED;
+	return count;
+}
+
+/**
+ * In order remove nodes from a subtree until k keys have been taken in
+ * total, returning what is left balanced. A node that stays has lost
+ * part or all of its left subtree, so it is joined back together with
+ * what is left of it.
+ */
+static Node DropSmallest(Node curr, int k, int *keys, int *count)
+{
+	if (curr == NULL || *count == k)
+		return curr;
+
+	Node left = DropSmallest(curr->left, k, keys, count);
+	if (*count == k)
+		return Join(left, curr, curr->right);
+
+	// The whole left subtree is gone, this node goes too
+	keys[(*count)++] = curr->key;
+	Node right = curr->right;
+	free(curr);
+	return DropSmallest(right, k, keys, count);
+}
+
+/**
+ * Join two AVL trees and a node whose key lies between them into one.
+ * The node is hung off the spine of the taller tree where the heights
+ * meet, and rebalanced on the way back up, in O(1 + the difference in
+ * height).
+ */
+static Node Join(Node left, Node mid, Node right)
+{
+	if (Height(left) > Height(right) + 1)
+	{
+		left->right = Join(left->right, mid, right);
+		return Rebalance(left);
+	}
+
+	if (Height(right) > Height(left) + 1)
+	{
+		right->left = Join(left, mid, right->left);
+		return Rebalance(right);
+	}
+
+	mid->left = left;
+	mid->right = right;
+	UpdateHeight(mid);
+	return mid;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Update the height of a node and rotate it if it is unbalanced
+ */
+static Node Rebalance(Node n)
+{
+	UpdateHeight(n);
+	int balance = GetBalance(n);
+
+	// Left Left and Left Right cases
+	if (balance > 1)
+	{
+		if (GetBalance(n->left) < 0)
+			n->left = RotateLeft(n->left);
+		return RotateRight(n);
+	}
+
+	// Right Right and Right Left cases
+	if (balance < -1)
+	{
+		if (GetBalance(n->right) > 0)
+			n->right = RotateRight(n->right);
+		return RotateLeft(n);
+	}
+
+	return n;
+}
+
+static Node RotateLeft(Node n)
+{
+	Node y = n->right;
+	n->right = y->left;
+	y->left = n;
+
+	UpdateHeight(n);
+	UpdateHeight(y);
+	return y;
+}
+
+static Node RotateRight(Node n)
+{
+	Node y = n->left;
+	n->left = y->right;
+	y->right = n;
+
+	UpdateHeight(n);
+	UpdateHeight(y);
+	return y;
+}
+
+static void UpdateHeight(Node n)
+{
+	n->height = 1 + max(Height(n->left), Height(n->right));
+}
+
+static int Height(Node n)
+{
+	return (n == NULL) ? -1 : n->height;
+}
+
+static int GetBalance(Node n)
+{
+	return Height(n->left) - Height(n->right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Leftmost(Node n)
+{
+	if (n == NULL)
+		return UNDEFINED;
+
+	while (n->left != NULL)
+		n = n->left;
+	return n->key;
+}
+
+static int Rightmost(Node n)
+{
+	if (n == NULL)
+		return UNDEFINED;
+
+	while (n->right != NULL)
+		n = n->right;
+	return n->key;
+}
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
@@ -0,0 +1,96 @@
+// Balanced Binary Search Trees used as priority queues.
+// A TreeQueue is a Tree from bBST.h with its smallest and largest keys
+// cached, so a scheduler can read the next key in O(1) instead of
+// walking to it with TreeKthSmallest(t, 1), and take it out in one pass
+// down the left or right spine instead of a walk followed by a
+// TreeDelete that searches from the root again.
+//
+// Keys are unique, as in the Tree: inserting a key that is already
+// queued fails. Changes must go through the functions below, which keep
+// the cache right. The Tree itself may be read with the bBST.h
+// functions.
+
+#ifndef TREE_QUEUE_H
+#define TREE_QUEUE_H
+
+#include <stdbool.h>
+
+#include "bBST.h"
+
+typedef struct treeQueue *TreeQueue;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of keys in the
+// queue, unless otherwise specified.
+
+/**
+ * Creates a new empty queue.
+ * The time complexity of this function is O(1).
+ */
+TreeQueue TreeQueueNew(void);
+
+/**
+ * Frees all memory allocated for the given queue.
+ * The time complexity of this function is O(n).
+ */
+void TreeQueueFree(TreeQueue q);
+
+/**
+ * Returns the tree holding the keys of the queue, for the read only
+ * queries of bBST.h. It must not be changed other than through the
+ * queue.
+ * The time complexity of this function is O(1).
+ */
+Tree TreeQueueTree(TreeQueue q);
+
+/**
+ * Inserts the given key into the queue.
+ * Returns true if the key was inserted, or false if it was already
+ * present, as TreeInsert does.
+ * The time complexity of this function is O(log n).
+ */
+bool TreeQueueInsert(TreeQueue q, int key);
+
+/**
+ * Deletes the given key from the queue if it is present.
+ * Returns true if the key was deleted, or false if it was not present.
+ * The time complexity of this function is O(log n).
+ */
+bool TreeQueueDelete(TreeQueue q, int key);
+
+/**
+ * Returns the smallest key in the queue, or UNDEFINED if it is empty.
+ * The time complexity of this function is O(1).
+ */
+int TreeQueueMin(TreeQueue q);
+
+/**
+ * Returns the largest key in the queue, or UNDEFINED if it is empty.
+ * The time complexity of this function is O(1).
+ */
+int TreeQueueMax(TreeQueue q);
+
+/**
+ * Removes and returns the smallest key in the queue, or returns
+ * UNDEFINED if it is empty.
+ * The time complexity of this function is O(log n).
+ */
+int TreeQueuePopMin(TreeQueue q);
+
+/**
+ * Removes and returns the largest key in the queue, or returns
+ * UNDEFINED if it is empty.
+ * The time complexity of this function is O(log n).
+ */
+int TreeQueuePopMax(TreeQueue q);
+
+/**
+ * Removes the k smallest keys in the queue, or all of them if there are
+ * fewer, and writes them to keys in ascending order. keys must have room
+ * for k keys.
+ * Returns the number of keys removed.
+ * The time complexity of this function is O(k + log n).
+ */
+int TreeQueuePopMinBatch(TreeQueue q, int k, int *keys);
+
+#endif
@@ -0,0 +1,88 @@
+// Instrumentation counters for bBST.c.
+// The counters are only compiled in when bBST.c is built with
+// -DBBST_STATS; otherwise every hook is an empty macro and the tree
+// runs exactly as before. struct tree cannot grow, so the counters are
+// global to the process rather than per tree.
+
+#ifndef BBST_STATS_H
+#define BBST_STATS_H
+
+#include <stdbool.h>
+
+// Indices into TreeStats.rotations
+typedef enum rotationCase
+{
+	ROTATE_LEFT_LEFT,
+	ROTATE_LEFT_RIGHT,
+	ROTATE_RIGHT_RIGHT,
+	ROTATE_RIGHT_LEFT,
+	NUM_ROTATION_CASES,
+} RotationCase;
+
+typedef struct treeStats
+{
+	// Non-NULL nodes entered by the recursive Node* functions
+	unsigned long visits;
+
+	// Calls to TreeInsert and TreeDelete, and how many of them were
+	// rejected because the key was already present or was missing
+	unsigned long inserts;
+	unsigned long deletes;
+	unsigned long duplicates;
+	unsigned long misses;
+
+	// Rotations performed, by case
+	unsigned long rotations[NUM_ROTATION_CASES];
+
+	// Nodes on the way back up from an insert or delete whose height
+	// changed or which were rotated, in total and the most for any
+	// single operation
+	unsigned long retraceSteps;
+	unsigned long maxRetrace;
+
+	// Nodes allocated and freed
+	unsigned long allocs;
+	unsigned long frees;
+} TreeStats;
+
+/**
+ * Returns true if bBST.c was built with the counters compiled in.
+ */
+bool TreeStatsEnabled(void);
+
+/**
+ * Copies the counters accumulated since the last reset into stats.
+ * All counters are zero if the counters are not compiled in.
+ */
+void TreeStatsGet(TreeStats *stats);
+
+/**
+ * Sets every counter back to zero.
+ */
+void TreeStatsReset(void);
+
+#ifdef BBST_STATS
+extern TreeStats TreeStatsCounters;
+extern unsigned long TreeStatsRetrace;
+
+#define STATS_INC(field) (TreeStatsCounters.field++)
+#define STATS_VISIT() STATS_INC(visits)
+#define STATS_ROTATE(c) STATS_INC(rotations[c])
+#define STATS_RETRACE_BEGIN() (TreeStatsRetrace = 0)
+#define STATS_RETRACE(changed) \
+	((changed) ? (TreeStatsRetrace++, TreeStatsCounters.retraceSteps++) : 0)
+#define STATS_RETRACE_END()                                  \
+	(TreeStatsCounters.maxRetrace < TreeStatsRetrace         \
+		 ? (TreeStatsCounters.maxRetrace = TreeStatsRetrace) \
+		 : 0)
+#else
+#define STATS_INC(field) ((void)0)
+#define STATS_VISIT() ((void)0)
+#define STATS_ROTATE(c) ((void)0)
+#define STATS_RETRACE_BEGIN() ((void)0)
+// sizeof keeps the argument referenced without evaluating it
+#define STATS_RETRACE(changed) ((void)sizeof(changed))
+#define STATS_RETRACE_END() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,538 @@
+// Implementation of the Balanced Binary Search Tree Map.
+//
+// A node is allocated with room for its value after the links: the value
+// itself for maps of fixed size values, or a pointer to it and its
+// length otherwise. Nodes are never copied into one another, a deletion
+// with two children moves the successor node into place instead, so the
+// value of every other key stays where it is.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bMap.h"
+
+typedef struct mapNode *MapNode;
+
+// Where the value of a map of variable length values is
+typedef struct outOfLine
+{
+	void *data;
+	size_t length;
+} OutOfLine;
+
+struct mapNode
+{
+	int key;
+	int height;
+	MapNode left;
+	MapNode right;
+	// valueSize bytes, or an OutOfLine
+	max_align_t value[];
+};
+
+struct map
+{
+	MapNode root;
+	int size;
+	// 0 for values of variable length
+	size_t valueSize;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void FreeNode(Map m, MapNode n);
+static MapNode NodeCreate(Map m, int k, const void *value, size_t length);
+static void SetValue(Map m, MapNode n, const void *value, size_t length);
+static MapNode Find(Map m, int key);
+static MapNode NodeInsert(Map m, MapNode curr, int key, const void *value, size_t length,
+						  bool *added);
+static MapNode NodeDelete(Map m, MapNode curr, int key);
+static MapNode RemoveMin(MapNode curr, MapNode *min);
+static MapNode Rebalance(MapNode n);
+static MapNode RotateLeft(MapNode n);
+static MapNode RotateRight(MapNode n);
+static void UpdateHeight(MapNode n);
+static int Height(MapNode n);
+static int GetBalance(MapNode n);
+static void ToEntry(Map m, MapNode n, MapEntry *e);
+static bool NodeBetween(Map m, MapNode curr, int lower, int upper, MapVisitor visit, void *arg,
+						int *count);
+static OutOfLine *ValueOutOfLine(MapNode n);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty map.
+ */
+Map MapNew(size_t valueSize)
+{
+	Map m = malloc(sizeof(*m));
+
+	if (m == NULL)
+	{
+		fprintf(stderr, "Could not malloc Map\n");
+		exit(EXIT_FAILURE);
+	}
+
+	m->root = NULL;
+	m->size = 0;
+	m->valueSize = valueSize;
+	return m;
+}
+
+/**
+ * Frees all memory allocated for the given map.
+ */
+void MapFree(Map m)
+{
+	if (m == NULL)
+		return;
+
+	FreeNode(m, m->root);
+	free(m);
+}
+
+static void FreeNode(Map m, MapNode n)
+{
+	if (n == NULL)
+		return;
+
+	FreeNode(m, n->left);
+	FreeNode(m, n->right);
+	if (m->valueSize == 0)
+		free(ValueOutOfLine(n)->data);
+	free(n);
+}
+
+/**
+ * Returns the number of entries in the map.
+ */
+int MapSize(Map m)
+{
+	return (m == NULL) ? 0 : m->size;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Sets the value of the given key.
+ */
+bool MapPut(Map m, int key, const void *value, size_t length)
+{
+	if (m == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return false;
+	}
+
+	bool added = false;
+	m->root = NodeInsert(m, m->root, key, value, length, &added);
+	if (added)
+		m->size++;
+	return added;
+}
+
+/**
+ * Create New node with room for its value and set all properties
+ */
+static MapNode NodeCreate(Map m, int k, const void *value, size_t length)
+{
+	size_t room = (m->valueSize > 0) ? m->valueSize : sizeof(OutOfLine);
+	MapNode n = malloc(sizeof(*n) + room);
+
+	if (n == NULL)
+	{
+		fprintf(stderr, "Could not malloc Node\n");
+		exit(EXIT_FAILURE);
+	}
+
+	n->key = k;
+	n->left = NULL;
+	n->right = NULL;
+	n->height = 0;
+	if (m->valueSize == 0)
+		*ValueOutOfLine(n) = (OutOfLine){NULL, 0};
+	SetValue(m, n, value, length);
+	return n;
+}
+
+/**
+ * Copy a value into a node, reusing the memory of the old value when it
+ * is large enough
+ */
+static void SetValue(Map m, MapNode n, const void *value, size_t length)
+{
+	if (m->valueSize > 0)
+	{
+		memcpy(n->value, value, m->valueSize);
+		return;
+	}
+
+	OutOfLine *v = ValueOutOfLine(n);
+	if (v->data == NULL || length > v->length || length < v->length / 2)
+	{
+		// One byte at least, so that an empty value is not NULL
+		void *data = realloc(v->data, (length > 0) ? length : 1);
+		if (data == NULL)
+		{
+			fprintf(stderr, "Could not malloc Value\n");
+			exit(EXIT_FAILURE);
+		}
+		v->data = data;
+	}
+
+	if (length > 0)
+		memcpy(v->data, value, length);
+	v->length = length;
+}
+
+/**
+ * Replace the value of a key where it is, or add a node for it at the
+ * end of the same descent
+ * Balance the tree if necessary
+ */
+static MapNode NodeInsert(Map m, MapNode curr, int key, const void *value, size_t length,
+						  bool *added)
+{
+	if (curr == NULL)
+	{
+		*added = true;
+		return NodeCreate(m, key, value, length);
+	}
+
+	if (key == curr->key)
+	{
+		// An existing key keeps its node
+		SetValue(m, curr, value, length);
+		return curr;
+	}
+
+	if (key < curr->key)
+		curr->left = NodeInsert(m, curr->left, key, value, length, added);
+	else
+		curr->right = NodeInsert(m, curr->right, key, value, length, added);
+
+	// A replaced value changes no heights
+	return *added ? Rebalance(curr) : curr;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the value of the given key.
+ */
+const void *MapGet(Map m, int key, size_t *length)
+{
+	MapNode n = Find(m, key);
+	if (n == NULL)
+		return NULL;
+
+	MapEntry e;
+	ToEntry(m, n, &e);
+	if (length != NULL)
+		*length = e.length;
+	return e.value;
+}
+
+static MapNode Find(Map m, int key)
+{
+	if (m == NULL || key == UNDEFINED)
+		return NULL;
+
+	MapNode curr = m->root;
+	while (curr != NULL && curr->key != key)
+		curr = (key > curr->key) ? curr->right : curr->left;
+
+	return curr;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Deletes the given key and its value from the map.
+ */
+bool MapDelete(Map m, int key)
+{
+	if (Find(m, key) == NULL)
+		return false;
+
+	m->root = NodeDelete(m, m->root, key);
+	m->size--;
+	return true;
+}
+
+/**
+ * Search for the node to delete
+ * Balance the tree if necessary
+ */
+static MapNode NodeDelete(Map m, MapNode curr, int key)
+{
+	if (key > curr->key)
+	{
+		curr->right = NodeDelete(m, curr->right, key);
+		return Rebalance(curr);
+	}
+	if (key < curr->key)
+	{
+		curr->left = NodeDelete(m, curr->left, key);
+		return Rebalance(curr);
+	}
+
+	MapNode replacement;
+	if (curr->left == NULL || curr->right == NULL)
+	{
+		// Zero or one child, splice the node out
+		replacement = (curr->left == NULL) ? curr->right : curr->left;
+	}
+	else
+	{
+		// Two children, the successor node takes the place of this one
+		MapNode right = RemoveMin(curr->right, &replacement);
+		replacement->left = curr->left;
+		replacement->right = right;
+		replacement = Rebalance(replacement);
+	}
+
+	if (m->valueSize == 0)
+		free(ValueOutOfLine(curr)->data);
+	free(curr);
+	return replacement;
+}
+
+/**
+ * Unlink the smallest node of a subtree, returning the rest balanced
+ */
+static MapNode RemoveMin(MapNode curr, MapNode *min)
+{
+	if (curr->left == NULL)
+	{
+		*min = curr;
+		return curr->right;
+	}
+
+	curr->left = RemoveMin(curr->left, min);
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Update the height of a node and rotate it if it is unbalanced
+ */
+static MapNode Rebalance(MapNode n)
+{
+	UpdateHeight(n);
+	int balance = GetBalance(n);
+
+	// Left Left and Left Right cases
+	if (balance > 1)
+	{
+		if (GetBalance(n->left) < 0)
+			n->left = RotateLeft(n->left);
+		return RotateRight(n);
+	}
+
+	// Right Right and Right Left cases
+	if (balance < -1)
+	{
+		if (GetBalance(n->right) > 0)
+			n->right = RotateRight(n->right);
+		return RotateLeft(n);
+	}
+
+	return n;
+}
+
+static MapNode RotateLeft(MapNode n)
+{
+	MapNode y = n->right;
+	n->right = y->left;
+	y->left = n;
+
+	UpdateHeight(n);
+	UpdateHeight(y);
+	return y;
+}
+
+static MapNode RotateRight(MapNode n)
+{
+	MapNode y = n->left;
+	n->left = y->right;
+	y->right = n;
+
+	UpdateHeight(n);
+	UpdateHeight(y);
+	return y;
+}
+
+static void UpdateHeight(MapNode n)
+{
+	n->height = 1 + max(Height(n->left), Height(n->right));
+}
+
+static int Height(MapNode n)
+{
+	return (n == NULL) ? -1 : n->height;
+}
+
+static int GetBalance(MapNode n)
+{
+	return Height(n->left) - Height(n->right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Finds the entry with the largest key less than or equal to the given
+ * value.
+ */
+bool MapFloorEntry(Map m, int key, MapEntry *e)
+{
+	if (m == NULL)
+		return false;
+
+	MapNode best = NULL;
+	for (MapNode curr = m->root; curr != NULL;)
+	{
+		if (curr->key == key)
+		{
+			best = curr;
+			break;
+		}
+
+		if (curr->key < key)
+		{
+			best = curr;
+			curr = curr->right;
+		}
+		else
+		{
+			curr = curr->left;
+		}
+	}
+
+	if (best == NULL)
+		return false;
+
+	ToEntry(m, best, e);
+	return true;
+}
+
+/**
+ * Finds the entry with the smallest key greater than or equal to the
+ * given value.
+ */
+bool MapCeilingEntry(Map m, int key, MapEntry *e)
+{
+	if (m == NULL)
+		return false;
+
+	MapNode best = NULL;
+	for (MapNode curr = m->root; curr != NULL;)
+	{
+		if (curr->key == key)
+		{
+			best = curr;
+			break;
+		}
+
+		if (curr->key > key)
+		{
+			best = curr;
+			curr = curr->left;
+		}
+		else
+		{
+			curr = curr->right;
+		}
+	}
+
+	if (best == NULL)
+		return false;
+
+	ToEntry(m, best, e);
+	return true;
+}
+
+static void ToEntry(Map m, MapNode n, MapEntry *e)
+{
+	e->key = n->key;
+	if (m->valueSize > 0)
+	{
+		e->value = n->value;
+		e->length = m->valueSize;
+	}
+	else
+	{
+		OutOfLine *v = ValueOutOfLine(n);
+		e->value = v->data;
+		e->length = v->length;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Calls visit on each entry with a key between the two given keys.
+ */
+int MapBetween(Map m, int lower, int upper, MapVisitor visit, void *arg)
+{
+	int count = 0;
+	if (m != NULL)
+		NodeBetween(m, m->root, lower, upper, visit, arg, &count);
+	return count;
+}
+
+/**
+ * In order traverse the part of a subtree in the range. Returns false
+ * once the visitor has asked to stop.
+ */
+static bool NodeBetween(Map m, MapNode curr, int lower, int upper, MapVisitor visit, void *arg,
+						int *count)
+{
+	if (curr == NULL)
+		return true;
+
+	if (curr->key > lower && !NodeBetween(m, curr->left, lower, upper, visit, arg, count))
+		return false;
+
+	if (curr->key >= lower && curr->key <= upper)
+	{
+		MapEntry e;
+		ToEntry(m, curr, &e);
+		(*count)++;
+		if (!visit(&e, arg))
+			return false;
+	}
+
+	if (curr->key < upper)
+		return NodeBetween(m, curr->right, lower, upper, visit, arg, count);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * The value of a node of a map of variable length values. The node's
+ * memory only ever holds an OutOfLine there, the cast through void *
+ * only keeps the compiler from reading it as a max_align_t.
+ */
+static OutOfLine *ValueOutOfLine(MapNode n)
+{
+	return (OutOfLine *)(void *)n->value;
+}
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
@@ -0,0 +1,108 @@
+// Operations on Balanced Binary Search Tree Maps.
+// An AVL tree of int keys that each carry a value, so that a lookup
+// finds the value in the node it finds the key in, rather than in a
+// second structure keyed the same way.
+//
+// A map is made for values of one fixed size, which are stored inline
+// at the end of each node, or for values of any size, which the map
+// copies to memory of their own and points to from the node. Putting a
+// key that is already in the map replaces its value where it is, without
+// taking the node out of the tree.
+
+#ifndef MAP_H
+#define MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bBST.h"
+
+typedef struct map *Map;
+
+typedef struct mapEntry
+{
+	int key;
+	// Owned by the map, valid until the key is next put or deleted
+	const void *value;
+	size_t length;
+} MapEntry;
+
+/**
+ * Called by MapBetween for each entry in the range, in ascending key
+ * order. Returns false to stop the iteration.
+ */
+typedef bool (*MapVisitor)(const MapEntry *e, void *arg);
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of entries in
+// the map, and exclude copying values.
+
+/**
+ * Creates a new empty map. With a valueSize above 0 every value is that
+ * many bytes and is stored inline. With 0 values may be of any length
+ * and are stored out of line.
+ * The time complexity of this function is O(1).
+ */
+Map MapNew(size_t valueSize);
+
+/**
+ * Frees all memory allocated for the given map, including the values.
+ * The time complexity of this function is O(n).
+ */
+void MapFree(Map m);
+
+/**
+ * Returns the number of entries in the map.
+ * The time complexity of this function is O(1).
+ */
+int MapSize(Map m);
+
+/**
+ * Sets the value of the given key to a copy of the length bytes at
+ * value. Maps of fixed size values copy that size and ignore length.
+ * Returns true if the key was added, or false if it was already present
+ * and its value was replaced in place.
+ * The time complexity of this function is O(log n).
+ */
+bool MapPut(Map m, int key, const void *value, size_t length);
+
+/**
+ * Returns the value of the given key, and its length through length
+ * unless it is NULL, or NULL if the key is not in the map.
+ * The time complexity of this function is O(log n).
+ */
+const void *MapGet(Map m, int key, size_t *length);
+
+/**
+ * Deletes the given key and its value from the map if it is present.
+ * Returns true if the key was deleted, or false if it was not present.
+ * The time complexity of this function is O(log n).
+ */
+bool MapDelete(Map m, int key);
+
+/**
+ * Finds the entry with the largest key less than or equal to the given
+ * value. Returns false, leaving e alone, if there is no such entry.
+ * The time complexity of this function is O(log n).
+ */
+bool MapFloorEntry(Map m, int key, MapEntry *e);
+
+/**
+ * Finds the entry with the smallest key greater than or equal to the
+ * given value. Returns false, leaving e alone, if there is no such
+ * entry.
+ * The time complexity of this function is O(log n).
+ */
+bool MapCeilingEntry(Map m, int key, MapEntry *e);
+
+/**
+ * Calls visit on each entry with a key between the two given keys
+ * (inclusive), in ascending order, until it returns false. The map must
+ * not be changed during the iteration.
+ * Returns the number of entries visited.
+ * The time complexity of this function is O(log n + m), where m is the
+ * number of entries visited.
+ */
+int MapBetween(Map m, int lower, int upper, MapVisitor visit, void *arg);
+
+#endif
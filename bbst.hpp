@@ -0,0 +1,1058 @@
+// Header-only C++ Balanced Binary Search Trees.
+// bbst::avl_map and bbst::avl_set are AVL trees balanced the way bBST.c
+// balances them (heights with leaves at 0, the four rotation cases),
+// with the key type, comparator and allocator as template parameters.
+// Comparisons are inlined rather than made through the C API, keys can
+// be of any type the comparator orders (64-bit integers, strings,
+// tuples), and values may be move-only.
+//
+// The interface follows std::map and std::set, so either can be swapped
+// in: bidirectional iterators, insert, emplace, try_emplace, erase,
+// find, lower_bound and upper_bound, with heterogeneous lookup when the
+// comparator is transparent (e.g. std::less<>). floor and ceiling give
+// the largest key at most and the smallest key at least a value, as
+// TreeFloor and TreeCeiling do.
+//
+// Unlike in bBST.c, nodes link to their parent, so that an iterator
+// steps without a stack, and erase relinks the successor node into the
+// place of the erased one rather than copying its key. Iterators and
+// references to other elements stay valid across inserts and erases.
+//
+// Requires C++17.
+
+#ifndef BBST_HPP
+#define BBST_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace bbst
+{
+
+namespace detail
+{
+
+struct node_base
+{
+	node_base *left;
+	node_base *right;
+	node_base *parent;
+	// A leaf has height 0. Only the header, which is end(), has -1.
+	int height;
+};
+
+template <class Value>
+struct node : node_base
+{
+	// Constructed and destroyed through the allocator, not with the node
+	alignas(Value) unsigned char storage[sizeof(Value)];
+
+	Value *valptr() { return std::launder(reinterpret_cast<Value *>(storage)); }
+	const Value *valptr() const { return std::launder(reinterpret_cast<const Value *>(storage)); }
+};
+
+inline int height(const node_base *n)
+{
+	return (n == nullptr) ? -1 : n->height;
+}
+
+/**
+ * The in-order successor of a node, or the header after the largest
+ */
+inline node_base *next(node_base *x)
+{
+	if (x->right != nullptr)
+	{
+		x = x->right;
+		while (x->left != nullptr)
+			x = x->left;
+		return x;
+	}
+
+	// The root is the left child of the header, so climbing out of the
+	// right spine ends there
+	node_base *y = x->parent;
+	while (x == y->right)
+	{
+		x = y;
+		y = y->parent;
+	}
+	return y;
+}
+
+/**
+ * The in-order predecessor of a node, or the largest node for the header
+ */
+inline node_base *prev(node_base *x)
+{
+	if (x->height < 0)
+	{
+		x = x->left;
+		while (x->right != nullptr)
+			x = x->right;
+		return x;
+	}
+
+	if (x->left != nullptr)
+	{
+		x = x->left;
+		while (x->right != nullptr)
+			x = x->right;
+		return x;
+	}
+
+	node_base *y = x->parent;
+	while (x == y->left)
+	{
+		x = y;
+		y = y->parent;
+	}
+	return y;
+}
+
+struct identity
+{
+	template <class T>
+	const T &operator()(const T &v) const { return v; }
+};
+
+struct select_first
+{
+	template <class Pair>
+	const typename Pair::first_type &operator()(const Pair &p) const { return p.first; }
+};
+
+template <class Value, bool Const>
+class tree_iterator
+{
+public:
+	using iterator_category = std::bidirectional_iterator_tag;
+	using value_type = Value;
+	using difference_type = std::ptrdiff_t;
+	using pointer = std::conditional_t<Const, const Value *, Value *>;
+	using reference = std::conditional_t<Const, const Value &, Value &>;
+
+	tree_iterator() = default;
+	explicit tree_iterator(const node_base *n) : n_(const_cast<node_base *>(n)) {}
+
+	// An iterator converts to a const_iterator
+	template <bool C = Const, class = std::enable_if_t<C>>
+	tree_iterator(const tree_iterator<Value, false> &other) : n_(other.n_) {}
+
+	reference operator*() const { return *static_cast<node<Value> *>(n_)->valptr(); }
+	pointer operator->() const { return static_cast<node<Value> *>(n_)->valptr(); }
+
+	tree_iterator &operator++()
+	{
+		n_ = next(n_);
+		return *this;
+	}
+
+	tree_iterator operator++(int)
+	{
+		tree_iterator old = *this;
+		n_ = next(n_);
+		return old;
+	}
+
+	tree_iterator &operator--()
+	{
+		n_ = prev(n_);
+		return *this;
+	}
+
+	tree_iterator operator--(int)
+	{
+		tree_iterator old = *this;
+		n_ = prev(n_);
+		return old;
+	}
+
+	template <bool C>
+	bool operator==(const tree_iterator<Value, C> &other) const { return n_ == other.n_; }
+	template <bool C>
+	bool operator!=(const tree_iterator<Value, C> &other) const { return n_ != other.n_; }
+
+private:
+	template <class, bool>
+	friend class tree_iterator;
+	template <class, class, class, class, class>
+	friend class avl_tree;
+
+	node_base *n_ = nullptr;
+};
+
+/**
+ * The tree behind avl_map and avl_set. KeyOf returns the key of a
+ * value: the value itself for a set, its first for a map.
+ */
+template <class Value, class Key, class KeyOf, class Compare, class Alloc>
+class avl_tree
+{
+	using node_type = node<Value>;
+	using node_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<node_type>;
+	using node_traits = std::allocator_traits<node_alloc>;
+
+	// Lookups by other types than key_type, for comparators such as
+	// std::less<> that declare is_transparent
+	template <class C>
+	using transparent = typename C::is_transparent;
+
+public:
+	using key_type = Key;
+	using value_type = Value;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+	using allocator_type = Alloc;
+	using reference = value_type &;
+	using const_reference = const value_type &;
+	using pointer = typename std::allocator_traits<Alloc>::pointer;
+	using const_pointer = typename std::allocator_traits<Alloc>::const_pointer;
+	// The elements of a set are its keys, which must not change
+	using iterator = tree_iterator<Value, std::is_same_v<Key, Value>>;
+	using const_iterator = tree_iterator<Value, true>;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	avl_tree() : avl_tree(Compare()) {}
+
+	explicit avl_tree(const Compare &comp, const Alloc &alloc = Alloc())
+		: comp_(comp), alloc_(alloc)
+	{
+		reset();
+	}
+
+	explicit avl_tree(const Alloc &alloc) : avl_tree(Compare(), alloc) {}
+
+	template <class InputIt>
+	avl_tree(InputIt first, InputIt last, const Compare &comp = Compare(), const Alloc &alloc = Alloc())
+		: avl_tree(comp, alloc)
+	{
+		insert(first, last);
+	}
+
+	avl_tree(std::initializer_list<value_type> values, const Compare &comp = Compare(),
+			 const Alloc &alloc = Alloc())
+		: avl_tree(values.begin(), values.end(), comp, alloc)
+	{
+	}
+
+	avl_tree(const avl_tree &other)
+		: comp_(other.comp_), alloc_(node_traits::select_on_container_copy_construction(other.alloc_))
+	{
+		reset();
+		if (other.root() != nullptr)
+		{
+			header_.left = clone(other.root(), &header_);
+			size_ = other.size_;
+		}
+	}
+
+	avl_tree(avl_tree &&other) noexcept
+		: comp_(std::move(other.comp_)), alloc_(std::move(other.alloc_))
+	{
+		reset();
+		steal(other);
+	}
+
+	~avl_tree()
+	{
+		clear();
+	}
+
+	avl_tree &operator=(const avl_tree &other)
+	{
+		if (this != &other)
+		{
+			avl_tree copy(other);
+			swap(copy);
+		}
+		return *this;
+	}
+
+	avl_tree &operator=(avl_tree &&other) noexcept
+	{
+		if (this != &other)
+		{
+			clear();
+			comp_ = std::move(other.comp_);
+			alloc_ = std::move(other.alloc_);
+			steal(other);
+		}
+		return *this;
+	}
+
+	avl_tree &operator=(std::initializer_list<value_type> values)
+	{
+		clear();
+		insert(values.begin(), values.end());
+		return *this;
+	}
+
+	allocator_type get_allocator() const { return allocator_type(alloc_); }
+	key_compare key_comp() const { return comp_; }
+
+	////////////////////////////////////////////////////////////////////
+	// Iterators. begin() walks down the left spine, so it is O(log n).
+
+	iterator begin() { return iterator(leftmost()); }
+	const_iterator begin() const { return const_iterator(leftmost()); }
+	const_iterator cbegin() const { return begin(); }
+	iterator end() { return iterator(&header_); }
+	const_iterator end() const { return const_iterator(&header_); }
+	const_iterator cend() const { return end(); }
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+	const_reverse_iterator crbegin() const { return rbegin(); }
+	const_reverse_iterator crend() const { return rend(); }
+
+	bool empty() const { return size_ == 0; }
+	size_type size() const { return size_; }
+	size_type max_size() const { return node_traits::max_size(alloc_); }
+
+	/**
+	 * Erases every element.
+	 * The time complexity of this function is O(n).
+	 */
+	void clear() noexcept
+	{
+		destroy_subtree(root());
+		reset();
+	}
+
+	////////////////////////////////////////////////////////////////////
+	// Insertion. All of these are O(log n).
+
+	/**
+	 * Inserts a copy of the value unless its key is present. Returns the
+	 * element with that key and whether it was inserted.
+	 */
+	std::pair<iterator, bool> insert(const value_type &value) { return insert_unique(value); }
+	std::pair<iterator, bool> insert(value_type &&value) { return insert_unique(std::move(value)); }
+
+	/**
+	 * As insert, the hint is ignored
+	 */
+	iterator insert(const_iterator, const value_type &value) { return insert(value).first; }
+	iterator insert(const_iterator, value_type &&value) { return insert(std::move(value)).first; }
+
+	template <class InputIt>
+	void insert(InputIt first, InputIt last)
+	{
+		for (; first != last; ++first)
+			emplace(*first);
+	}
+
+	void insert(std::initializer_list<value_type> values) { insert(values.begin(), values.end()); }
+
+	/**
+	 * Constructs a value from the arguments and inserts it unless its
+	 * key is present, in which case the value is destroyed again.
+	 */
+	template <class... Args>
+	std::pair<iterator, bool> emplace(Args &&...args)
+	{
+		node_type *n = create_node(std::forward<Args>(args)...);
+		node_base *parent;
+		bool left;
+		node_base *found = find_position(key_of(n), parent, left);
+		if (found != nullptr)
+		{
+			destroy_node(n);
+			return {iterator(found), false};
+		}
+
+		link(n, parent, left);
+		return {iterator(n), true};
+	}
+
+	template <class... Args>
+	iterator emplace_hint(const_iterator, Args &&...args)
+	{
+		return emplace(std::forward<Args>(args)...).first;
+	}
+
+	////////////////////////////////////////////////////////////////////
+	// Removal. All of these are O(log n).
+
+	/**
+	 * Erases an element, returns the element after it
+	 */
+	iterator erase(const_iterator pos)
+	{
+		node_base *n = pos.n_;
+		iterator following(next(n));
+		unlink(n);
+		destroy_node(static_cast<node_type *>(n));
+		return following;
+	}
+
+	// Only declared when iterator is not const_iterator, as for a map
+	template <class It = iterator, class = std::enable_if_t<!std::is_same_v<It, const_iterator>>>
+	iterator erase(iterator pos)
+	{
+		return erase(const_iterator(pos));
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		while (first != last)
+			first = erase(first);
+		return iterator(last.n_);
+	}
+
+	/**
+	 * Erases the element with the given key, returns how many were
+	 * erased (0 or 1)
+	 */
+	size_type erase(const key_type &key)
+	{
+		node_base *n = find_node(key);
+		if (n == nullptr)
+			return 0;
+
+		unlink(n);
+		destroy_node(static_cast<node_type *>(n));
+		return 1;
+	}
+
+	void swap(avl_tree &other) noexcept
+	{
+		using std::swap;
+		swap(comp_, other.comp_);
+		swap(alloc_, other.alloc_);
+		swap(header_, other.header_);
+		swap(size_, other.size_);
+		adopt_root();
+		other.adopt_root();
+	}
+
+	friend void swap(avl_tree &a, avl_tree &b) noexcept { a.swap(b); }
+
+	////////////////////////////////////////////////////////////////////
+	// Lookup. All of these are O(log n).
+
+	iterator find(const key_type &key) { return make_iterator(find_node(key)); }
+	const_iterator find(const key_type &key) const { return make_const_iterator(find_node(key)); }
+	template <class K, class C = Compare, class = transparent<C>>
+	iterator find(const K &key) { return make_iterator(find_node(key)); }
+	template <class K, class C = Compare, class = transparent<C>>
+	const_iterator find(const K &key) const { return make_const_iterator(find_node(key)); }
+
+	size_type count(const key_type &key) const { return find_node(key) != nullptr; }
+	template <class K, class C = Compare, class = transparent<C>>
+	size_type count(const K &key) const { return find_node(key) != nullptr; }
+
+	bool contains(const key_type &key) const { return find_node(key) != nullptr; }
+	template <class K, class C = Compare, class = transparent<C>>
+	bool contains(const K &key) const { return find_node(key) != nullptr; }
+
+	/**
+	 * The first element whose key is not less than the given key
+	 */
+	iterator lower_bound(const key_type &key) { return iterator(lower_bound_node(key)); }
+	const_iterator lower_bound(const key_type &key) const { return const_iterator(lower_bound_node(key)); }
+	template <class K, class C = Compare, class = transparent<C>>
+	iterator lower_bound(const K &key) { return iterator(lower_bound_node(key)); }
+	template <class K, class C = Compare, class = transparent<C>>
+	const_iterator lower_bound(const K &key) const { return const_iterator(lower_bound_node(key)); }
+
+	/**
+	 * The first element whose key is greater than the given key
+	 */
+	iterator upper_bound(const key_type &key) { return iterator(upper_bound_node(key)); }
+	const_iterator upper_bound(const key_type &key) const { return const_iterator(upper_bound_node(key)); }
+	template <class K, class C = Compare, class = transparent<C>>
+	iterator upper_bound(const K &key) { return iterator(upper_bound_node(key)); }
+	template <class K, class C = Compare, class = transparent<C>>
+	const_iterator upper_bound(const K &key) const { return const_iterator(upper_bound_node(key)); }
+
+	std::pair<iterator, iterator> equal_range(const key_type &key)
+	{
+		return {lower_bound(key), upper_bound(key)};
+	}
+
+	std::pair<const_iterator, const_iterator> equal_range(const key_type &key) const
+	{
+		return {lower_bound(key), upper_bound(key)};
+	}
+
+	/**
+	 * The element with the largest key less than or equal to the given
+	 * key, or end() if there is none
+	 */
+	iterator floor(const key_type &key) { return iterator(floor_node(key)); }
+	const_iterator floor(const key_type &key) const { return const_iterator(floor_node(key)); }
+
+	/**
+	 * The element with the smallest key greater than or equal to the
+	 * given key, or end() if there is none
+	 */
+	iterator ceiling(const key_type &key) { return lower_bound(key); }
+	const_iterator ceiling(const key_type &key) const { return lower_bound(key); }
+
+	friend bool operator==(const avl_tree &a, const avl_tree &b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+	}
+
+	friend bool operator!=(const avl_tree &a, const avl_tree &b) { return !(a == b); }
+
+protected:
+	/**
+	 * Find where a key is or would go. Returns its node if it is present,
+	 * otherwise nullptr with the parent a new node would hang off and on
+	 * which side.
+	 */
+	template <class K>
+	node_base *find_position(const K &key, node_base *&parent, bool &left)
+	{
+		parent = &header_;
+		left = true;
+		node_base *curr = root();
+		while (curr != nullptr)
+		{
+			const key_type &k = key_of(curr);
+			if (comp_(key, k))
+			{
+				parent = curr;
+				left = true;
+				curr = curr->left;
+			}
+			else if (comp_(k, key))
+			{
+				parent = curr;
+				left = false;
+				curr = curr->right;
+			}
+			else
+			{
+				return curr;
+			}
+		}
+		return nullptr;
+	}
+
+	template <class... Args>
+	node_type *create_node(Args &&...args)
+	{
+		node_type *n = node_traits::allocate(alloc_, 1);
+		::new (static_cast<void *>(n)) node_type;
+		try
+		{
+			node_traits::construct(alloc_, n->valptr(), std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			node_traits::deallocate(alloc_, n, 1);
+			throw;
+		}
+
+		n->left = nullptr;
+		n->right = nullptr;
+		n->parent = nullptr;
+		n->height = 0;
+		return n;
+	}
+
+	/**
+	 * Hang a new leaf off parent and rebalance up from it
+	 */
+	void link(node_type *n, node_base *parent, bool left)
+	{
+		n->parent = parent;
+		if (left)
+			parent->left = n;
+		else
+			parent->right = n;
+		size_++;
+
+		// Once a subtree is as high as before the insertion, nothing
+		// above it changes. A rotation always makes it so.
+		for (node_base *p = parent; p != &header_; p = p->parent)
+		{
+			int old = p->height;
+			p = rebalance(p);
+			if (p->height == old)
+				break;
+		}
+	}
+
+	static const key_type &key_of(const node_base *n)
+	{
+		return KeyOf()(*static_cast<const node_type *>(n)->valptr());
+	}
+
+	static Value &value_of(node_base *n)
+	{
+		return *static_cast<node_type *>(n)->valptr();
+	}
+
+	iterator make_iterator(node_base *n) { return iterator(n != nullptr ? n : &header_); }
+
+	const_iterator make_const_iterator(const node_base *n) const
+	{
+		return const_iterator(n != nullptr ? n : &header_);
+	}
+
+	template <class K>
+	node_base *find_node(const K &key) const
+	{
+		node_base *curr = root();
+		while (curr != nullptr)
+		{
+			const key_type &k = key_of(curr);
+			if constexpr (std::is_scalar_v<key_type>)
+			{
+				// Both comparisons up front are cheap for scalars, and let
+				// the step down be a conditional move rather than a branch
+				// mispredicted half the time, as in TreeSearch
+				bool less = comp_(key, k);
+				bool greater = comp_(k, key);
+				if (less == greater)
+					return curr;
+				curr = greater ? curr->right : curr->left;
+			}
+			else
+			{
+				if (comp_(key, k))
+					curr = curr->left;
+				else if (comp_(k, key))
+					curr = curr->right;
+				else
+					return curr;
+			}
+		}
+		return nullptr;
+	}
+
+private:
+	template <class V>
+	std::pair<iterator, bool> insert_unique(V &&value)
+	{
+		node_base *parent;
+		bool left;
+		node_base *found = find_position(KeyOf()(value), parent, left);
+		if (found != nullptr)
+			return {iterator(found), false};
+
+		node_type *n = create_node(std::forward<V>(value));
+		link(n, parent, left);
+		return {iterator(n), true};
+	}
+
+	template <class K>
+	node_base *lower_bound_node(const K &key) const
+	{
+		const node_base *best = &header_;
+		for (node_base *curr = root(); curr != nullptr;)
+		{
+			if (!comp_(key_of(curr), key))
+			{
+				best = curr;
+				curr = curr->left;
+			}
+			else
+			{
+				curr = curr->right;
+			}
+		}
+		return const_cast<node_base *>(best);
+	}
+
+	template <class K>
+	node_base *upper_bound_node(const K &key) const
+	{
+		const node_base *best = &header_;
+		for (node_base *curr = root(); curr != nullptr;)
+		{
+			if (comp_(key, key_of(curr)))
+			{
+				best = curr;
+				curr = curr->left;
+			}
+			else
+			{
+				curr = curr->right;
+			}
+		}
+		return const_cast<node_base *>(best);
+	}
+
+	template <class K>
+	node_base *floor_node(const K &key) const
+	{
+		const node_base *best = &header_;
+		for (node_base *curr = root(); curr != nullptr;)
+		{
+			if (comp_(key, key_of(curr)))
+			{
+				curr = curr->left;
+			}
+			else
+			{
+				best = curr;
+				curr = curr->right;
+			}
+		}
+		return const_cast<node_base *>(best);
+	}
+
+	/**
+	 * Take a node out of the tree without destroying it. A node with two
+	 * children is replaced by its successor node, relinked rather than
+	 * copied.
+	 */
+	void unlink(node_base *z)
+	{
+		node_base *start;
+		if (z->left == nullptr || z->right == nullptr)
+		{
+			node_base *child = (z->left != nullptr) ? z->left : z->right;
+			if (child != nullptr)
+				child->parent = z->parent;
+			replace_child(z->parent, z, child);
+			start = z->parent;
+		}
+		else
+		{
+			node_base *y = z->right;
+			while (y->left != nullptr)
+				y = y->left;
+
+			if (y->parent == z)
+			{
+				start = y;
+			}
+			else
+			{
+				start = y->parent;
+				y->parent->left = y->right;
+				if (y->right != nullptr)
+					y->right->parent = y->parent;
+				y->right = z->right;
+				z->right->parent = y;
+			}
+
+			y->left = z->left;
+			z->left->parent = y;
+			y->parent = z->parent;
+			replace_child(z->parent, z, y);
+			y->height = z->height;
+		}
+		size_--;
+
+		for (node_base *p = start; p != &header_; p = p->parent)
+		{
+			int old = p->height;
+			p = rebalance(p);
+			if (p->height == old)
+				break;
+		}
+	}
+
+	/**
+	 * Update the height of a node and rotate it if it is unbalanced.
+	 * Returns the root of the subtree.
+	 */
+	static node_base *rebalance(node_base *n)
+	{
+		update_height(n);
+		int balance = height(n->left) - height(n->right);
+
+		// Left Left and Left Right cases
+		if (balance > 1)
+		{
+			if (height(n->left->left) < height(n->left->right))
+				rotate_left(n->left);
+			return rotate_right(n);
+		}
+
+		// Right Right and Right Left cases
+		if (balance < -1)
+		{
+			if (height(n->right->right) < height(n->right->left))
+				rotate_right(n->right);
+			return rotate_left(n);
+		}
+
+		return n;
+	}
+
+	static node_base *rotate_left(node_base *x)
+	{
+		node_base *y = x->right;
+		x->right = y->left;
+		if (y->left != nullptr)
+			y->left->parent = x;
+		y->parent = x->parent;
+		replace_child(x->parent, x, y);
+		y->left = x;
+		x->parent = y;
+
+		update_height(x);
+		update_height(y);
+		return y;
+	}
+
+	static node_base *rotate_right(node_base *x)
+	{
+		node_base *y = x->left;
+		x->left = y->right;
+		if (y->right != nullptr)
+			y->right->parent = x;
+		y->parent = x->parent;
+		replace_child(x->parent, x, y);
+		y->right = x;
+		x->parent = y;
+
+		update_height(x);
+		update_height(y);
+		return y;
+	}
+
+	static void update_height(node_base *n)
+	{
+		int l = height(n->left);
+		int r = height(n->right);
+		n->height = 1 + ((l > r) ? l : r);
+	}
+
+	static void replace_child(node_base *parent, node_base *old, node_base *n)
+	{
+		if (parent->left == old)
+			parent->left = n;
+		else
+			parent->right = n;
+	}
+
+	/**
+	 * Copy a subtree, keeping its shape and so its heights
+	 */
+	node_base *clone(const node_base *src, node_base *parent)
+	{
+		node_type *n = create_node(*static_cast<const node_type *>(src)->valptr());
+		n->parent = parent;
+		n->height = src->height;
+		try
+		{
+			if (src->left != nullptr)
+				n->left = clone(src->left, n);
+			if (src->right != nullptr)
+				n->right = clone(src->right, n);
+		}
+		catch (...)
+		{
+			destroy_subtree(n);
+			throw;
+		}
+		return n;
+	}
+
+	void destroy_node(node_type *n)
+	{
+		node_traits::destroy(alloc_, n->valptr());
+		n->~node_type();
+		node_traits::deallocate(alloc_, n, 1);
+	}
+
+	void destroy_subtree(node_base *n)
+	{
+		// Iterative, rotating left children up so the loop only goes
+		// right: no recursion however the tree is shaped
+		while (n != nullptr)
+		{
+			if (n->left != nullptr)
+			{
+				node_base *l = n->left;
+				n->left = l->right;
+				l->right = n;
+				n = l;
+			}
+			else
+			{
+				node_base *r = n->right;
+				destroy_node(static_cast<node_type *>(n));
+				n = r;
+			}
+		}
+	}
+
+	node_base *root() const { return header_.left; }
+
+	const node_base *leftmost() const
+	{
+		const node_base *n = &header_;
+		while (n->left != nullptr)
+			n = n->left;
+		return n;
+	}
+
+	void reset()
+	{
+		header_.left = nullptr;
+		header_.right = nullptr;
+		header_.parent = nullptr;
+		header_.height = -1;
+		size_ = 0;
+	}
+
+	void steal(avl_tree &other)
+	{
+		header_ = other.header_;
+		size_ = other.size_;
+		adopt_root();
+		other.reset();
+	}
+
+	// The root points back at the header, which moves with the tree
+	void adopt_root()
+	{
+		if (header_.left != nullptr)
+			header_.left->parent = &header_;
+	}
+
+	node_base header_;
+	size_type size_;
+	Compare comp_;
+	node_alloc alloc_;
+};
+
+} // namespace detail
+
+/**
+ * An ordered map from unique keys to values, as std::map
+ */
+template <class Key, class T, class Compare = std::less<Key>,
+		  class Alloc = std::allocator<std::pair<const Key, T>>>
+class avl_map : public detail::avl_tree<std::pair<const Key, T>, Key, detail::select_first, Compare, Alloc>
+{
+	using base = detail::avl_tree<std::pair<const Key, T>, Key, detail::select_first, Compare, Alloc>;
+
+public:
+	using mapped_type = T;
+	using typename base::iterator;
+	using typename base::key_type;
+	using typename base::value_type;
+
+	using base::base;
+	avl_map() = default;
+	avl_map(std::initializer_list<value_type> values, const Compare &comp = Compare(),
+			const Alloc &alloc = Alloc())
+		: base(values, comp, alloc)
+	{
+	}
+
+	/**
+	 * Inserts a value constructed from the arguments under the given key
+	 * unless the key is present, in which case the arguments are left
+	 * alone. Returns the element with that key and whether it was
+	 * inserted.
+	 * The time complexity of this function is O(log n).
+	 */
+	template <class... Args>
+	std::pair<iterator, bool> try_emplace(const key_type &key, Args &&...args)
+	{
+		return try_emplace_key(key, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	std::pair<iterator, bool> try_emplace(key_type &&key, Args &&...args)
+	{
+		return try_emplace_key(std::move(key), std::forward<Args>(args)...);
+	}
+
+	/**
+	 * Assigns to the value of the given key in place, or inserts it.
+	 * The time complexity of this function is O(log n).
+	 */
+	template <class M>
+	std::pair<iterator, bool> insert_or_assign(const key_type &key, M &&obj)
+	{
+		auto result = try_emplace(key, std::forward<M>(obj));
+		if (!result.second)
+			result.first->second = std::forward<M>(obj);
+		return result;
+	}
+
+	/**
+	 * Returns the value of the given key, inserting a value initialised
+	 * one if the key is not present.
+	 * The time complexity of this function is O(log n).
+	 */
+	T &operator[](const key_type &key) { return try_emplace(key).first->second; }
+	T &operator[](key_type &&key) { return try_emplace(std::move(key)).first->second; }
+
+	/**
+	 * Returns the value of the given key, or throws std::out_of_range if
+	 * it is not present.
+	 * The time complexity of this function is O(log n).
+	 */
+	T &at(const key_type &key)
+	{
+		auto n = this->find_node(key);
+		if (n == nullptr)
+			throw std::out_of_range("bbst::avl_map::at");
+		return this->value_of(n).second;
+	}
+
+	const T &at(const key_type &key) const
+	{
+		auto n = this->find_node(key);
+		if (n == nullptr)
+			throw std::out_of_range("bbst::avl_map::at");
+		return base::value_of(n).second;
+	}
+
+private:
+	template <class K, class... Args>
+	std::pair<iterator, bool> try_emplace_key(K &&key, Args &&...args)
+	{
+		detail::node_base *parent;
+		bool left;
+		detail::node_base *found = this->find_position(key, parent, left);
+		if (found != nullptr)
+			return {iterator(found), false};
+
+		auto n = this->create_node(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+								   std::forward_as_tuple(std::forward<Args>(args)...));
+		this->link(n, parent, left);
+		return {iterator(n), true};
+	}
+};
+
+/**
+ * An ordered set of unique keys, as std::set
+ */
+template <class Key, class Compare = std::less<Key>, class Alloc = std::allocator<Key>>
+class avl_set : public detail::avl_tree<Key, Key, detail::identity, Compare, Alloc>
+{
+	using base = detail::avl_tree<Key, Key, detail::identity, Compare, Alloc>;
+
+public:
+	using typename base::value_type;
+
+	using base::base;
+	avl_set() = default;
+	avl_set(std::initializer_list<value_type> values, const Compare &comp = Compare(),
+			const Alloc &alloc = Alloc())
+		: base(values, comp, alloc)
+	{
+	}
+};
+
+} // namespace bbst
+
+#endif
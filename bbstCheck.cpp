@@ -0,0 +1,529 @@
+// Checker for the header-only C++ trees (bbst.hpp) against std::map and
+// std::set. A bbst::avl_map from string keys to std::unique_ptr values
+// and a bbst::avl_set of tuple keys each take the same random inserts,
+// emplaces and erases as their std counterpart, by key, by iterator and
+// by range, and after every batch the checker walks both forwards and
+// backwards and compares find, lower_bound, upper_bound, floor and
+// ceiling at random probes. The last pass copies, moves and swaps trees
+// and checks what each leaves behind, including that iterators follow
+// their elements into the other tree on a swap.
+//
+// Usage: ./bbstCheck [-o operations] [-s seed]
+//
+// String keys are decimal numbers, so they sort differently from the
+// numbers ("10" < "9") and share long prefixes.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "bbst.hpp"
+
+#define DEFAULT_OPS 100000
+// Operations between two full comparisons
+#define BATCH 2000
+// Keys are drawn from this many numbers
+#define KEYSPACE 4096
+// Elements in the trees copied, moved and swapped
+#define COPY_KEYS 5000
+
+using StringMap = bbst::avl_map<std::string, std::unique_ptr<int>, std::less<>>;
+using StringRef = std::map<std::string, std::unique_ptr<int>, std::less<>>;
+using TupleKey = std::tuple<int, std::string>;
+using TupleSet = bbst::avl_set<TupleKey>;
+using TupleRef = std::set<TupleKey>;
+
+static bool checkMap(int ops, unsigned int seed);
+static bool checkSet(int ops, unsigned int seed);
+static bool checkCopyMove(unsigned int seed);
+template <class Tree, class Ref, class Key>
+static bool checkQueries(const Tree &t, const Ref &ref, const Key &key);
+template <class Tree, class Ref>
+static bool checkEraseRange(Tree &t, Ref &ref, const typename Ref::key_type &lower, int span);
+template <class Tree, class Ref>
+static bool sameContents(const Tree &t, const Ref &ref);
+template <class Tree, class Ref, class TreeIt, class RefIt>
+static bool samePosition(const Tree &t, TreeIt it, const Ref &ref, RefIt rit);
+template <class K, class T>
+static const K &keyOf(const std::pair<const K, T> &element);
+template <class K>
+static const K &keyOf(const K &element);
+template <class K, class T>
+static bool sameElement(const std::pair<const K, std::unique_ptr<T>> &a,
+						const std::pair<const K, std::unique_ptr<T>> &b);
+template <class K>
+static bool sameElement(const K &a, const K &b);
+static std::string stringKey(unsigned int *state);
+static TupleKey tupleKey(unsigned int *state);
+static unsigned int nextRandom(unsigned int *state);
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkMap(ops, seed);
+	failures += !checkSet(ops, seed);
+	failures += !checkCopyMove(seed);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Random updates of a map with move-only values through every way in,
+ * growing and shrinking it in turns
+ */
+static bool checkMap(int ops, unsigned int seed)
+{
+	StringMap t;
+	StringRef ref;
+	unsigned int state = seed;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		bool grow = (i / (4 * BATCH)) % 2 == 0;
+		std::string key = stringKey(&state);
+		int value = (int)(nextRandom(&state) % 1000);
+		unsigned int op = nextRandom(&state) % 16;
+		if (!grow && op < 8 && nextRandom(&state) % 2 == 0)
+			op = 8;
+		else if (grow && op >= 8 && op <= 12 && nextRandom(&state) % 4 != 0)
+			op = 0;
+
+		switch (op)
+		{
+		case 0:
+		case 1:
+		{
+			auto got = t.try_emplace(key, std::make_unique<int>(value));
+			auto want = ref.try_emplace(key, std::make_unique<int>(value));
+			ok = got.second == want.second && samePosition(t, got.first, ref, want.first);
+			break;
+		}
+		case 2:
+		{
+			auto got = t.emplace(key, std::make_unique<int>(value));
+			auto want = ref.emplace(key, std::make_unique<int>(value));
+			ok = got.second == want.second && samePosition(t, got.first, ref, want.first);
+			break;
+		}
+		case 3:
+		{
+			auto got = t.insert(StringMap::value_type(key, std::make_unique<int>(value)));
+			auto want = ref.insert(StringRef::value_type(key, std::make_unique<int>(value)));
+			ok = got.second == want.second && samePosition(t, got.first, ref, want.first);
+			break;
+		}
+		case 4:
+			// Missing keys get a null value first
+			t[key] = std::make_unique<int>(value);
+			ref[key] = std::make_unique<int>(value);
+			break;
+		case 5:
+		{
+			auto got = t.insert_or_assign(key, std::make_unique<int>(value));
+			auto want = ref.insert_or_assign(key, std::make_unique<int>(value));
+			ok = got.second == want.second && samePosition(t, got.first, ref, want.first);
+			break;
+		}
+		case 6:
+		{
+			auto got = t.emplace_hint(t.end(), key, std::make_unique<int>(value));
+			auto want = ref.emplace_hint(ref.end(), key, std::make_unique<int>(value));
+			ok = samePosition(t, got, ref, want);
+			break;
+		}
+		case 7:
+		{
+			// Values change in place through the iterator
+			auto it = t.find(key);
+			auto rit = ref.find(key);
+			ok = samePosition(t, it, ref, rit);
+			if (ok && it != t.end())
+			{
+				it->second.reset();
+				rit->second.reset();
+			}
+			break;
+		}
+		case 8:
+		case 9:
+		case 10:
+			ok = t.erase(key) == ref.erase(key);
+			break;
+		case 11:
+		{
+			// The element at or after the key, by iterator
+			auto rit = ref.lower_bound(key);
+			if (rit == ref.end())
+				break;
+			auto it = t.find(rit->first);
+			ok = it != t.end();
+			if (ok)
+				ok = samePosition(t, t.erase(it), ref, ref.erase(rit));
+			break;
+		}
+		case 12:
+			ok = checkEraseRange(t, ref, key, (int)(nextRandom(&state) % 8));
+			break;
+		default:
+		{
+			bool thrown = false;
+			try
+			{
+				const StringMap &c = t;
+				const std::unique_ptr<int> &got = c.at(key);
+				const std::unique_ptr<int> &want = ref.at(key);
+				ok = (got == nullptr) == (want == nullptr) && (got == nullptr || *got == *want);
+			}
+			catch (const std::out_of_range &)
+			{
+				thrown = true;
+			}
+			ok = ok && thrown == (ref.count(key) == 0);
+			break;
+		}
+		}
+
+		if (!ok)
+			printf("FAIL map operation %u on \"%s\" at step %d\n", op, key.c_str(), i);
+
+		if (ok && i % BATCH == BATCH - 1)
+		{
+			ok = sameContents(t, ref);
+			for (int j = 0; j < 64 && ok; j++)
+				ok = checkQueries(t, ref, stringKey(&state));
+
+			// Lookups without making a std::string
+			const char *probe = "1024";
+			ok = ok && t.count(probe) == ref.count(probe) &&
+				 samePosition(t, t.find(probe), ref, ref.find(probe)) &&
+				 samePosition(t, t.lower_bound(probe), ref, ref.lower_bound(probe));
+		}
+	}
+
+	ok = ok && sameContents(t, ref);
+	printf("%s string map         %d operations, %zu keys\n", ok ? "PASS" : "FAIL", ops, t.size());
+	return ok;
+}
+
+/**
+ * Random updates of a set of tuples, growing and shrinking it in turns
+ */
+static bool checkSet(int ops, unsigned int seed)
+{
+	TupleSet t;
+	TupleRef ref;
+	unsigned int state = seed;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		bool grow = (i / (4 * BATCH)) % 2 == 0;
+		TupleKey key = tupleKey(&state);
+		unsigned int op = nextRandom(&state) % 8;
+		if (!grow && op < 3 && nextRandom(&state) % 2 == 0)
+			op = 3;
+		else if (grow && op >= 3 && op <= 6 && nextRandom(&state) % 4 != 0)
+			op = 0;
+
+		switch (op)
+		{
+		case 0:
+		{
+			auto got = t.insert(key);
+			auto want = ref.insert(key);
+			ok = got.second == want.second && samePosition(t, got.first, ref, want.first);
+			break;
+		}
+		case 1:
+		{
+			auto got = t.emplace(std::get<0>(key), std::get<1>(key));
+			auto want = ref.emplace(std::get<0>(key), std::get<1>(key));
+			ok = got.second == want.second && samePosition(t, got.first, ref, want.first);
+			break;
+		}
+		case 2:
+		{
+			// A few keys at once, some of them present
+			std::vector<TupleKey> keys = {key, tupleKey(&state), key, tupleKey(&state)};
+			t.insert(keys.begin(), keys.end());
+			ref.insert(keys.begin(), keys.end());
+			break;
+		}
+		case 3:
+		case 4:
+			ok = t.erase(key) == ref.erase(key);
+			break;
+		case 5:
+		{
+			auto rit = ref.lower_bound(key);
+			if (rit == ref.end())
+				break;
+			auto it = t.find(*rit);
+			ok = it != t.end();
+			if (ok)
+				ok = samePosition(t, t.erase(it), ref, ref.erase(rit));
+			break;
+		}
+		case 6:
+			ok = checkEraseRange(t, ref, key, (int)(nextRandom(&state) % 8));
+			break;
+		default:
+			ok = checkQueries(t, ref, key);
+			break;
+		}
+
+		if (!ok)
+			printf("FAIL set operation %u on (%d, \"%s\") at step %d\n", op, std::get<0>(key),
+				   std::get<1>(key).c_str(), i);
+
+		if (ok && i % BATCH == BATCH - 1)
+		{
+			ok = sameContents(t, ref);
+			for (int j = 0; j < 64 && ok; j++)
+				ok = checkQueries(t, ref, tupleKey(&state));
+		}
+	}
+
+	ok = ok && sameContents(t, ref);
+	printf("%s tuple set          %d operations, %zu keys\n", ok ? "PASS" : "FAIL", ops, t.size());
+	return ok;
+}
+
+/**
+ * Copies, moves and swaps, checking each tree holds what it should
+ * afterwards and that changing one leaves the others alone
+ */
+static bool checkCopyMove(unsigned int seed)
+{
+	unsigned int state = seed;
+	TupleSet a;
+	TupleRef ref;
+	for (int i = 0; i < COPY_KEYS; i++)
+	{
+		TupleKey key = tupleKey(&state);
+		a.insert(key);
+		ref.insert(key);
+	}
+
+	// A copy has the same elements and its own nodes
+	TupleSet b(a);
+	bool ok = sameContents(b, ref) && a == b;
+	TupleRef erased = ref;
+	for (int i = 0; i < COPY_KEYS / 2 && ok; i++)
+	{
+		TupleKey key = tupleKey(&state);
+		ok = a.erase(key) == erased.erase(key);
+	}
+	ok = ok && sameContents(a, erased) && sameContents(b, ref) && (a == b) == (erased == ref);
+
+	TupleSet c;
+	c.insert(tupleKey(&state));
+	c = a;
+	TupleSet &alias = c;
+	c = alias;
+	ok = ok && sameContents(c, erased);
+
+	// A moved from tree is empty and can be used again
+	TupleSet d(std::move(b));
+	ok = ok && sameContents(d, ref) && b.empty() && b.begin() == b.end();
+	b.insert(TupleKey(1, "1"));
+	ok = ok && b.size() == 1 && *b.begin() == TupleKey(1, "1");
+	b = std::move(d);
+	ok = ok && sameContents(b, ref) && d.empty();
+
+	// On a swap, iterators follow their elements, up to the end of the
+	// tree they are now in
+	auto first = a.begin();
+	auto last = std::prev(b.end());
+	swap(a, b);
+	ok = ok && sameContents(a, ref) && sameContents(b, erased);
+	ok = ok && first != b.end() && *first == *erased.begin() && std::next(last) == a.end() &&
+		 *last == *ref.rbegin() && std::distance(first, b.end()) == (long)erased.size();
+	a.swap(d);
+	ok = ok && a.empty() && sameContents(d, ref);
+
+	// Values of a map are moved with it, not copied
+	StringMap m;
+	StringRef mref;
+	for (int i = 0; i < COPY_KEYS; i++)
+	{
+		std::string key = stringKey(&state);
+		int value = (int)(nextRandom(&state) % 1000);
+		m.try_emplace(key, std::make_unique<int>(value));
+		mref.try_emplace(key, std::make_unique<int>(value));
+	}
+	const int *value = m.begin()->second.get();
+	StringMap n(std::move(m));
+	StringMap o;
+	o = std::move(n);
+	ok = ok && m.empty() && n.empty() && o.begin()->second.get() == value && sameContents(o, mref);
+	swap(m, o);
+	ok = ok && o.empty() && m.begin()->second.get() == value && sameContents(m, mref);
+
+	printf("%s copy, move, swap   %d keys\n", ok ? "PASS" : "FAIL", COPY_KEYS);
+	return ok;
+}
+
+/**
+ * Compare find, count, lower_bound, upper_bound, floor and ceiling at a
+ * key, through const trees
+ */
+template <class Tree, class Ref, class Key>
+static bool checkQueries(const Tree &t, const Ref &ref, const Key &key)
+{
+	auto floor = ref.upper_bound(key);
+	floor = (floor == ref.begin()) ? ref.end() : std::prev(floor);
+
+	bool ok = t.count(key) == ref.count(key) && t.contains(key) == (ref.count(key) == 1) &&
+			  samePosition(t, t.find(key), ref, ref.find(key)) &&
+			  samePosition(t, t.lower_bound(key), ref, ref.lower_bound(key)) &&
+			  samePosition(t, t.upper_bound(key), ref, ref.upper_bound(key)) &&
+			  samePosition(t, t.floor(key), ref, floor) &&
+			  samePosition(t, t.ceiling(key), ref, ref.lower_bound(key));
+
+	auto range = t.equal_range(key);
+	auto want = ref.equal_range(key);
+	ok = ok && samePosition(t, range.first, ref, want.first) &&
+		 samePosition(t, range.second, ref, want.second);
+
+	if (!ok)
+		printf("FAIL queries differ from std\n");
+	return ok;
+}
+
+/**
+ * Erase the elements from the first at or after lower through up to span
+ * more, and compare the iterators returned
+ */
+template <class Tree, class Ref>
+static bool checkEraseRange(Tree &t, Ref &ref, const typename Ref::key_type &lower, int span)
+{
+	auto first = ref.lower_bound(lower);
+	auto last = first;
+	for (int i = 0; i < span && last != ref.end(); i++)
+		++last;
+
+	auto tFirst = t.lower_bound(lower);
+	auto tLast = (last == ref.end()) ? t.end() : t.find(keyOf(*last));
+	auto got = t.erase(tFirst, tLast);
+	auto want = ref.erase(first, last);
+	return samePosition(t, got, ref, want);
+}
+
+/**
+ * Compare the elements in order, then backwards through the reverse
+ * iterators, which step back from end()
+ */
+template <class Tree, class Ref>
+static bool sameContents(const Tree &t, const Ref &ref)
+{
+	auto same = [](const auto &a, const auto &b) { return sameElement(a, b); };
+	bool ok = t.size() == ref.size() && t.empty() == ref.empty() &&
+			  std::equal(t.begin(), t.end(), ref.begin(), ref.end(), same) &&
+			  std::equal(t.rbegin(), t.rend(), ref.rbegin(), ref.rend(), same) &&
+			  std::equal(t.crbegin(), t.crend(), ref.crbegin(), ref.crend(), same);
+
+	if (!ok)
+		printf("FAIL contents differ from std, %zu and %zu elements\n", t.size(), ref.size());
+	return ok;
+}
+
+/**
+ * Check two iterators are both at the end or both at the same key
+ */
+template <class Tree, class Ref, class TreeIt, class RefIt>
+static bool samePosition(const Tree &t, TreeIt it, const Ref &ref, RefIt rit)
+{
+	if (it == t.end() || rit == ref.end())
+		return it == t.end() && rit == ref.end();
+	return keyOf(*it) == keyOf(*rit);
+}
+
+/* Helper Functions */
+
+template <class K, class T>
+static const K &keyOf(const std::pair<const K, T> &element)
+{
+	return element.first;
+}
+
+template <class K>
+static const K &keyOf(const K &element)
+{
+	return element;
+}
+
+/**
+ * Map elements are the same if their keys are and their values are both
+ * null or point at equal ints
+ */
+template <class K, class T>
+static bool sameElement(const std::pair<const K, std::unique_ptr<T>> &a,
+						const std::pair<const K, std::unique_ptr<T>> &b)
+{
+	if (a.first != b.first || (a.second == nullptr) != (b.second == nullptr))
+		return false;
+	return a.second == nullptr || *a.second == *b.second;
+}
+
+template <class K>
+static bool sameElement(const K &a, const K &b)
+{
+	return a == b;
+}
+
+static std::string stringKey(unsigned int *state)
+{
+	return std::to_string(nextRandom(state) % KEYSPACE);
+}
+
+static TupleKey tupleKey(unsigned int *state)
+{
+	unsigned int n = nextRandom(state) % KEYSPACE;
+	return TupleKey((int)(n % 64) - 32, std::to_string(n / 64));
+}
+
+static unsigned int nextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
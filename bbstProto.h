@@ -0,0 +1,121 @@
+// Wire protocol of bbstd, the tree server, and its clients.
+//
+// A client connects to a Unix domain stream socket and sends requests as
+// fixed size BbstRequest records, back to back. It does not have to wait
+// for a response before sending the next request: any number can be in
+// flight on a connection. The server answers every request, in the order
+// they were sent on that connection, with a BbstResponse. For
+// BBST_BETWEEN the response is followed by `count` 32-bit keys in
+// ascending order. Both sides use the byte order of the host, since a
+// Unix domain socket never leaves it.
+//
+// The value of a response is
+//   insert, delete, search  1 if the call returned true, else 0
+//   floor, ceiling, lca     the key returned, or UNDEFINED if none
+//   kth                     the kth smallest key, or UNDEFINED
+//   between                 the number of keys in the range, of which at
+//                           most BBST_MAX_KEYS are sent
+//   size                    the number of keys in the tree
+//
+// Each run of reads is answered from one consistent view of the tree:
+// no insert or delete is applied while it runs, and it sees every
+// insert and delete sent before it on the same connection.
+//
+// Replication runs on a second socket. A follower sends REPL_HELLO with
+// the epoch and sequence number of the last update it holds. The
+// primary answers with the updates after it as REPL_BATCH frames, or
+// first with a REPL_SNAPSHOT of its whole tree if it no longer holds
+// them or the epoch is not its own, then keeps sending a batch for every
+// pass of its event loop that changed the tree. The follower sends
+// REPL_ACK with its sequence number after applying the frames it read.
+// Every successful insert or delete on the primary is one update, and
+// updates are numbered from 1 within an epoch, which a primary picks
+// when it starts.
+
+#ifndef BBST_PROTO_H
+#define BBST_PROTO_H
+
+#include <stdint.h>
+
+#define BBST_SOCKET "/tmp/bbstd.sock"
+#define BBST_REPL_SOCKET "/tmp/bbstd-repl.sock"
+// Keys sent back for one BBST_BETWEEN request at most
+#define BBST_MAX_KEYS 1024
+
+typedef enum bbstOp
+{
+	BBST_INSERT = 1,
+	BBST_DELETE,
+	BBST_SEARCH,
+	BBST_FLOOR,
+	BBST_CEILING,
+	// a is k, not a key
+	BBST_KTH,
+	BBST_LCA,
+	// a and b are lower and upper
+	BBST_BETWEEN,
+	BBST_SIZE,
+	BBST_NUM_OPS,
+} BbstOp;
+
+#define BBST_IS_WRITE(op) ((op) == BBST_INSERT || (op) == BBST_DELETE)
+
+typedef enum bbstStatus
+{
+	BBST_OK,
+	// The opcode is not a BbstOp
+	BBST_BAD_OP,
+	// An insert or delete sent to a follower
+	BBST_READ_ONLY,
+} BbstStatus;
+
+typedef struct bbstRequest
+{
+	// Chosen by the client and echoed in the response
+	uint32_t id;
+	uint8_t op;
+	uint8_t reserved[3];
+	int32_t a;
+	int32_t b;
+} BbstRequest;
+
+typedef struct bbstResponse
+{
+	uint32_t id;
+	uint8_t op;
+	uint8_t status;
+	uint16_t reserved;
+	int32_t value;
+	// Keys following the response
+	uint32_t count;
+} BbstResponse;
+
+typedef enum replType
+{
+	REPL_HELLO = 1,
+	// count ReplRecords follow, the first is update seq
+	REPL_BATCH,
+	// count keys follow in ascending order, the tree as of update seq
+	REPL_SNAPSHOT,
+	REPL_ACK,
+} ReplType;
+
+typedef struct replFrame
+{
+	uint32_t type;
+	uint32_t count;
+	uint64_t epoch;
+	uint64_t seq;
+	// CLOCK_MONOTONIC time the first update of a batch was applied on
+	// the primary, so a follower on the same host can tell its lag
+	uint64_t timeNs;
+} ReplFrame;
+
+typedef struct replRecord
+{
+	int32_t key;
+	// BBST_INSERT or BBST_DELETE
+	uint32_t op;
+} ReplRecord;
+
+#endif
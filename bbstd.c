@@ -0,0 +1,1415 @@
+// Tree server: serves one Tree over a Unix domain socket with the
+// protocol of bbstProto.h.
+//
+// A single thread runs an epoll loop over every connection. It reads as
+// many requests as are waiting, applies inserts and deletes itself under
+// the write side of a rwlock, and hands each run of up to -b reads on a
+// connection to a pool of -t worker threads, which answer the whole run
+// under one read lock. A connection is not read from again until its run
+// is answered, so responses stay in order and every read sees the writes
+// sent before it. Responses are collected per connection and written
+// with one send per pass of the loop.
+//
+// By default there is a worker for every CPU but the one running the
+// loop; with -t 0 the loop answers reads itself.
+//
+// With -r the server ships every successful insert and delete to
+// followers connecting on a second socket, as described in bbstProto.h.
+// The last REPL_LOG_SIZE updates are kept, so a follower that reconnects
+// is sent only the updates it missed, and otherwise a snapshot first.
+// With -f the server is a follower of the primary listening on the given
+// socket: it applies the updates, answers reads and turns inserts and
+// deletes away. On SIGUSR1 it stops following and takes writes itself.
+// A follower given -r ships what it applies on to its own followers.
+// Every second either reports how far behind its followers are.
+//
+// With -S the tree is saved to a snapshot file on exit and loaded from
+// it on start. A follower restarted from its snapshot then asks only for
+// the updates since, and is sent just those if the primary still has
+// them.
+//
+// Messages printed by the tree (e.g. for duplicate inserts) are
+// discarded.
+//
+// Usage: ./bbstd [-s socket] [-t workers] [-b max reads per batch]
+//                [-r replication socket] [-f primary replication socket]
+//                [-S snapshot file]
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "List.h"
+#include "bbstProto.h"
+#include "bench.h"
+
+#define DEFAULT_BATCH 64
+#define MAX_WORKERS 64
+#define MAX_EVENTS 256
+#define READ_CHUNK (64 * 1024)
+// A connection is not read from while this much is waiting to be
+// processed or sent on it
+#define IN_LIMIT (1 << 20)
+#define OUT_LIMIT (1 << 20)
+// Updates kept for followers that fall behind or reconnect
+#define REPL_LOG_SIZE (1 << 20)
+// Updates per REPL_BATCH frame at most
+#define REPL_BATCH_MAX 4096
+// A follower is not sent more while this much is waiting to go to it
+#define REPL_OUT_LIMIT (4 << 20)
+#define REPORT_NS 1000000000ULL
+#define SNAPSHOT_MAGIC "BBSTSNP1"
+
+typedef enum connKind
+{
+	CONN_CLIENT,
+	// A follower of this server
+	CONN_FOLLOWER,
+	// The primary this server follows
+	CONN_PRIMARY,
+} ConnKind;
+
+typedef struct buffer
+{
+	char *data;
+	size_t len;
+	size_t cap;
+} Buffer;
+
+typedef struct conn
+{
+	int fd;
+	ConnKind kind;
+	Buffer in;
+	// Processed bytes at the start of in, and sent bytes of out
+	size_t inOff;
+	Buffer out;
+	size_t outOff;
+	// A run of reads is with the workers
+	bool busy;
+	// Closed, freed after the current pass of the loop once it is not
+	// busy
+	bool closed;
+	uint32_t events;
+	// Followers: whether REPL_HELLO was seen, the last update queued to
+	// it and the last it acknowledged
+	bool hello;
+	uint64_t sentSeq;
+	uint64_t ackSeq;
+	struct conn *prev;
+	struct conn *next;
+} Conn;
+
+typedef struct snapshotHeader
+{
+	char magic[8];
+	uint64_t epoch;
+	uint64_t seq;
+	uint64_t count;
+} SnapshotHeader;
+
+typedef struct job
+{
+	Conn *conn;
+	BbstRequest *reqs;
+	int count;
+	Buffer out;
+	struct job *next;
+} Job;
+
+typedef struct jobQueue
+{
+	Job *head;
+	Job *tail;
+} JobQueue;
+
+typedef struct server
+{
+	Tree t;
+	long size;
+	pthread_rwlock_t lock;
+
+	int listenFd;
+	int epollFd;
+	// Workers signal finished jobs through this
+	int eventFd;
+	Conn *conns;
+	// Closed connections waiting to be freed
+	Conn *dead;
+
+	int workers;
+	int maxBatch;
+	pthread_t threads[MAX_WORKERS];
+	pthread_mutex_t mutex;
+	pthread_cond_t ready;
+	JobQueue pending;
+	JobQueue done;
+	bool stopping;
+
+	long connections;
+	long requests;
+	long batches;
+
+	// Replication. seq is the last update applied, the updates from
+	// logStart to seq are in log at seq % REPL_LOG_SIZE.
+	int replListenFd;
+	uint64_t epoch;
+	uint64_t seq;
+	uint64_t logStart;
+	ReplRecord *log;
+	uint64_t *logNs;
+	uint64_t shippedSeq;
+	int followers;
+	Conn *primary;
+	bool readOnly;
+	// Follower: updates applied and their lag since the last report
+	Histogram lag;
+	long applied;
+	long diverged;
+	uint64_t reportNs;
+	uint64_t reportSeq;
+} Server;
+
+static volatile sig_atomic_t Stop = 0;
+static volatile sig_atomic_t PromoteRequested = 0;
+// stderr is discarded, messages of the server go here
+static FILE *Log;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static int Listen(Server *s, const char *path);
+static void Serve(Server *s);
+static void Accept(Server *s, int listenFd, ConnKind kind);
+static void Service(Server *s, Conn *c);
+static void ConnectPrimary(Server *s, const char *path);
+static void ServicePrimary(Server *s, Conn *c);
+static bool ApplyFrame(Server *s, ReplFrame *f, const char *payload);
+static void ServiceFollower(Server *s, Conn *c);
+static void Ship(Server *s, Conn *c);
+static void ShipAll(Server *s);
+static void SendSnapshot(Server *s, Conn *c);
+static void LogAppend(Server *s, int op, int key);
+static void Promote(Server *s);
+static void ReportReplication(Server *s, uint64_t now);
+static bool SaveSnapshot(Server *s, const char *path);
+static bool LoadSnapshot(Server *s, const char *path);
+static void Rebuild(Server *s, const int32_t *keys, uint64_t n);
+static void InsertBalanced(Tree t, const int32_t *keys, long lo, long hi);
+static void AppendKeys(Node n, Buffer *out);
+static bool Process(Server *s, Conn *c);
+static void Execute(Server *s, BbstRequest *r, Buffer *out);
+static void FinishJobs(Server *s);
+static void *Worker(void *arg);
+static bool ReadConn(Conn *c);
+static bool Flush(Conn *c);
+static void UpdateEvents(Server *s, Conn *c);
+static void CloseConn(Server *s, Conn *c);
+static void FreeDead(Server *s);
+static void Push(JobQueue *q, Job *j);
+static Job *Pop(JobQueue *q);
+static void CollectBetween(Node n, int lower, int upper, Buffer *out, BbstResponse *resp);
+static char *BufferReserve(Buffer *b, size_t extra);
+static void BufferAppend(Buffer *b, const void *data, size_t length);
+static uint64_t Now(void);
+static void OnSignal(int sig);
+static void OnPromote(int sig);
+static void PrintUsage(const char *name);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	Server s = {
+		.workers = sysconf(_SC_NPROCESSORS_ONLN) - 1,
+		.maxBatch = DEFAULT_BATCH,
+		.replListenFd = -1,
+		.logStart = 1,
+	};
+	const char *path = BBST_SOCKET;
+	const char *replPath = NULL;
+	const char *primaryPath = NULL;
+	const char *snapshotPath = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			path = argv[++i];
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			s.workers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			s.maxBatch = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			replPath = argv[++i];
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			primaryPath = argv[++i];
+		else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+			snapshotPath = argv[++i];
+		else
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (s.workers > MAX_WORKERS)
+		s.workers = MAX_WORKERS;
+	if (s.workers < 0 || s.maxBatch < 1)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Keep the tree quiet, it reports every rejected insert or delete
+	Log = fdopen(dup(STDERR_FILENO), "w");
+	int devNull = open("/dev/null", O_WRONLY);
+	if (Log == NULL || devNull < 0)
+	{
+		perror("bbstd");
+		return EXIT_FAILURE;
+	}
+	setvbuf(Log, NULL, _IOLBF, 0);
+	dup2(devNull, STDERR_FILENO);
+	close(devNull);
+
+	struct sigaction sa = {.sa_handler = OnSignal};
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sa.sa_handler = OnPromote;
+	sigaction(SIGUSR1, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	// Prefer the writer, so that a steady stream of reads cannot hold
+	// back inserts and deletes forever
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&s.lock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+	pthread_mutex_init(&s.mutex, NULL);
+	pthread_cond_init(&s.ready, NULL);
+
+	s.t = TreeNew();
+	if (snapshotPath != NULL && access(snapshotPath, F_OK) == 0 && !LoadSnapshot(&s, snapshotPath))
+		return EXIT_FAILURE;
+
+	// A primary numbers its updates afresh, a follower keeps the epoch
+	// of the snapshot it was restarted from
+	if (primaryPath == NULL)
+		s.epoch = (Now() << 16 ^ getpid()) | 1;
+
+	s.listenFd = Listen(&s, path);
+	if (replPath != NULL)
+	{
+		s.replListenFd = Listen(&s, replPath);
+		s.log = malloc(REPL_LOG_SIZE * sizeof(ReplRecord));
+		s.logNs = malloc(REPL_LOG_SIZE * sizeof(uint64_t));
+		if (s.log == NULL || s.logNs == NULL)
+		{
+			fprintf(Log, "Could not malloc Replication Log\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (primaryPath != NULL)
+		ConnectPrimary(&s, primaryPath);
+
+	for (int i = 0; i < s.workers; i++)
+		pthread_create(&s.threads[i], NULL, Worker, &s);
+
+	fprintf(Log, "bbstd: listening on %s with %d workers\n", path, s.workers);
+	Serve(&s);
+
+	pthread_mutex_lock(&s.mutex);
+	s.stopping = true;
+	pthread_cond_broadcast(&s.ready);
+	pthread_mutex_unlock(&s.mutex);
+	for (int i = 0; i < s.workers; i++)
+		pthread_join(s.threads[i], NULL);
+
+	FinishJobs(&s);
+	while (s.conns != NULL)
+		CloseConn(&s, s.conns);
+	FreeDead(&s);
+
+	if (snapshotPath != NULL && SaveSnapshot(&s, snapshotPath))
+		fprintf(Log, "bbstd: saved %ld keys at update %llu to %s\n", s.size,
+				(unsigned long long)s.seq, snapshotPath);
+
+	close(s.listenFd);
+	close(s.epollFd);
+	close(s.eventFd);
+	unlink(path);
+	if (s.replListenFd >= 0)
+	{
+		close(s.replListenFd);
+		unlink(replPath);
+	}
+	free(s.log);
+	free(s.logNs);
+	TreeFree(s.t);
+	pthread_rwlock_destroy(&s.lock);
+	pthread_mutex_destroy(&s.mutex);
+	pthread_cond_destroy(&s.ready);
+
+	fprintf(Log, "bbstd: served %ld requests on %ld connections, %ld read batches\n",
+			s.requests, s.connections, s.batches);
+	fclose(Log);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Create a listening socket and add it to the epoll set, which is
+ * created on the first call. Returns the socket.
+ */
+static int Listen(Server *s, const char *path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		fprintf(Log, "bbstd: socket path too long: %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(addr.sun_path, path);
+
+	// A socket file left by a server that did not exit cleanly
+	unlink(path);
+
+	if (s->epollFd == 0)
+	{
+		s->epollFd = epoll_create1(EPOLL_CLOEXEC);
+		s->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (s->epollFd < 0 || s->eventFd < 0)
+		{
+			fprintf(Log, "bbstd: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		// The listening sockets and the eventfd are told apart from
+		// connections by their data
+		struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &s->eventFd};
+		epoll_ctl(s->epollFd, EPOLL_CTL_ADD, s->eventFd, &ev);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+		listen(fd, SOMAXCONN) != 0)
+	{
+		fprintf(Log, "bbstd: %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	struct epoll_event ev = {.events = EPOLLIN,
+							 .data.ptr = (s->listenFd == 0) ? &s->listenFd : &s->replListenFd};
+	epoll_ctl(s->epollFd, EPOLL_CTL_ADD, fd, &ev);
+	return fd;
+}
+
+/**
+ * Run the event loop until SIGINT or SIGTERM
+ */
+static void Serve(Server *s)
+{
+	struct epoll_event events[MAX_EVENTS];
+	bool replicating = s->replListenFd >= 0 || s->primary != NULL;
+	s->reportNs = Now() + REPORT_NS;
+
+	while (!Stop)
+	{
+		if (PromoteRequested)
+		{
+			PromoteRequested = 0;
+			Promote(s);
+		}
+
+		int n = epoll_wait(s->epollFd, events, MAX_EVENTS, replicating ? REPORT_NS / 1000000 : -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fprintf(Log, "bbstd: epoll_wait: %s\n", strerror(errno));
+			return;
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			void *ptr = events[i].data.ptr;
+			uint32_t ev = events[i].events;
+
+			if (ptr == &s->listenFd)
+				Accept(s, s->listenFd, CONN_CLIENT);
+			else if (ptr == &s->replListenFd)
+				Accept(s, s->replListenFd, CONN_FOLLOWER);
+			else if (ptr == &s->eventFd)
+			{
+				uint64_t count;
+				if (read(s->eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+					fprintf(Log, "bbstd: eventfd: %s\n", strerror(errno));
+				FinishJobs(s);
+			}
+			else
+			{
+				Conn *c = ptr;
+				if (c->closed)
+					continue;
+				if ((ev & EPOLLIN) && !ReadConn(c))
+					CloseConn(s, c);
+				else if (!(ev & EPOLLIN) && (ev & (EPOLLHUP | EPOLLERR)))
+					CloseConn(s, c);
+				else if (c->kind == CONN_FOLLOWER)
+					ServiceFollower(s, c);
+				else if (c->kind == CONN_PRIMARY)
+					ServicePrimary(s, c);
+				else
+					Service(s, c);
+			}
+		}
+
+		// One batch to every follower for all the updates of this pass
+		ShipAll(s);
+
+		// Only now, as later events of the same pass can still name a
+		// connection closed earlier in it
+		FreeDead(s);
+
+		uint64_t now = Now();
+		if (replicating && now >= s->reportNs)
+			ReportReplication(s, now);
+	}
+}
+
+static void Accept(Server *s, int listenFd, ConnKind kind)
+{
+	for (;;)
+	{
+		int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno != EAGAIN && errno != EINTR)
+				fprintf(Log, "bbstd: accept: %s\n", strerror(errno));
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		Conn *c = calloc(1, sizeof(Conn));
+		if (c == NULL)
+		{
+			fprintf(Log, "Could not malloc Conn\n");
+			exit(EXIT_FAILURE);
+		}
+		c->fd = fd;
+		c->kind = kind;
+		c->events = EPOLLIN;
+		s->followers += (kind == CONN_FOLLOWER);
+
+		struct epoll_event ev = {.events = c->events, .data.ptr = c};
+		epoll_ctl(s->epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+		c->next = s->conns;
+		if (s->conns != NULL)
+			s->conns->prev = c;
+		s->conns = c;
+		s->connections++;
+	}
+}
+
+/**
+ * Answer what can be answered on a connection and send the responses
+ */
+static void Service(Server *s, Conn *c)
+{
+	bool progress;
+	do
+	{
+		progress = Process(s, c);
+		if (!Flush(c))
+		{
+			CloseConn(s, c);
+			return;
+		}
+		// Processing stops when the output is full, carry on if it was
+		// all sent
+	} while (progress && !c->busy && c->out.len == 0 &&
+			 c->in.len - c->inOff >= sizeof(BbstRequest));
+
+	UpdateEvents(s, c);
+}
+
+/**
+ * Apply the complete requests read on a connection, until a run of
+ * reads has to wait for a worker. Returns whether any were taken.
+ */
+static bool Process(Server *s, Conn *c)
+{
+	bool progress = false;
+
+	while (!c->busy && c->out.len - c->outOff <= OUT_LIMIT)
+	{
+		int avail = (c->in.len - c->inOff) / sizeof(BbstRequest);
+		if (avail == 0)
+			break;
+
+		// Whole requests are taken and the buffer is compacted to the
+		// start, so requests are always aligned
+		BbstRequest *reqs = (BbstRequest *)(c->in.data + c->inOff);
+		bool isWrite = BBST_IS_WRITE(reqs[0].op);
+		int run = 1;
+		while (run < avail && BBST_IS_WRITE(reqs[run].op) == isWrite &&
+			   (isWrite || run < s->maxBatch))
+			run++;
+
+		if (isWrite || s->workers == 0)
+		{
+			if (isWrite)
+				pthread_rwlock_wrlock(&s->lock);
+			else
+				pthread_rwlock_rdlock(&s->lock);
+			for (int i = 0; i < run; i++)
+				Execute(s, &reqs[i], &c->out);
+			pthread_rwlock_unlock(&s->lock);
+		}
+		else
+		{
+			Job *j = calloc(1, sizeof(Job));
+			if (j == NULL || (j->reqs = malloc(run * sizeof(BbstRequest))) == NULL)
+			{
+				fprintf(Log, "Could not malloc Job\n");
+				exit(EXIT_FAILURE);
+			}
+			memcpy(j->reqs, reqs, run * sizeof(BbstRequest));
+			j->count = run;
+			j->conn = c;
+			c->busy = true;
+			s->batches++;
+
+			pthread_mutex_lock(&s->mutex);
+			Push(&s->pending, j);
+			pthread_cond_signal(&s->ready);
+			pthread_mutex_unlock(&s->mutex);
+		}
+
+		c->inOff += run * sizeof(BbstRequest);
+		s->requests += run;
+		progress = true;
+	}
+
+	if (c->inOff == c->in.len)
+		c->in.len = c->inOff = 0;
+	else if (c->inOff > 0)
+	{
+		memmove(c->in.data, c->in.data + c->inOff, c->in.len - c->inOff);
+		c->in.len -= c->inOff;
+		c->inOff = 0;
+	}
+
+	return progress;
+}
+
+/**
+ * Apply one request and append its response
+ */
+static void Execute(Server *s, BbstRequest *r, Buffer *out)
+{
+	BbstResponse resp = {.id = r->id, .op = r->op};
+	Tree t = s->t;
+
+	switch (r->op)
+	{
+	case BBST_INSERT:
+	case BBST_DELETE:
+		if (s->readOnly)
+		{
+			resp.status = BBST_READ_ONLY;
+			break;
+		}
+
+		resp.value = (r->op == BBST_INSERT) ? TreeInsert(t, r->a) : TreeDelete(t, r->a);
+		if (resp.value)
+		{
+			s->size += (r->op == BBST_INSERT) ? 1 : -1;
+			LogAppend(s, r->op, r->a);
+		}
+		break;
+	case BBST_SEARCH:
+		resp.value = TreeSearch(t, r->a);
+		break;
+	case BBST_FLOOR:
+		resp.value = TreeFloor(t, r->a);
+		break;
+	case BBST_CEILING:
+		resp.value = TreeCeiling(t, r->a);
+		break;
+	case BBST_KTH:
+		// Refused up front, so an out of range k cannot make the walk run
+		// over the whole tree under the read lock
+		resp.value = (r->a < 1 || r->a > s->size) ? UNDEFINED : TreeKthSmallest(t, r->a);
+		break;
+	case BBST_LCA:
+		resp.value = TreeLCA(t, r->a, r->b);
+		break;
+	case BBST_BETWEEN:
+	{
+		// The keys are written straight after the response, which is
+		// filled in once they are counted. The tree is walked here so
+		// that they go into the buffer without building a List first.
+		size_t at = out->len;
+		BufferReserve(out, sizeof(resp));
+		out->len += sizeof(resp);
+		CollectBetween(t->root, r->a, r->b, out, &resp);
+		memcpy(out->data + at, &resp, sizeof(resp));
+		return;
+	}
+	case BBST_SIZE:
+		resp.value = s->size;
+		break;
+	default:
+		resp.status = BBST_BAD_OP;
+	}
+
+	BufferAppend(out, &resp, sizeof(resp));
+}
+
+/**
+ * Hand the answered runs of reads back to their connections
+ */
+static void FinishJobs(Server *s)
+{
+	pthread_mutex_lock(&s->mutex);
+	Job *list = s->done.head;
+	s->done.head = s->done.tail = NULL;
+	pthread_mutex_unlock(&s->mutex);
+
+	while (list != NULL)
+	{
+		Job *j = list;
+		list = j->next;
+		Conn *c = j->conn;
+		c->busy = false;
+
+		if (!c->closed)
+		{
+			BufferAppend(&c->out, j->out.data, j->out.len);
+			Service(s, c);
+		}
+
+		free(j->reqs);
+		free(j->out.data);
+		free(j);
+	}
+}
+
+static void *Worker(void *arg)
+{
+	Server *s = arg;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&s->mutex);
+		while (s->pending.head == NULL && !s->stopping)
+			pthread_cond_wait(&s->ready, &s->mutex);
+		Job *j = Pop(&s->pending);
+		pthread_mutex_unlock(&s->mutex);
+
+		if (j == NULL)
+			return NULL;
+
+		// One lock for the whole run, so it sees one version of the tree
+		pthread_rwlock_rdlock(&s->lock);
+		for (int i = 0; i < j->count; i++)
+			Execute(s, &j->reqs[i], &j->out);
+		pthread_rwlock_unlock(&s->lock);
+
+		pthread_mutex_lock(&s->mutex);
+		Push(&s->done, j);
+		pthread_mutex_unlock(&s->mutex);
+
+		uint64_t one = 1;
+		if (write(s->eventFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+			fprintf(Log, "bbstd: eventfd: %s\n", strerror(errno));
+	}
+}
+
+/**
+ * Connect to the primary and ask for the updates after the last one
+ * held
+ */
+static void ConnectPrimary(Server *s, const char *path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		fprintf(Log, "bbstd: %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	Conn *c = calloc(1, sizeof(struct conn));
+	if (c == NULL)
+	{
+		fprintf(Log, "Could not malloc Conn\n");
+		exit(EXIT_FAILURE);
+	}
+	c->fd = fd;
+	c->kind = CONN_PRIMARY;
+	c->events = EPOLLIN;
+	struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+	epoll_ctl(s->epollFd, EPOLL_CTL_ADD, fd, &ev);
+	c->next = s->conns;
+	if (s->conns != NULL)
+		s->conns->prev = c;
+	s->conns = c;
+
+	ReplFrame hello = {.type = REPL_HELLO, .epoch = s->epoch, .seq = s->seq};
+	BufferAppend(&c->out, &hello, sizeof(hello));
+	Flush(c);
+	UpdateEvents(s, c);
+
+	s->primary = c;
+	s->readOnly = true;
+	s->reportSeq = s->seq;
+}
+
+/**
+ * Apply the complete frames read from the primary and acknowledge them
+ */
+static void ServicePrimary(Server *s, Conn *c)
+{
+	bool applied = false;
+
+	pthread_rwlock_wrlock(&s->lock);
+	while (c->in.len - c->inOff >= sizeof(ReplFrame))
+	{
+		ReplFrame f;
+		memcpy(&f, c->in.data + c->inOff, sizeof(f));
+		size_t length = sizeof(f) + (size_t)f.count *
+			(f.type == REPL_BATCH ? sizeof(ReplRecord) : sizeof(int32_t));
+		if (c->in.len - c->inOff < length)
+			break;
+
+		// Frames are a multiple of 4 bytes long, so the payload is
+		// aligned for keys and records
+		if (!ApplyFrame(s, &f, c->in.data + c->inOff + sizeof(f)))
+		{
+			pthread_rwlock_unlock(&s->lock);
+			CloseConn(s, c);
+			return;
+		}
+		c->inOff += length;
+		applied = true;
+	}
+	pthread_rwlock_unlock(&s->lock);
+
+	if (c->inOff == c->in.len)
+		c->in.len = c->inOff = 0;
+	else if (c->inOff > c->in.cap / 2)
+	{
+		memmove(c->in.data, c->in.data + c->inOff, c->in.len - c->inOff);
+		c->in.len -= c->inOff;
+		c->inOff = 0;
+	}
+
+	if (applied)
+	{
+		ReplFrame ack = {.type = REPL_ACK, .epoch = s->epoch, .seq = s->seq};
+		BufferAppend(&c->out, &ack, sizeof(ack));
+	}
+	if (!Flush(c))
+	{
+		CloseConn(s, c);
+		return;
+	}
+	UpdateEvents(s, c);
+}
+
+/**
+ * Apply one frame from the primary, under the write lock. Returns false
+ * if the stream does not follow on from the tree.
+ */
+static bool ApplyFrame(Server *s, ReplFrame *f, const char *payload)
+{
+	if (f->type == REPL_SNAPSHOT)
+	{
+		Rebuild(s, (const int32_t *)payload, f->count);
+		s->epoch = f->epoch;
+		s->seq = f->seq;
+		// What this server held before is no use to its own followers
+		s->logStart = s->seq + 1;
+		fprintf(Log, "bbstd: loaded a snapshot of %u keys at update %llu\n", f->count,
+				(unsigned long long)f->seq);
+		return true;
+	}
+
+	if (f->type != REPL_BATCH || f->epoch != s->epoch || f->seq != s->seq + 1)
+	{
+		fprintf(Log, "bbstd: expected update %llu from the primary, got frame %u at %llu\n",
+				(unsigned long long)s->seq + 1, f->type, (unsigned long long)f->seq);
+		return false;
+	}
+
+	const ReplRecord *r = (const ReplRecord *)payload;
+	for (uint32_t i = 0; i < f->count; i++)
+	{
+		bool done = (r[i].op == BBST_INSERT) ? TreeInsert(s->t, r[i].key) : TreeDelete(s->t, r[i].key);
+		if (done)
+			s->size += (r[i].op == BBST_INSERT) ? 1 : -1;
+		else
+			s->diverged++;
+		// Numbered as on the primary, for followers of this server
+		LogAppend(s, r[i].op, r[i].key);
+	}
+
+	uint64_t now = Now();
+	HistogramRecord(&s->lag, now > f->timeNs ? now - f->timeNs : 0);
+	s->applied += f->count;
+	return true;
+}
+
+/**
+ * Read REPL_HELLO and REPL_ACK frames from a follower and send it what
+ * it is missing
+ */
+static void ServiceFollower(Server *s, Conn *c)
+{
+	while (c->in.len - c->inOff >= sizeof(ReplFrame))
+	{
+		ReplFrame f;
+		memcpy(&f, c->in.data + c->inOff, sizeof(f));
+		c->inOff += sizeof(f);
+
+		if (f.type == REPL_HELLO)
+		{
+			c->hello = true;
+			c->ackSeq = f.seq;
+			if (f.epoch == s->epoch && f.seq <= s->seq && f.seq + 1 >= s->logStart)
+			{
+				c->sentSeq = f.seq;
+				fprintf(Log, "bbstd: follower at update %llu, sending the %llu after it\n",
+						(unsigned long long)f.seq, (unsigned long long)(s->seq - f.seq));
+			}
+			else
+			{
+				SendSnapshot(s, c);
+				fprintf(Log, "bbstd: follower at update %llu, sending a snapshot at %llu\n",
+						(unsigned long long)f.seq, (unsigned long long)s->seq);
+			}
+		}
+		else if (f.type == REPL_ACK && f.epoch == s->epoch)
+			c->ackSeq = f.seq;
+	}
+	if (c->inOff == c->in.len)
+		c->in.len = c->inOff = 0;
+
+	Ship(s, c);
+	if (!Flush(c))
+	{
+		CloseConn(s, c);
+		return;
+	}
+	UpdateEvents(s, c);
+}
+
+/**
+ * Queue the updates a follower has not been sent, as far as its output
+ * allows
+ */
+static void Ship(Server *s, Conn *c)
+{
+	if (!c->hello)
+		return;
+
+	while (c->sentSeq < s->seq && c->out.len - c->outOff < REPL_OUT_LIMIT)
+	{
+		// The follower fell so far behind that the updates it needs are
+		// gone
+		if (c->sentSeq + 1 < s->logStart)
+		{
+			SendSnapshot(s, c);
+			continue;
+		}
+
+		uint64_t first = c->sentSeq + 1;
+		uint32_t count = (s->seq - c->sentSeq < REPL_BATCH_MAX) ? s->seq - c->sentSeq : REPL_BATCH_MAX;
+		ReplFrame f = {
+			.type = REPL_BATCH,
+			.count = count,
+			.epoch = s->epoch,
+			.seq = first,
+			.timeNs = s->logNs[first % REPL_LOG_SIZE],
+		};
+		BufferAppend(&c->out, &f, sizeof(f));
+
+		// The ring wraps at most once within a batch
+		size_t start = first % REPL_LOG_SIZE;
+		size_t head = (start + count <= REPL_LOG_SIZE) ? count : REPL_LOG_SIZE - start;
+		BufferAppend(&c->out, s->log + start, head * sizeof(ReplRecord));
+		BufferAppend(&c->out, s->log, (count - head) * sizeof(ReplRecord));
+		c->sentSeq += count;
+	}
+}
+
+/**
+ * Send the updates of this pass to every follower
+ */
+static void ShipAll(Server *s)
+{
+	if (s->shippedSeq == s->seq)
+		return;
+	s->shippedSeq = s->seq;
+
+	for (Conn *c = s->conns, *next; c != NULL; c = next)
+	{
+		next = c->next;
+		if (c->kind != CONN_FOLLOWER || !c->hello)
+			continue;
+
+		Ship(s, c);
+		if (!Flush(c))
+			CloseConn(s, c);
+		else
+			UpdateEvents(s, c);
+	}
+}
+
+/**
+ * Queue the whole tree to a follower, which then needs only the updates
+ * after it
+ */
+static void SendSnapshot(Server *s, Conn *c)
+{
+	ReplFrame f = {
+		.type = REPL_SNAPSHOT,
+		.count = s->size,
+		.epoch = s->epoch,
+		.seq = s->seq,
+		.timeNs = Now(),
+	};
+	BufferAppend(&c->out, &f, sizeof(f));
+	BufferReserve(&c->out, (size_t)s->size * sizeof(int32_t));
+	AppendKeys(s->t->root, &c->out);
+	c->sentSeq = s->seq;
+}
+
+/**
+ * Number an update and keep it for followers, dropping the oldest once
+ * the log is full
+ */
+static void LogAppend(Server *s, int op, int key)
+{
+	s->seq++;
+	if (s->log == NULL)
+		return;
+
+	size_t i = s->seq % REPL_LOG_SIZE;
+	s->log[i] = (ReplRecord){.key = key, .op = op};
+	s->logNs[i] = Now();
+	if (s->seq - s->logStart >= REPL_LOG_SIZE)
+		s->logStart++;
+}
+
+/**
+ * Stop following and take writes. The updates are numbered in a new
+ * epoch, so followers of this server that were ahead of it are sent a
+ * snapshot.
+ */
+static void Promote(Server *s)
+{
+	if (!s->readOnly)
+		return;
+
+	if (s->primary != NULL)
+		CloseConn(s, s->primary);
+	s->readOnly = false;
+	s->epoch = (Now() << 16 ^ getpid()) | 1;
+	s->seq = 0;
+	s->logStart = 1;
+	s->shippedSeq = 0;
+	for (Conn *c = s->conns; c != NULL; c = c->next)
+		if (c->kind == CONN_FOLLOWER && c->hello)
+			SendSnapshot(s, c);
+
+	fprintf(Log, "bbstd: promoted to primary with %ld keys\n", s->size);
+}
+
+/**
+ * Print how replication went since the last report, if anything happened
+ */
+static void ReportReplication(Server *s, uint64_t now)
+{
+	double seconds = (now - s->reportNs + REPORT_NS) / 1e9;
+	s->reportNs = now + REPORT_NS;
+
+	if (s->readOnly && s->lag.total > 0)
+	{
+		fprintf(Log, "bbstd: follower at update %llu, %.0f updates/s, lag p50 %.1f us p99 %.1f us max %.1f us",
+				(unsigned long long)s->seq, s->applied / seconds, HistogramPercentile(&s->lag, 0.5) / 1e3,
+				HistogramPercentile(&s->lag, 0.99) / 1e3, s->lag.max / 1e3);
+		if (s->diverged > 0)
+			fprintf(Log, ", %ld updates did not apply", s->diverged);
+		fprintf(Log, "\n");
+		memset(&s->lag, 0, sizeof(s->lag));
+		s->applied = 0;
+	}
+
+	if (s->followers > 0 && (s->seq != s->reportSeq || !s->readOnly))
+	{
+		uint64_t slowest = s->seq;
+		for (Conn *c = s->conns; c != NULL; c = c->next)
+			if (c->kind == CONN_FOLLOWER && c->ackSeq < slowest)
+				slowest = c->ackSeq;
+		if (s->seq != s->reportSeq || slowest != s->seq)
+			fprintf(Log, "bbstd: at update %llu, %d followers, the slowest %llu updates behind\n",
+					(unsigned long long)s->seq, s->followers, (unsigned long long)(s->seq - slowest));
+	}
+	s->reportSeq = s->seq;
+}
+
+/**
+ * Write the tree to a file, by way of a temporary file so that a crash
+ * leaves the last snapshot whole
+ */
+static bool SaveSnapshot(Server *s, const char *path)
+{
+	char temp[PATH_MAX];
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+	FILE *fp = fopen(temp, "wb");
+	if (fp == NULL)
+	{
+		fprintf(Log, "bbstd: %s: %s\n", temp, strerror(errno));
+		return false;
+	}
+
+	Buffer keys = {0};
+	BufferReserve(&keys, (size_t)s->size * sizeof(int32_t));
+	AppendKeys(s->t->root, &keys);
+	SnapshotHeader h = {.epoch = s->epoch, .seq = s->seq, .count = s->size};
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+
+	bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(keys.data, 1, keys.len, fp) == keys.len;
+	ok = (fclose(fp) == 0) && ok && rename(temp, path) == 0;
+	if (!ok)
+	{
+		fprintf(Log, "bbstd: %s: %s\n", path, strerror(errno));
+		unlink(temp);
+	}
+	free(keys.data);
+	return ok;
+}
+
+static bool LoadSnapshot(Server *s, const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	SnapshotHeader h;
+	if (fp == NULL || fread(&h, sizeof(h), 1, fp) != 1 ||
+		memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.count > INT_MAX)
+	{
+		fprintf(Log, "bbstd: %s is not a snapshot\n", path);
+		if (fp != NULL)
+			fclose(fp);
+		return false;
+	}
+
+	int32_t *keys = malloc(h.count * sizeof(int32_t) + 1);
+	if (keys == NULL)
+	{
+		fprintf(Log, "Could not malloc Snapshot\n");
+		exit(EXIT_FAILURE);
+	}
+	bool ok = fread(keys, sizeof(int32_t), h.count, fp) == h.count;
+	fclose(fp);
+	if (ok)
+	{
+		Rebuild(s, keys, h.count);
+		s->epoch = h.epoch;
+		s->seq = h.seq;
+		s->logStart = s->seq + 1;
+		fprintf(Log, "bbstd: loaded %llu keys at update %llu from %s\n", (unsigned long long)h.count,
+				(unsigned long long)h.seq, path);
+	}
+	else
+		fprintf(Log, "bbstd: %s is truncated\n", path);
+
+	free(keys);
+	return ok;
+}
+
+/**
+ * Read what is waiting on a connection, returns false once it is closed
+ * by the peer or fails
+ */
+static bool ReadConn(Conn *c)
+{
+	// A snapshot from the primary is read whole, however large
+	while (c->kind == CONN_PRIMARY || c->in.len - c->inOff <= IN_LIMIT)
+	{
+		BufferReserve(&c->in, READ_CHUNK);
+		ssize_t n = read(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len);
+		if (n > 0)
+			c->in.len += n;
+		else if (n == 0)
+			return false;
+		else if (errno == EAGAIN)
+			return true;
+		else if (errno != EINTR)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Send as much of the output as the socket takes, returns false if the
+ * connection failed
+ */
+static bool Flush(Conn *c)
+{
+	while (c->outOff < c->out.len)
+	{
+		ssize_t n = send(c->fd, c->out.data + c->outOff, c->out.len - c->outOff, MSG_NOSIGNAL);
+		if (n > 0)
+			c->outOff += n;
+		else if (n < 0 && errno == EAGAIN)
+			break;
+		else if (n < 0 && errno != EINTR)
+			return false;
+	}
+
+	if (c->outOff == c->out.len)
+		c->out.len = c->outOff = 0;
+	else if (c->outOff > c->out.cap / 2)
+	{
+		memmove(c->out.data, c->out.data + c->outOff, c->out.len - c->outOff);
+		c->out.len -= c->outOff;
+		c->outOff = 0;
+	}
+
+	return true;
+}
+
+/**
+ * Wait for input only when it can be processed, and for the socket to
+ * drain only when output is waiting
+ */
+static void UpdateEvents(Server *s, Conn *c)
+{
+	uint32_t events = 0;
+	if (c->kind != CONN_CLIENT ||
+		(!c->busy && c->out.len - c->outOff <= OUT_LIMIT && c->in.len - c->inOff <= IN_LIMIT))
+		events |= EPOLLIN;
+	if (c->outOff < c->out.len)
+		events |= EPOLLOUT;
+
+	if (events != c->events)
+	{
+		struct epoll_event ev = {.events = events, .data.ptr = c};
+		epoll_ctl(s->epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+		c->events = events;
+	}
+}
+
+static void CloseConn(Server *s, Conn *c)
+{
+	epoll_ctl(s->epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+
+	if (c->prev != NULL)
+		c->prev->next = c->next;
+	else
+		s->conns = c->next;
+	if (c->next != NULL)
+		c->next->prev = c->prev;
+
+	s->followers -= (c->kind == CONN_FOLLOWER);
+	if (c == s->primary && !Stop)
+		fprintf(Log, "bbstd: lost the primary at update %llu, answering reads only\n",
+				(unsigned long long)s->seq);
+	if (c == s->primary)
+		s->primary = NULL;
+
+	c->closed = true;
+	c->next = s->dead;
+	s->dead = c;
+}
+
+/**
+ * Free the closed connections that no worker is answering for
+ */
+static void FreeDead(Server *s)
+{
+	Conn **link = &s->dead;
+	while (*link != NULL)
+	{
+		Conn *c = *link;
+		if (c->busy)
+		{
+			link = &c->next;
+			continue;
+		}
+
+		*link = c->next;
+		free(c->in.data);
+		free(c->out.data);
+		free(c);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static void Push(JobQueue *q, Job *j)
+{
+	j->next = NULL;
+	if (q->tail != NULL)
+		q->tail->next = j;
+	else
+		q->head = j;
+	q->tail = j;
+}
+
+static Job *Pop(JobQueue *q)
+{
+	Job *j = q->head;
+	if (j != NULL)
+	{
+		q->head = j->next;
+		if (q->head == NULL)
+			q->tail = NULL;
+	}
+	return j;
+}
+
+/**
+ * Count the keys between lower and upper inclusive into resp, and append
+ * the first BBST_MAX_KEYS of them in order
+ */
+static void CollectBetween(Node n, int lower, int upper, Buffer *out, BbstResponse *resp)
+{
+	if (n == NULL)
+		return;
+
+	if (n->key > lower)
+		CollectBetween(n->left, lower, upper, out, resp);
+
+	if (n->key >= lower && n->key <= upper)
+	{
+		if (resp->count < BBST_MAX_KEYS)
+		{
+			int32_t key = n->key;
+			BufferAppend(out, &key, sizeof(key));
+			resp->count++;
+		}
+		resp->value++;
+	}
+
+	if (n->key < upper)
+		CollectBetween(n->right, lower, upper, out, resp);
+}
+
+/**
+ * Make room for extra more bytes, returns where they go
+ */
+static char *BufferReserve(Buffer *b, size_t extra)
+{
+	if (b->len + extra > b->cap)
+	{
+		size_t cap = (b->cap == 0) ? 4096 : b->cap;
+		while (cap < b->len + extra)
+			cap *= 2;
+
+		b->data = realloc(b->data, cap);
+		if (b->data == NULL)
+		{
+			fprintf(Log, "Could not grow Buffer\n");
+			exit(EXIT_FAILURE);
+		}
+		b->cap = cap;
+	}
+
+	return b->data + b->len;
+}
+
+static void BufferAppend(Buffer *b, const void *data, size_t length)
+{
+	memcpy(BufferReserve(b, length), data, length);
+	b->len += length;
+}
+
+/**
+ * Replace the tree with the given keys, in ascending order
+ */
+static void Rebuild(Server *s, const int32_t *keys, uint64_t n)
+{
+	TreeFree(s->t);
+	s->t = TreeNew();
+	InsertBalanced(s->t, keys, 0, (long)n - 1);
+	s->size = n;
+}
+
+/**
+ * Insert the middle key first, then each half, so that no insert
+ * rotates
+ */
+static void InsertBalanced(Tree t, const int32_t *keys, long lo, long hi)
+{
+	if (lo > hi)
+		return;
+
+	long mid = lo + (hi - lo) / 2;
+	TreeInsert(t, keys[mid]);
+	InsertBalanced(t, keys, lo, mid - 1);
+	InsertBalanced(t, keys, mid + 1, hi);
+}
+
+static void AppendKeys(Node n, Buffer *out)
+{
+	while (n != NULL)
+	{
+		AppendKeys(n->left, out);
+		int32_t key = n->key;
+		BufferAppend(out, &key, sizeof(key));
+		n = n->right;
+	}
+}
+
+static uint64_t Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void OnSignal(int sig)
+{
+	Stop = 1;
+}
+
+static void OnPromote(int sig)
+{
+	PromoteRequested = 1;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-s socket] [-t workers (0 to %d)] [-b max reads per batch]\n"
+					"       [-r replication socket] [-f primary replication socket] [-S snapshot file]\n",
+			name, MAX_WORKERS);
+}
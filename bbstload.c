@@ -0,0 +1,610 @@
+// Load generator for bbstd.
+// Opens -c connections to the server and keeps -p requests in flight on
+// each for -d seconds, from one thread with an epoll loop. Requests are
+// sent in batches: whenever responses come back, as many new requests as
+// were answered are written with one send. The latency of a request is
+// the time from building it to reading its response, so it includes the
+// time spent queued behind the requests before it on the connection.
+//
+// Before the timed run, -l random keys are inserted over one connection.
+// Keys are drawn uniformly from [0, keyspace). -w percent of the requests
+// are inserts and deletes in equal parts, the rest are reads: searches,
+// floors, ceilings, kth smallest with k up to -K (TreeKthSmallest is
+// O(log n + k)), LCAs and ranges of -m keys.
+//
+// Usage: ./bbstload [-s socket] [-c connections] [-p pipeline depth]
+//                   [-d seconds] [-l preload keys] [-k keyspace]
+//                   [-w write percent] [-m range span] [-K max k]
+//                   [-x seed] [-j]
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bbstProto.h"
+#include "bench.h"
+
+#define DEFAULT_CONNS 64
+#define DEFAULT_DEPTH 16
+#define DEFAULT_SECONDS 5
+#define DEFAULT_PRELOAD 100000
+#define DEFAULT_KEYSPACE (1 << 20)
+#define DEFAULT_WRITES 10
+#define DEFAULT_SPAN 16
+#define DEFAULT_MAX_K 16
+#define MAX_CONNS 4096
+#define MAX_DEPTH 4096
+// Requests sent at a time while preloading
+#define PRELOAD_BATCH 4096
+// Time allowed for the requests in flight to come back after the run
+#define DRAIN_NS 5000000000ULL
+#define IN_SIZE (64 * 1024)
+
+// Relative weight of each read
+static const int ReadMix[BBST_NUM_OPS] = {
+	[BBST_SEARCH] = 50,
+	[BBST_FLOOR] = 15,
+	[BBST_CEILING] = 15,
+	[BBST_KTH] = 10,
+	[BBST_LCA] = 5,
+	[BBST_BETWEEN] = 5,
+};
+
+typedef struct config
+{
+	const char *path;
+	int conns;
+	int depth;
+	int seconds;
+	int preload;
+	int keyspace;
+	int writes;
+	int span;
+	int maxK;
+	uint64_t seed;
+	bool json;
+} Config;
+
+typedef struct client
+{
+	int fd;
+	// Requests built but not yet sent
+	char *out;
+	size_t outLen;
+	size_t outOff;
+	// Responses read but not yet handled
+	char in[IN_SIZE];
+	size_t inLen;
+	// When each request in flight was built, oldest at head
+	uint64_t *sentAt;
+	int head;
+	int inflight;
+	uint32_t nextId;
+	uint32_t expectId;
+	bool wantWrite;
+} Client;
+
+typedef struct load
+{
+	Config *cfg;
+	uint64_t state;
+	int epollFd;
+	bool sending;
+	Histogram latency;
+	long requests;
+	long errors;
+	long keysReturned;
+} Load;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void Preload(Load *l);
+static void Run(Load *l, Client *clients);
+static void Issue(Load *l, Client *c, int count);
+static bool Receive(Load *l, Client *c, uint64_t now);
+static bool Flush(Load *l, Client *c);
+static void MakeRequest(Load *l, BbstRequest *r);
+static long TreeSize(Load *l);
+static void Report(Load *l, double seconds, long size);
+static int Connect(const char *path, bool block);
+static bool WriteAll(int fd, const void *data, size_t length);
+static bool ReadAll(int fd, void *data, size_t length);
+static uint64_t NextRandom(uint64_t *state);
+static uint64_t Now(void);
+static void PrintUsage(const char *name);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	Config cfg = {
+		.path = BBST_SOCKET,
+		.conns = DEFAULT_CONNS,
+		.depth = DEFAULT_DEPTH,
+		.seconds = DEFAULT_SECONDS,
+		.preload = DEFAULT_PRELOAD,
+		.keyspace = DEFAULT_KEYSPACE,
+		.writes = DEFAULT_WRITES,
+		.span = DEFAULT_SPAN,
+		.maxK = DEFAULT_MAX_K,
+		.seed = 1,
+	};
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-j") == 0)
+			cfg.json = true;
+		else if (strcmp(argv[i], "-s") == 0 && hasValue)
+			cfg.path = argv[++i];
+		else if (strcmp(argv[i], "-c") == 0 && hasValue)
+			cfg.conns = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-p") == 0 && hasValue)
+			cfg.depth = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-d") == 0 && hasValue)
+			cfg.seconds = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-l") == 0 && hasValue)
+			cfg.preload = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0 && hasValue)
+			cfg.keyspace = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-w") == 0 && hasValue)
+			cfg.writes = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-m") == 0 && hasValue)
+			cfg.span = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-K") == 0 && hasValue)
+			cfg.maxK = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-x") == 0 && hasValue)
+			cfg.seed = strtoull(argv[++i], NULL, 10);
+		else
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.conns < 1 || cfg.conns > MAX_CONNS || cfg.depth < 1 || cfg.depth > MAX_DEPTH ||
+		cfg.seconds < 1 || cfg.preload < 0 || cfg.keyspace < 1 || cfg.writes < 0 ||
+		cfg.writes > 100 || cfg.span < 0 || cfg.maxK < 1)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Load l = {.cfg = &cfg, .state = cfg.seed};
+	Preload(&l);
+
+	Client *clients = calloc(cfg.conns, sizeof(Client));
+	if (clients == NULL)
+	{
+		fprintf(stderr, "Could not malloc Clients\n");
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t start = Now();
+	Run(&l, clients);
+	double seconds = (Now() - start) / 1e9;
+
+	for (int i = 0; i < cfg.conns; i++)
+	{
+		close(clients[i].fd);
+		free(clients[i].out);
+		free(clients[i].sentAt);
+	}
+	free(clients);
+
+	Report(&l, seconds, TreeSize(&l));
+	return (l.errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Insert the preload keys, PRELOAD_BATCH requests at a time
+ */
+static void Preload(Load *l)
+{
+	Config *cfg = l->cfg;
+	if (cfg->preload == 0)
+		return;
+
+	int fd = Connect(cfg->path, true);
+	BbstRequest *reqs = malloc(PRELOAD_BATCH * sizeof(BbstRequest));
+	if (reqs == NULL)
+	{
+		fprintf(stderr, "Could not malloc Preload\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int done = 0; done < cfg->preload;)
+	{
+		int count = cfg->preload - done;
+		if (count > PRELOAD_BATCH)
+			count = PRELOAD_BATCH;
+
+		for (int i = 0; i < count; i++)
+			reqs[i] = (BbstRequest){.id = done + i, .op = BBST_INSERT,
+									.a = NextRandom(&l->state) % cfg->keyspace};
+
+		// Inserts have no keys in their responses, so the responses fit
+		// in the same space
+		if (!WriteAll(fd, reqs, count * sizeof(BbstRequest)) ||
+			!ReadAll(fd, reqs, count * sizeof(BbstResponse)))
+		{
+			fprintf(stderr, "bbstload: lost the connection while preloading\n");
+			exit(EXIT_FAILURE);
+		}
+		done += count;
+	}
+
+	free(reqs);
+	close(fd);
+}
+
+/**
+ * Keep every connection full for the length of the run, then wait for
+ * the requests in flight
+ */
+static void Run(Load *l, Client *clients)
+{
+	Config *cfg = l->cfg;
+	l->epollFd = epoll_create1(0);
+	if (l->epollFd < 0)
+	{
+		perror("bbstload: epoll_create1");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < cfg->conns; i++)
+	{
+		Client *c = &clients[i];
+		c->fd = Connect(cfg->path, false);
+		c->sentAt = malloc(cfg->depth * sizeof(uint64_t));
+		if (c->sentAt == NULL)
+		{
+			fprintf(stderr, "Could not malloc Client\n");
+			exit(EXIT_FAILURE);
+		}
+
+		struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+		epoll_ctl(l->epollFd, EPOLL_CTL_ADD, c->fd, &ev);
+	}
+
+	l->sending = true;
+	for (int i = 0; i < cfg->conns; i++)
+		Issue(l, &clients[i], cfg->depth);
+
+	uint64_t end = Now() + (uint64_t)cfg->seconds * 1000000000;
+	long inflight = (long)cfg->conns * cfg->depth;
+	struct epoll_event events[256];
+
+	while (inflight > 0)
+	{
+		uint64_t now = Now();
+		if (l->sending && now >= end)
+		{
+			l->sending = false;
+			end = now + DRAIN_NS;
+		}
+		else if (!l->sending && now >= end)
+		{
+			fprintf(stderr, "bbstload: %ld requests not answered\n", inflight);
+			l->errors += inflight;
+			break;
+		}
+
+		int n = epoll_wait(l->epollFd, events, 256, (end - now) / 1000000 + 1);
+		if (n < 0 && errno != EINTR)
+		{
+			perror("bbstload: epoll_wait");
+			exit(EXIT_FAILURE);
+		}
+
+		now = Now();
+		for (int i = 0; i < n; i++)
+		{
+			Client *c = events[i].data.ptr;
+			int before = c->inflight;
+			bool ok = true;
+
+			if (events[i].events & EPOLLOUT)
+				ok = Flush(l, c);
+			if (ok && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+				ok = Receive(l, c, now);
+			if (!ok)
+			{
+				fprintf(stderr, "bbstload: lost a connection\n");
+				exit(EXIT_FAILURE);
+			}
+
+			int answered = before - c->inflight;
+			if (l->sending && answered > 0)
+				Issue(l, c, answered);
+			inflight += c->inflight - before;
+		}
+	}
+
+	close(l->epollFd);
+}
+
+/**
+ * Build count requests on a connection and send them with one write
+ */
+static void Issue(Load *l, Client *c, int count)
+{
+	size_t length = count * sizeof(BbstRequest);
+	if (c->outOff == c->outLen)
+		c->outLen = c->outOff = 0;
+
+	// Never more than the pipeline depth is waiting to be sent
+	if (c->out == NULL)
+	{
+		c->out = malloc(l->cfg->depth * sizeof(BbstRequest));
+		if (c->out == NULL)
+		{
+			fprintf(stderr, "Could not malloc Client\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (c->outOff > 0)
+	{
+		memmove(c->out, c->out + c->outOff, c->outLen - c->outOff);
+		c->outLen -= c->outOff;
+		c->outOff = 0;
+	}
+
+	uint64_t now = Now();
+	BbstRequest *r = (BbstRequest *)(c->out + c->outLen);
+	for (int i = 0; i < count; i++)
+	{
+		MakeRequest(l, &r[i]);
+		r[i].id = c->nextId++;
+		c->sentAt[(c->head + c->inflight) % l->cfg->depth] = now;
+		c->inflight++;
+	}
+	c->outLen += length;
+
+	if (!Flush(l, c))
+	{
+		fprintf(stderr, "bbstload: lost a connection\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Read and check the responses waiting on a connection, returns false if
+ * it was closed
+ */
+static bool Receive(Load *l, Client *c, uint64_t now)
+{
+	for (;;)
+	{
+		ssize_t n = read(c->fd, c->in + c->inLen, IN_SIZE - c->inLen);
+		if (n == 0)
+			return false;
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN;
+		}
+		c->inLen += n;
+
+		size_t off = 0;
+		while (c->inLen - off >= sizeof(BbstResponse))
+		{
+			BbstResponse resp;
+			memcpy(&resp, c->in + off, sizeof(resp));
+			size_t length = sizeof(resp) + resp.count * sizeof(int32_t);
+			if (c->inLen - off < length)
+				break;
+
+			if (resp.id != c->expectId || resp.status != BBST_OK || resp.count > BBST_MAX_KEYS ||
+				(resp.op == BBST_BETWEEN && (int32_t)resp.count > resp.value))
+				l->errors++;
+
+			HistogramRecord(&l->latency, now - c->sentAt[c->head]);
+			c->head = (c->head + 1) % l->cfg->depth;
+			c->inflight--;
+			c->expectId++;
+			l->requests++;
+			l->keysReturned += resp.count;
+			off += length;
+		}
+
+		memmove(c->in, c->in + off, c->inLen - off);
+		c->inLen -= off;
+	}
+}
+
+/**
+ * Send what is waiting on a connection, and wait for it to drain if the
+ * socket is full. Returns false if the connection failed.
+ */
+static bool Flush(Load *l, Client *c)
+{
+	while (c->outOff < c->outLen)
+	{
+		ssize_t n = send(c->fd, c->out + c->outOff, c->outLen - c->outOff, MSG_NOSIGNAL);
+		if (n > 0)
+			c->outOff += n;
+		else if (n < 0 && errno == EAGAIN)
+			break;
+		else if (n < 0 && errno != EINTR)
+			return false;
+	}
+
+	bool wantWrite = c->outOff < c->outLen;
+	if (wantWrite != c->wantWrite)
+	{
+		struct epoll_event ev = {.events = EPOLLIN | (wantWrite ? EPOLLOUT : 0), .data.ptr = c};
+		epoll_ctl(l->epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+		c->wantWrite = wantWrite;
+	}
+
+	return true;
+}
+
+static void MakeRequest(Load *l, BbstRequest *r)
+{
+	Config *cfg = l->cfg;
+	uint64_t x = NextRandom(&l->state);
+	int key = (x >> 32) % cfg->keyspace;
+	int roll = x % 100;
+
+	*r = (BbstRequest){.a = key};
+	if (roll < cfg->writes)
+	{
+		r->op = (roll % 2 == 0) ? BBST_INSERT : BBST_DELETE;
+		return;
+	}
+
+	int total = 0;
+	for (int op = 0; op < BBST_NUM_OPS; op++)
+		total += ReadMix[op];
+
+	int pick = (x >> 8) % total;
+	r->op = BBST_SEARCH;
+	for (int op = 0; op < BBST_NUM_OPS; op++)
+	{
+		if (pick < ReadMix[op])
+		{
+			r->op = op;
+			break;
+		}
+		pick -= ReadMix[op];
+	}
+
+	if (r->op == BBST_KTH)
+		r->a = 1 + (x >> 32) % cfg->maxK;
+	else if (r->op == BBST_LCA)
+		r->b = NextRandom(&l->state) % cfg->keyspace;
+	else if (r->op == BBST_BETWEEN)
+		r->b = key + cfg->span;
+}
+
+/**
+ * Ask the server how many keys the tree holds
+ */
+static long TreeSize(Load *l)
+{
+	int fd = Connect(l->cfg->path, true);
+	BbstRequest req = {.op = BBST_SIZE};
+	BbstResponse resp;
+
+	bool ok = WriteAll(fd, &req, sizeof(req)) && ReadAll(fd, &resp, sizeof(resp));
+	close(fd);
+	return ok ? resp.value : -1;
+}
+
+static void Report(Load *l, double seconds, long size)
+{
+	Config *cfg = l->cfg;
+	double rate = (seconds > 0) ? l->requests / seconds : 0;
+	uint64_t p50 = HistogramPercentile(&l->latency, 0.50);
+	uint64_t p99 = HistogramPercentile(&l->latency, 0.99);
+	uint64_t p999 = HistogramPercentile(&l->latency, 0.999);
+
+	if (cfg->json)
+	{
+		printf("{\"connections\": %d, \"depth\": %d, \"writes\": %d, \"requests\": %ld, "
+			   "\"seconds\": %.3f, \"requests_per_sec\": %.0f, \"p50_ns\": %llu, "
+			   "\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu, \"keys_returned\": %ld, "
+			   "\"tree_size\": %ld, \"errors\": %ld}\n",
+			   cfg->conns, cfg->depth, cfg->writes, l->requests, seconds, rate,
+			   (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999,
+			   (unsigned long long)l->latency.max, l->keysReturned, size, l->errors);
+		return;
+	}
+
+	printf("%d connections, %d in flight each, %d%% writes\n", cfg->conns, cfg->depth,
+		   cfg->writes);
+	printf("%ld requests in %.3f s, %.0f requests/s\n", l->requests, seconds, rate);
+	printf("latency p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n", p50 / 1e3,
+		   p99 / 1e3, p999 / 1e3, l->latency.max / 1e3);
+	printf("%ld keys returned by ranges, %ld keys in the tree, %ld errors\n", l->keysReturned,
+		   size, l->errors);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Connect(const char *path, bool block)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | (block ? 0 : SOCK_NONBLOCK), 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		fprintf(stderr, "bbstload: %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+static bool WriteAll(int fd, const void *data, size_t length)
+{
+	const char *p = data;
+	while (length > 0)
+	{
+		ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+static bool ReadAll(int fd, void *data, size_t length)
+{
+	char *p = data;
+	while (length > 0)
+	{
+		ssize_t n = read(fd, p, length);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+/**
+ * splitmix64
+ */
+static uint64_t NextRandom(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static uint64_t Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [-s socket] [-c connections] [-p pipeline depth]\n"
+			"       [-d seconds] [-l preload keys] [-k keyspace]\n"
+			"       [-w write percent] [-m range span] [-K max k] [-x seed] [-j]\n",
+			name);
+}
@@ -0,0 +1,656 @@
+// Implementation of the Balanced Binary Search Tree benchmark harness.
+//
+// Keys are kept in a pool of the keys currently in the tree so that
+// deletes, successful searches and LCA queries can pick a present key in
+// O(1). Fresh keys for inserts come from the odd numbers (the tree is
+// built from even ones) so no insert is ever rejected as a duplicate.
+// Every operation is timed on its own with CLOCK_MONOTONIC; the
+// randomness for the next operation is drawn outside the timed region.
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "bBST.h"
+#include "bench.h"
+#include "List.h"
+#include "perfCounters.h"
+
+#define DEFAULT_SIZE 100000
+#define DEFAULT_OPS 1000000
+#define DEFAULT_SPAN 100
+#define DEFAULT_MAX_K 100
+
+static const char *OpNames[BENCH_NUM_OPS] = {
+	"insert", "delete", "search", "floor", "ceiling", "kth", "lca", "between"};
+
+// Weights used by the "mixed" workload unless -r is given
+static const int DefaultMix[BENCH_NUM_OPS] = {20, 10, 40, 10, 10, 4, 3, 3};
+
+// Keys currently in the tree, in no particular order
+typedef struct pool
+{
+	int *keys;
+	int size;
+	int capacity;
+	int nextFresh;
+} Pool;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool ParseMix(char *s, int mix[BENCH_NUM_OPS]);
+static int FindOp(const char *name, size_t length);
+static bool ParseCount(const char *s, long max, long *count);
+static void PrintUsage(const char *name);
+static void PoolInit(Pool *p, int size, unsigned int *state);
+static int PoolRandom(Pool *p, unsigned int *state);
+static int PoolTake(Pool *p, unsigned int *state);
+static void PoolAdd(Pool *p, int key);
+static BenchOp PickOp(int mix[BENCH_NUM_OPS], int total, unsigned int *state);
+static void RunOp(Tree t, BenchConfig *c, BenchOp op, Pool *p, unsigned int *state,
+				  Histogram *h);
+static int HistogramBucket(uint64_t ns);
+static uint64_t HistogramBucketMax(int bucket);
+static unsigned int NextRandom(unsigned int *state);
+static uint64_t Now(void);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Parses a bench command line and runs each workload it names.
+ */
+int BenchMain(int argc, char **argv)
+{
+	BenchConfig base = {
+		.name = NULL,
+		.size = DEFAULT_SIZE,
+		.ops = DEFAULT_OPS,
+		.seed = 1,
+		.span = DEFAULT_SPAN,
+		.maxK = DEFAULT_MAX_K,
+		.json = false,
+		.perf = false,
+	};
+	memcpy(base.mix, DefaultMix, sizeof(base.mix));
+
+	const char *workloads[BENCH_NUM_OPS + 2];
+	int nworkloads = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		char *arg = argv[i];
+		char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (arg[0] != '-')
+		{
+			if (strcmp(arg, "mixed") != 0 && strcmp(arg, "all") != 0 &&
+				FindOp(arg, strlen(arg)) < 0)
+			{
+				fprintf(stderr, "Unknown workload: %s\n", arg);
+				PrintUsage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			if (nworkloads == BENCH_NUM_OPS + 2)
+			{
+				fprintf(stderr, "Too many workloads\n");
+				return EXIT_FAILURE;
+			}
+			workloads[nworkloads++] = arg;
+			continue;
+		}
+
+		if (strcmp(arg, "-j") == 0)
+		{
+			base.json = true;
+			continue;
+		}
+
+		if (strcmp(arg, "-p") == 0)
+		{
+			base.perf = true;
+			continue;
+		}
+
+		if (value == NULL || arg[1] == '\0' || arg[2] != '\0')
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+
+		long count = 0;
+		if (strchr("nomk", arg[1]) != NULL && !ParseCount(value, INT_MAX, &count))
+		{
+			fprintf(stderr, "Invalid count for %s: %s\n", arg, value);
+			return EXIT_FAILURE;
+		}
+
+		switch (arg[1])
+		{
+		case 'n':
+			base.size = (int)count;
+			break;
+		case 'o':
+			base.ops = count;
+			break;
+		case 's':
+			base.seed = (unsigned int)strtoul(value, NULL, 10);
+			break;
+		case 'm':
+			base.span = (int)count;
+			break;
+		case 'k':
+			base.maxK = (int)count;
+			break;
+		case 'r':
+			if (!ParseMix(value, base.mix))
+			{
+				fprintf(stderr, "Invalid mix: %s\n", value);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		i++;
+	}
+
+	if (base.size < 0 || base.ops < 0 || base.span < 0 || base.maxK < 1)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// The tree is built from the even keys below 2 * size and inserts take
+	// odd keys from 1 up, every key and the end of a range must fit in int
+	if (2LL * base.size + base.span > INT_MAX || 2LL * base.ops + 1 > INT_MAX)
+	{
+		fprintf(stderr, "Keys would overflow int: need 2 * size + span and 2 * ops + 1 "
+						"at most %d\n",
+				INT_MAX);
+		return EXIT_FAILURE;
+	}
+
+	if (nworkloads == 0)
+		workloads[nworkloads++] = "mixed";
+
+	for (int i = 0; i < nworkloads; i++)
+	{
+		bool all = strcmp(workloads[i], "all") == 0;
+		for (int op = 0; op < BENCH_NUM_OPS; op++)
+		{
+			BenchConfig c = base;
+			int single = all ? op : FindOp(workloads[i], strlen(workloads[i]));
+
+			if (single >= 0)
+			{
+				memset(c.mix, 0, sizeof(c.mix));
+				c.mix[single] = 1;
+				c.name = OpNames[single];
+			}
+			else
+				c.name = "mixed";
+
+			BenchResult r;
+			BenchRun(&c, &r);
+			BenchReport(stdout, &c, &r);
+
+			if (!all)
+				break;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Runs a single workload
+ */
+void BenchRun(BenchConfig *c, BenchResult *r)
+{
+	memset(r, 0, sizeof(*r));
+	unsigned int state = (c->seed == 0) ? 1 : c->seed;
+
+	int total = 0;
+	for (int op = 0; op < BENCH_NUM_OPS; op++)
+		total += c->mix[op];
+
+	// Build the starting tree
+	Tree t = TreeNew();
+	Pool p;
+	PoolInit(&p, c->size, &state);
+	for (int i = 0; i < p.size; i++)
+		TreeInsert(t, p.keys[i]);
+
+	// Only say why counters are missing once per process
+	static bool warned = false;
+	PerfCounters perf;
+	bool counting = c->perf && PerfOpen(&perf);
+	if (c->perf && perf.error != NULL && !warned)
+	{
+		fprintf(stderr, "Hardware counters unavailable: %s\n", perf.error);
+		warned = true;
+	}
+	if (counting)
+		PerfStart(&perf);
+
+	uint64_t start = Now();
+	for (long i = 0; i < c->ops && total > 0; i++)
+	{
+		BenchOp op = PickOp(c->mix, total, &state);
+
+		// A delete only workload stops once the tree is empty
+		if (op == BENCH_DELETE && p.size == 0)
+		{
+			if (c->mix[BENCH_DELETE] == total)
+				break;
+			op = BENCH_INSERT;
+		}
+
+		RunOp(t, c, op, &p, &state, &r->latency);
+		r->ops++;
+	}
+	r->seconds = (Now() - start) / 1e9;
+
+	if (counting)
+	{
+		PerfStop(&perf, &r->perf);
+		PerfClose(&perf);
+	}
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		r->peakRss = usage.ru_maxrss;
+
+	free(p.keys);
+	TreeFree(t);
+}
+
+/**
+ * Prints the result of a workload
+ */
+void BenchReport(FILE *fp, BenchConfig *c, BenchResult *r)
+{
+	double rate = (r->seconds > 0) ? r->ops / r->seconds : 0;
+	uint64_t p50 = HistogramPercentile(&r->latency, 0.50);
+	uint64_t p99 = HistogramPercentile(&r->latency, 0.99);
+	uint64_t p999 = HistogramPercentile(&r->latency, 0.999);
+
+	if (c->json)
+	{
+		fprintf(fp, "{\"workload\": \"%s\", \"size\": %d, \"ops\": %ld, "
+					"\"seed\": %u, \"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+					"\"p50_ns\": %lu, \"p99_ns\": %lu, \"p999_ns\": %lu, "
+					"\"max_ns\": %lu, \"peak_rss_kb\": %ld",
+				c->name, c->size, r->ops, c->seed, r->seconds, rate,
+				(unsigned long)p50, (unsigned long)p99, (unsigned long)p999,
+				(unsigned long)r->latency.max, r->peakRss);
+
+		// Events that could not be counted are null
+		for (PerfEvent e = 0; c->perf && e < PERF_NUM_EVENTS; e++)
+		{
+			// JSON keys use underscores, e.g. "cache_misses_per_op"
+			fprintf(fp, ", \"");
+			for (const char *ch = PerfEventName(e); *ch != '\0'; ch++)
+				fputc((*ch == '-') ? '_' : *ch, fp);
+			fprintf(fp, "_per_op\": ");
+			if (r->perf.valid[e] && r->ops > 0)
+				fprintf(fp, "%.3f", r->perf.counts[e] / r->ops);
+			else
+				fprintf(fp, "null");
+		}
+
+		fprintf(fp, "}\n");
+		return;
+	}
+
+	fprintf(fp, "%-8s n=%-9d ops=%-9ld %12.0f ops/sec   p50 %6lu ns   "
+				"p99 %7lu ns   p999 %8lu ns   max %9lu ns   peak rss %ld KiB\n",
+			c->name, c->size, r->ops, rate, (unsigned long)p50,
+			(unsigned long)p99, (unsigned long)p999,
+			(unsigned long)r->latency.max, r->peakRss);
+
+	if (!c->perf)
+		return;
+
+	fprintf(fp, "%-8s", "");
+	for (PerfEvent e = 0; e < PERF_NUM_EVENTS; e++)
+	{
+		if (r->perf.valid[e] && r->ops > 0)
+			fprintf(fp, " %s/op %.3f", PerfEventName(e), r->perf.counts[e] / r->ops);
+		else
+			fprintf(fp, " %s/op n/a", PerfEventName(e));
+	}
+	fprintf(fp, "\n");
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Time one operation and record its latency
+ */
+static void RunOp(Tree t, BenchConfig *c, BenchOp op, Pool *p, unsigned int *state,
+				  Histogram *h)
+{
+	// Draw the arguments before starting the clock
+	int a = 0, b = 0;
+	switch (op)
+	{
+	case BENCH_INSERT:
+		a = p->nextFresh;
+		p->nextFresh += 2;
+		break;
+	case BENCH_DELETE:
+		a = PoolTake(p, state);
+		break;
+	case BENCH_KTH:
+		a = 1 + NextRandom(state) % c->maxK;
+		break;
+	case BENCH_LCA:
+		a = PoolRandom(p, state);
+		b = PoolRandom(p, state);
+		break;
+	default:
+		// Half of the searches hit, the other half land between keys
+		a = PoolRandom(p, state) + (NextRandom(state) & 1);
+		b = a + c->span;
+		break;
+	}
+
+	uint64_t start = Now();
+	List l;
+	switch (op)
+	{
+	case BENCH_INSERT:
+		TreeInsert(t, a);
+		break;
+	case BENCH_DELETE:
+		TreeDelete(t, a);
+		break;
+	case BENCH_SEARCH:
+		TreeSearch(t, a);
+		break;
+	case BENCH_FLOOR:
+		TreeFloor(t, a);
+		break;
+	case BENCH_CEILING:
+		TreeCeiling(t, a);
+		break;
+	case BENCH_KTH:
+		TreeKthSmallest(t, a);
+		break;
+	case BENCH_LCA:
+		TreeLCA(t, a, b);
+		break;
+	default:
+		l = TreeSearchBetween(t, a, b);
+		ListFree(l);
+		break;
+	}
+	HistogramRecord(h, Now() - start);
+
+	if (op == BENCH_INSERT)
+		PoolAdd(p, a);
+}
+
+/**
+ * Pick an operation with probability proportional to its weight
+ */
+static BenchOp PickOp(int mix[BENCH_NUM_OPS], int total, unsigned int *state)
+{
+	int r = NextRandom(state) % total;
+	int op = 0;
+
+	while (r >= mix[op])
+		r -= mix[op++];
+
+	return op;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Key pool
+
+/**
+ * Fill the pool with size distinct even keys in random order
+ */
+static void PoolInit(Pool *p, int size, unsigned int *state)
+{
+	p->capacity = (size < 16) ? 16 : size;
+	p->keys = malloc(p->capacity * sizeof(int));
+
+	if (p->keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Key Pool\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < size; i++)
+		p->keys[i] = 2 * i;
+
+	for (int i = size - 1; i > 0; i--)
+	{
+		int j = NextRandom(state) % (i + 1);
+		int tmp = p->keys[i];
+		p->keys[i] = p->keys[j];
+		p->keys[j] = tmp;
+	}
+
+	p->size = size;
+	p->nextFresh = 1;
+}
+
+/**
+ * Returns a random key from the pool, or 0 if it is empty
+ */
+static int PoolRandom(Pool *p, unsigned int *state)
+{
+	return (p->size == 0) ? 0 : p->keys[NextRandom(state) % p->size];
+}
+
+/**
+ * Removes a random key from the pool and returns it
+ */
+static int PoolTake(Pool *p, unsigned int *state)
+{
+	int i = NextRandom(state) % p->size;
+	int key = p->keys[i];
+	p->keys[i] = p->keys[--p->size];
+	return key;
+}
+
+static void PoolAdd(Pool *p, int key)
+{
+	if (p->size == p->capacity)
+	{
+		p->capacity *= 2;
+		p->keys = realloc(p->keys, p->capacity * sizeof(int));
+
+		if (p->keys == NULL)
+		{
+			fprintf(stderr, "Could not grow Key Pool\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	p->keys[p->size++] = key;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Histogram
+
+/**
+ * Records a latency in nanoseconds.
+ */
+void HistogramRecord(Histogram *h, uint64_t ns)
+{
+	h->counts[HistogramBucket(ns)]++;
+	h->total++;
+	if (ns > h->max)
+		h->max = ns;
+}
+
+/**
+ * Returns the latency below which the given fraction of latencies fall.
+ */
+uint64_t HistogramPercentile(Histogram *h, double fraction)
+{
+	if (h->total == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)(fraction * h->total);
+	if (rank >= h->total)
+		rank = h->total - 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += h->counts[i];
+		if (seen > rank)
+		{
+			uint64_t bound = HistogramBucketMax(i);
+			return (bound < h->max) ? bound : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+/**
+ * Index of the bucket a latency falls in
+ */
+static int HistogramBucket(uint64_t ns)
+{
+	if (ns < HIST_LINEAR)
+		return (int)ns;
+
+	int exp = 63 - __builtin_clzll(ns);
+	int sub = (int)(ns >> (exp - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1);
+	return HIST_LINEAR + (exp - HIST_SUB_BITS - 1) * (1 << HIST_SUB_BITS) + sub;
+}
+
+/**
+ * Largest latency that falls in a bucket
+ */
+static uint64_t HistogramBucketMax(int bucket)
+{
+	if (bucket < HIST_LINEAR)
+		return bucket;
+
+	int exp = (bucket - HIST_LINEAR) / (1 << HIST_SUB_BITS) + HIST_SUB_BITS + 1;
+	uint64_t sub = (bucket - HIST_LINEAR) % (1 << HIST_SUB_BITS);
+	int shift = exp - HIST_SUB_BITS;
+	uint64_t lower = ((1ULL << HIST_SUB_BITS) + sub) << shift;
+	return lower + ((1ULL << shift) - 1);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Parse weights such as "insert=20,search=70,delete=10"
+ */
+static bool ParseMix(char *s, int mix[BENCH_NUM_OPS])
+{
+	int parsed[BENCH_NUM_OPS] = {0};
+	int total = 0;
+
+	while (*s != '\0')
+	{
+		char *eq = strchr(s, '=');
+		if (eq == NULL)
+			return false;
+
+		int op = FindOp(s, eq - s);
+		if (op < 0)
+			return false;
+
+		char *end;
+		long weight = strtol(eq + 1, &end, 10);
+		if (end == eq + 1 || weight < 0 || weight > 1000000)
+			return false;
+
+		parsed[op] = (int)weight;
+		total += (int)weight;
+
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return false;
+		s = end;
+	}
+
+	if (total == 0)
+		return false;
+
+	memcpy(mix, parsed, sizeof(parsed));
+	return true;
+}
+
+/**
+ * Returns the operation with the given name, or -1
+ */
+static int FindOp(const char *name, size_t length)
+{
+	for (int op = 0; op < BENCH_NUM_OPS; op++)
+		if (strlen(OpNames[op]) == length && strncmp(OpNames[op], name, length) == 0)
+			return op;
+
+	return -1;
+}
+
+/**
+ * Parses a whole decimal count between 0 and max
+ */
+static bool ParseCount(const char *s, long max, long *count)
+{
+	char *end;
+	errno = 0;
+	long value = strtol(s, &end, 10);
+
+	if (errno != 0 || end == s || *end != '\0' || value < 0 || value > max)
+		return false;
+
+	*count = value;
+	return true;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [workload...] [-n size] [-o ops] [-s seed] [-m span]\n"
+			"       [-k max k] [-r op=weight,...] [-j] [-p]\n"
+			"Workloads: insert delete search floor ceiling kth lca between\n"
+			"           mixed (the default) all\n",
+			name);
+}
+
+/**
+ * xorshift32, never returns 0 for a non-zero state
+ */
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/**
+ * Monotonic time in nanoseconds
+ */
+static uint64_t Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
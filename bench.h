@@ -0,0 +1,105 @@
+// Benchmark harness for Balanced Binary Search Trees.
+// Runs a workload of tree operations against a tree of a chosen size
+// and reports throughput, latency percentiles, peak RSS and optionally
+// hardware counters per operation, either as a human readable table or
+// as one JSON object per workload.
+// Shared by the `bench` command in testBBST and by benchBBST.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "perfCounters.h"
+
+// Latencies below 2^HIST_SUB_BITS ns get a bucket each, above that every
+// power of two is split into 2^HIST_SUB_BITS buckets, so a percentile is
+// within 1 / 2^HIST_SUB_BITS of the true value
+#define HIST_SUB_BITS 4
+#define HIST_LINEAR (2 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_LINEAR + (64 - HIST_SUB_BITS - 1) * (1 << HIST_SUB_BITS))
+
+typedef enum benchOp
+{
+	BENCH_INSERT,
+	BENCH_DELETE,
+	BENCH_SEARCH,
+	BENCH_FLOOR,
+	BENCH_CEILING,
+	BENCH_KTH,
+	BENCH_LCA,
+	BENCH_BETWEEN,
+	BENCH_NUM_OPS,
+} BenchOp;
+
+typedef struct histogram
+{
+	uint64_t counts[HIST_BUCKETS];
+	uint64_t total;
+	uint64_t max;
+} Histogram;
+
+typedef struct benchConfig
+{
+	// Name of the workload, e.g. "search" or "mixed"
+	const char *name;
+	// Keys in the tree before the timed operations start
+	int size;
+	// Number of timed operations
+	long ops;
+	unsigned int seed;
+	// Width of the key range passed to TreeSearchBetween
+	int span;
+	// TreeKthSmallest is called with k between 1 and maxK
+	int maxK;
+	// Relative weight of each operation
+	int mix[BENCH_NUM_OPS];
+	bool json;
+	// Count hardware events over the timed operations with
+	// perf_event_open. The counts include the two clock reads that time
+	// each operation.
+	bool perf;
+} BenchConfig;
+
+typedef struct benchResult
+{
+	long ops;
+	double seconds;
+	Histogram latency;
+	// Peak resident set size of the whole process, in KiB
+	long peakRss;
+	// Hardware event counts over all operations, if c->perf was set
+	PerfSample perf;
+} BenchResult;
+
+/**
+ * Parses a bench command line, runs every workload it names and prints
+ * the results to stdout. argv[0] is the command name.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the arguments are invalid.
+ */
+int BenchMain(int argc, char **argv);
+
+/**
+ * Runs a single workload and fills in the result.
+ */
+void BenchRun(BenchConfig *c, BenchResult *r);
+
+/**
+ * Prints the result of a workload, as JSON if c->json is set.
+ */
+void BenchReport(FILE *fp, BenchConfig *c, BenchResult *r);
+
+/**
+ * Records a latency in nanoseconds.
+ */
+void HistogramRecord(Histogram *h, uint64_t ns);
+
+/**
+ * Returns the latency in nanoseconds below which the given fraction
+ * (between 0 and 1) of the recorded latencies fall.
+ */
+uint64_t HistogramPercentile(Histogram *h, double fraction);
+
+#endif
@@ -0,0 +1,10 @@
+// Standalone benchmark for Balanced Binary Search Trees.
+// Takes the same arguments as the `bench` command in testBBST, see
+// bench.h, but is built with optimisation and without sanitizers.
+
+#include "bench.h"
+
+int main(int argc, char **argv)
+{
+	return BenchMain(argc, argv);
+}
@@ -0,0 +1,831 @@
+// Implementation of the Leaf-Bucketed Balanced Binary Search Tree.
+//
+// Internal nodes hold a separator key: every key in the left subtree is
+// less than the separator and every key in the right subtree is greater
+// than or equal to it. Leaves (height 0) hold up to BUCKET_MAX sorted
+// keys. Unused bucket slots are padded with INT_MAX so a bucket can be
+// searched with a fixed number of branch-free vector compares.
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bucketBST.h"
+#include "List.h"
+
+#define BUCKET_MIN (BUCKET_MAX / 4)
+#define BUCKET_PAD INT_MAX
+
+typedef struct bucketNode *BucketNode;
+
+// Fields shared by both kinds of node, the height tells them apart
+struct bucketNode
+{
+	int height;
+	int size;
+};
+
+struct routeNode
+{
+	struct bucketNode base;
+	int sep;
+	BucketNode left;
+	BucketNode right;
+};
+
+struct leafNode
+{
+	struct bucketNode base;
+	int keys[BUCKET_MAX];
+};
+
+#define ROUTE(n) ((struct routeNode *)(n))
+#define LEAF(n) ((struct leafNode *)(n))
+
+struct bucketTree
+{
+	BucketNode root;
+};
+
+#define ROUTE_SIZE (sizeof(struct routeNode))
+#define LEAF_SIZE (sizeof(struct leafNode))
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static BucketNode LeafNew(void);
+static BucketNode RouteNew(int sep, BucketNode left, BucketNode right);
+static void FreeNode(BucketNode n);
+static size_t NodeMemory(BucketNode n);
+static int NodeSmallestBucket(BucketNode n);
+static int LowerBound(const int *keys, int size, int key);
+static BucketNode NodeInsert(BucketNode curr, int key, bool *inserted);
+static BucketNode LeafInsert(BucketNode leaf, int key, bool *inserted);
+static BucketNode NodeDelete(BucketNode curr, int key, bool *deleted);
+static BucketNode FixUnderflow(BucketNode curr);
+static void ShiftOut(BucketNode leaf, int pos, int count);
+static void UpdateSizes(BucketNode n, bool leftmost);
+static BucketNode Rebalance(BucketNode n);
+static BucketNode RotateLeft(BucketNode n);
+static BucketNode RotateRight(BucketNode n);
+static void UpdateNode(BucketNode n);
+static int Height(BucketNode n);
+static void NodeToList(List l, BucketNode curr);
+static int NodeMin(BucketNode curr);
+static int NodeMax(BucketNode curr);
+static int NodeFloor(BucketNode curr, int key);
+static int NodeCeiling(BucketNode curr, int key);
+static void NodeSearchBetween(BucketNode curr, int lower, int upper, List l);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty tree.
+ */
+BucketTree BucketTreeNew(void)
+{
+	BucketTree t = malloc(sizeof(*t));
+
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc BucketTree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t->root = NULL;
+	return t;
+}
+
+/**
+ * Create an empty leaf bucket with every slot padded
+ */
+static BucketNode LeafNew(void)
+{
+	BucketNode n = malloc(LEAF_SIZE);
+
+	if (n == NULL)
+	{
+		fprintf(stderr, "Could not malloc Bucket\n");
+		exit(EXIT_FAILURE);
+	}
+
+	n->height = 0;
+	n->size = 0;
+	for (int i = 0; i < BUCKET_MAX; i++)
+		LEAF(n)->keys[i] = BUCKET_PAD;
+
+	return n;
+}
+
+/**
+ * Create a routing node above two existing subtrees
+ */
+static BucketNode RouteNew(int sep, BucketNode left, BucketNode right)
+{
+	BucketNode n = malloc(ROUTE_SIZE);
+
+	if (n == NULL)
+	{
+		fprintf(stderr, "Could not malloc Routing Node\n");
+		exit(EXIT_FAILURE);
+	}
+
+	ROUTE(n)->sep = sep;
+	ROUTE(n)->left = left;
+	ROUTE(n)->right = right;
+	UpdateNode(n);
+
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Frees all memory allocated for the given tree.
+ */
+void BucketTreeFree(BucketTree t)
+{
+	if (t == NULL)
+		return;
+
+	FreeNode(t->root);
+	free(t);
+}
+
+static void FreeNode(BucketNode n)
+{
+	if (n == NULL)
+		return;
+
+	if (n->height > 0)
+	{
+		FreeNode(ROUTE(n)->left);
+		FreeNode(ROUTE(n)->right);
+	}
+
+	free(n);
+}
+
+/**
+ * Returns the number of keys in the tree.
+ */
+int BucketTreeSize(BucketTree t)
+{
+	if (t == NULL || t->root == NULL)
+		return 0;
+
+	return t->root->size;
+}
+
+/**
+ * Returns the number of bytes allocated for the given tree.
+ */
+size_t BucketTreeMemory(BucketTree t)
+{
+	if (t == NULL)
+		return 0;
+
+	return sizeof(*t) + NodeMemory(t->root);
+}
+
+static size_t NodeMemory(BucketNode n)
+{
+	if (n == NULL)
+		return 0;
+
+	if (n->height == 0)
+		return LEAF_SIZE;
+
+	return ROUTE_SIZE + NodeMemory(ROUTE(n)->left) + NodeMemory(ROUTE(n)->right);
+}
+
+/**
+ * Returns the number of keys in the emptiest bucket of the tree.
+ */
+int BucketTreeSmallestBucket(BucketTree t)
+{
+	if (t == NULL || t->root == NULL)
+		return 0;
+
+	return NodeSmallestBucket(t->root);
+}
+
+static int NodeSmallestBucket(BucketNode n)
+{
+	if (n->height == 0)
+		return n->size;
+
+	int left = NodeSmallestBucket(ROUTE(n)->left);
+	int right = NodeSmallestBucket(ROUTE(n)->right);
+	return (left < right) ? left : right;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the number of keys in a bucket that are less than key,
+ * which is also the position key would be inserted at.
+ */
+static int LowerBound(const int *keys, int size, int key)
+{
+#ifdef __SSE2__
+	// Count keys below the target across the whole padded bucket.
+	// Padding is INT_MAX so it never compares less than the key.
+	(void)size;
+	__m128i target = _mm_set1_epi32(key);
+	__m128i count = _mm_setzero_si128();
+	for (int i = 0; i < BUCKET_MAX; i += 4)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)&keys[i]);
+		count = _mm_sub_epi32(count, _mm_cmplt_epi32(block, target));
+	}
+
+	count = _mm_add_epi32(count, _mm_shuffle_epi32(count, _MM_SHUFFLE(1, 0, 3, 2)));
+	count = _mm_add_epi32(count, _mm_shuffle_epi32(count, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(count);
+#else
+	// Branchless binary search, the comparison compiles to a cmov
+	const int *base = keys;
+	int len = size;
+	while (len > 1)
+	{
+		int half = len / 2;
+		base = (base[half - 1] < key) ? base + half : base;
+		len -= half;
+	}
+
+	return (int)(base - keys) + (len == 1 && *base < key);
+#endif
+}
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ */
+bool BucketTreeSearch(BucketTree t, int key)
+{
+	if (t == NULL || t->root == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+		return false;
+
+	// Routing nodes never hold keys, so walk straight down to a bucket
+	BucketNode curr = t->root;
+	while (curr->height > 0)
+		curr = (key < ROUTE(curr)->sep) ? ROUTE(curr)->left : ROUTE(curr)->right;
+
+	int pos = LowerBound(LEAF(curr)->keys, curr->size, key);
+	return pos < curr->size && LEAF(curr)->keys[pos] == key;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Inserts the given key into the tree, splitting its bucket if full.
+ */
+bool BucketTreeInsert(BucketTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return false;
+	}
+
+	if (t->root == NULL)
+		t->root = LeafNew();
+
+	bool inserted = false;
+	t->root = NodeInsert(t->root, key, &inserted);
+	return inserted;
+}
+
+/**
+ * Search for the bucket the key belongs in
+ * Balance the routing nodes on the way back up if necessary
+ */
+static BucketNode NodeInsert(BucketNode curr, int key, bool *inserted)
+{
+	if (curr->height == 0)
+		return LeafInsert(curr, key, inserted);
+
+	if (key < ROUTE(curr)->sep)
+		ROUTE(curr)->left = NodeInsert(ROUTE(curr)->left, key, inserted);
+	else
+		ROUTE(curr)->right = NodeInsert(ROUTE(curr)->right, key, inserted);
+
+	if (!*inserted)
+		return curr;
+
+	return Rebalance(curr);
+}
+
+/**
+ * Insert a key into a bucket
+ * A full bucket is split in two under a new routing node
+ */
+static BucketNode LeafInsert(BucketNode leaf, int key, bool *inserted)
+{
+	int pos = LowerBound(LEAF(leaf)->keys, leaf->size, key);
+	if (pos < leaf->size && LEAF(leaf)->keys[pos] == key)
+	{
+		fprintf(stderr, "Value %d already Exists in Tree\n", key);
+		return leaf;
+	}
+
+	*inserted = true;
+
+	if (leaf->size < BUCKET_MAX)
+	{
+		memmove(&LEAF(leaf)->keys[pos + 1], &LEAF(leaf)->keys[pos],
+				sizeof(int) * (leaf->size - pos));
+		LEAF(leaf)->keys[pos] = key;
+		leaf->size++;
+		return leaf;
+	}
+
+	// Move the upper half of the keys into a new bucket
+	int half = BUCKET_MAX / 2;
+	BucketNode right = LeafNew();
+	memcpy(LEAF(right)->keys, &LEAF(leaf)->keys[half], sizeof(int) * (BUCKET_MAX - half));
+	right->size = BUCKET_MAX - half;
+	for (int i = half; i < BUCKET_MAX; i++)
+		LEAF(leaf)->keys[i] = BUCKET_PAD;
+	leaf->size = half;
+
+	// Both halves now have room, so this insertion cannot split again
+	bool ignored = false;
+	if (pos < half)
+		LeafInsert(leaf, key, &ignored);
+	else
+		LeafInsert(right, key, &ignored);
+
+	return RouteNew(LEAF(right)->keys[0], leaf, right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Deletes the given key from the tree if it is present.
+ */
+bool BucketTreeDelete(BucketTree t, int key)
+{
+	if (t == NULL || t->root == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't accept UNDEFINED as input\n");
+		return false;
+	}
+
+	bool deleted = false;
+	t->root = NodeDelete(t->root, key, &deleted);
+
+	if (!deleted)
+	{
+		fprintf(stderr, "Value to Delete not in Tree\n");
+		return false;
+	}
+
+	// The last bucket is freed once it runs empty
+	if (t->root->height == 0 && t->root->size == 0)
+	{
+		free(t->root);
+		t->root = NULL;
+	}
+
+	return true;
+}
+
+/**
+ * Search for the bucket holding the key and remove it
+ * Merge small buckets and balance the tree on the way back up
+ */
+static BucketNode NodeDelete(BucketNode curr, int key, bool *deleted)
+{
+	if (curr->height == 0)
+	{
+		int pos = LowerBound(LEAF(curr)->keys, curr->size, key);
+		if (pos == curr->size || LEAF(curr)->keys[pos] != key)
+			return curr;
+
+		memmove(&LEAF(curr)->keys[pos], &LEAF(curr)->keys[pos + 1],
+				sizeof(int) * (curr->size - pos - 1));
+		curr->size--;
+		LEAF(curr)->keys[curr->size] = BUCKET_PAD;
+		*deleted = true;
+		return curr;
+	}
+
+	if (key < ROUTE(curr)->sep)
+		ROUTE(curr)->left = NodeDelete(ROUTE(curr)->left, key, deleted);
+	else
+		ROUTE(curr)->right = NodeDelete(ROUTE(curr)->right, key, deleted);
+
+	if (!*deleted)
+		return curr;
+
+	curr = FixUnderflow(curr);
+	if (curr->height == 0)
+		return curr;
+
+	return Rebalance(curr);
+}
+
+/**
+ * Remove empty buckets below a routing node and refill a bucket child
+ * that has become too small from the bucket next to it in key order,
+ * which is its sibling or the nearest bucket down the other subtree.
+ * The two are merged if they fit in one bucket, otherwise keys move
+ * across until both are half full. Returns whatever replaces the node.
+ */
+static BucketNode FixUnderflow(BucketNode curr)
+{
+	BucketNode left = ROUTE(curr)->left;
+	BucketNode right = ROUTE(curr)->right;
+
+	// An empty bucket is dropped along with the routing node above it
+	if (left->height == 0 && left->size == 0)
+	{
+		free(left);
+		free(curr);
+		return right;
+	}
+
+	if (right->height == 0 && right->size == 0)
+	{
+		free(right);
+		free(curr);
+		return left;
+	}
+
+	if (left->height == 0 && left->size < BUCKET_MIN)
+	{
+		// The next bucket up is the smallest one on the right
+		BucketNode next = right;
+		while (next->height > 0)
+			next = ROUTE(next)->left;
+
+		if (left->size + next->size <= BUCKET_MAX)
+		{
+			// Every key on the left is smaller, so it goes in front
+			memmove(&LEAF(next)->keys[left->size], LEAF(next)->keys, sizeof(int) * next->size);
+			memcpy(LEAF(next)->keys, LEAF(left)->keys, sizeof(int) * left->size);
+			next->size += left->size;
+			UpdateSizes(right, true);
+
+			free(left);
+			free(curr);
+			return right;
+		}
+
+		int moved = (left->size + next->size) / 2 - left->size;
+		memcpy(&LEAF(left)->keys[left->size], LEAF(next)->keys, sizeof(int) * moved);
+		left->size += moved;
+		ShiftOut(next, 0, moved);
+		ROUTE(curr)->sep = LEAF(next)->keys[0];
+		UpdateSizes(right, true);
+		return curr;
+	}
+
+	if (right->height == 0 && right->size < BUCKET_MIN)
+	{
+		// The previous bucket is the largest one on the left
+		BucketNode prev = left;
+		while (prev->height > 0)
+			prev = ROUTE(prev)->right;
+
+		if (prev->size + right->size <= BUCKET_MAX)
+		{
+			// Every key on the right is larger, so the merge is a plain append
+			memcpy(&LEAF(prev)->keys[prev->size], LEAF(right)->keys, sizeof(int) * right->size);
+			prev->size += right->size;
+			UpdateSizes(left, false);
+
+			free(right);
+			free(curr);
+			return left;
+		}
+
+		int moved = (prev->size + right->size) / 2 - right->size;
+		memmove(&LEAF(right)->keys[moved], LEAF(right)->keys, sizeof(int) * right->size);
+		memcpy(LEAF(right)->keys, &LEAF(prev)->keys[prev->size - moved], sizeof(int) * moved);
+		right->size += moved;
+		ShiftOut(prev, prev->size - moved, moved);
+		ROUTE(curr)->sep = LEAF(right)->keys[0];
+		UpdateSizes(left, false);
+		return curr;
+	}
+
+	return curr;
+}
+
+/**
+ * Remove count keys from a bucket starting at pos and pad the slots
+ * freed at the end
+ */
+static void ShiftOut(BucketNode leaf, int pos, int count)
+{
+	memmove(&LEAF(leaf)->keys[pos], &LEAF(leaf)->keys[pos + count],
+			sizeof(int) * (leaf->size - pos - count));
+	leaf->size -= count;
+	for (int i = leaf->size; i < leaf->size + count; i++)
+		LEAF(leaf)->keys[i] = BUCKET_PAD;
+}
+
+/**
+ * Recount the subtree sizes down the leftmost (or rightmost) path of n,
+ * after the bucket at its end has gained or lost keys
+ */
+static void UpdateSizes(BucketNode n, bool leftmost)
+{
+	if (n->height == 0)
+		return;
+
+	UpdateSizes(leftmost ? ROUTE(n)->left : ROUTE(n)->right, leftmost);
+	UpdateNode(n);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Restore the AVL property at a routing node
+ * Leaves always have height 0, so any child taller than its sibling by
+ * two is a routing node and only routing nodes are ever rotated.
+ */
+static BucketNode Rebalance(BucketNode n)
+{
+	UpdateNode(n);
+
+	int balance = Height(ROUTE(n)->left) - Height(ROUTE(n)->right);
+
+	if (balance > 1)
+	{
+		BucketNode y = ROUTE(n)->left;
+		if (Height(ROUTE(y)->left) < Height(ROUTE(y)->right))
+			ROUTE(n)->left = RotateLeft(y);
+		return RotateRight(n);
+	}
+
+	if (balance < -1)
+	{
+		BucketNode y = ROUTE(n)->right;
+		if (Height(ROUTE(y)->right) < Height(ROUTE(y)->left))
+			ROUTE(n)->right = RotateRight(y);
+		return RotateLeft(n);
+	}
+
+	return n;
+}
+
+static BucketNode RotateLeft(BucketNode n)
+{
+	BucketNode y = ROUTE(n)->right;
+	ROUTE(n)->right = ROUTE(y)->left;
+	ROUTE(y)->left = n;
+
+	UpdateNode(n);
+	UpdateNode(y);
+	return y;
+}
+
+static BucketNode RotateRight(BucketNode n)
+{
+	BucketNode y = ROUTE(n)->left;
+	ROUTE(n)->left = ROUTE(y)->right;
+	ROUTE(y)->right = n;
+
+	UpdateNode(n);
+	UpdateNode(y);
+	return y;
+}
+
+/**
+ * Update the height and subtree size of a routing node
+ */
+static void UpdateNode(BucketNode n)
+{
+	n->height = 1 + max(Height(ROUTE(n)->left), Height(ROUTE(n)->right));
+	n->size = ROUTE(n)->left->size + ROUTE(n)->right->size;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a list containing all the keys in the given tree in ascending
+ * order.
+ */
+List BucketTreeToList(BucketTree t)
+{
+	List l = ListNew();
+	if (t == NULL)
+		return l;
+
+	NodeToList(l, t->root);
+	return l;
+}
+
+static void NodeToList(List l, BucketNode curr)
+{
+	if (curr == NULL)
+		return;
+
+	if (curr->height == 0)
+	{
+		for (int i = 0; i < curr->size; i++)
+			ListAppend(l, LEAF(curr)->keys[i]);
+		return;
+	}
+
+	NodeToList(l, ROUTE(curr)->left);
+	NodeToList(l, ROUTE(curr)->right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the k-th smallest key in the tree.
+ * Subtree sizes let the search skip whole subtrees at a time.
+ */
+int BucketTreeKthSmallest(BucketTree t, int k)
+{
+	if (t == NULL || t->root == NULL)
+		return UNDEFINED;
+
+	if (k < 1 || k > t->root->size)
+		return UNDEFINED;
+
+	BucketNode curr = t->root;
+	while (curr->height > 0)
+	{
+		BucketNode left = ROUTE(curr)->left;
+		if (k <= left->size)
+		{
+			curr = left;
+		}
+		else
+		{
+			k -= left->size;
+			curr = ROUTE(curr)->right;
+		}
+	}
+
+	return LEAF(curr)->keys[k - 1];
+}
+
+/**
+ * Returns the k-th largest key in the tree.
+ */
+int BucketTreeKthLargest(BucketTree t, int k)
+{
+	int size = BucketTreeSize(t);
+	if (k < 1 || k > size)
+		return UNDEFINED;
+
+	return BucketTreeKthSmallest(t, size - k + 1);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ */
+int BucketTreeFloor(BucketTree t, int key)
+{
+	if (t == NULL || t->root == NULL)
+		return UNDEFINED;
+
+	return NodeFloor(t->root, key);
+}
+
+static int NodeFloor(BucketNode curr, int key)
+{
+	if (curr->height == 0)
+	{
+		int pos = LowerBound(LEAF(curr)->keys, curr->size, key);
+		if (pos < curr->size && LEAF(curr)->keys[pos] == key)
+			return key;
+		return (pos == 0) ? UNDEFINED : LEAF(curr)->keys[pos - 1];
+	}
+
+	if (key < ROUTE(curr)->sep)
+		return NodeFloor(ROUTE(curr)->left, key);
+
+	// Everything on the left is below the separator, so if the right
+	// subtree has no floor it is the largest key on the left
+	int right = NodeFloor(ROUTE(curr)->right, key);
+	return (right == UNDEFINED) ? NodeMax(ROUTE(curr)->left) : right;
+}
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ */
+int BucketTreeCeiling(BucketTree t, int key)
+{
+	if (t == NULL || t->root == NULL)
+		return UNDEFINED;
+
+	return NodeCeiling(t->root, key);
+}
+
+static int NodeCeiling(BucketNode curr, int key)
+{
+	if (curr->height == 0)
+	{
+		int pos = LowerBound(LEAF(curr)->keys, curr->size, key);
+		return (pos == curr->size) ? UNDEFINED : LEAF(curr)->keys[pos];
+	}
+
+	if (key >= ROUTE(curr)->sep)
+		return NodeCeiling(ROUTE(curr)->right, key);
+
+	int left = NodeCeiling(ROUTE(curr)->left, key);
+	return (left == UNDEFINED) ? NodeMin(ROUTE(curr)->right) : left;
+}
+
+static int NodeMin(BucketNode curr)
+{
+	while (curr->height > 0)
+		curr = ROUTE(curr)->left;
+	return LEAF(curr)->keys[0];
+}
+
+static int NodeMax(BucketNode curr)
+{
+	while (curr->height > 0)
+		curr = ROUTE(curr)->right;
+	return LEAF(curr)->keys[curr->size - 1];
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in a list in ascending order.
+ */
+List BucketTreeSearchBetween(BucketTree t, int lower, int upper)
+{
+	List l = ListNew();
+
+	if (t == NULL)
+		return l;
+
+	if (lower > upper)
+		return l;
+
+	if (lower == UNDEFINED || upper == UNDEFINED)
+		return l;
+
+	NodeSearchBetween(t->root, lower, upper, l);
+	return l;
+}
+
+static void NodeSearchBetween(BucketNode curr, int lower, int upper, List l)
+{
+	if (curr == NULL)
+		return;
+
+	// Buckets in range are copied out with one sequential scan each
+	if (curr->height == 0)
+	{
+		for (int i = LowerBound(LEAF(curr)->keys, curr->size, lower);
+			 i < curr->size && LEAF(curr)->keys[i] <= upper; i++)
+			ListAppend(l, LEAF(curr)->keys[i]);
+		return;
+	}
+
+	if (lower < ROUTE(curr)->sep)
+		NodeSearchBetween(ROUTE(curr)->left, lower, upper, l);
+	if (upper >= ROUTE(curr)->sep)
+		NodeSearchBetween(ROUTE(curr)->right, lower, upper, l);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Returns the height of the given node.
+ * Buckets are 0
+ */
+static int Height(BucketNode n)
+{
+	return n->height;
+}
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
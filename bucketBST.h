@@ -0,0 +1,128 @@
+// Operations on Leaf-Bucketed Balanced Binary Search Trees.
+// A hybrid AVL tree whose internal nodes only route searches and whose
+// leaves are small sorted arrays ("buckets") of keys. Rotations only
+// ever move routing nodes, so the bottom levels of the tree are packed
+// into a handful of cache lines instead of one allocation per key.
+
+#ifndef BUCKET_TREE_H
+#define BUCKET_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bBST.h"
+#include "List.h"
+
+// Maximum number of keys held by a single leaf bucket.
+// A full bucket is split in half and a bucket left with fewer than
+// BUCKET_MAX / 4 keys is merged with or refilled from the bucket next
+// to it, so every bucket but a lone root holds between BUCKET_MAX / 4
+// and BUCKET_MAX keys.
+#define BUCKET_MAX 64
+
+typedef struct bucketTree *BucketTree;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of keys in the
+// tree, and B, the bucket size, unless otherwise specified.
+
+/**
+ * Creates a new empty tree.
+ * The time complexity of this function is O(1).
+ */
+BucketTree BucketTreeNew(void);
+
+/**
+ * Frees all memory allocated for the given tree.
+ * The time complexity of this function is O(n / B).
+ */
+void BucketTreeFree(BucketTree t);
+
+/**
+ * Returns the number of keys in the tree.
+ * The time complexity of this function is O(1).
+ */
+int BucketTreeSize(BucketTree t);
+
+/**
+ * Returns the number of bytes allocated for the given tree.
+ * The time complexity of this function is O(n / B).
+ */
+size_t BucketTreeMemory(BucketTree t);
+
+/**
+ * Returns the number of keys in the emptiest bucket of the tree, or 0
+ * if the tree is empty.
+ * The time complexity of this function is O(n / B).
+ */
+int BucketTreeSmallestBucket(BucketTree t);
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ * The time complexity of this function is O(log n).
+ */
+bool BucketTreeSearch(BucketTree t, int key);
+
+/**
+ * Inserts the given key into the tree, splitting its bucket if full.
+ * Returns true if the key was inserted successfully, or false if the
+ * key was already present in the tree or is UNDEFINED.
+ * The time complexity of this function is O(log n + B).
+ */
+bool BucketTreeInsert(BucketTree t, int key);
+
+/**
+ * Deletes the given key from the tree if it is present, merging its
+ * bucket with a neighbouring bucket, or moving keys across from it, if
+ * it becomes too small.
+ * Returns true if the key was deleted successfully, or false if the key
+ * was not present in the tree.
+ * The time complexity of this function is O(log n + B).
+ */
+bool BucketTreeDelete(BucketTree t, int key);
+
+/**
+ * Creates a list containing all the keys in the given tree in ascending
+ * order.
+ * The time complexity of this function is O(n).
+ */
+List BucketTreeToList(BucketTree t);
+
+/**
+ * Returns the k-th smallest key in the tree, or UNDEFINED if k is not
+ * between 1 and the number of keys in the tree.
+ * The time complexity of this function is O(log n).
+ */
+int BucketTreeKthSmallest(BucketTree t, int k);
+
+/**
+ * Returns the k-th largest key in the tree, or UNDEFINED if k is not
+ * between 1 and the number of keys in the tree.
+ * The time complexity of this function is O(log n).
+ */
+int BucketTreeKthLargest(BucketTree t, int k);
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int BucketTreeFloor(BucketTree t, int key);
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int BucketTreeCeiling(BucketTree t, int key);
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in order in a list.
+ * The time complexity of this function is O(log n + m), where m is the
+ * length of the returned list.
+ */
+List BucketTreeSearchBetween(BucketTree t, int lower, int upper);
+
+#endif
@@ -0,0 +1,451 @@
+// Differential checker for Leaf-Bucketed Balanced Binary Search Trees.
+// Runs random inserts and deletes through a BucketTree and a Tree from
+// bBST.h with the same keys, and compares every answer: the return of
+// each update, and after every batch the size, the search, floor and
+// ceiling of probes, every k-th smallest and largest key, and the Lists
+// of ToList and SearchBetween, read back with ListCapture.
+//
+// Keys include INT_MAX, which is also the value empty bucket slots are
+// padded with, and INT_MIN + 1 next to UNDEFINED. A run with keys packed
+// against both ends of int follows, and a last pass shrinks a large tree
+// back down and checks that buckets stay at least a quarter full.
+//
+// Usage: ./bucketCheck [-o operations] [-s seed]
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "bucketBST.h"
+#include "List.h"
+#include "listCapture.h"
+
+#define DEFAULT_OPS 100000
+// Operations between two full comparisons
+#define BATCH 2000
+// Keys are drawn from [-KEYSPACE, KEYSPACE), plus the ends of int
+#define KEYSPACE 4096
+#define EDGE_KEYS 300
+#define FILL_KEYS 50000
+#define FILL_KEPT 50
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkRandom(int ops, unsigned int seed);
+static bool checkEdges(void);
+static bool checkFill(unsigned int seed);
+static bool checkUpdate(BucketTree bt, Tree t, int key, bool insert);
+static bool checkQueries(BucketTree bt, Tree t, unsigned int *state);
+static bool checkLists(const char *what, List got, List want);
+static bool checkFilled(BucketTree bt);
+static int randomKey(unsigned int *state);
+static int randomProbe(unsigned int *state);
+static int Silence(void);
+static void Restore(int saved);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkRandom(ops, seed);
+	failures += !checkEdges();
+	failures += !checkFill(seed);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Random inserts and deletes, growing and shrinking the tree in turns so
+ * that buckets are split, refilled and merged, with every query compared
+ * after each batch
+ */
+static bool checkRandom(int ops, unsigned int seed)
+{
+	BucketTree bt = BucketTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int insertPct = (i / (4 * BATCH) % 2 == 0) ? 65 : 35;
+		int key = randomKey(&state);
+		ok = checkUpdate(bt, t, key, (int)(NextRandom(&state) % 100) < insertPct);
+
+		if (ok && i % BATCH == BATCH - 1)
+			ok = checkQueries(bt, t, &state) && checkFilled(bt);
+	}
+
+	if (ok)
+		ok = checkQueries(bt, t, &state);
+
+	printf("%s random operations  %d operations, %d keys at the end\n", ok ? "PASS" : "FAIL",
+		   ops, BucketTreeSize(bt));
+	BucketTreeFree(bt);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Keys packed against both ends of int, so that whole buckets hold
+ * INT_MAX and its neighbours beside the padding, then deleted again
+ */
+static bool checkEdges(void)
+{
+	BucketTree bt = BucketTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = 99;
+	bool ok = true;
+
+	for (int i = 0; i < EDGE_KEYS && ok; i++)
+	{
+		ok = checkUpdate(bt, t, INT_MAX - i, true) && checkUpdate(bt, t, INT_MIN + 1 + i, true);
+		if (ok && i % 25 == 0)
+			ok = checkQueries(bt, t, &state);
+	}
+
+	// UNDEFINED is never a key
+	ok = ok && checkUpdate(bt, t, UNDEFINED, true) && checkQueries(bt, t, &state);
+
+	for (int i = 0; i < 4 * EDGE_KEYS && ok; i++)
+	{
+		int offset = (int)(NextRandom(&state) % EDGE_KEYS);
+		int key = (NextRandom(&state) & 1) ? INT_MAX - offset : INT_MIN + 1 + offset;
+		ok = checkUpdate(bt, t, key, false);
+		if (ok && i % 25 == 0)
+			ok = checkQueries(bt, t, &state);
+	}
+
+	ok = ok && checkQueries(bt, t, &state);
+
+	printf("%s ends of int        %d keys at each end\n", ok ? "PASS" : "FAIL", EDGE_KEYS);
+	BucketTreeFree(bt);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Build a large tree and delete most of its keys in random order,
+ * checking along the way that no bucket has fewer than a quarter
+ * of BUCKET_MAX keys unless it is the only one
+ */
+static bool checkFill(unsigned int seed)
+{
+	BucketTree bt = BucketTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	int *keys = malloc(FILL_KEYS * sizeof(int));
+	if (keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < FILL_KEYS; i++)
+		keys[i] = i;
+	for (int i = FILL_KEYS - 1; i > 0; i--)
+	{
+		int j = (int)(NextRandom(&state) % (unsigned int)(i + 1));
+		int tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+
+	for (int i = 0; i < FILL_KEYS && ok; i++)
+		ok = checkUpdate(bt, t, keys[i], true);
+
+	// Every FILL_KEPT-th key stays, so most buckets are thinned out to a
+	// few keys before any of them runs empty
+	for (int i = 0; i < FILL_KEYS && ok; i++)
+	{
+		if (keys[i] % FILL_KEPT == 0)
+			continue;
+
+		// A bucket that is too small stays so until it is deleted from
+		// again, so checking now and then is enough to catch it
+		ok = checkUpdate(bt, t, keys[i], false);
+		if (ok && i % 16 == 0)
+			ok = checkFilled(bt);
+		if (ok && i % (FILL_KEYS / 10) == 0)
+			ok = checkQueries(bt, t, &state);
+	}
+
+	ok = ok && checkQueries(bt, t, &state);
+
+	printf("%s bucket fill        %d keys thinned out to %d\n", ok ? "PASS" : "FAIL",
+		   FILL_KEYS, BucketTreeSize(bt));
+	free(keys);
+	BucketTreeFree(bt);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Insert or delete a key in both trees and compare what they return.
+ * The trees complain about duplicates and missing keys on stderr, which
+ * is silenced for the updates that are expected to be refused.
+ */
+static bool checkUpdate(BucketTree bt, Tree t, int key, bool insert)
+{
+	bool refused = (key == UNDEFINED) || (TreeSearch(t, key) == insert);
+	int saved = refused ? Silence() : -1;
+
+	bool got = insert ? BucketTreeInsert(bt, key) : BucketTreeDelete(bt, key);
+	bool want = insert ? TreeInsert(t, key) : TreeDelete(t, key);
+
+	if (refused)
+		Restore(saved);
+
+	if (got != want)
+	{
+		printf("FAIL %s %d returned %d, expected %d\n", insert ? "insert" : "delete", key, got,
+			   want);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the size, every query on random probes, each k from -1 to one
+ * past the size, and random ranges. The k-th keys are compared with the
+ * keys of TreeToList.
+ */
+static bool checkQueries(BucketTree bt, Tree t, unsigned int *state)
+{
+	List got = BucketTreeToList(bt);
+	List want = TreeToList(t);
+	int *keys;
+	int size = ListCapture(want, &keys);
+	bool ok = checkLists("to list", got, want);
+	ListFree(got);
+	ListFree(want);
+
+	if (ok && BucketTreeSize(bt) != size)
+	{
+		printf("FAIL size %d, expected %d\n", BucketTreeSize(bt), size);
+		ok = false;
+	}
+
+	for (int i = 0; i < 64 && ok; i++)
+	{
+		int key = randomProbe(state);
+		if (BucketTreeSearch(bt, key) != TreeSearch(t, key) ||
+			BucketTreeFloor(bt, key) != TreeFloor(t, key) ||
+			BucketTreeCeiling(bt, key) != TreeCeiling(t, key))
+		{
+			printf("FAIL probe %d: search %d, floor %d, ceiling %d; expected %d, %d, %d\n", key,
+				   BucketTreeSearch(bt, key), BucketTreeFloor(bt, key),
+				   BucketTreeCeiling(bt, key), TreeSearch(t, key), TreeFloor(t, key),
+				   TreeCeiling(t, key));
+			ok = false;
+		}
+	}
+
+	// The k-th keys are read off the sorted keys, TreeKthSmallest walks
+	// the whole tree
+	for (int k = -1; k <= size + 1 && ok; k++)
+	{
+		bool inRange = k >= 1 && k <= size;
+		int smallest = inRange ? keys[k - 1] : UNDEFINED;
+		int largest = inRange ? keys[size - k] : UNDEFINED;
+		if (BucketTreeKthSmallest(bt, k) != smallest || BucketTreeKthLargest(bt, k) != largest)
+		{
+			printf("FAIL k = %d: smallest %d, largest %d; expected %d, %d\n", k,
+				   BucketTreeKthSmallest(bt, k), BucketTreeKthLargest(bt, k), smallest, largest);
+			ok = false;
+		}
+	}
+	free(keys);
+
+	for (int i = 0; i < 16 && ok; i++)
+	{
+		int lower = randomProbe(state);
+		int upper = randomProbe(state);
+		// Ordered three times in four, inverted ranges are empty
+		if (NextRandom(state) % 4 != 0 && lower > upper)
+		{
+			int tmp = lower;
+			lower = upper;
+			upper = tmp;
+		}
+
+		got = BucketTreeSearchBetween(bt, lower, upper);
+		want = TreeSearchBetween(t, lower, upper);
+		ok = checkLists("search between", got, want);
+		if (!ok)
+			printf("     range [%d, %d]\n", lower, upper);
+		ListFree(got);
+		ListFree(want);
+	}
+
+	return ok;
+}
+
+/**
+ * Compare two Lists value by value
+ */
+static bool checkLists(const char *what, List got, List want)
+{
+	int *gotKeys, *wantKeys;
+	int gotSize = ListCapture(got, &gotKeys);
+	int wantSize = ListCapture(want, &wantKeys);
+
+	bool ok = gotSize >= 0 && gotSize == wantSize;
+	int i = 0;
+	while (ok && i < gotSize && gotKeys[i] == wantKeys[i])
+		i++;
+	ok = ok && i == gotSize;
+
+	if (!ok)
+		printf("FAIL %s returned %d keys, expected %d, first difference at %d\n", what, gotSize,
+			   wantSize, i);
+
+	free(gotKeys);
+	free(wantKeys);
+	return ok;
+}
+
+/**
+ * Every bucket but a lone root holds at least a quarter of BUCKET_MAX
+ * keys. The number of buckets is worked out from the memory the tree
+ * uses: one key takes a tree and a bucket, and BUCKET_MAX + 1 keys take
+ * two buckets and the routing node above them.
+ */
+static bool checkFilled(BucketTree bt)
+{
+	static size_t base = 0, bucket = 0, route = 0;
+
+	if (bucket == 0)
+	{
+		BucketTree sample = BucketTreeNew();
+		base = BucketTreeMemory(sample);
+		BucketTreeInsert(sample, 0);
+		bucket = BucketTreeMemory(sample) - base;
+		for (int key = 1; key <= BUCKET_MAX; key++)
+			BucketTreeInsert(sample, key);
+		route = BucketTreeMemory(sample) - base - 2 * bucket;
+		BucketTreeFree(sample);
+	}
+
+	size_t buckets = (BucketTreeMemory(bt) - base + route) / (bucket + route);
+	int smallest = BucketTreeSmallestBucket(bt);
+	if (buckets <= 1 || smallest >= BUCKET_MAX / 4)
+		return true;
+
+	printf("FAIL %zu buckets for %d keys, the smallest holds %d\n", buckets,
+		   BucketTreeSize(bt), smallest);
+	return false;
+}
+
+/**
+ * A key from the keyspace, or now and then one next to the ends of int
+ * or UNDEFINED itself
+ */
+static int randomKey(unsigned int *state)
+{
+	switch (NextRandom(state) % 64)
+	{
+	case 0:
+		return INT_MAX;
+	case 1:
+		return INT_MAX - 1;
+	case 2:
+		return INT_MIN + 1;
+	case 3:
+		return INT_MIN + 2;
+	case 4:
+		return UNDEFINED;
+	default:
+		return (int)(NextRandom(state) % (2 * KEYSPACE)) - KEYSPACE;
+	}
+}
+
+/**
+ * A key or a value next to one, including the ends of int
+ */
+static int randomProbe(unsigned int *state)
+{
+	switch (NextRandom(state) % 8)
+	{
+	case 0:
+		return INT_MAX - (int)(NextRandom(state) % (EDGE_KEYS + 2));
+	case 1:
+		return INT_MIN + (int)(NextRandom(state) % (EDGE_KEYS + 2));
+	default:
+		return (int)(NextRandom(state) % (2 * KEYSPACE + 20)) - KEYSPACE - 10;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Silence(void)
+{
+	fflush(stderr);
+	int saved = dup(STDERR_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0)
+	{
+		dup2(devNull, STDERR_FILENO);
+		close(devNull);
+	}
+	return saved;
+}
+
+static void Restore(int saved)
+{
+	if (saved < 0)
+		return;
+
+	fflush(stderr);
+	dup2(saved, STDERR_FILENO);
+	close(saved);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
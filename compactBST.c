@@ -0,0 +1,605 @@
+// Implementation of the Compact Balanced Binary Search Tree.
+//
+// Nodes are stored in one array and referenced by index. Index 0 is
+// never handed out so it can stand in for NULL. Freed nodes are kept on
+// a free list threaded through their left index and reused before the
+// pool grows. The pool may move when it grows, so code that allocates
+// works with indices only and never holds a node pointer across it.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "compactBST.h"
+#include "List.h"
+
+#define NIL 0
+#define INITIAL_CAPACITY 16
+
+typedef uint32_t Index;
+
+struct compactTree
+{
+	struct compactNode *pool;
+	Index capacity;
+	Index used;
+	Index freeList;
+	Index root;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static Index NodeCreate(CompactTree t, int k);
+static void NodeRelease(CompactTree t, Index n);
+static Index NodeInsert(CompactTree t, Index curr, Index n);
+static Index NodeDelete(CompactTree t, Index curr, int key);
+static Index Rebalance(CompactTree t, Index n);
+static Index RotateLeft(CompactTree t, Index n);
+static Index RotateRight(CompactTree t, Index n);
+static void UpdateHeight(CompactTree t, Index n);
+static int Height(CompactTree t, Index n);
+static int GetBalance(CompactTree t, Index n);
+static void NodeToList(CompactTree t, List l, Index curr);
+static Index NodeKthSmallest(CompactTree t, Index curr, int k, int *count);
+static Index NodeKthLargest(CompactTree t, Index curr, int k, int *count);
+static void NodeSearchBetween(CompactTree t, Index curr, int lower, int upper, List l);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty tree.
+ */
+CompactTree CompactTreeNew(void)
+{
+	CompactTree t = malloc(sizeof(*t));
+
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc CompactTree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t->pool = malloc(sizeof(*t->pool) * INITIAL_CAPACITY);
+	if (t->pool == NULL)
+	{
+		fprintf(stderr, "Could not malloc Node Pool\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Slot 0 is the null node and is never used
+	t->capacity = INITIAL_CAPACITY;
+	t->used = 1;
+	t->freeList = NIL;
+	t->root = NIL;
+	return t;
+}
+
+/**
+ * Frees all memory allocated for the given tree.
+ * Every node lives in the pool, so this is two frees.
+ */
+void CompactTreeFree(CompactTree t)
+{
+	if (t == NULL)
+		return;
+
+	free(t->pool);
+	free(t);
+}
+
+/**
+ * Returns the number of bytes allocated for the given tree.
+ */
+size_t CompactTreeMemory(CompactTree t)
+{
+	if (t == NULL)
+		return 0;
+
+	return sizeof(*t) + sizeof(*t->pool) * (size_t)t->capacity;
+}
+
+/**
+ * Take a node from the free list, growing the pool if it is empty
+ */
+static Index NodeCreate(CompactTree t, int k)
+{
+	Index n = t->freeList;
+
+	if (n != NIL)
+	{
+		t->freeList = t->pool[n].left;
+	}
+	else
+	{
+		if (t->used == COMPACT_MAX_NODES)
+		{
+			fprintf(stderr, "CompactTree is full\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (t->used == t->capacity)
+		{
+			Index capacity = (t->capacity > COMPACT_MAX_NODES / 2)
+								 ? COMPACT_MAX_NODES
+								 : t->capacity * 2;
+
+			struct compactNode *pool = realloc(t->pool, sizeof(*pool) * (size_t)capacity);
+			if (pool == NULL)
+			{
+				fprintf(stderr, "Could not grow Node Pool\n");
+				exit(EXIT_FAILURE);
+			}
+
+			t->pool = pool;
+			t->capacity = capacity;
+		}
+
+		n = t->used++;
+	}
+
+	t->pool[n].key = k;
+	t->pool[n].left = NIL;
+	t->pool[n].right = NIL;
+	t->pool[n].height = 0;
+	return n;
+}
+
+/**
+ * Return a node to the free list
+ */
+static void NodeRelease(CompactTree t, Index n)
+{
+	t->pool[n].left = t->freeList;
+	t->freeList = n;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ */
+bool CompactTreeSearch(CompactTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+		return false;
+
+	const struct compactNode *pool = t->pool;
+	Index curr = t->root;
+	while (curr != NIL)
+	{
+		int k = pool[curr].key;
+		if (k == key)
+			return true;
+
+		// A real branch lets the CPU speculate down the tree, a
+		// conditional move would serialise every load on the compare
+		if (key > k)
+			curr = pool[curr].right;
+		else
+			curr = pool[curr].left;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Inserts the given key into the tree.
+ */
+bool CompactTreeInsert(CompactTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	if (CompactTreeSearch(t, key))
+	{
+		fprintf(stderr, "Value %d already Exists in Tree\n", key);
+		return false;
+	}
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return false;
+	}
+
+	// Allocate first, the pool is stable for the rest of the insertion
+	Index n = NodeCreate(t, key);
+	t->root = NodeInsert(t, t->root, n);
+	return true;
+}
+
+/**
+ * Search for correct position to insert new node
+ * Balance tree if necessary
+ */
+static Index NodeInsert(CompactTree t, Index curr, Index n)
+{
+	if (curr == NIL)
+		return n;
+
+	if (t->pool[curr].key > t->pool[n].key)
+		t->pool[curr].left = NodeInsert(t, t->pool[curr].left, n);
+	else
+		t->pool[curr].right = NodeInsert(t, t->pool[curr].right, n);
+
+	return Rebalance(t, curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Deletes the given key from the tree if it is present.
+ */
+bool CompactTreeDelete(CompactTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't accept UNDEFINED as input\n");
+		return false;
+	}
+
+	if (!CompactTreeSearch(t, key))
+	{
+		fprintf(stderr, "Value to Delete not in Tree\n");
+		return false;
+	}
+
+	t->root = NodeDelete(t, t->root, key);
+	return true;
+}
+
+/**
+ * Search for the node to delete
+ * Balance the tree if necessary
+ */
+static Index NodeDelete(CompactTree t, Index curr, int key)
+{
+	if (curr == NIL)
+		return NIL;
+
+	struct compactNode *node = &t->pool[curr];
+
+	if (key > node->key)
+	{
+		node->right = NodeDelete(t, node->right, key);
+	}
+	else if (key < node->key)
+	{
+		node->left = NodeDelete(t, node->left, key);
+	}
+	else if (node->left == NIL || node->right == NIL)
+	{
+		// Zero or one child, splice the node out
+		Index child = (node->left == NIL) ? node->right : node->left;
+		NodeRelease(t, curr);
+		return child;
+	}
+	else
+	{
+		// Two children, replace with the smallest key on the right
+		Index min = node->right;
+		while (t->pool[min].left != NIL)
+			min = t->pool[min].left;
+
+		node->key = t->pool[min].key;
+		node->right = NodeDelete(t, node->right, node->key);
+	}
+
+	return Rebalance(t, curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Update the height of a node and rotate it if it is unbalanced
+ */
+static Index Rebalance(CompactTree t, Index n)
+{
+	UpdateHeight(t, n);
+	int balance = GetBalance(t, n);
+
+	// Left Left and Left Right cases
+	if (balance > 1)
+	{
+		if (GetBalance(t, t->pool[n].left) < 0)
+			t->pool[n].left = RotateLeft(t, t->pool[n].left);
+		return RotateRight(t, n);
+	}
+
+	// Right Right and Right Left cases
+	if (balance < -1)
+	{
+		if (GetBalance(t, t->pool[n].right) > 0)
+			t->pool[n].right = RotateRight(t, t->pool[n].right);
+		return RotateLeft(t, n);
+	}
+
+	return n;
+}
+
+static Index RotateLeft(CompactTree t, Index n)
+{
+	Index y = t->pool[n].right;
+	t->pool[n].right = t->pool[y].left;
+	t->pool[y].left = n;
+
+	UpdateHeight(t, n);
+	UpdateHeight(t, y);
+	return y;
+}
+
+static Index RotateRight(CompactTree t, Index n)
+{
+	Index y = t->pool[n].left;
+	t->pool[n].left = t->pool[y].right;
+	t->pool[y].right = n;
+
+	UpdateHeight(t, n);
+	UpdateHeight(t, y);
+	return y;
+}
+
+static void UpdateHeight(CompactTree t, Index n)
+{
+	struct compactNode *node = &t->pool[n];
+	node->height = 1 + max(Height(t, node->left), Height(t, node->right));
+}
+
+static int GetBalance(CompactTree t, Index n)
+{
+	return Height(t, t->pool[n].left) - Height(t, t->pool[n].right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a list containing all the keys in the given tree in ascending
+ * order.
+ */
+List CompactTreeToList(CompactTree t)
+{
+	List l = ListNew();
+	if (t == NULL)
+		return l;
+
+	NodeToList(t, l, t->root);
+	return l;
+}
+
+static void NodeToList(CompactTree t, List l, Index curr)
+{
+	if (curr == NIL)
+		return;
+
+	NodeToList(t, l, t->pool[curr].left);
+	ListAppend(l, t->pool[curr].key);
+	NodeToList(t, l, t->pool[curr].right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the k-th smallest key in the tree.
+ */
+int CompactTreeKthSmallest(CompactTree t, int k)
+{
+	if (t == NULL || t->root == NIL)
+		return UNDEFINED;
+
+	int count = 0;
+	Index result = NodeKthSmallest(t, t->root, k, &count);
+	return (result == NIL) ? UNDEFINED : t->pool[result].key;
+}
+
+/**
+ * In order traverse through BST to find the kth smallest node
+ */
+static Index NodeKthSmallest(CompactTree t, Index curr, int k, int *count)
+{
+	if (curr == NIL)
+		return NIL;
+
+	Index left = NodeKthSmallest(t, t->pool[curr].left, k, count);
+	if (left != NIL)
+		return left;
+
+	(*count)++;
+	if (*count == k)
+		return curr;
+
+	return NodeKthSmallest(t, t->pool[curr].right, k, count);
+}
+
+/**
+ * Returns the k-th largest key in the tree.
+ */
+int CompactTreeKthLargest(CompactTree t, int k)
+{
+	if (t == NULL || t->root == NIL)
+		return UNDEFINED;
+
+	int count = 0;
+	Index result = NodeKthLargest(t, t->root, k, &count);
+	return (result == NIL) ? UNDEFINED : t->pool[result].key;
+}
+
+/**
+ * Reverse in order traverse through BST to find the kth largest node
+ */
+static Index NodeKthLargest(CompactTree t, Index curr, int k, int *count)
+{
+	if (curr == NIL)
+		return NIL;
+
+	Index right = NodeKthLargest(t, t->pool[curr].right, k, count);
+	if (right != NIL)
+		return right;
+
+	(*count)++;
+	if (*count == k)
+		return curr;
+
+	return NodeKthLargest(t, t->pool[curr].left, k, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the least common ancestor of two keys, a and b.
+ */
+int CompactTreeLCA(CompactTree t, int a, int b)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	if (!CompactTreeSearch(t, a) || !CompactTreeSearch(t, b))
+		return UNDEFINED;
+
+	// Walk down while a and b are on the same side of the node
+	Index curr = t->root;
+	while (curr != NIL)
+	{
+		int k = t->pool[curr].key;
+		if (a < k && b < k)
+			curr = t->pool[curr].left;
+		else if (a > k && b > k)
+			curr = t->pool[curr].right;
+		else
+			return k;
+	}
+
+	return UNDEFINED;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ */
+int CompactTreeFloor(CompactTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	// The last node we turned right at is the best floor so far
+	int floor = UNDEFINED;
+	Index curr = t->root;
+	while (curr != NIL)
+	{
+		int k = t->pool[curr].key;
+		if (k == key)
+			return k;
+
+		if (k > key)
+		{
+			curr = t->pool[curr].left;
+		}
+		else
+		{
+			floor = k;
+			curr = t->pool[curr].right;
+		}
+	}
+
+	return floor;
+}
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ */
+int CompactTreeCeiling(CompactTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	int ceiling = UNDEFINED;
+	Index curr = t->root;
+	while (curr != NIL)
+	{
+		int k = t->pool[curr].key;
+		if (k == key)
+			return k;
+
+		if (k < key)
+		{
+			curr = t->pool[curr].right;
+		}
+		else
+		{
+			ceiling = k;
+			curr = t->pool[curr].left;
+		}
+	}
+
+	return ceiling;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in a list in ascending order.
+ */
+List CompactTreeSearchBetween(CompactTree t, int lower, int upper)
+{
+	List l = ListNew();
+
+	if (t == NULL)
+		return l;
+
+	if (lower > upper)
+		return l;
+
+	if (lower == UNDEFINED || upper == UNDEFINED)
+		return l;
+
+	NodeSearchBetween(t, t->root, lower, upper, l);
+	return l;
+}
+
+static void NodeSearchBetween(CompactTree t, Index curr, int lower, int upper, List l)
+{
+	if (curr == NIL)
+		return;
+
+	int k = t->pool[curr].key;
+
+	if (lower < k)
+		NodeSearchBetween(t, t->pool[curr].left, lower, upper, l);
+	if (lower <= k && k <= upper)
+		ListAppend(l, k);
+	if (upper > k)
+		NodeSearchBetween(t, t->pool[curr].right, lower, upper, l);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Returns the height of the given node.
+ * NIL is -1
+ */
+static int Height(CompactTree t, Index n)
+{
+	if (n == NIL)
+		return -1;
+	return t->pool[n].height;
+}
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
@@ -0,0 +1,131 @@
+// Operations on Compact Balanced Binary Search Trees.
+// An AVL tree whose nodes live in a single growable pool and link to
+// each other with 32-bit indices instead of pointers. The height is
+// packed into a byte, so a node is 16 bytes instead of the 32 bytes
+// (48 once malloc'd) of struct node.
+//
+// A 12 byte layout with the height in the top bits of an index was
+// tried and is slower than the pointer tree: one node in eight then
+// straddles a cache line, so 16 bytes keeps every node in one line.
+
+#ifndef COMPACT_TREE_H
+#define COMPACT_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bBST.h"
+#include "List.h"
+
+// Index 0 is reserved as the null child
+#define COMPACT_MAX_NODES UINT32_MAX
+
+typedef struct compactTree *CompactTree;
+
+struct compactNode
+{
+	int key;
+	uint32_t left;
+	uint32_t right;
+	uint8_t height;
+	uint8_t spare[3];
+};
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of nodes in the
+// tree, unless otherwise specified.
+
+/**
+ * Creates a new empty tree.
+ * The time complexity of this function is O(1).
+ */
+CompactTree CompactTreeNew(void);
+
+/**
+ * Frees all memory allocated for the given tree.
+ * The time complexity of this function is O(1).
+ */
+void CompactTreeFree(CompactTree t);
+
+/**
+ * Returns the number of bytes allocated for the given tree, including
+ * unused capacity in the node pool.
+ * The time complexity of this function is O(1).
+ */
+size_t CompactTreeMemory(CompactTree t);
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ * The time complexity of this function is O(log n).
+ */
+bool CompactTreeSearch(CompactTree t, int key);
+
+/**
+ * Inserts the given key into the tree.
+ * Returns true if the key was inserted successfully, or false if the
+ * key was already present in the tree.
+ * The time complexity of this function is amortised O(log n).
+ */
+bool CompactTreeInsert(CompactTree t, int key);
+
+/**
+ * Deletes the given key from the tree if it is present.
+ * Returns true if the key was deleted successfully, or false if the key
+ * was not present in the tree.
+ * The time complexity of this function is O(log n).
+ */
+bool CompactTreeDelete(CompactTree t, int key);
+
+/**
+ * Creates a list containing all the keys in the given tree in ascending
+ * order.
+ * The time complexity of this function is O(n).
+ */
+List CompactTreeToList(CompactTree t);
+
+/**
+ * Returns the k-th smallest key in the tree.
+ * Returns UNDEFINED if k is not between 1 and the number of nodes.
+ * The time complexity of this function is O(log n + k).
+ */
+int CompactTreeKthSmallest(CompactTree t, int k);
+
+/**
+ * Returns the k-th largest key in the tree.
+ * Returns UNDEFINED if k is not between 1 and the number of nodes.
+ * The time complexity of this function is O(log n + k).
+ */
+int CompactTreeKthLargest(CompactTree t, int k);
+
+/**
+ * Returns the least common ancestor of two keys, a and b.
+ * Returns UNDEFINED if either a or b are not present in the tree.
+ * The time complexity of this function is O(log n).
+ */
+int CompactTreeLCA(CompactTree t, int a, int b);
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int CompactTreeFloor(CompactTree t, int key);
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int CompactTreeCeiling(CompactTree t, int key);
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in order in a list.
+ * The time complexity of this function is O(log n + m), where m is the
+ * length of the returned list.
+ */
+List CompactTreeSearchBetween(CompactTree t, int lower, int upper);
+
+#endif
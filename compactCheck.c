@@ -0,0 +1,404 @@
+// Differential checker for Compact Balanced Binary Search Trees.
+// Runs random inserts and deletes through a CompactTree and a Tree from
+// bBST.h with the same keys, and compares every answer: the return of
+// each update, and after every batch the search, floor and ceiling of
+// probes, k-th smallest and largest keys, LCAs, and the Lists of ToList
+// and SearchBetween, read back with ListCapture.
+//
+// Keys include the ends of int and UNDEFINED itself. A second pass
+// churns a tree of fixed size through deletes and inserts and checks,
+// from CompactTreeMemory, that freed nodes are reused before the pool
+// grows, with the queries compared after every round.
+//
+// Usage: ./compactCheck [-o operations] [-s seed]
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "compactBST.h"
+#include "List.h"
+#include "listCapture.h"
+
+#define DEFAULT_OPS 100000
+// Operations between two full comparisons
+#define BATCH 2000
+// Keys are drawn from [-KEYSPACE, KEYSPACE), plus the ends of int
+#define KEYSPACE 4096
+#define REUSE_KEYS 20000
+#define REUSE_ROUNDS 8
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkRandom(int ops, unsigned int seed);
+static bool checkReuse(unsigned int seed);
+static bool checkUpdate(CompactTree ct, Tree t, int key, bool insert);
+static bool checkQueries(CompactTree ct, Tree t, unsigned int *state);
+static bool checkKth(CompactTree ct, int *keys, int size, int k);
+static bool checkLists(const char *what, List got, List want);
+static int randomKey(unsigned int *state);
+static int randomProbe(unsigned int *state);
+static int Silence(void);
+static void Restore(int saved);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkRandom(ops, seed);
+	failures += !checkReuse(seed);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Random inserts and deletes, growing and shrinking the tree in turns,
+ * with every query compared after each batch
+ */
+static bool checkRandom(int ops, unsigned int seed)
+{
+	CompactTree ct = CompactTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int insertPct = (i / (4 * BATCH) % 2 == 0) ? 65 : 35;
+		int key = randomKey(&state);
+		ok = checkUpdate(ct, t, key, (int)(NextRandom(&state) % 100) < insertPct);
+
+		if (ok && i % BATCH == BATCH - 1)
+			ok = checkQueries(ct, t, &state);
+	}
+
+	if (ok)
+		ok = checkQueries(ct, t, &state);
+
+	printf("%s random operations  %d operations\n", ok ? "PASS" : "FAIL", ops);
+	CompactTreeFree(ct);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Fill a tree, then in each round delete half of its keys at random and
+ * insert as many new ones. Every new node fits in a slot freed by the
+ * deletes, so the pool never grows past its size after the fill.
+ */
+static bool checkReuse(unsigned int seed)
+{
+	CompactTree ct = CompactTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	int *keys = malloc(REUSE_KEYS * sizeof(int));
+	if (keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Keys in the tree, and the next key above all of them. Keys are at
+	// least 2 apart there, so one past a kept key is never next.
+	int next = 0;
+	for (int i = 0; i < REUSE_KEYS && ok; i++)
+	{
+		keys[i] = next;
+		next += 2 + (int)(NextRandom(&state) % 8);
+		ok = checkUpdate(ct, t, keys[i], true);
+	}
+
+	size_t filled = CompactTreeMemory(ct);
+
+	for (int round = 0; round < REUSE_ROUNDS && ok; round++)
+	{
+		for (int i = REUSE_KEYS - 1; i > 0; i--)
+		{
+			int j = (int)(NextRandom(&state) % (unsigned int)(i + 1));
+			int tmp = keys[i];
+			keys[i] = keys[j];
+			keys[j] = tmp;
+		}
+
+		for (int i = 0; i < REUSE_KEYS / 2 && ok; i++)
+			ok = checkUpdate(ct, t, keys[i], false);
+
+		// Fresh keys go next to the kept ones or above all of them
+		for (int i = 0; i < REUSE_KEYS / 2 && ok; i++)
+		{
+			int fresh = keys[REUSE_KEYS / 2 + i] + 1;
+			if ((NextRandom(&state) & 1) || TreeSearch(t, fresh))
+			{
+				fresh = next;
+				next += 2;
+			}
+			keys[i] = fresh;
+			ok = checkUpdate(ct, t, fresh, true);
+		}
+
+		if (ok && CompactTreeMemory(ct) != filled)
+		{
+			printf("FAIL round %d: the tree takes %zu bytes, %zu after the fill\n", round,
+				   CompactTreeMemory(ct), filled);
+			ok = false;
+		}
+
+		ok = ok && checkQueries(ct, t, &state);
+	}
+
+	printf("%s node reuse         %d rounds of %d deletes and inserts, %zu bytes\n",
+		   ok ? "PASS" : "FAIL", REUSE_ROUNDS, REUSE_KEYS / 2, CompactTreeMemory(ct));
+	free(keys);
+	CompactTreeFree(ct);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Insert or delete a key in both trees and compare what they return.
+ * The trees complain about duplicates and missing keys on stderr, which
+ * is silenced for the updates that are expected to be refused.
+ */
+static bool checkUpdate(CompactTree ct, Tree t, int key, bool insert)
+{
+	bool refused = (key == UNDEFINED) || (TreeSearch(t, key) == insert);
+	int saved = refused ? Silence() : -1;
+
+	bool got = insert ? CompactTreeInsert(ct, key) : CompactTreeDelete(ct, key);
+	bool want = insert ? TreeInsert(t, key) : TreeDelete(t, key);
+
+	if (refused)
+		Restore(saved);
+
+	if (got != want)
+	{
+		printf("FAIL %s %d returned %d, expected %d\n", insert ? "insert" : "delete", key, got,
+			   want);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare every query on random probes, the ends of k and a sample of k
+ * in between, LCAs of keys in the tree and random ranges. The k-th keys
+ * are compared with the keys of TreeToList.
+ */
+static bool checkQueries(CompactTree ct, Tree t, unsigned int *state)
+{
+	List got = CompactTreeToList(ct);
+	List want = TreeToList(t);
+	int *keys;
+	int size = ListCapture(want, &keys);
+	bool ok = checkLists("to list", got, want);
+	ListFree(got);
+	ListFree(want);
+
+	for (int i = 0; i < 64 && ok; i++)
+	{
+		int key = randomProbe(state);
+		if (CompactTreeSearch(ct, key) != TreeSearch(t, key) ||
+			CompactTreeFloor(ct, key) != TreeFloor(t, key) ||
+			CompactTreeCeiling(ct, key) != TreeCeiling(t, key))
+		{
+			printf("FAIL probe %d: search %d, floor %d, ceiling %d; expected %d, %d, %d\n", key,
+				   CompactTreeSearch(ct, key), CompactTreeFloor(ct, key),
+				   CompactTreeCeiling(ct, key), TreeSearch(t, key), TreeFloor(t, key),
+				   TreeCeiling(t, key));
+			ok = false;
+		}
+	}
+
+	// The k-th walks are in order, so only the ends and a sample
+	for (int k = -1; k <= 2 && ok; k++)
+		ok = checkKth(ct, keys, size, k) && checkKth(ct, keys, size, size - k + 1);
+	for (int i = 0; i < 32 && ok && size > 0; i++)
+		ok = checkKth(ct, keys, size, 1 + (int)(NextRandom(state) % (unsigned int)size));
+
+	for (int i = 0; i < 32 && ok; i++)
+	{
+		// Mostly keys of the tree, which have an LCA, otherwise probes
+		int a = (size > 0 && i % 4 != 0) ? keys[NextRandom(state) % size] : randomProbe(state);
+		int b = (size > 0 && i % 8 != 0) ? keys[NextRandom(state) % size] : randomProbe(state);
+		if (CompactTreeLCA(ct, a, b) != TreeLCA(t, a, b))
+		{
+			printf("FAIL lca of %d and %d is %d, expected %d\n", a, b, CompactTreeLCA(ct, a, b),
+				   TreeLCA(t, a, b));
+			ok = false;
+		}
+	}
+	free(keys);
+
+	for (int i = 0; i < 16 && ok; i++)
+	{
+		int lower = randomProbe(state);
+		int upper = randomProbe(state);
+		// Ordered three times in four, inverted ranges are empty
+		if (NextRandom(state) % 4 != 0 && lower > upper)
+		{
+			int tmp = lower;
+			lower = upper;
+			upper = tmp;
+		}
+
+		got = CompactTreeSearchBetween(ct, lower, upper);
+		want = TreeSearchBetween(t, lower, upper);
+		ok = checkLists("search between", got, want);
+		if (!ok)
+			printf("     range [%d, %d]\n", lower, upper);
+		ListFree(got);
+		ListFree(want);
+	}
+
+	return ok;
+}
+
+/**
+ * Compare the k-th smallest and largest keys with the sorted keys
+ */
+static bool checkKth(CompactTree ct, int *keys, int size, int k)
+{
+	bool inRange = k >= 1 && k <= size;
+	int smallest = inRange ? keys[k - 1] : UNDEFINED;
+	int largest = inRange ? keys[size - k] : UNDEFINED;
+
+	if (CompactTreeKthSmallest(ct, k) == smallest && CompactTreeKthLargest(ct, k) == largest)
+		return true;
+
+	printf("FAIL k = %d: smallest %d, largest %d; expected %d, %d\n", k,
+		   CompactTreeKthSmallest(ct, k), CompactTreeKthLargest(ct, k), smallest, largest);
+	return false;
+}
+
+/**
+ * Compare two Lists value by value
+ */
+static bool checkLists(const char *what, List got, List want)
+{
+	int *gotKeys, *wantKeys;
+	int gotSize = ListCapture(got, &gotKeys);
+	int wantSize = ListCapture(want, &wantKeys);
+
+	bool ok = gotSize >= 0 && gotSize == wantSize;
+	int i = 0;
+	while (ok && i < gotSize && gotKeys[i] == wantKeys[i])
+		i++;
+	ok = ok && i == gotSize;
+
+	if (!ok)
+		printf("FAIL %s returned %d keys, expected %d, first difference at %d\n", what, gotSize,
+			   wantSize, i);
+
+	free(gotKeys);
+	free(wantKeys);
+	return ok;
+}
+
+/**
+ * A key from the keyspace, or now and then one of the ends of int or
+ * UNDEFINED itself
+ */
+static int randomKey(unsigned int *state)
+{
+	switch (NextRandom(state) % 64)
+	{
+	case 0:
+		return INT_MAX;
+	case 1:
+		return INT_MIN + 1;
+	case 2:
+		return UNDEFINED;
+	default:
+		return (int)(NextRandom(state) % (2 * KEYSPACE)) - KEYSPACE;
+	}
+}
+
+/**
+ * A key or a value next to one, including the ends of int
+ */
+static int randomProbe(unsigned int *state)
+{
+	switch (NextRandom(state) % 8)
+	{
+	case 0:
+		return INT_MAX - (int)(NextRandom(state) % 2);
+	case 1:
+		return INT_MIN + (int)(NextRandom(state) % 3);
+	default:
+		return (int)(NextRandom(state) % (2 * KEYSPACE + 20)) - KEYSPACE - 10;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Silence(void)
+{
+	fflush(stderr);
+	int saved = dup(STDERR_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0)
+	{
+		dup2(devNull, STDERR_FILENO);
+		close(devNull);
+	}
+	return saved;
+}
+
+static void Restore(int saved)
+{
+	if (saved < 0)
+		return;
+
+	fflush(stderr);
+	dup2(saved, STDERR_FILENO);
+	close(saved);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,376 @@
+// Empirical complexity verifier for Balanced Binary Search Trees.
+// Runs each tree operation at geometrically growing n (and k or m for
+// the operations whose bound depends on them), counts the nodes visited
+// through the bBSTStats.h counters, fits the growth curve and fails if
+// the measured growth breaks the bound documented in bBST.h and
+// analysis.txt.
+//
+// For each sweep the points are fitted twice: a power law
+// visits = c * x^e on a log-log scale, whose exponent e is what is
+// checked, and the documented bound visits = a + b * f(x), which is
+// reported so the constant factors can be compared between runs.
+// An O(log n) operation over n = 2^10..2^18 has e around 0.1, so a
+// limit of 0.3 catches anything growing like n^0.3 or faster, and an
+// O(k) or O(m) sweep must stay below e = 1.15.
+//
+// Usage: ./complexityCheck [-n max log2 n] [-q queries] [-s seed] [-v]
+// Must be built with -DBBST_STATS.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bBST.h"
+#include "bBSTStats.h"
+#include "List.h"
+
+#define MIN_LOG_N 10
+#define DEFAULT_MAX_LOG_N 18
+#define DEFAULT_QUERIES 2000
+#define MAX_POINTS 32
+
+#define LOG_LIMIT 0.3
+#define LINEAR_LIMIT 1.15
+
+typedef enum bound
+{
+	BOUND_LOG,
+	BOUND_LINEAR,
+} Bound;
+
+typedef enum op
+{
+	OP_SEARCH,
+	OP_INSERT,
+	OP_DELETE,
+	OP_KTH_SMALLEST,
+	OP_KTH_LARGEST,
+	OP_LCA,
+	OP_FLOOR,
+	OP_CEILING,
+	OP_SEARCH_BETWEEN,
+	NUM_OPS,
+} Op;
+
+static const char *OpNames[NUM_OPS] = {
+	"TreeSearch", "TreeInsert", "TreeDelete", "TreeKthSmallest",
+	"TreeKthLargest", "TreeLCA", "TreeFloor", "TreeCeiling",
+	"TreeSearchBetween"};
+
+// The tree being measured and the keys in it
+typedef struct subject
+{
+	Tree t;
+	// Keys in the tree, in the order they were inserted
+	int *keys;
+	// The same keys sorted
+	int *sorted;
+	int size;
+} Subject;
+
+typedef struct sweep
+{
+	double x[MAX_POINTS];
+	double visits[MAX_POINTS];
+	int points;
+} Sweep;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void Grow(Subject *s, int *all, int size);
+static double Measure(Subject *s, Op op, int x, int queries, unsigned int *state);
+static bool Check(const char *op, const char *variable, Sweep *sw, Bound bound, bool verbose);
+static double FitExponent(Sweep *sw);
+static void FitBound(Sweep *sw, Bound bound, double *a, double *b);
+static unsigned long Visits(void);
+static int orderIncreasing(const void *a, const void *b);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int maxLog = DEFAULT_MAX_LOG_N;
+	int queries = DEFAULT_QUERIES;
+	unsigned int seed = 1;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-v") == 0)
+			verbose = true;
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			maxLog = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+			queries = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-n max log2 n] [-q queries] [-s seed] [-v]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!TreeStatsEnabled())
+	{
+		fprintf(stderr, "bBST.c was built without -DBBST_STATS\n");
+		return EXIT_FAILURE;
+	}
+
+	if (maxLog < MIN_LOG_N + 2 || maxLog > 24 || queries < 1)
+	{
+		fprintf(stderr, "Need %d <= max log2 n <= 24 and at least 1 query\n", MIN_LOG_N + 2);
+		return EXIT_FAILURE;
+	}
+
+	unsigned int state = (seed == 0) ? 1 : seed;
+	int maxN = 1 << maxLog;
+
+	// Every key the tree will hold, even so that odd keys are misses
+	int *all = malloc(maxN * sizeof(int));
+	if (all == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < maxN; i++)
+		all[i] = 2 * i;
+	for (int i = maxN - 1; i > 0; i--)
+	{
+		int j = NextRandom(&state) % (i + 1);
+		int tmp = all[i];
+		all[i] = all[j];
+		all[j] = tmp;
+	}
+
+	Subject s = {TreeNew(), all, malloc(maxN * sizeof(int)), 0};
+	if (s.sorted == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Sweep n with k = 1 and m = 8
+	Sweep byN[NUM_OPS];
+	memset(byN, 0, sizeof(byN));
+	for (int lg = MIN_LOG_N; lg <= maxLog; lg++)
+	{
+		Grow(&s, all, 1 << lg);
+		for (Op op = 0; op < NUM_OPS; op++)
+		{
+			int x = (op == OP_SEARCH_BETWEEN) ? 8 : 1;
+			Sweep *sw = &byN[op];
+			sw->x[sw->points] = s.size;
+			sw->visits[sw->points] = Measure(&s, op, x, queries, &state);
+			sw->points++;
+		}
+	}
+
+	// Sweep k and m on the largest tree. Long walks vary little between
+	// queries, so fewer of them are needed
+	int walks = queries / 16 + 1;
+	Sweep byK[2] = {0};
+	Sweep byM = {0};
+	for (int x = 1; x <= maxN / 8; x *= 2)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			byK[i].x[byK[i].points] = x;
+			byK[i].visits[byK[i].points++] =
+				Measure(&s, OP_KTH_SMALLEST + i, x, walks, &state);
+		}
+
+		byM.x[byM.points] = x;
+		byM.visits[byM.points++] = Measure(&s, OP_SEARCH_BETWEEN, x, walks, &state);
+	}
+
+	printf("%-18s %-3s %8s %8s %8s %9s %9s  %s\n",
+		   "operation", "var", "exponent", "limit", "bound", "a", "b", "result");
+
+	bool ok = true;
+	for (Op op = 0; op < NUM_OPS; op++)
+		ok &= Check(OpNames[op], "n", &byN[op], BOUND_LOG, verbose);
+	ok &= Check(OpNames[OP_KTH_SMALLEST], "k", &byK[0], BOUND_LINEAR, verbose);
+	ok &= Check(OpNames[OP_KTH_LARGEST], "k", &byK[1], BOUND_LINEAR, verbose);
+	ok &= Check(OpNames[OP_SEARCH_BETWEEN], "m", &byM, BOUND_LINEAR, verbose);
+
+	printf("%s\n", ok ? "All bounds hold." : "Some bounds are broken.");
+
+	TreeFree(s.t);
+	free(s.sorted);
+	free(all);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Insert keys until the tree holds the first size keys of all
+ */
+static void Grow(Subject *s, int *all, int size)
+{
+	while (s->size < size)
+		TreeInsert(s->t, all[s->size++]);
+
+	memcpy(s->sorted, s->keys, s->size * sizeof(int));
+	qsort(s->sorted, s->size, sizeof(int), orderIncreasing);
+}
+
+/**
+ * Average number of nodes visited by one call of an operation.
+ * x is k for the k-th queries and m (the number of keys returned) for
+ * TreeSearchBetween, and is ignored otherwise.
+ */
+static double Measure(Subject *s, Op op, int x, int queries, unsigned int *state)
+{
+	unsigned long total = 0;
+
+	for (int q = 0; q < queries; q++)
+	{
+		int i = NextRandom(state) % s->size;
+		int key = s->keys[i];
+		// Half of the point queries miss
+		int probe = key + (int)(NextRandom(state) & 1);
+		List l;
+
+		TreeStatsReset();
+		switch (op)
+		{
+		case OP_SEARCH:
+			TreeSearch(s->t, probe);
+			break;
+		case OP_INSERT:
+			TreeInsert(s->t, key + 1);
+			total += Visits();
+			TreeDelete(s->t, key + 1);
+			continue;
+		case OP_DELETE:
+			TreeDelete(s->t, key);
+			total += Visits();
+			TreeInsert(s->t, key);
+			continue;
+		case OP_KTH_SMALLEST:
+			TreeKthSmallest(s->t, x);
+			break;
+		case OP_KTH_LARGEST:
+			TreeKthLargest(s->t, x);
+			break;
+		case OP_LCA:
+			TreeLCA(s->t, key, s->keys[NextRandom(state) % s->size]);
+			break;
+		case OP_FLOOR:
+			TreeFloor(s->t, probe);
+			break;
+		case OP_CEILING:
+			TreeCeiling(s->t, probe);
+			break;
+		default:
+			// A range holding exactly x keys
+			i = NextRandom(state) % (s->size - x + 1);
+			l = TreeSearchBetween(s->t, s->sorted[i], s->sorted[i + x - 1]);
+			ListFree(l);
+			break;
+		}
+		total += Visits();
+	}
+
+	return (double)total / queries;
+}
+
+/**
+ * Fit a sweep, print a line for it and return whether it is in bound
+ */
+static bool Check(const char *op, const char *variable, Sweep *sw, Bound bound, bool verbose)
+{
+	double exponent = FitExponent(sw);
+	double limit = (bound == BOUND_LOG) ? LOG_LIMIT : LINEAR_LIMIT;
+	bool ok = exponent <= limit;
+	double a, b;
+	FitBound(sw, bound, &a, &b);
+
+	printf("%-18s %-3s %8.3f %8.2f %8s %9.2f %9.3f  %s\n",
+		   op, variable, exponent, limit,
+		   (bound == BOUND_LOG) ? "log n" : variable, a, b, ok ? "ok" : "FAIL");
+
+	if (verbose || !ok)
+	{
+		for (int i = 0; i < sw->points; i++)
+			printf("    %s = %-9.0f visits %.2f\n", variable, sw->x[i], sw->visits[i]);
+	}
+
+	return ok;
+}
+
+/**
+ * Least squares exponent e of visits = c * x^e
+ */
+static double FitExponent(Sweep *sw)
+{
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	int n = sw->points;
+
+	for (int i = 0; i < n; i++)
+	{
+		double x = log(sw->x[i]);
+		double y = log(fmax(sw->visits[i], 1));
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+
+	return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+/**
+ * Least squares fit of visits = a + b * f(x), where f is the bound
+ */
+static void FitBound(Sweep *sw, Bound bound, double *a, double *b)
+{
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	int n = sw->points;
+
+	for (int i = 0; i < n; i++)
+	{
+		double x = (bound == BOUND_LOG) ? log2(sw->x[i]) : sw->x[i];
+		double y = sw->visits[i];
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+
+	*b = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+	*a = (sy - *b * sx) / n;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static unsigned long Visits(void)
+{
+	TreeStats stats;
+	TreeStatsGet(&stats);
+	return stats.visits;
+}
+
+static int orderIncreasing(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
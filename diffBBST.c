@@ -0,0 +1,219 @@
+// Benchmark for AugTreeDiff (augBST.h), the hash guided comparison of
+// two keysets. Builds two trees of -n random keys inserted in different
+// orders, so they have different shapes, then makes d of the keys differ
+// between them, half taken out of the second tree and half added to it,
+// for d = 0, 1, 10, ... up to -d. For each d it reports the time
+// AugTreeDiff takes next to the time of listing both trees, which a
+// comparison of TreeToList results pays before it compares anything,
+// and checks that the differences found are the ones made.
+//
+// Usage: ./diffBBST [-n keys] [-d max differences] [-k keyspace]
+//                   [-x seed] [-v]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "augBST.h"
+#include "bBST.h"
+#include "List.h"
+
+#define DEFAULT_KEYS 100000
+// ListFree recurses once per key, larger lists overflow the stack
+#define MAX_KEYS 200000
+#define DEFAULT_MAX_DIFFERENCES 100000
+#define DEFAULT_KEYSPACE (1 << 30)
+// Runs of each measurement, the fastest is reported
+#define REPEATS 5
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool Compare(AugTree a, AugTree b, int d, bool verbose);
+static void Shuffle(int *keys, int n, unsigned int *state);
+static int RandomKey(int keyspace, unsigned int *state);
+static unsigned int NextRandom(unsigned int *state);
+static double Now(void);
+static void PrintUsage(const char *name);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int n = DEFAULT_KEYS;
+	int maxDifferences = DEFAULT_MAX_DIFFERENCES;
+	int keyspace = DEFAULT_KEYSPACE;
+	unsigned int state = 1;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			n = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			maxDifferences = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+			keyspace = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc)
+			state = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-v") == 0)
+			verbose = true;
+		else
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Twice the keys, the second half to add to b
+	if (n < 1 || n > MAX_KEYS || maxDifferences < 0 || maxDifferences > n || keyspace / 4 < n)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Duplicates are drawn and skipped, the tree would print them
+	int *keys = malloc(sizeof(int) * 2 * n);
+	if (keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	AugTree a = AugTreeNew();
+	for (int i = 0; i < 2 * n;)
+	{
+		int key = RandomKey(keyspace, &state);
+		if (AugTreeSearch(a, key))
+			continue;
+		AugTreeInsert(a, key);
+		keys[i++] = key;
+	}
+	for (int i = n; i < 2 * n; i++)
+		AugTreeDelete(a, keys[i]);
+
+	Shuffle(keys, n, &state);
+	AugTree b = AugTreeNew();
+	for (int i = 0; i < n; i++)
+		AugTreeInsert(b, keys[i]);
+
+	printf("%d keys, hashes %s\n", n, AugTreeHash(a) == AugTreeHash(b) ? "equal" : "DIFFER");
+
+	bool ok = Compare(a, b, 0, verbose);
+	int made = 0;
+	for (int d = 1; d <= maxDifferences; d *= 10)
+	{
+		// Take out keys[0..] and add keys[n..] until d keys differ
+		for (; made < d; made++)
+		{
+			if (made % 2 == 0)
+				AugTreeDelete(b, keys[made / 2]);
+			else
+				AugTreeInsert(b, keys[n + made / 2]);
+		}
+		ok = Compare(a, b, d, verbose) && ok;
+	}
+
+	AugTreeFree(a);
+	AugTreeFree(b);
+	free(keys);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Time a diff of the two trees against listing them, and check that it
+ * finds the d differences made
+ */
+static bool Compare(AugTree a, AugTree b, int d, bool verbose)
+{
+	double diffTime = 1e9;
+	double listTime = 1e9;
+	int found = 0;
+
+	for (int r = 0; r < REPEATS; r++)
+	{
+		double start = Now();
+		found = AugTreeDiff(a, b, NULL, NULL);
+		double mid = Now();
+		List la = AugTreeToList(a);
+		List lb = AugTreeToList(b);
+		double end = Now();
+		ListFree(la);
+		ListFree(lb);
+
+		if (mid - start < diffTime)
+			diffTime = mid - start;
+		if (end - mid < listTime)
+			listTime = end - mid;
+	}
+
+	int reverse = AugTreeDiff(b, a, NULL, NULL);
+	bool ok = (found == d && reverse == d);
+	printf("d %7d: diff %10.1f us, list both %10.1f us, found %d%s\n", d, diffTime * 1e6,
+		   listTime * 1e6, found, ok ? "" : " MISMATCH");
+
+	if (verbose && d > 0)
+	{
+		List onlyA = ListNew();
+		List onlyB = ListNew();
+		AugTreeDiff(a, b, onlyA, onlyB);
+		printf("only in a: ");
+		ListShow(onlyA);
+		printf("\nonly in b: ");
+		ListShow(onlyB);
+		printf("\n");
+		ListFree(onlyA);
+		ListFree(onlyB);
+	}
+
+	return ok;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static void Shuffle(int *keys, int n, unsigned int *state)
+{
+	for (int i = n - 1; i > 0; i--)
+	{
+		int j = NextRandom(state) % (i + 1);
+		int temp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = temp;
+	}
+}
+
+static int RandomKey(int keyspace, unsigned int *state)
+{
+	return (int)(((unsigned long)NextRandom(state) << 16 ^ NextRandom(state)) % keyspace);
+}
+
+/**
+ * xorshift32, seeded by -x so that runs can be repeated
+ */
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static double Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-n keys (up to %d)] [-d max differences (up to n)]\n"
+					"       [-k keyspace (at least 4n)] [-x seed] [-v]\n",
+			name, MAX_KEYS);
+}
@@ -0,0 +1,365 @@
+// Side by side comparison of the tree engines.
+// Builds the same random keyset in every engine and reports the memory
+// used per key and the lookup, floor and write throughput. A write is
+// half of a delete and reinsert of a key, so the size stays at n.
+//
+// Usage: ./engineBench [n] [lookups] [seed] [spread] [writes]
+//
+// Keys are multiples of spread (default 2). A large spread gives a
+// sparse keyset, which is the worst case for the bitmap engines.
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "adaptiveBST.h"
+#include "bBST.h"
+#include "bBST64.h"
+#include "bucketBST.h"
+#include "compactBST.h"
+#include "roaringSet.h"
+#include "vebTree.h"
+
+#define DEFAULT_N 1000000
+#define DEFAULT_LOOKUPS 5000000
+// A sorted array moves half of itself on every write, so far fewer
+#define DEFAULT_WRITES 100000
+
+typedef struct engine
+{
+	char *name;
+	void *(*new)(void);
+	void (*free)(void *);
+	bool (*insert)(void *, int);
+	bool (*delete)(void *, int);
+	bool (*search)(void *, int);
+	int (*floor)(void *, int);
+	// Loads the whole keyset at once, for engines too slow to fill one
+	// key at a time. NULL to use insert
+	int (*build)(void *, int *, int);
+} Engine;
+
+static void *PointerNew(void) { return TreeNew(); }
+static void PointerFree(void *t) { TreeFree(t); }
+static bool PointerInsert(void *t, int key) { return TreeInsert(t, key); }
+static bool PointerDelete(void *t, int key) { return TreeDelete(t, key); }
+static bool PointerSearch(void *t, int key) { return TreeSearch(t, key); }
+static int PointerFloor(void *t, int key) { return TreeFloor(t, key); }
+
+static void *Wide64New(void) { return Tree64New(); }
+static void Wide64Free(void *t) { Tree64Free(t); }
+static bool Wide64Insert(void *t, int key) { return Tree64Insert(t, key); }
+static bool Wide64Delete(void *t, int key) { return Tree64Delete(t, key); }
+static bool Wide64Search(void *t, int key) { return Tree64Search(t, key); }
+static int Wide64Floor(void *t, int key)
+{
+	int64_t floor;
+	return Tree64Floor(t, key, &floor) ? (int)floor : UNDEFINED;
+}
+
+static void *CompactNew(void) { return CompactTreeNew(); }
+static void CompactFree(void *t) { CompactTreeFree(t); }
+static bool CompactInsert(void *t, int key) { return CompactTreeInsert(t, key); }
+static bool CompactDelete(void *t, int key) { return CompactTreeDelete(t, key); }
+static bool CompactSearch(void *t, int key) { return CompactTreeSearch(t, key); }
+static int CompactFloor(void *t, int key) { return CompactTreeFloor(t, key); }
+
+static void *BucketNew(void) { return BucketTreeNew(); }
+static void BucketFree(void *t) { BucketTreeFree(t); }
+static bool BucketInsert(void *t, int key) { return BucketTreeInsert(t, key); }
+static bool BucketDelete(void *t, int key) { return BucketTreeDelete(t, key); }
+static bool BucketSearch(void *t, int key) { return BucketTreeSearch(t, key); }
+static int BucketFloor(void *t, int key) { return BucketTreeFloor(t, key); }
+
+static void *RoaringNew(void) { return RoaringSetNew(); }
+static void RoaringFree(void *t) { RoaringSetFree(t); }
+static bool RoaringInsert(void *t, int key) { return RoaringSetInsert(t, key); }
+static bool RoaringDelete(void *t, int key) { return RoaringSetDelete(t, key); }
+static bool RoaringSearch(void *t, int key) { return RoaringSetSearch(t, key); }
+static int RoaringFloor(void *t, int key) { return RoaringSetFloor(t, key); }
+
+static void *VebNew(void) { return VebTreeNew(); }
+static void VebFree(void *t) { VebTreeFree(t); }
+static bool VebInsert(void *t, int key) { return VebTreeInsert(t, key); }
+static bool VebDelete(void *t, int key) { return VebTreeDelete(t, key); }
+static bool VebSearch(void *t, int key) { return VebTreeSearch(t, key); }
+static int VebFloor(void *t, int key) { return VebTreeFloor(t, key); }
+
+static void *AdaptiveNew(void)
+{
+	AdaptiveTree t = AdaptiveTreeNew();
+	AdaptiveTreeSetLog(t, NULL);
+	return t;
+}
+static void AdaptiveFree(void *t) { AdaptiveTreeFree(t); }
+static bool AdaptiveInsert(void *t, int key) { return AdaptiveTreeInsert(t, key); }
+static bool AdaptiveDelete(void *t, int key) { return AdaptiveTreeDelete(t, key); }
+static bool AdaptiveSearch(void *t, int key) { return AdaptiveTreeSearch(t, key); }
+static int AdaptiveFloor(void *t, int key) { return AdaptiveTreeFloor(t, key); }
+
+// A plain sorted array searched by bisection, the layout of the
+// adaptive tree's snapshot engine
+typedef struct sorted
+{
+	int *keys;
+	int size;
+	int capacity;
+} *Sorted;
+
+static void *SortedNew(void)
+{
+	Sorted s = calloc(1, sizeof(*s));
+	if (s == NULL)
+	{
+		fprintf(stderr, "Could not malloc Sorted\n");
+		exit(EXIT_FAILURE);
+	}
+	return s;
+}
+static void SortedFree(void *t)
+{
+	free(((Sorted)t)->keys);
+	free(t);
+}
+static int SortedRank(Sorted s, int key)
+{
+	int lo = 0;
+	int hi = s->size;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		if (s->keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+static bool SortedInsert(void *t, int key)
+{
+	Sorted s = t;
+	int i = SortedRank(s, key);
+	if (i < s->size && s->keys[i] == key)
+		return false;
+
+	if (s->size == s->capacity)
+	{
+		s->capacity = (s->capacity == 0) ? 16 : 2 * s->capacity;
+		s->keys = realloc(s->keys, sizeof(int) * s->capacity);
+		if (s->keys == NULL)
+		{
+			fprintf(stderr, "Could not realloc Sorted\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memmove(&s->keys[i + 1], &s->keys[i], sizeof(int) * (s->size - i));
+	s->keys[i] = key;
+	s->size++;
+	return true;
+}
+static bool SortedDelete(void *t, int key)
+{
+	Sorted s = t;
+	int i = SortedRank(s, key);
+	if (i == s->size || s->keys[i] != key)
+		return false;
+
+	memmove(&s->keys[i], &s->keys[i + 1], sizeof(int) * (s->size - i - 1));
+	s->size--;
+	return true;
+}
+static bool SortedSearch(void *t, int key)
+{
+	Sorted s = t;
+	int i = SortedRank(s, key);
+	return i < s->size && s->keys[i] == key;
+}
+static int SortedFloor(void *t, int key)
+{
+	Sorted s = t;
+	int i = SortedRank(s, key);
+	if (i < s->size && s->keys[i] == key)
+		return key;
+	return (i == 0) ? UNDEFINED : s->keys[i - 1];
+}
+static int compareInts(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+static int SortedBuild(void *t, int *keys, int n)
+{
+	Sorted s = t;
+	s->keys = malloc(sizeof(int) * n);
+	if (s->keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Sorted\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(s->keys, keys, sizeof(int) * n);
+	qsort(s->keys, n, sizeof(int), compareInts);
+	s->size = s->capacity = n;
+	return n;
+}
+
+static Engine Engines[] = {
+	{"pointer", PointerNew, PointerFree, PointerInsert, PointerDelete, PointerSearch, PointerFloor, NULL},
+	{"64-bit", Wide64New, Wide64Free, Wide64Insert, Wide64Delete, Wide64Search, Wide64Floor, NULL},
+	{"compact", CompactNew, CompactFree, CompactInsert, CompactDelete, CompactSearch, CompactFloor, NULL},
+	{"bucket", BucketNew, BucketFree, BucketInsert, BucketDelete, BucketSearch, BucketFloor, NULL},
+	{"roaring", RoaringNew, RoaringFree, RoaringInsert, RoaringDelete, RoaringSearch, RoaringFloor, NULL},
+	{"veb", VebNew, VebFree, VebInsert, VebDelete, VebSearch, VebFloor, NULL},
+	{"sorted", SortedNew, SortedFree, SortedInsert, SortedDelete, SortedSearch, SortedFloor, SortedBuild},
+	{"adaptive", AdaptiveNew, AdaptiveFree, AdaptiveInsert, AdaptiveDelete, AdaptiveSearch, AdaptiveFloor, NULL},
+	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}};
+
+static void runEngine(Engine *e, int *keys, int n, int *queries, int nqueries,
+					  int nwrites);
+static size_t heapInUse(void);
+static double now(void);
+static unsigned int nextRandom(unsigned int *state);
+
+int main(int argc, char **argv)
+{
+	int n = (argc > 1) ? atoi(argv[1]) : DEFAULT_N;
+	int nqueries = (argc > 2) ? atoi(argv[2]) : DEFAULT_LOOKUPS;
+	unsigned int seed = (argc > 3) ? (unsigned int)atoi(argv[3]) : 1;
+	int spread = (argc > 4) ? atoi(argv[4]) : 2;
+	int nwrites = (argc > 5) ? atoi(argv[5]) : DEFAULT_WRITES;
+
+	if (seed == 0)
+		seed = 1;
+
+	if (n <= 0 || nqueries <= 0 || spread < 2 || nwrites <= 0 ||
+		(long long)n * spread > INT_MAX)
+	{
+		fprintf(stderr, "Usage: %s [n] [lookups] [seed] [spread] [writes]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int *keys = malloc(sizeof(int) * n);
+	int *queries = malloc(sizeof(int) * nqueries);
+	if (keys == NULL || queries == NULL)
+	{
+		fprintf(stderr, "Could not malloc workload\n");
+		return EXIT_FAILURE;
+	}
+
+	// Multiples of spread in shuffled order, so there are no duplicates
+	for (int i = 0; i < n; i++)
+		keys[i] = spread * i;
+	for (int i = n - 1; i > 0; i--)
+	{
+		int j = (int)(nextRandom(&seed) % (unsigned int)(i + 1));
+		int tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+
+	// Queries are drawn from the whole key range, so with the default
+	// spread roughly half of the lookups miss
+	for (int i = 0; i < nqueries; i++)
+		queries[i] = (int)(nextRandom(&seed) % ((unsigned int)spread * n));
+
+	printf("%-10s %10s %12s %14s %14s %14s\n", "engine", "keys", "bytes/key",
+		   "lookups/sec", "floors/sec", "writes/sec");
+	for (int i = 0; Engines[i].name != NULL; i++)
+		runEngine(&Engines[i], keys, n, queries, nqueries, nwrites);
+
+	free(keys);
+	free(queries);
+	return EXIT_SUCCESS;
+}
+
+static void runEngine(Engine *e, int *keys, int n, int *queries, int nqueries,
+					  int nwrites)
+{
+	size_t before = heapInUse();
+	void *t = e->new();
+
+	int inserted = 0;
+	if (e->build != NULL)
+		inserted = e->build(t, keys, n);
+	else
+		for (int i = 0; i < n; i++)
+			inserted += e->insert(t, keys[i]);
+
+	size_t bytes = heapInUse() - before;
+
+	double start = now();
+	int found = 0;
+	for (int i = 0; i < nqueries; i++)
+		found += e->search(t, queries[i]);
+	double elapsed = now() - start;
+
+	// Odd queries are never keys, so every floor is a real predecessor
+	// search rather than an exact hit
+	start = now();
+	long long checksum = 0;
+	for (int i = 0; i < nqueries; i++)
+		checksum += e->floor(t, queries[i] | 1);
+	double floorElapsed = now() - start;
+
+	// The keys were inserted shuffled, so walking them in order deletes
+	// and reinserts at random positions
+	start = now();
+	int written = 0;
+	for (int i = 0; i < nwrites; i++)
+	{
+		written += e->delete(t, keys[i % n]);
+		written += e->insert(t, keys[i % n]);
+	}
+	double writeElapsed = now() - start;
+
+	printf("%-10s %10d %12.2f %14.0f %14.0f %14.0f   (%d hits, %lld, %d)\n",
+		   e->name, inserted, (double)bytes / inserted, nqueries / elapsed,
+		   nqueries / floorElapsed, written / writeElapsed, found, checksum,
+		   written);
+
+	e->free(t);
+}
+
+/* Helper Functions */
+
+/**
+ * Returns the number of bytes currently allocated on the heap,
+ * including allocator overhead
+ */
+static size_t heapInUse(void)
+{
+#ifdef __GLIBC__
+	// Large blocks such as the compact node pool are mmapped separately
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * xorshift32, good enough to scatter keys and cheap enough to not show
+ * up in the timings
+ */
+static unsigned int nextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
@@ -0,0 +1,148 @@
+// Implementation of reading a List back through ListShow.
+//
+// The temporary file is made once and truncated before every capture.
+// While ListShow runs, file descriptor 1 is a duplicate of the file's
+// descriptor, so the file is read back with pread: a FILE read from the
+// same file would serve stale bytes from its buffer. A child made by
+// fork shares the parent's descriptor and offset, so it makes its own.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "List.h"
+#include "listCapture.h"
+
+static int CaptureFd = -1;
+static pid_t CapturePid = -1;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool Redirect(List l);
+static char *ReadBack(void);
+static int Parse(const char *text, int **values);
+
+////////////////////////////////////////////////////////////////////////
+
+int ListCapture(List l, int **values)
+{
+	*values = NULL;
+
+	if (CaptureFd < 0 || CapturePid != getpid())
+	{
+		FILE *fp = tmpfile();
+		if (fp == NULL)
+			return -1;
+		// The FILE is never closed, only its descriptor is used
+		CaptureFd = fileno(fp);
+		CapturePid = getpid();
+	}
+
+	if (ftruncate(CaptureFd, 0) != 0 || lseek(CaptureFd, 0, SEEK_SET) != 0 || !Redirect(l))
+		return -1;
+
+	char *text = ReadBack();
+	if (text == NULL)
+		return -1;
+
+	int size = Parse(text, values);
+	free(text);
+	return size;
+}
+
+/**
+ * Run ListShow with stdout pointing at the capture file
+ */
+static bool Redirect(List l)
+{
+	fflush(stdout);
+	int saved = dup(STDOUT_FILENO);
+	if (saved < 0)
+		return false;
+
+	if (dup2(CaptureFd, STDOUT_FILENO) < 0)
+	{
+		close(saved);
+		return false;
+	}
+
+	ListShow(l);
+	fflush(stdout);
+
+	bool restored = dup2(saved, STDOUT_FILENO) >= 0;
+	close(saved);
+	return restored;
+}
+
+/**
+ * Everything ListShow wrote, as a string
+ */
+static char *ReadBack(void)
+{
+	off_t length = lseek(CaptureFd, 0, SEEK_CUR);
+	if (length < 0)
+		return NULL;
+
+	char *text = malloc(length + 1);
+	if (text == NULL)
+	{
+		fprintf(stderr, "Could not malloc Capture\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (pread(CaptureFd, text, length, 0) != length)
+	{
+		free(text);
+		return NULL;
+	}
+
+	text[length] = '\0';
+	return text;
+}
+
+/**
+ * Parse "[a, b, c]" as written by ListShow
+ */
+static int Parse(const char *text, int **values)
+{
+	if (*text++ != '[')
+		return -1;
+
+	int size = 0, capacity = 16;
+	int *keys = malloc(capacity * sizeof(int));
+	if (keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Values\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// An empty list has no value before the ]
+	while (*text != ']')
+	{
+		char *end;
+		long value = strtol(text, &end, 10);
+		if (end == text || (*end != ',' && *end != ']'))
+		{
+			free(keys);
+			return -1;
+		}
+
+		if (size == capacity)
+		{
+			capacity *= 2;
+			keys = realloc(keys, capacity * sizeof(int));
+			if (keys == NULL)
+			{
+				fprintf(stderr, "Could not grow Values\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		keys[size++] = (int)value;
+		text = (*end == ',') ? end + 1 : end;
+	}
+
+	*values = keys;
+	return size;
+}
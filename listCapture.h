@@ -0,0 +1,23 @@
+// Reading a List back for the differential testers.
+//
+// List.h has no way to get at the values of a List other than ListShow,
+// which prints them to stdout. ListCapture points stdout at a temporary
+// file for the length of one ListShow call and parses what it wrote.
+//
+// stdout is the process's, so nothing else may print to it while a List
+// is being captured: callers with threads hold one lock around both
+// their captures and their own output.
+
+#ifndef LIST_CAPTURE_H
+#define LIST_CAPTURE_H
+
+#include "List.h"
+
+/**
+ * Reads the values of l, in order, into a malloc'd array set in *values
+ * and returns how many there are. Returns -1, with *values set to NULL,
+ * if stdout could not be redirected or the output could not be parsed.
+ */
+int ListCapture(List l, int **values);
+
+#endif
@@ -0,0 +1,485 @@
+// Checker for Balanced Binary Search Tree Maps (bMap.h).
+// Runs a random mix of puts, gets and deletes through a map of fixed
+// size values and a map of variable length values, and compares every
+// answer, floor and ceiling entries and MapBetween ranges included, with
+// plain arrays indexed by key. A few targeted checks follow: values are
+// replaced where they are, deleting a node with two children leaves the
+// other values where they were, and MapBetween stops as soon as the
+// visitor asks it to.
+//
+// Usage: ./mapCheck [-o operations] [-s seed]
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bMap.h"
+
+#define DEFAULT_OPS 200000
+// Keys are drawn from [0, KEYSPACE)
+#define KEYSPACE 1024
+#define MAX_LENGTH 64
+
+// The fixed size value, wider than a pointer so it is not mistaken for
+// one
+typedef struct record
+{
+	int key;
+	int version;
+	long long checksum;
+} Record;
+
+typedef struct reference
+{
+	bool present[KEYSPACE];
+	int version[KEYSPACE];
+	// Only used for variable length values
+	size_t length[KEYSPACE];
+} Reference;
+
+typedef struct collector
+{
+	int keys[KEYSPACE];
+	int count;
+	// Stop once this many entries have been visited
+	int limit;
+	bool valuesOk;
+	Reference *ref;
+	bool fixed;
+} Collector;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkRandom(bool fixed, int ops, unsigned int seed);
+static bool checkEntries(Map m, Reference *ref, bool fixed, unsigned int *state);
+static bool checkInPlace(void);
+static bool checkTwoChildren(bool fixed);
+static bool checkEarlyStop(void);
+static void makeValue(int key, int version, size_t length, unsigned char *out);
+static bool valueOk(const void *value, size_t length, int key, int version,
+					size_t expected);
+static bool collect(const MapEntry *e, void *arg);
+static int floorKey(Reference *ref, int key);
+static int ceilingKey(Reference *ref, int key);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkRandom(true, ops, seed);
+	failures += !checkRandom(false, ops, seed);
+	failures += !checkInPlace();
+	failures += !checkTwoChildren(true);
+	failures += !checkTwoChildren(false);
+	failures += !checkEarlyStop();
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Random puts, gets and deletes against the reference, with the whole
+ * map compared every so often
+ */
+static bool checkRandom(bool fixed, int ops, unsigned int seed)
+{
+	const char *name = fixed ? "fixed size values" : "variable length values";
+	Map m = MapNew(fixed ? sizeof(Record) : 0);
+	Reference *ref = calloc(1, sizeof(Reference));
+	if (ref == NULL)
+	{
+		fprintf(stderr, "Could not malloc Reference\n");
+		exit(EXIT_FAILURE);
+	}
+
+	unsigned int state = seed;
+	bool ok = true;
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int key = (int)(NextRandom(&state) % KEYSPACE);
+		unsigned int action = NextRandom(&state) % 8;
+
+		if (action < 4)
+		{
+			// Put, which adds the key or replaces its value
+			size_t length = NextRandom(&state) % (MAX_LENGTH + 1);
+			int version = ref->version[key] + 1;
+			bool added;
+			if (fixed)
+			{
+				Record r = {key, version, (long long)key * 1000003 + version};
+				added = MapPut(m, key, &r, sizeof(r));
+			}
+			else
+			{
+				unsigned char value[MAX_LENGTH];
+				makeValue(key, version, length, value);
+				added = MapPut(m, key, value, length);
+			}
+
+			if (added == ref->present[key])
+			{
+				printf("FAIL %s: put %d returned %d\n", name, key, added);
+				ok = false;
+			}
+			ref->present[key] = true;
+			ref->version[key] = version;
+			ref->length[key] = length;
+		}
+		else if (action < 6)
+		{
+			size_t length = 0;
+			const void *value = MapGet(m, key, &length);
+			if ((value != NULL) != ref->present[key] ||
+				(value != NULL &&
+				 !valueOk(value, length, key, ref->version[key],
+						  fixed ? sizeof(Record) : ref->length[key])))
+			{
+				printf("FAIL %s: get %d\n", name, key);
+				ok = false;
+			}
+		}
+		else
+		{
+			bool deleted = MapDelete(m, key);
+			if (deleted != ref->present[key])
+			{
+				printf("FAIL %s: delete %d returned %d\n", name, key, deleted);
+				ok = false;
+			}
+			ref->present[key] = false;
+		}
+
+		if (ok && i % 1000 == 999)
+			ok = checkEntries(m, ref, fixed, &state);
+	}
+
+	if (ok)
+		ok = checkEntries(m, ref, fixed, &state);
+
+	printf("%s %-24s %d operations\n", ok ? "PASS" : "FAIL", name, ops);
+	MapFree(m);
+	free(ref);
+	return ok;
+}
+
+/**
+ * Compare the size, a few floor and ceiling entries, and a random range
+ * of the map with the reference
+ */
+static bool checkEntries(Map m, Reference *ref, bool fixed, unsigned int *state)
+{
+	const char *name = fixed ? "fixed size values" : "variable length values";
+	size_t valueSize = fixed ? sizeof(Record) : 0;
+
+	int size = 0;
+	for (int k = 0; k < KEYSPACE; k++)
+		size += ref->present[k];
+	if (MapSize(m) != size)
+	{
+		printf("FAIL %s: size %d, expected %d\n", name, MapSize(m), size);
+		return false;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		// One past either end of the keyspace as well
+		int key = (int)(NextRandom(state) % (KEYSPACE + 2)) - 1;
+
+		MapEntry e = {.key = -1};
+		int want = floorKey(ref, key);
+		bool found = MapFloorEntry(m, key, &e);
+		if (found != (want >= 0) ||
+			(found && (e.key != want ||
+					   !valueOk(e.value, e.length, want, ref->version[want],
+								valueSize ? valueSize : ref->length[want]))))
+		{
+			printf("FAIL %s: floor of %d is %d, expected %d\n", name, key,
+				   found ? e.key : -1, want);
+			return false;
+		}
+
+		want = ceilingKey(ref, key);
+		found = MapCeilingEntry(m, key, &e);
+		if (found != (want >= 0) ||
+			(found && (e.key != want ||
+					   !valueOk(e.value, e.length, want, ref->version[want],
+								valueSize ? valueSize : ref->length[want]))))
+		{
+			printf("FAIL %s: ceiling of %d is %d, expected %d\n", name, key,
+				   found ? e.key : -1, want);
+			return false;
+		}
+	}
+
+	int lower = (int)(NextRandom(state) % KEYSPACE);
+	int upper = lower + (int)(NextRandom(state) % (KEYSPACE / 4));
+	Collector c = {.count = 0, .limit = KEYSPACE, .valuesOk = true, .ref = ref,
+				   .fixed = fixed};
+	int visited = MapBetween(m, lower, upper, collect, &c);
+
+	int expected = 0;
+	bool same = c.valuesOk && visited == c.count;
+	for (int k = lower; k <= upper && k < KEYSPACE; k++)
+		if (ref->present[k])
+			same = same && expected < c.count && c.keys[expected++] == k;
+	if (!same || expected != c.count)
+	{
+		printf("FAIL %s: MapBetween(%d, %d) visited %d entries, expected %d\n",
+			   name, lower, upper, visited, expected);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Putting a key that is present replaces its value where it is: inline
+ * values never move, and an out of line value keeps its memory while the
+ * new one is not much smaller or any larger
+ */
+static bool checkInPlace(void)
+{
+	bool ok = true;
+
+	Map fixed = MapNew(sizeof(Record));
+	Record r = {7, 1, 1};
+	MapPut(fixed, 7, &r, sizeof(r));
+	const void *before = MapGet(fixed, 7, NULL);
+	r.version = 2;
+	bool added = MapPut(fixed, 7, &r, sizeof(r));
+	const Record *after = MapGet(fixed, 7, NULL);
+	if (added || after != before || after->version != 2 || MapSize(fixed) != 1)
+	{
+		printf("FAIL in place: fixed size value was not replaced in place\n");
+		ok = false;
+	}
+	MapFree(fixed);
+
+	Map variable = MapNew(0);
+	unsigned char value[MAX_LENGTH];
+	makeValue(7, 1, 40, value);
+	MapPut(variable, 7, value, 40);
+	before = MapGet(variable, 7, NULL);
+
+	size_t length = 0;
+	makeValue(7, 2, 32, value);
+	added = MapPut(variable, 7, value, 32);
+	const void *shrunk = MapGet(variable, 7, &length);
+	if (added || shrunk != before || !valueOk(shrunk, length, 7, 2, 32))
+	{
+		printf("FAIL in place: shorter value did not reuse its memory\n");
+		ok = false;
+	}
+
+	makeValue(7, 3, 0, value);
+	MapPut(variable, 7, value, 0);
+	const void *empty = MapGet(variable, 7, &length);
+	if (empty == NULL || length != 0 || MapSize(variable) != 1)
+	{
+		printf("FAIL in place: empty value was lost\n");
+		ok = false;
+	}
+
+	makeValue(7, 4, MAX_LENGTH, value);
+	MapPut(variable, 7, value, MAX_LENGTH);
+	const void *grown = MapGet(variable, 7, &length);
+	if (!valueOk(grown, length, 7, 4, MAX_LENGTH))
+	{
+		printf("FAIL in place: longer value was not copied\n");
+		ok = false;
+	}
+	MapFree(variable);
+
+	if (ok)
+		printf("PASS replace in place\n");
+	return ok;
+}
+
+/**
+ * Deleting a key whose node has two children moves its successor's node
+ * into place, so no other value moves. Keys 1 to 7 put in order make a
+ * perfect tree with 4 at the root.
+ */
+static bool checkTwoChildren(bool fixed)
+{
+	Map m = MapNew(fixed ? sizeof(Record) : 0);
+	const void *where[8] = {NULL};
+	unsigned char value[MAX_LENGTH];
+
+	for (int k = 1; k <= 7; k++)
+	{
+		Record r = {k, 1, (long long)k * 1000003 + 1};
+		makeValue(k, 1, 8 * k, value);
+		if (fixed)
+			MapPut(m, k, &r, sizeof(r));
+		else
+			MapPut(m, k, value, 8 * k);
+		where[k] = MapGet(m, k, NULL);
+	}
+
+	// The root, then 2, which still has both its children
+	bool ok = MapDelete(m, 4) && MapDelete(m, 2) && MapSize(m) == 5;
+	for (int k = 1; k <= 7 && ok; k++)
+	{
+		size_t length = 0;
+		const void *v = MapGet(m, k, &length);
+		if (k == 4 || k == 2)
+			ok = v == NULL;
+		else
+			ok = v == where[k] &&
+				 valueOk(v, length, k, 1, fixed ? sizeof(Record) : 8 * (size_t)k);
+	}
+
+	Collector c = {.count = 0, .limit = KEYSPACE, .valuesOk = true};
+	MapBetween(m, 0, 8, collect, &c);
+	int order[] = {1, 3, 5, 6, 7};
+	ok = ok && c.count == 5 && memcmp(c.keys, order, sizeof(order)) == 0;
+
+	printf("%s %-24s %s values\n", ok ? "PASS" : "FAIL", "delete with two children",
+		   fixed ? "fixed size" : "variable length");
+	MapFree(m);
+	return ok;
+}
+
+/**
+ * MapBetween stops at the entry the visitor returns false for, and
+ * counts that entry
+ */
+static bool checkEarlyStop(void)
+{
+	Map m = MapNew(sizeof(Record));
+	for (int k = 0; k < 100; k++)
+	{
+		Record r = {k, 1, (long long)k * 1000003 + 1};
+		MapPut(m, 2 * k, &r, sizeof(r));
+	}
+
+	bool ok = true;
+	for (int limit = 1; limit <= 10 && ok; limit++)
+	{
+		Collector c = {.count = 0, .limit = limit, .valuesOk = true};
+		int visited = MapBetween(m, 51, 199, collect, &c);
+		ok = visited == limit && c.count == limit;
+		for (int i = 0; i < c.count && ok; i++)
+			ok = c.keys[i] == 52 + 2 * i;
+	}
+
+	// A visitor that never stops sees the whole range
+	Collector c = {.count = 0, .limit = KEYSPACE, .valuesOk = true};
+	ok = ok && MapBetween(m, 51, 199, collect, &c) == 74 && c.keys[73] == 198;
+
+	printf("%s MapBetween stopping early\n", ok ? "PASS" : "FAIL");
+	MapFree(m);
+	return ok;
+}
+
+/**
+ * Visitor that records the keys it is given, checks their values when
+ * it has a reference, and stops after limit entries
+ */
+static bool collect(const MapEntry *e, void *arg)
+{
+	Collector *c = arg;
+	c->keys[c->count++] = e->key;
+
+	if (c->ref != NULL)
+	{
+		Reference *ref = c->ref;
+		size_t expected = c->fixed ? sizeof(Record) : ref->length[e->key];
+		if (!valueOk(e->value, e->length, e->key, ref->version[e->key], expected))
+			c->valuesOk = false;
+	}
+
+	return c->count < c->limit;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Fill a variable length value with bytes that depend on its key and
+ * version
+ */
+static void makeValue(int key, int version, size_t length, unsigned char *out)
+{
+	for (size_t i = 0; i < length; i++)
+		out[i] = (unsigned char)(key * 31 + version * 7 + i);
+}
+
+static bool valueOk(const void *value, size_t length, int key, int version,
+					size_t expected)
+{
+	if (value == NULL || length != expected)
+		return false;
+
+	if (length == sizeof(Record))
+	{
+		// Either kind of value may be this long, a Record says so itself
+		const Record *r = value;
+		if (r->key == key && r->version == version &&
+			r->checksum == (long long)key * 1000003 + version)
+			return true;
+	}
+
+	unsigned char want[MAX_LENGTH];
+	makeValue(key, version, length, want);
+	return length <= MAX_LENGTH && memcmp(value, want, length) == 0;
+}
+
+static int floorKey(Reference *ref, int key)
+{
+	for (int k = (key < KEYSPACE) ? key : KEYSPACE - 1; k >= 0; k--)
+		if (ref->present[k])
+			return k;
+	return -1;
+}
+
+static int ceilingKey(Reference *ref, int key)
+{
+	for (int k = (key > 0) ? key : 0; k < KEYSPACE; k++)
+		if (ref->present[k])
+			return k;
+	return -1;
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
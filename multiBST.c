@@ -0,0 +1,504 @@
+// Implementation of the Balanced Binary Search Tree Multiset.
+//
+// Every node caches the height of its subtree and its weight, the total
+// of the counts in it. Both are recomputed from the children by Update,
+// which is called on each node of the path an insertion or deletion
+// changed, bottom up, and on the nodes a rotation moves.
+//
+// Changing the count of a key that stays in the tree leaves the shape
+// alone, so only the weights on its path are redone. A node is only
+// added or removed when a key's count goes from or to 0.
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "multiBST.h"
+#include "List.h"
+
+typedef struct multiNode *MultiNode;
+
+struct multiNode
+{
+	int key;
+	int height;
+	// Occurrences of key, always at least 1
+	long long count;
+	// Occurrences of every key in the subtree
+	long long weight;
+	MultiNode left;
+	MultiNode right;
+};
+
+struct multiTree
+{
+	MultiNode root;
+	int distinct;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void FreeNode(MultiNode n);
+static MultiNode Find(MultiTree t, int key);
+static MultiNode NodeCreate(int k);
+static MultiNode NodeInsert(MultiNode curr, int key, MultiNode *found);
+static MultiNode NodeRemove(MultiNode curr, int key, long long n, long long *removed,
+							bool *unlinked);
+static MultiNode RemoveMin(MultiNode curr, MultiNode *min);
+static MultiNode Rebalance(MultiNode n);
+static MultiNode RotateLeft(MultiNode n);
+static MultiNode RotateRight(MultiNode n);
+static void Update(MultiNode n);
+static int Height(MultiNode n);
+static long long Weight(MultiNode n);
+static int GetBalance(MultiNode n);
+static void NodeToList(List l, MultiNode curr);
+static long long RankBelow(MultiTree t, long long key);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty multiset.
+ */
+MultiTree MultiTreeNew(void)
+{
+	MultiTree t = malloc(sizeof(*t));
+
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc Tree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t->root = NULL;
+	t->distinct = 0;
+	return t;
+}
+
+/**
+ * Frees all memory allocated for the given multiset.
+ */
+void MultiTreeFree(MultiTree t)
+{
+	if (t == NULL)
+		return;
+
+	FreeNode(t->root);
+	free(t);
+}
+
+static void FreeNode(MultiNode n)
+{
+	if (n == NULL)
+		return;
+
+	FreeNode(n->left);
+	FreeNode(n->right);
+	free(n);
+}
+
+/**
+ * Returns the number of occurrences of all keys in the multiset.
+ */
+long long MultiTreeSize(MultiTree t)
+{
+	return (t == NULL) ? 0 : Weight(t->root);
+}
+
+/**
+ * Returns the number of distinct keys in the multiset.
+ */
+int MultiTreeDistinct(MultiTree t)
+{
+	return (t == NULL) ? 0 : t->distinct;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the number of times the given key occurs in the multiset.
+ */
+long long MultiTreeCount(MultiTree t, int key)
+{
+	MultiNode n = Find(t, key);
+	return (n == NULL) ? 0 : n->count;
+}
+
+static MultiNode Find(MultiTree t, int key)
+{
+	if (t == NULL || key == UNDEFINED)
+		return NULL;
+
+	MultiNode curr = t->root;
+	while (curr != NULL && curr->key != key)
+		curr = (key > curr->key) ? curr->right : curr->left;
+
+	return curr;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Adds an occurrence of the given key.
+ */
+long long MultiTreeInsert(MultiTree t, int key)
+{
+	if (t == NULL)
+		return 0;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return 0;
+	}
+
+	MultiNode found = NULL;
+	t->root = NodeInsert(t->root, key, &found);
+	if (found->count == 1)
+		t->distinct++;
+	return found->count;
+}
+
+/**
+ * Create New node for the first occurrence of a key
+ */
+static MultiNode NodeCreate(int k)
+{
+	MultiNode n = malloc(sizeof(*n));
+
+	if (n == NULL)
+	{
+		fprintf(stderr, "Could not malloc Node\n");
+		exit(EXIT_FAILURE);
+	}
+
+	n->key = k;
+	n->count = 1;
+	n->left = NULL;
+	n->right = NULL;
+	Update(n);
+	return n;
+}
+
+/**
+ * Count another occurrence of a key in its node, or add a node for it
+ * Balance the tree if necessary
+ */
+static MultiNode NodeInsert(MultiNode curr, int key, MultiNode *found)
+{
+	if (curr == NULL)
+	{
+		*found = NodeCreate(key);
+		return *found;
+	}
+
+	if (key == curr->key)
+	{
+		curr->count++;
+		curr->weight++;
+		*found = curr;
+		return curr;
+	}
+
+	if (key < curr->key)
+		curr->left = NodeInsert(curr->left, key, found);
+	else
+		curr->right = NodeInsert(curr->right, key, found);
+
+	// A repeated key changes no heights, only the weights above it
+	if ((*found)->count > 1)
+	{
+		curr->weight++;
+		return curr;
+	}
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Removes one occurrence of the given key.
+ */
+bool MultiTreeDelete(MultiTree t, int key)
+{
+	if (Find(t, key) == NULL)
+		return false;
+
+	long long removed = 0;
+	bool unlinked = false;
+	t->root = NodeRemove(t->root, key, 1, &removed, &unlinked);
+	if (unlinked)
+		t->distinct--;
+	return true;
+}
+
+/**
+ * Removes every occurrence of the given key.
+ */
+long long MultiTreeDeleteAll(MultiTree t, int key)
+{
+	if (Find(t, key) == NULL)
+		return 0;
+
+	long long removed = 0;
+	bool unlinked = false;
+	t->root = NodeRemove(t->root, key, LLONG_MAX, &removed, &unlinked);
+	t->distinct--;
+	return removed;
+}
+
+/**
+ * Remove up to n occurrences of a key that is in the subtree, and its
+ * node if none are left
+ * Balance the tree if necessary
+ */
+static MultiNode NodeRemove(MultiNode curr, int key, long long n, long long *removed,
+							bool *unlinked)
+{
+	if (key < curr->key)
+	{
+		curr->left = NodeRemove(curr->left, key, n, removed, unlinked);
+	}
+	else if (key > curr->key)
+	{
+		curr->right = NodeRemove(curr->right, key, n, removed, unlinked);
+	}
+	else if (curr->count > n)
+	{
+		curr->count -= n;
+		*removed = n;
+	}
+	else
+	{
+		*removed = curr->count;
+		*unlinked = true;
+
+		MultiNode replacement;
+		if (curr->left == NULL || curr->right == NULL)
+		{
+			// Zero or one child, splice the node out
+			replacement = (curr->left == NULL) ? curr->right : curr->left;
+		}
+		else
+		{
+			// Two children, the successor node takes the place of this
+			// one along with its count
+			MultiNode right = RemoveMin(curr->right, &replacement);
+			replacement->left = curr->left;
+			replacement->right = right;
+			replacement = Rebalance(replacement);
+		}
+
+		free(curr);
+		return replacement;
+	}
+
+	if (!*unlinked)
+	{
+		curr->weight -= *removed;
+		return curr;
+	}
+	return Rebalance(curr);
+}
+
+/**
+ * Unlink the smallest node of a subtree, returning the rest balanced
+ */
+static MultiNode RemoveMin(MultiNode curr, MultiNode *min)
+{
+	if (curr->left == NULL)
+	{
+		*min = curr;
+		return curr->right;
+	}
+
+	curr->left = RemoveMin(curr->left, min);
+	return Rebalance(curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Update the cached fields of a node and rotate it if it is unbalanced
+ */
+static MultiNode Rebalance(MultiNode n)
+{
+	Update(n);
+	int balance = GetBalance(n);
+
+	// Left Left and Left Right cases
+	if (balance > 1)
+	{
+		if (GetBalance(n->left) < 0)
+			n->left = RotateLeft(n->left);
+		return RotateRight(n);
+	}
+
+	// Right Right and Right Left cases
+	if (balance < -1)
+	{
+		if (GetBalance(n->right) > 0)
+			n->right = RotateRight(n->right);
+		return RotateLeft(n);
+	}
+
+	return n;
+}
+
+static MultiNode RotateLeft(MultiNode n)
+{
+	MultiNode y = n->right;
+	n->right = y->left;
+	y->left = n;
+
+	Update(n);
+	Update(y);
+	return y;
+}
+
+static MultiNode RotateRight(MultiNode n)
+{
+	MultiNode y = n->left;
+	n->left = y->right;
+	y->right = n;
+
+	Update(n);
+	Update(y);
+	return y;
+}
+
+static void Update(MultiNode n)
+{
+	n->height = 1 + max(Height(n->left), Height(n->right));
+	n->weight = Weight(n->left) + n->count + Weight(n->right);
+}
+
+static int Height(MultiNode n)
+{
+	return (n == NULL) ? -1 : n->height;
+}
+
+static long long Weight(MultiNode n)
+{
+	return (n == NULL) ? 0 : n->weight;
+}
+
+static int GetBalance(MultiNode n)
+{
+	return Height(n->left) - Height(n->right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a list containing each distinct key once in ascending order.
+ */
+List MultiTreeToList(MultiTree t)
+{
+	List l = ListNew();
+	if (t == NULL)
+		return l;
+
+	NodeToList(l, t->root);
+	return l;
+}
+
+static void NodeToList(List l, MultiNode curr)
+{
+	if (curr == NULL)
+		return;
+
+	NodeToList(l, curr->left);
+	ListAppend(l, curr->key);
+	NodeToList(l, curr->right);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the number of occurrences of keys less than the given value.
+ */
+long long MultiTreeRank(MultiTree t, int key)
+{
+	return RankBelow(t, key);
+}
+
+/**
+ * Returns the k-th smallest occurrence in the multiset.
+ * The weights say which side of each node the occurrence is on, so this
+ * walks a single path.
+ */
+int MultiTreeKthSmallest(MultiTree t, long long k)
+{
+	if (t == NULL || k < 1 || k > Weight(t->root))
+		return UNDEFINED;
+
+	MultiNode curr = t->root;
+	for (;;)
+	{
+		long long left = Weight(curr->left);
+		if (k <= left)
+		{
+			curr = curr->left;
+		}
+		else if (k <= left + curr->count)
+		{
+			return curr->key;
+		}
+		else
+		{
+			k -= left + curr->count;
+			curr = curr->right;
+		}
+	}
+}
+
+/**
+ * Returns the number of occurrences of keys between the two given keys.
+ */
+long long MultiTreeRangeCount(MultiTree t, int lower, int upper)
+{
+	if (lower > upper)
+		return 0;
+
+	// Widened so that upper + 1 does not overflow at INT_MAX
+	return RankBelow(t, (long long)upper + 1) - RankBelow(t, lower);
+}
+
+/**
+ * Sum the weights hung off the left of the path to a key, which are the
+ * occurrences of every smaller key
+ */
+static long long RankBelow(MultiTree t, long long key)
+{
+	if (t == NULL)
+		return 0;
+
+	long long rank = 0;
+	MultiNode curr = t->root;
+	while (curr != NULL)
+	{
+		if (key <= curr->key)
+		{
+			curr = curr->left;
+		}
+		else
+		{
+			rank += Weight(curr->left) + curr->count;
+			curr = curr->right;
+		}
+	}
+	return rank;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
@@ -0,0 +1,114 @@
+// Operations on Balanced Binary Search Tree Multisets.
+// An AVL tree in which a key may occur any number of times. Each node
+// holds a key once with the number of times it occurs, so a stream that
+// repeats a key costs a counter increment rather than a node, and memory
+// grows with the number of distinct keys however many occurrences there
+// are.
+//
+// Nodes also hold the number of occurrences in their subtree, so rank,
+// k-th smallest and range count queries take every occurrence into
+// account and still walk a single path. Counts are long long so a busy
+// key cannot overflow them.
+
+#ifndef MULTI_TREE_H
+#define MULTI_TREE_H
+
+#include <stdbool.h>
+
+#include "bBST.h"
+#include "List.h"
+
+typedef struct multiTree *MultiTree;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of distinct keys
+// in the tree, unless otherwise specified.
+
+/**
+ * Creates a new empty multiset.
+ * The time complexity of this function is O(1).
+ */
+MultiTree MultiTreeNew(void);
+
+/**
+ * Frees all memory allocated for the given multiset.
+ * The time complexity of this function is O(n).
+ */
+void MultiTreeFree(MultiTree t);
+
+/**
+ * Returns the number of occurrences of all keys in the multiset.
+ * The time complexity of this function is O(1).
+ */
+long long MultiTreeSize(MultiTree t);
+
+/**
+ * Returns the number of distinct keys in the multiset.
+ * The time complexity of this function is O(1).
+ */
+int MultiTreeDistinct(MultiTree t);
+
+/**
+ * Returns the number of times the given key occurs in the multiset.
+ * The time complexity of this function is O(log n).
+ */
+long long MultiTreeCount(MultiTree t, int key);
+
+/**
+ * Adds an occurrence of the given key. Only the first occurrence of a
+ * key allocates.
+ * Returns the number of times the key now occurs, or 0 if the key is
+ * UNDEFINED and was not added.
+ * The time complexity of this function is O(log n).
+ */
+long long MultiTreeInsert(MultiTree t, int key);
+
+/**
+ * Removes one occurrence of the given key, and the key itself once none
+ * are left.
+ * Returns true if an occurrence was removed, or false if the key was not
+ * present.
+ * The time complexity of this function is O(log n).
+ */
+bool MultiTreeDelete(MultiTree t, int key);
+
+/**
+ * Removes every occurrence of the given key.
+ * Returns the number of occurrences removed.
+ * The time complexity of this function is O(log n).
+ */
+long long MultiTreeDeleteAll(MultiTree t, int key);
+
+/**
+ * Creates a list containing each distinct key in the multiset once, in
+ * ascending order.
+ * The time complexity of this function is O(n).
+ */
+List MultiTreeToList(MultiTree t);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the number of occurrences of keys less than the given value,
+ * which is the 0-based position its first occurrence has or would have.
+ * The time complexity of this function is O(log n).
+ */
+long long MultiTreeRank(MultiTree t, int key);
+
+/**
+ * Returns the k-th smallest occurrence in the multiset, k = 1 being the
+ * smallest, so a key that occurs c times is returned for c consecutive
+ * values of k.
+ * Returns UNDEFINED if k is not between 1 and the size of the multiset.
+ * The time complexity of this function is O(log n).
+ */
+int MultiTreeKthSmallest(MultiTree t, long long k);
+
+/**
+ * Returns the number of occurrences of keys between the two given keys
+ * (inclusive).
+ * The time complexity of this function is O(log n).
+ */
+long long MultiTreeRangeCount(MultiTree t, int lower, int upper);
+
+#endif
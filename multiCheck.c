@@ -0,0 +1,327 @@
+// Differential checker for Balanced Binary Search Tree Multisets.
+// Runs random inserts, deletes and delete-alls through a MultiTree and
+// an array of occurrence counts over the same small set of keys, and
+// compares MultiTreeCount, MultiTreeRank, MultiTreeKthSmallest and
+// MultiTreeRangeCount with a scan of the array after every batch.
+//
+// The keys include the ends of int, so that the range count whose upper
+// bound is INT_MAX is exercised, and probes fall between keys and
+// outside them. The run finishes with a stream of many occurrences of a
+// few keys, after which the tree must still hold one node per key.
+//
+// Usage: ./multiCheck [-o operations] [-s seed]
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bBST.h"
+#include "multiBST.h"
+
+#define DEFAULT_OPS 200000
+// Operations between two full comparisons
+#define BATCH 500
+// Keys are the ends of int and every third integer in between these
+#define SPAN 600
+#define NUM_KEYS (SPAN / 3 + 2)
+#define HEAVY_KEYS 1000
+#define HEAVY_OCCURRENCES 1000000
+
+typedef struct reference
+{
+	// In ascending order
+	int keys[NUM_KEYS];
+	long long counts[NUM_KEYS];
+} Reference;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkRandom(int ops, unsigned int seed);
+static bool checkQueries(MultiTree t, Reference *ref, unsigned int *state);
+static bool checkHeavy(void);
+static int randomProbe(unsigned int *state);
+static long long refSize(Reference *ref);
+static int refDistinct(Reference *ref);
+static long long refRank(Reference *ref, int key);
+static int refKth(Reference *ref, long long k);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int failures = 0;
+	failures += !checkRandom(ops, (seed == 0) ? 1 : seed);
+	failures += !checkHeavy();
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Random changes against the reference counts, with every query
+ * compared after each batch
+ */
+static bool checkRandom(int ops, unsigned int seed)
+{
+	Reference ref = {.keys = {INT_MIN + 1}};
+	for (int i = 1; i < NUM_KEYS - 1; i++)
+		ref.keys[i] = -SPAN / 2 + 3 * (i - 1);
+	ref.keys[NUM_KEYS - 1] = INT_MAX;
+
+	MultiTree t = MultiTreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		// Every key would end up present after a while with as many
+		// deletes as inserts, so the mix changes from batch to batch
+		int insertPct = (i / BATCH % 2 == 0) ? 70 : 35;
+		int j = (int)(NextRandom(&state) % NUM_KEYS);
+		int key = ref.keys[j];
+		int action = (int)(NextRandom(&state) % 100);
+
+		if (action < insertPct)
+		{
+			long long count = MultiTreeInsert(t, key);
+			if (count != ++ref.counts[j])
+			{
+				printf("FAIL insert %d returned %lld, expected %lld\n", key, count,
+					   ref.counts[j]);
+				ok = false;
+			}
+		}
+		else if (action < 97)
+		{
+			bool deleted = MultiTreeDelete(t, key);
+			if (deleted != (ref.counts[j] > 0))
+			{
+				printf("FAIL delete %d returned %d\n", key, deleted);
+				ok = false;
+			}
+			if (ref.counts[j] > 0)
+				ref.counts[j]--;
+		}
+		else
+		{
+			long long removed = MultiTreeDeleteAll(t, key);
+			if (removed != ref.counts[j])
+			{
+				printf("FAIL delete all %d removed %lld, expected %lld\n", key, removed,
+					   ref.counts[j]);
+				ok = false;
+			}
+			ref.counts[j] = 0;
+		}
+
+		if (ok && i % BATCH == BATCH - 1)
+			ok = checkQueries(t, &ref, &state);
+	}
+
+	if (ok)
+		ok = checkQueries(t, &ref, &state);
+
+	printf("%s random operations       %d operations, %d distinct keys at the end\n",
+		   ok ? "PASS" : "FAIL", ops, MultiTreeDistinct(t));
+	MultiTreeFree(t);
+	return ok;
+}
+
+/**
+ * Compare the size and every query with the reference: counts and ranks
+ * of probes, each k from -1 to one past the size, and random ranges
+ */
+static bool checkQueries(MultiTree t, Reference *ref, unsigned int *state)
+{
+	long long size = refSize(ref);
+	if (MultiTreeSize(t) != size || MultiTreeDistinct(t) != refDistinct(ref))
+	{
+		printf("FAIL size %lld and %d distinct, expected %lld and %d\n",
+			   MultiTreeSize(t), MultiTreeDistinct(t), size, refDistinct(ref));
+		return false;
+	}
+
+	for (int i = 0; i < NUM_KEYS; i++)
+	{
+		if (MultiTreeCount(t, ref->keys[i]) != ref->counts[i])
+		{
+			printf("FAIL count of %d is %lld, expected %lld\n", ref->keys[i],
+				   MultiTreeCount(t, ref->keys[i]), ref->counts[i]);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < 32; i++)
+	{
+		int key = randomProbe(state);
+		long long want = refRank(ref, key);
+		if (MultiTreeRank(t, key) != want)
+		{
+			printf("FAIL rank of %d is %lld, expected %lld\n", key,
+				   MultiTreeRank(t, key), want);
+			return false;
+		}
+	}
+
+	// Every k when the tree is small, a sample otherwise
+	long long step = (size > 2000) ? size / 1000 : 1;
+	for (long long k = -1; k <= size + 1; k += step)
+	{
+		int want = refKth(ref, k);
+		if (MultiTreeKthSmallest(t, k) != want)
+		{
+			printf("FAIL %lldth smallest is %d, expected %d\n", k,
+				   MultiTreeKthSmallest(t, k), want);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < 32; i++)
+	{
+		int lower = randomProbe(state);
+		int upper = randomProbe(state);
+		// Ordered three times in four, inverted ranges count nothing
+		if (NextRandom(state) % 4 != 0 && lower > upper)
+		{
+			int tmp = lower;
+			lower = upper;
+			upper = tmp;
+		}
+
+		long long want = 0;
+		for (int j = 0; j < NUM_KEYS; j++)
+			if (ref->keys[j] >= lower && ref->keys[j] <= upper)
+				want += ref->counts[j];
+
+		if (MultiTreeRangeCount(t, lower, upper) != want)
+		{
+			printf("FAIL range count [%d, %d] is %lld, expected %lld\n", lower, upper,
+				   MultiTreeRangeCount(t, lower, upper), want);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * A stream of many occurrences of a few keys changes only their counts,
+ * so the tree ends with one node for each key
+ */
+static bool checkHeavy(void)
+{
+	MultiTree t = MultiTreeNew();
+	unsigned int state = 12345;
+
+	for (int i = 0; i < HEAVY_OCCURRENCES; i++)
+		MultiTreeInsert(t, (int)(NextRandom(&state) % HEAVY_KEYS));
+
+	long long total = 0;
+	for (int k = 0; k < HEAVY_KEYS; k++)
+		total += MultiTreeCount(t, k);
+
+	bool ok = MultiTreeDistinct(t) == HEAVY_KEYS && MultiTreeSize(t) == HEAVY_OCCURRENCES &&
+			  total == HEAVY_OCCURRENCES && MultiTreeKthSmallest(t, 1) == 0 &&
+			  MultiTreeKthSmallest(t, HEAVY_OCCURRENCES) == HEAVY_KEYS - 1;
+
+	printf("%s repeated keys           %d occurrences of %d keys in %d nodes\n",
+		   ok ? "PASS" : "FAIL", HEAVY_OCCURRENCES, HEAVY_KEYS, MultiTreeDistinct(t));
+	MultiTreeFree(t);
+	return ok;
+}
+
+/**
+ * A key, a value between two keys, or one outside them all
+ */
+static int randomProbe(unsigned int *state)
+{
+	switch (NextRandom(state) % 8)
+	{
+	case 0:
+		return INT_MAX;
+	case 1:
+		return INT_MIN;
+	case 2:
+		return INT_MIN + 1;
+	default:
+		return (int)(NextRandom(state) % (SPAN + 20)) - SPAN / 2 - 10;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static long long refSize(Reference *ref)
+{
+	long long size = 0;
+	for (int i = 0; i < NUM_KEYS; i++)
+		size += ref->counts[i];
+	return size;
+}
+
+static int refDistinct(Reference *ref)
+{
+	int distinct = 0;
+	for (int i = 0; i < NUM_KEYS; i++)
+		distinct += ref->counts[i] > 0;
+	return distinct;
+}
+
+static long long refRank(Reference *ref, int key)
+{
+	long long rank = 0;
+	for (int i = 0; i < NUM_KEYS && ref->keys[i] < key; i++)
+		rank += ref->counts[i];
+	return rank;
+}
+
+static int refKth(Reference *ref, long long k)
+{
+	if (k < 1)
+		return UNDEFINED;
+
+	for (int i = 0; i < NUM_KEYS; i++)
+	{
+		if (k <= ref->counts[i])
+			return ref->keys[i];
+		k -= ref->counts[i];
+	}
+	return UNDEFINED;
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,206 @@
+// Implementation of hardware performance counters for benchmarks.
+//
+// All events are opened as one group with PERF_FORMAT_GROUP, so a single
+// read returns every count for exactly the same interval. The time the
+// group was enabled and actually running is read as well; if the kernel
+// had to multiplex the PMU between groups, counts are scaled by
+// enabled / running.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perfCounters.h"
+
+static const char *EventNames[PERF_NUM_EVENTS] = {
+	"instructions", "cache-misses", "tlb-misses", "branch-misses", "page-faults"};
+
+#ifdef __linux__
+
+#define CACHE_EVENT(cache, op, result) \
+	((cache) | ((op) << 8) | ((result) << 16))
+
+static const struct
+{
+	uint32_t type;
+	uint64_t config;
+} Events[PERF_NUM_EVENTS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+									 PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static int OpenEvent(PerfEvent e, int group);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Opens the counter group, disabled.
+ */
+bool PerfOpen(PerfCounters *p)
+{
+	p->leader = -1;
+	p->error = NULL;
+
+	for (PerfEvent e = 0; e < PERF_NUM_EVENTS; e++)
+	{
+		p->fds[e] = OpenEvent(e, p->leader);
+
+		if (p->fds[e] < 0 && Events[e].type != PERF_TYPE_SOFTWARE && p->error == NULL)
+		{
+			switch (errno)
+			{
+			case ENOENT:
+			case EOPNOTSUPP:
+				p->error = "not supported by this CPU or hypervisor";
+				break;
+			case EACCES:
+			case EPERM:
+				p->error = "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+				break;
+			case ENOSYS:
+				p->error = "perf_event_open is not available";
+				break;
+			default:
+				p->error = strerror(errno);
+				break;
+			}
+		}
+
+		if (p->fds[e] >= 0 && p->leader < 0)
+			p->leader = p->fds[e];
+	}
+
+	return p->leader >= 0;
+}
+
+/**
+ * Zeroes and enables every counter in the group.
+ */
+void PerfStart(PerfCounters *p)
+{
+	if (p->leader < 0)
+		return;
+
+	ioctl(p->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(p->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/**
+ * Disables the group and reads the counts since PerfStart.
+ */
+void PerfStop(PerfCounters *p, PerfSample *s)
+{
+	memset(s, 0, sizeof(*s));
+	if (p->leader < 0)
+		return;
+
+	ioctl(p->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	// nr, time enabled, time running, then one value per member in the
+	// order the members were opened
+	uint64_t buf[3 + PERF_NUM_EVENTS];
+	ssize_t length = read(p->leader, buf, sizeof(buf));
+	if (length < (ssize_t)(3 * sizeof(uint64_t)))
+		return;
+
+	uint64_t members = buf[0];
+	double scale = 1;
+	if (buf[2] == 0)
+		return;
+	if (buf[2] < buf[1])
+		scale = (double)buf[1] / buf[2];
+
+	uint64_t i = 0;
+	for (PerfEvent e = 0; e < PERF_NUM_EVENTS && i < members; e++)
+	{
+		if (p->fds[e] < 0)
+			continue;
+
+		s->valid[e] = true;
+		s->counts[e] = buf[3 + i] * scale;
+		i++;
+	}
+}
+
+/**
+ * Closes every counter in the group.
+ */
+void PerfClose(PerfCounters *p)
+{
+	for (PerfEvent e = 0; e < PERF_NUM_EVENTS; e++)
+	{
+		if (p->fds[e] >= 0)
+			close(p->fds[e]);
+		p->fds[e] = -1;
+	}
+	p->leader = -1;
+}
+
+/**
+ * Open a single event for this thread in user space, as a member of
+ * group or as a new leader if group is -1
+ */
+static int OpenEvent(PerfEvent e, int group)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = Events[e].type;
+	attr.config = Events[e].config;
+	attr.disabled = (group < 0);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+					   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+#else
+
+bool PerfOpen(PerfCounters *p)
+{
+	for (PerfEvent e = 0; e < PERF_NUM_EVENTS; e++)
+		p->fds[e] = -1;
+	p->leader = -1;
+	p->error = "perf_event_open is only available on Linux";
+	return false;
+}
+
+void PerfStart(PerfCounters *p)
+{
+}
+
+void PerfStop(PerfCounters *p, PerfSample *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+void PerfClose(PerfCounters *p)
+{
+}
+
+#endif
+
+/**
+ * Returns a short name for an event.
+ */
+const char *PerfEventName(PerfEvent e)
+{
+	return EventNames[e];
+}
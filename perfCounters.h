@@ -0,0 +1,68 @@
+// Hardware performance counters for benchmarks.
+// Opens one perf_event_open group for the calling thread, counting
+// user-space instructions, cache misses, data TLB misses, branch misses
+// and page faults, so they can be read together around a timed region.
+// Events the kernel or CPU does not support are left out, and on
+// systems without perf_event_open (or with it restricted) nothing is
+// counted and PerfOpen reports why.
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum perfEvent
+{
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_TLB_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_PAGE_FAULTS,
+	PERF_NUM_EVENTS,
+} PerfEvent;
+
+typedef struct perfCounters
+{
+	// File descriptor for each event, -1 if it could not be opened
+	int fds[PERF_NUM_EVENTS];
+	// The first event opened leads the group
+	int leader;
+	// Why the hardware events could not be opened, if they could not
+	const char *error;
+} PerfCounters;
+
+typedef struct perfSample
+{
+	bool valid[PERF_NUM_EVENTS];
+	// Counts scaled up if the group was multiplexed with others
+	double counts[PERF_NUM_EVENTS];
+} PerfSample;
+
+/**
+ * Opens the counter group, disabled.
+ * Returns true if at least one event is being counted.
+ */
+bool PerfOpen(PerfCounters *p);
+
+/**
+ * Zeroes and enables every counter in the group.
+ */
+void PerfStart(PerfCounters *p);
+
+/**
+ * Disables the group and reads the counts since PerfStart.
+ */
+void PerfStop(PerfCounters *p, PerfSample *s);
+
+/**
+ * Closes every counter in the group.
+ */
+void PerfClose(PerfCounters *p);
+
+/**
+ * Returns a short name for an event, e.g. "cache-misses".
+ */
+const char *PerfEventName(PerfEvent e);
+
+#endif
@@ -0,0 +1,208 @@
+// Benchmark for draining a TreeQueue (bBSTQueue.h).
+// Builds a tree of -n shuffled keys and takes every key out in
+// ascending order three ways: TreeKthSmallest(t, 1) followed by
+// TreeDelete on a plain Tree, TreeQueuePopMin, and TreeQueuePopMinBatch
+// in batches of -b keys. Each is run -r times on a fresh tree and the
+// fastest run is reported, as keys taken out per second.
+//
+// Usage: ./queueBench [-n keys] [-b batch size] [-r repeats] [-x seed]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bBST.h"
+#include "bBSTQueue.h"
+
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_BATCH 64
+#define DEFAULT_REPEATS 3
+
+typedef enum drain
+{
+	DRAIN_KTH_DELETE,
+	DRAIN_POP_MIN,
+	DRAIN_POP_BATCH,
+	NUM_DRAINS,
+} Drain;
+
+static const char *DrainNames[NUM_DRAINS] = {"kth smallest + delete", "pop min",
+											  "pop min batch"};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static double Run(Drain d, int *keys, int n, int batch);
+static void Shuffle(int *keys, int n, unsigned int *state);
+static unsigned int NextRandom(unsigned int *state);
+static double Now(void);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int n = DEFAULT_KEYS;
+	int batch = DEFAULT_BATCH;
+	int repeats = DEFAULT_REPEATS;
+	unsigned int state = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			n = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			batch = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			repeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc)
+			state = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-n keys] [-b batch size] [-r repeats] [-x seed]\n",
+					argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (n < 1 || batch < 1 || repeats < 1)
+	{
+		fprintf(stderr, "Need at least 1 key, batch size and repeat\n");
+		return EXIT_FAILURE;
+	}
+
+	if (state == 0)
+		state = 1;
+
+	int *keys = malloc(sizeof(int) * n);
+	if (keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+	for (int i = 0; i < n; i++)
+		keys[i] = i;
+	Shuffle(keys, n, &state);
+
+	printf("draining %d shuffled keys, batches of %d\n", n, batch);
+	for (Drain d = 0; d < NUM_DRAINS; d++)
+	{
+		double best = 0;
+		for (int r = 0; r < repeats; r++)
+		{
+			double rate = Run(d, keys, n, batch);
+			if (rate > best)
+				best = rate;
+		}
+		printf("%-22s %12.0f keys/sec\n", DrainNames[d], best);
+	}
+
+	free(keys);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Build a tree of the keys and time taking them all out in order.
+ * Returns the keys taken out per second, or 0 if they did not come out
+ * in ascending order.
+ */
+static double Run(Drain d, int *keys, int n, int batch)
+{
+	int *out = malloc(sizeof(int) * batch);
+	if (out == NULL)
+	{
+		fprintf(stderr, "Could not malloc Batch\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Tree t = NULL;
+	TreeQueue q = NULL;
+	if (d == DRAIN_KTH_DELETE)
+	{
+		t = TreeNew();
+		for (int i = 0; i < n; i++)
+			TreeInsert(t, keys[i]);
+	}
+	else
+	{
+		q = TreeQueueNew();
+		for (int i = 0; i < n; i++)
+			TreeQueueInsert(q, keys[i]);
+	}
+
+	bool inOrder = true;
+	double start = Now();
+	switch (d)
+	{
+	case DRAIN_KTH_DELETE:
+		for (int i = 0; i < n; i++)
+		{
+			int min = TreeKthSmallest(t, 1);
+			inOrder = inOrder && min == i;
+			TreeDelete(t, min);
+		}
+		break;
+	case DRAIN_POP_MIN:
+		for (int i = 0; i < n; i++)
+			inOrder = inOrder && TreeQueuePopMin(q) == i;
+		break;
+	default:
+		for (int taken = 0; taken < n;)
+		{
+			int count = TreeQueuePopMinBatch(q, batch, out);
+			inOrder = inOrder && count > 0 && out[0] == taken && out[count - 1] == taken + count - 1;
+			if (count == 0)
+				break;
+			taken += count;
+		}
+		break;
+	}
+	double elapsed = Now() - start;
+
+	TreeFree(t);
+	TreeQueueFree(q);
+	free(out);
+
+	if (!inOrder)
+	{
+		fprintf(stderr, "%s took the keys out of order\n", DrainNames[d]);
+		return 0;
+	}
+	return n / elapsed;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static void Shuffle(int *keys, int n, unsigned int *state)
+{
+	for (int i = n - 1; i > 0; i--)
+	{
+		int j = (int)(NextRandom(state) % (unsigned int)(i + 1));
+		int temp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = temp;
+	}
+}
+
+/**
+ * xorshift32, seeded by -x so that runs can be repeated
+ */
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static double Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,382 @@
+// Checker for Balanced Binary Search Tree Queues (bBSTQueue.h).
+// Runs a random mix of inserts, deletes, pops from either end and batch
+// pops through a TreeQueue and an array of flags over the same keys.
+// After every operation the cached smallest and largest keys must match
+// the array. Every few operations the tree under the queue is walked to
+// check that it is a valid AVL tree with correct stored heights and the
+// same keys as the array.
+//
+// Batch pops drop whole subtrees and join what is left back together,
+// so they are also run on large trees with batch sizes from 1 up to most
+// of the tree, checking the tree after each.
+//
+// Usage: ./queueCheck [-o operations] [-s seed]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bBST.h"
+#include "bBSTQueue.h"
+
+#define DEFAULT_OPS 100000
+// Keys are drawn from [0, KEYSPACE)
+#define KEYSPACE 2048
+#define MAX_BATCH 300
+// Operations between two walks of the whole tree
+#define CHECK_EVERY 64
+#define LARGE_KEYS 100000
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkRandom(int ops, unsigned int seed);
+static bool checkBatches(unsigned int seed);
+static bool checkEmpty(void);
+static bool checkTree(TreeQueue q, bool *present, int keyspace);
+static int NodeCheck(Node n, long lower, long upper, bool *present, int *count, bool *ok);
+static int refMin(bool *present, int keyspace);
+static int refMax(bool *present, int keyspace);
+static void Shuffle(int *keys, int n, unsigned int *state);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkEmpty();
+	failures += !checkRandom(ops, seed);
+	failures += !checkBatches(seed);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Every pop of an empty queue, and of a queue emptied by one, answers
+ * UNDEFINED or 0
+ */
+static bool checkEmpty(void)
+{
+	TreeQueue q = TreeQueueNew();
+	int keys[4];
+
+	bool ok = TreeQueueMin(q) == UNDEFINED && TreeQueueMax(q) == UNDEFINED &&
+			  TreeQueuePopMin(q) == UNDEFINED && TreeQueuePopMax(q) == UNDEFINED &&
+			  TreeQueuePopMinBatch(q, 4, keys) == 0;
+
+	// A single key is both ends, and either pop leaves both empty
+	TreeQueueInsert(q, 5);
+	ok = ok && TreeQueueMin(q) == 5 && TreeQueueMax(q) == 5 && TreeQueuePopMax(q) == 5 &&
+		 TreeQueueMin(q) == UNDEFINED && TreeQueueMax(q) == UNDEFINED;
+	TreeQueueInsert(q, 5);
+	ok = ok && TreeQueuePopMin(q) == 5 && TreeQueueMax(q) == UNDEFINED;
+
+	// k of 0 or less takes nothing, more than the size takes everything
+	TreeQueueInsert(q, 1);
+	TreeQueueInsert(q, 2);
+	ok = ok && TreeQueuePopMinBatch(q, 0, keys) == 0 && TreeQueuePopMinBatch(q, -1, keys) == 0 &&
+		 TreeQueuePopMinBatch(q, 4, keys) == 2 && keys[0] == 1 && keys[1] == 2 &&
+		 TreeQueueMin(q) == UNDEFINED && TreeQueueMax(q) == UNDEFINED &&
+		 TreeQueueTree(q)->root == NULL;
+
+	printf("%s empty queues\n", ok ? "PASS" : "FAIL");
+	TreeQueueFree(q);
+	return ok;
+}
+
+/**
+ * Random operations against the reference, with the cache compared
+ * after each one
+ */
+static bool checkRandom(int ops, unsigned int seed)
+{
+	TreeQueue q = TreeQueueNew();
+	bool *present = calloc(KEYSPACE, sizeof(bool));
+	int *keys = malloc(MAX_BATCH * sizeof(int));
+	if (present == NULL || keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Reference\n");
+		exit(EXIT_FAILURE);
+	}
+
+	unsigned int state = seed;
+	bool ok = true;
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int key = (int)(NextRandom(&state) % KEYSPACE);
+		unsigned int action = NextRandom(&state) % 16;
+
+		// Only absent keys are inserted and present ones deleted, the
+		// Tree complains about the others
+		if (action < 8)
+		{
+			if (!present[key] && !TreeQueueInsert(q, key))
+			{
+				printf("FAIL insert %d returned false\n", key);
+				ok = false;
+			}
+			present[key] = true;
+		}
+		else if (action < 11)
+		{
+			// Deletes of the ends move the cache, the others must not
+			if (NextRandom(&state) % 4 == 0)
+				key = (NextRandom(&state) % 2) ? refMin(present, KEYSPACE)
+											   : refMax(present, KEYSPACE);
+			while (key != UNDEFINED && key < KEYSPACE && !present[key])
+				key++;
+			if (key != UNDEFINED && key < KEYSPACE)
+			{
+				if (!TreeQueueDelete(q, key))
+				{
+					printf("FAIL delete %d returned false\n", key);
+					ok = false;
+				}
+				present[key] = false;
+			}
+		}
+		else if (action < 13)
+		{
+			int want = refMin(present, KEYSPACE);
+			int popped = TreeQueuePopMin(q);
+			if (popped != want)
+			{
+				printf("FAIL pop min returned %d, expected %d\n", popped, want);
+				ok = false;
+			}
+			if (want != UNDEFINED)
+				present[want] = false;
+		}
+		else if (action < 15)
+		{
+			int want = refMax(present, KEYSPACE);
+			int popped = TreeQueuePopMax(q);
+			if (popped != want)
+			{
+				printf("FAIL pop max returned %d, expected %d\n", popped, want);
+				ok = false;
+			}
+			if (want != UNDEFINED)
+				present[want] = false;
+		}
+		else
+		{
+			int k = (int)(NextRandom(&state) % MAX_BATCH);
+			int popped = TreeQueuePopMinBatch(q, k, keys);
+			int expected = 0;
+			for (int j = 0; j < KEYSPACE && expected < k; j++)
+			{
+				if (!present[j])
+					continue;
+				if (expected >= popped || keys[expected] != j)
+					ok = false;
+				present[j] = false;
+				expected++;
+			}
+			if (!ok || popped != expected)
+			{
+				printf("FAIL batch of %d popped %d keys, expected %d\n", k, popped, expected);
+				ok = false;
+			}
+		}
+
+		int min = refMin(present, KEYSPACE);
+		int max = refMax(present, KEYSPACE);
+		if (ok && (TreeQueueMin(q) != min || TreeQueueMax(q) != max))
+		{
+			printf("FAIL cached ends %d and %d, expected %d and %d\n", TreeQueueMin(q),
+				   TreeQueueMax(q), min, max);
+			ok = false;
+		}
+
+		if (ok && i % CHECK_EVERY == 0)
+			ok = checkTree(q, present, KEYSPACE);
+	}
+
+	if (ok)
+		ok = checkTree(q, present, KEYSPACE);
+
+	printf("%s random operations  %d operations\n", ok ? "PASS" : "FAIL", ops);
+	TreeQueueFree(q);
+	free(present);
+	free(keys);
+	return ok;
+}
+
+/**
+ * Batch pops of every size out of large shuffled trees. Each batch must
+ * be the next keys in order and leave a valid AVL tree behind.
+ */
+static bool checkBatches(unsigned int seed)
+{
+	int *keys = malloc(LARGE_KEYS * sizeof(int));
+	int *popped = malloc(LARGE_KEYS * sizeof(int));
+	bool *present = malloc(LARGE_KEYS * sizeof(bool));
+	if (keys == NULL || popped == NULL || present == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	unsigned int state = seed;
+	bool ok = true;
+	int batches = 0;
+	for (int round = 0; round < 4 && ok; round++)
+	{
+		for (int i = 0; i < LARGE_KEYS; i++)
+		{
+			keys[i] = i;
+			present[i] = true;
+		}
+		Shuffle(keys, LARGE_KEYS, &state);
+
+		TreeQueue q = TreeQueueNew();
+		for (int i = 0; i < LARGE_KEYS; i++)
+			TreeQueueInsert(q, keys[i]);
+
+		// Sizes grow geometrically with some noise, so batches end both
+		// deep inside subtrees and on their edges
+		int next = 0;
+		for (int k = 1; next < LARGE_KEYS && ok; k = k * 2 + (int)(NextRandom(&state) % 3))
+		{
+			int count = TreeQueuePopMinBatch(q, k, popped);
+			int expected = (k < LARGE_KEYS - next) ? k : LARGE_KEYS - next;
+			ok = count == expected;
+			for (int i = 0; i < count && ok; i++)
+			{
+				ok = popped[i] == next + i;
+				present[next + i] = false;
+			}
+			next += count;
+			batches++;
+
+			ok = ok && TreeQueueMin(q) == ((next < LARGE_KEYS) ? next : UNDEFINED) &&
+				 TreeQueueMax(q) == ((next < LARGE_KEYS) ? LARGE_KEYS - 1 : UNDEFINED) &&
+				 checkTree(q, present, LARGE_KEYS);
+			if (!ok)
+				printf("FAIL batch of %d after %d keys\n", k, next - count);
+		}
+
+		TreeQueueFree(q);
+	}
+
+	printf("%s large batches      %d batches from %d keys\n", ok ? "PASS" : "FAIL", batches,
+		   LARGE_KEYS);
+	free(keys);
+	free(popped);
+	free(present);
+	return ok;
+}
+
+/**
+ * Walk the tree under the queue and check that it is an AVL tree with
+ * correct heights, holding exactly the keys flagged present
+ */
+static bool checkTree(TreeQueue q, bool *present, int keyspace)
+{
+	int count = 0;
+	bool ok = true;
+	NodeCheck(TreeQueueTree(q)->root, -1, keyspace, present, &count, &ok);
+
+	int expected = 0;
+	for (int i = 0; i < keyspace; i++)
+		expected += present[i];
+
+	if (!ok || count != expected)
+	{
+		printf("FAIL tree holds %d keys, expected %d%s\n", count, expected,
+			   ok ? "" : ", and is not a valid AVL tree");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Check the subtree rooted at n, whose keys must lie strictly between
+ * lower and upper. Returns its height as walked.
+ */
+static int NodeCheck(Node n, long lower, long upper, bool *present, int *count, bool *ok)
+{
+	if (n == NULL)
+		return -1;
+
+	(*count)++;
+	if (n->key <= lower || n->key >= upper || !present[n->key])
+		*ok = false;
+
+	int left = NodeCheck(n->left, lower, n->key, present, count, ok);
+	int right = NodeCheck(n->right, n->key, upper, present, count, ok);
+	int height = 1 + ((left > right) ? left : right);
+	if (abs(left - right) > 1 || n->height != height)
+		*ok = false;
+	return height;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int refMin(bool *present, int keyspace)
+{
+	for (int i = 0; i < keyspace; i++)
+		if (present[i])
+			return i;
+	return UNDEFINED;
+}
+
+static int refMax(bool *present, int keyspace)
+{
+	for (int i = keyspace - 1; i >= 0; i--)
+		if (present[i])
+			return i;
+	return UNDEFINED;
+}
+
+static void Shuffle(int *keys, int n, unsigned int *state)
+{
+	for (int i = n - 1; i > 0; i--)
+	{
+		int j = (int)(NextRandom(state) % (unsigned int)(i + 1));
+		int temp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = temp;
+	}
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
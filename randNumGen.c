@@ -1,30 +1,788 @@
+// Workload generator for Balanced Binary Search Trees.
+// Writes a seeded, reproducible stream of tree operations, either as a
+// testBBST script (one command per line, run with testBBST --batch) or
+// as a binary trace (see trace.h).
+//
+// Keys are drawn from [0, keyspace) with one of these patterns:
+//   uniform      every key equally likely
+//   zipf         a few hot keys, Zipfian with parameter theta, with the
+//                hot keys scattered over the keyspace
+//   sequential   ascending keys
+//   reverse      descending keys
+//   sawtooth     ascending runs of width keys across the whole keyspace,
+//                each starting just above the start of the previous run
+//   adversarial  ascending triples 3t + 2, 3t + 1, 3t, where two of every
+//                three inserts need a double rotation
+// Inserts and point reads follow the pattern. Deletes remove a live key:
+// a random one for uniform and zipf, otherwise the oldest, so the tree
+// behaves like a sliding window over the pattern.
+//
+// The legacy form `randNumGen N MAX` still writes a single insert line of
+// N keys below MAX followed by `w`.
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
-#include <time.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define DEFAULT_OPS 1000000L
+#define DEFAULT_KEYSPACE (1 << 20)
+#define DEFAULT_THETA 0.99
+#define DEFAULT_SPAN 64
+#define DEFAULT_WIDTH 64
+#define DEFAULT_MAX_K 64
+#define MAX_KEYSPACE (1 << 28)
+// zeta(n) is summed exactly up to this many terms and approximated above
+#define ZETA_EXACT 10000000
+// Attempts at drawing a key that is not in the tree before giving up
+#define INSERT_ATTEMPTS 4
+#define OUTPUT_BUFFER (1 << 20)
+
+typedef enum dist
+{
+	DIST_UNIFORM,
+	DIST_ZIPF,
+	DIST_SEQUENTIAL,
+	DIST_REVERSE,
+	DIST_SAWTOOTH,
+	DIST_ADVERSARIAL,
+	NUM_DISTS,
+} Dist;
+
+static const char *DistNames[NUM_DISTS] = {
+	"uniform", "zipf", "sequential", "reverse", "sawtooth", "adversarial"};
+
+typedef struct config
+{
+	long ops;
+	long load;
+	int keyspace;
+	uint64_t seed;
+	Dist dist;
+	double theta;
+	int span;
+	int width;
+	int maxK;
+	// Relative weight of each operation, indexed by TraceOp
+	int mix[TRACE_NUM_OPS];
+	bool binary;
+	// Output file, or NULL for stdout
+	const char *file;
+} Config;
+
+// Zipfian sampling in O(1) per key, from Gray et al., "Quickly
+// Generating Billion-Record Synthetic Databases"
+typedef struct zipf
+{
+	double theta;
+	double alpha;
+	double zetan;
+	double eta;
+	// Ranks are scattered over the keyspace by multiplying with a step
+	// coprime to it
+	uint64_t step;
+} Zipf;
+
+typedef struct generator
+{
+	Config *c;
+	uint64_t state;
+	Zipf zipf;
+	// Keys in the tree in no particular order, and the index of each key
+	// in live, or -1
+	int *live;
+	int *index;
+	int size;
+	// Position in the key pattern of the next insert, and of the oldest
+	// key that may still be in the tree
+	long insertCursor;
+	long deleteCursor;
+	// Cumulative weights of c->mix
+	int cumulative[TRACE_NUM_OPS];
+	int total;
+} Generator;
+
+// Text output buffer
+typedef struct output
+{
+	FILE *fp;
+	char *buf;
+	size_t used;
+} Output;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static int Legacy(int argc, char **argv);
+static bool ParseArgs(int argc, char **argv, Config *c);
+static bool ParseMix(char *s, int mix[TRACE_NUM_OPS]);
+static void GeneratorInit(Generator *g, Config *c);
+static void GeneratorFree(Generator *g);
+static void Generate(Generator *g, TraceWriter w, Output *out);
+static TraceOp NextOp(Generator *g);
+static void NextArgs(Generator *g, TraceOp op, int *a, int *b);
+static int InsertKey(Generator *g);
+static int DeleteKey(Generator *g);
+static int ReadKey(Generator *g);
+static int PatternKey(Generator *g, long i);
+static void Add(Generator *g, int key);
+static void Remove(Generator *g, int key);
+static void ZipfInit(Zipf *z, int n, double theta);
+static int ZipfKey(Zipf *z, int n, uint64_t r);
+static void Emit(Output *out, TraceOp op, int a, int b);
+static void OutputFlush(Output *out);
+static char *PutInt(char *p, int value);
+static uint64_t NextRandom(uint64_t *state);
+static int RandomBelow(uint64_t *state, int n);
+static uint64_t gcd(uint64_t a, uint64_t b);
+static void PrintUsage(const char *name);
+
+////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char **argv)
 {
-	int numTimes = rand() % 150;
-	int maxInputNum = rand() % 1000;
-	srand(time(NULL));
+	if (argc == 3 && argv[1][0] != '-')
+		return Legacy(argc, argv);
+
+	Config c = {
+		.ops = DEFAULT_OPS,
+		.load = 0,
+		.keyspace = DEFAULT_KEYSPACE,
+		.seed = 1,
+		.dist = DIST_UNIFORM,
+		.theta = DEFAULT_THETA,
+		.span = DEFAULT_SPAN,
+		.width = DEFAULT_WIDTH,
+		.maxK = DEFAULT_MAX_K,
+		.mix = {
+			[TRACE_INSERT] = 40,
+			[TRACE_DELETE] = 20,
+			[TRACE_SEARCH] = 20,
+			[TRACE_FLOOR] = 5,
+			[TRACE_CEILING] = 5,
+			[TRACE_KTH] = 4,
+			[TRACE_BETWEEN] = 4,
+			[TRACE_LCA] = 2,
+		},
+		.binary = false,
+		.file = NULL,
+	};
+
+	if (!ParseArgs(argc, argv, &c))
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *fp = (c.file == NULL) ? stdout : fopen(c.file, c.binary ? "wb" : "w");
+	if (fp == NULL)
+	{
+		perror(c.file);
+		return EXIT_FAILURE;
+	}
+
+	Generator g;
+	GeneratorInit(&g, &c);
+
+	Output out = {fp, NULL, 0};
+	TraceWriter w = NULL;
+	if (c.binary)
+		w = TraceWriterNew(fp, TRACE_LZ);
+	else if ((out.buf = malloc(OUTPUT_BUFFER)) == NULL)
+	{
+		fprintf(stderr, "Could not malloc Output\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Generate(&g, w, &out);
+
+	TraceWriterFree(w);
+	OutputFlush(&out);
+	free(out.buf);
+	GeneratorFree(&g);
+
+	if (fclose(fp) != 0)
+	{
+		perror(c.file == NULL ? "stdout" : c.file);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * randNumGen N MAX: one insert line of N keys below MAX, then save
+ */
+static int Legacy(int argc, char **argv)
+{
+	long n = strtol(argv[1], NULL, 10);
+	long max = strtol(argv[2], NULL, 10);
+
+	if (n <= 0 || max <= 0 || max > INT_MAX)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t state = 1;
+	char line[16];
+
+	fputs("+", stdout);
+	for (long i = 0; i < n; i++)
+	{
+		char *end = PutInt(line, RandomBelow(&state, (int)max));
+		*end = '\0';
+		putchar(' ');
+		fputs(line, stdout);
+	}
+	fputs("\nw\n", stdout);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Parse the options into c, returns false if any is invalid
+ */
+static bool ParseArgs(int argc, char **argv, Config *c)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		char *opt = argv[i];
+		if (opt[0] != '-' || opt[1] == '\0' || opt[2] != '\0' || i + 1 >= argc)
+			return false;
+
+		char *arg = argv[++i];
+		char *end;
+		long value = strtol(arg, &end, 10);
+		bool numeric = end != arg && *end == '\0';
+
+		switch (opt[1])
+		{
+		case 'n':
+			c->ops = value;
+			if (!numeric || value < 0)
+				return false;
+			break;
+		case 'l':
+			c->load = value;
+			if (!numeric || value < 0)
+				return false;
+			break;
+		case 'k':
+			if (!numeric || value < 1 || value > MAX_KEYSPACE)
+				return false;
+			c->keyspace = (int)value;
+			break;
+		case 's':
+			c->seed = strtoull(arg, &end, 10);
+			if (end == arg || *end != '\0')
+				return false;
+			break;
+		case 'd':
+			c->dist = NUM_DISTS;
+			for (Dist d = 0; d < NUM_DISTS; d++)
+				if (strcmp(arg, DistNames[d]) == 0)
+					c->dist = d;
+			if (c->dist == NUM_DISTS)
+				return false;
+			break;
+		case 'z':
+			c->theta = strtod(arg, &end);
+			if (end == arg || *end != '\0' || c->theta <= 0 || c->theta >= 1)
+				return false;
+			break;
+		case 'm':
+		case 'w':
+		case 'K':
+			if (!numeric || value < 1 || value > INT_MAX)
+				return false;
+			*(opt[1] == 'm' ? &c->span : opt[1] == 'w' ? &c->width : &c->maxK) = (int)value;
+			break;
+		case 'r':
+			if (!ParseMix(arg, c->mix))
+				return false;
+			break;
+		case 'o':
+			if (strcmp(arg, "text") != 0 && strcmp(arg, "binary") != 0)
+				return false;
+			c->binary = arg[0] == 'b';
+			break;
+		case 'f':
+			c->file = arg;
+			break;
+		default:
+			return false;
+		}
+	}
+
+	if (c->dist == DIST_ADVERSARIAL && c->keyspace < 3)
+		return false;
+
+	return true;
+}
+
+/**
+ * Parse weights such as "insert=20,search=70,delete=10"
+ */
+static bool ParseMix(char *s, int mix[TRACE_NUM_OPS])
+{
+	int parsed[TRACE_NUM_OPS] = {0};
+	long total = 0;
+
+	while (*s != '\0')
+	{
+		char *eq = strchr(s, '=');
+		if (eq == NULL)
+			return false;
+
+		TraceOp op = TRACE_INSERT;
+		while (op < TRACE_PHASE &&
+			   (strlen(TraceOpName(op)) != (size_t)(eq - s) ||
+				strncmp(TraceOpName(op), s, eq - s) != 0))
+			op++;
+		if (op == TRACE_PHASE)
+			return false;
+
+		char *end;
+		long weight = strtol(eq + 1, &end, 10);
+		if (end == eq + 1 || weight < 0 || weight > 1000000)
+			return false;
+
+		total += weight - parsed[op];
+		parsed[op] = (int)weight;
+
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return false;
+		s = end;
+	}
+
+	if (total == 0)
+		return false;
+
+	memcpy(mix, parsed, sizeof(parsed));
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Generating
+
+static void GeneratorInit(Generator *g, Config *c)
+{
+	memset(g, 0, sizeof(*g));
+	g->c = c;
+
+	// Spread the seed over the whole state, which must not be 0
+	g->state = c->seed;
+	g->state = NextRandom(&g->state) | 1;
+
+	if (c->dist == DIST_ZIPF)
+		ZipfInit(&g->zipf, c->keyspace, c->theta);
+
+	g->live = malloc(c->keyspace * sizeof(int));
+	g->index = malloc(c->keyspace * sizeof(int));
+	if (g->live == NULL || g->index == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+	memset(g->index, -1, c->keyspace * sizeof(int));
+
+	for (TraceOp op = TRACE_INSERT; op < TRACE_PHASE; op++)
+	{
+		g->total += c->mix[op];
+		g->cumulative[op] = g->total;
+	}
+}
+
+static void GeneratorFree(Generator *g)
+{
+	free(g->live);
+	free(g->index);
+}
+
+/**
+ * Write the load phase, inserts only, then the mixed operations
+ */
+static void Generate(Generator *g, TraceWriter w, Output *out)
+{
+	int a, b;
+
+	if (w != NULL)
+		TraceWrite(w, TRACE_PHASE, 0, 0);
+	for (long i = 0; i < g->c->load; i++)
+	{
+		NextArgs(g, TRACE_INSERT, &a, &b);
+		if (w != NULL)
+			TraceWrite(w, TRACE_INSERT, a, b);
+		else
+			Emit(out, TRACE_INSERT, a, b);
+	}
+
+	if (w != NULL)
+		TraceWrite(w, TRACE_PHASE, 1, 0);
+	for (long i = 0; i < g->c->ops; i++)
+	{
+		TraceOp op = NextOp(g);
+		NextArgs(g, op, &a, &b);
+		if (w != NULL)
+			TraceWrite(w, op, a, b);
+		else
+			Emit(out, op, a, b);
+	}
+}
+
+/**
+ * Pick an operation according to the mix
+ */
+static TraceOp NextOp(Generator *g)
+{
+	int r = RandomBelow(&g->state, g->total);
+	TraceOp op = TRACE_INSERT;
+
+	while (r >= g->cumulative[op])
+		op++;
+
+	return op;
+}
 
-	if (argc > 1)
+/**
+ * Pick the arguments of an operation and apply it to the live keys
+ */
+static void NextArgs(Generator *g, TraceOp op, int *a, int *b)
+{
+	*b = 0;
+
+	switch (op)
+	{
+	case TRACE_INSERT:
+		*a = InsertKey(g);
+		Add(g, *a);
+		break;
+	case TRACE_DELETE:
+		*a = DeleteKey(g);
+		Remove(g, *a);
+		break;
+	case TRACE_KTH:
 	{
-		assert(argc == 3);
-		assert(atoi(argv[1]) > 0);
-		assert(atoi(argv[2]) > 0);
+		int maxK = (g->size < g->c->maxK) ? g->size : g->c->maxK;
+		*a = 1 + RandomBelow(&g->state, (maxK > 0) ? maxK : 1);
+		break;
+	}
+	case TRACE_BETWEEN:
+		*a = ReadKey(g);
+		*b = (*a > INT_MAX - g->c->span) ? INT_MAX : *a + g->c->span;
+		break;
+	case TRACE_LCA:
+		// TreeLCA needs both keys in the tree to do any work
+		*a = (g->size > 0) ? g->live[RandomBelow(&g->state, g->size)] : ReadKey(g);
+		*b = (g->size > 0) ? g->live[RandomBelow(&g->state, g->size)] : ReadKey(g);
+		break;
+	default:
+		*a = ReadKey(g);
+		break;
+	}
+}
 
-		numTimes = atoi(argv[1]);
-		maxInputNum = atoi(argv[2]);
+/**
+ * Next key to insert, preferring keys not already in the tree
+ */
+static int InsertKey(Generator *g)
+{
+	Config *c = g->c;
+	int key = 0;
+
+	switch (c->dist)
+	{
+	case DIST_UNIFORM:
+	case DIST_ZIPF:
+		for (int i = 0; i < INSERT_ATTEMPTS; i++)
+		{
+			key = ReadKey(g);
+			if (g->index[key] < 0)
+				break;
+		}
+		return key;
+	default:
+		// Skip keys the pattern has already put back in the tree
+		for (int i = 0; i < INSERT_ATTEMPTS; i++)
+		{
+			key = PatternKey(g, g->insertCursor++);
+			if (g->index[key] < 0)
+				break;
+		}
+		return key;
+	}
+}
+
+/**
+ * Next key to delete: random or oldest live key, or a miss if the tree
+ * is empty
+ */
+static int DeleteKey(Generator *g)
+{
+	if (g->size == 0)
+		return ReadKey(g);
+
+	if (g->c->dist == DIST_UNIFORM || g->c->dist == DIST_ZIPF)
+		return g->live[RandomBelow(&g->state, g->size)];
+
+	// The tree is not empty, so a live key is found before the delete
+	// cursor passes the insert cursor
+	for (;;)
+	{
+		int key = PatternKey(g, g->deleteCursor++);
+		if (g->index[key] >= 0)
+			return key;
 	}
+}
 
-	// int num1 = 1;
-	// int num2 = 2;
+/**
+ * Key for a point read
+ */
+static int ReadKey(Generator *g)
+{
+	uint64_t r = NextRandom(&g->state);
+
+	if (g->c->dist == DIST_ZIPF)
+		return ZipfKey(&g->zipf, g->c->keyspace, r);
+
+	return (int)(((r >> 32) * (uint64_t)g->c->keyspace) >> 32);
+}
+
+/**
+ * The i-th key of the sequential, reverse, sawtooth and adversarial
+ * patterns, which repeat after keyspace keys
+ */
+static int PatternKey(Generator *g, long i)
+{
+	int n = g->c->keyspace;
+	long j = i % n;
+
+	switch (g->c->dist)
+	{
+	case DIST_REVERSE:
+		return n - 1 - (int)j;
+	case DIST_SAWTOOTH:
+	{
+		// Runs of width keys step by n / width, so n / width runs cover
+		// the keyspace once
+		long width = (g->c->width < n) ? g->c->width : n;
+		long step = n / width;
+		long run = j / width;
+		if (run >= step)
+			return (int)j;
+		return (int)((j % width) * step + run);
+	}
+	case DIST_ADVERSARIAL:
+	{
+		// 3t + 2, 3t + 1, 3t
+		long t = j / 3;
+		if (3 * t + 2 >= n)
+			return (int)j;
+		return (int)(3 * t + 2 - j % 3);
+	}
+	default:
+		return (int)j;
+	}
+}
+
+static void Add(Generator *g, int key)
+{
+	if (g->index[key] >= 0)
+		return;
+
+	g->index[key] = g->size;
+	g->live[g->size++] = key;
+}
+
+static void Remove(Generator *g, int key)
+{
+	int i = g->index[key];
+	if (i < 0)
+		return;
+
+	int last = g->live[--g->size];
+	g->live[i] = last;
+	g->index[last] = i;
+	g->index[key] = -1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Zipfian keys
+
+static void ZipfInit(Zipf *z, int n, double theta)
+{
+	int exact = (n < ZETA_EXACT) ? n : ZETA_EXACT;
+	double zeta = 0;
 
-	printf("+");
-	for (int i = 0; i < numTimes; i++)
-		printf(" %d", rand() % maxInputNum);
+	for (int i = 1; i <= exact; i++)
+		zeta += pow(i, -theta);
 
-	printf("\nw\n");
-}
\ No newline at end of file
+	// The rest of the sum is close to the integral of x^-theta
+	if (n > exact)
+		zeta += (pow(n, 1 - theta) - pow(exact, 1 - theta)) / (1 - theta);
+
+	double zeta2 = 1 + pow(2, -theta);
+
+	z->theta = theta;
+	z->alpha = 1 / (1 - theta);
+	z->zetan = zeta;
+	z->eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zeta);
+
+	// An odd step near n times the golden ratio, moved up until it is
+	// coprime to n
+	z->step = (uint64_t)(n * 0.6180339887) | 1;
+	while (gcd(z->step, n) != 1)
+		z->step += 2;
+}
+
+/**
+ * Key of the given rank order, where rank 0 is the most popular
+ */
+static int ZipfKey(Zipf *z, int n, uint64_t r)
+{
+	double u = (double)(r >> 11) * (1.0 / 9007199254740992.0);
+	double uz = u * z->zetan;
+	uint64_t rank;
+
+	if (uz < 1)
+		rank = 0;
+	else if (uz < 1 + pow(0.5, z->theta))
+		rank = 1;
+	else
+		rank = (uint64_t)(n * pow(z->eta * u - z->eta + 1, z->alpha));
+
+	if (rank >= (uint64_t)n)
+		rank = n - 1;
+
+	return (int)((rank * z->step) % n);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Text output
+
+/**
+ * Append the testBBST command for an operation
+ */
+static void Emit(Output *out, TraceOp op, int a, int b)
+{
+	static const char *commands[TRACE_NUM_OPS] = {
+		[TRACE_INSERT] = "+ ",
+		[TRACE_DELETE] = "- ",
+		[TRACE_SEARCH] = "s ",
+		[TRACE_FLOOR] = "f ",
+		[TRACE_CEILING] = "C ",
+		[TRACE_KTH] = "k ",
+		[TRACE_BETWEEN] = "sb ",
+		[TRACE_LCA] = "a ",
+	};
+
+	// Command, two numbers and the separators
+	if (out->used + 32 > OUTPUT_BUFFER)
+		OutputFlush(out);
+
+	char *p = &out->buf[out->used];
+	const char *command = commands[op];
+	while (*command != '\0')
+		*p++ = *command++;
+
+	p = PutInt(p, a);
+	if (TraceOpArgs(op) == 2)
+	{
+		*p++ = ' ';
+		p = PutInt(p, b);
+	}
+	*p++ = '\n';
+
+	out->used = p - out->buf;
+}
+
+static void OutputFlush(Output *out)
+{
+	if (out->used > 0)
+		fwrite(out->buf, 1, out->used, out->fp);
+	out->used = 0;
+}
+
+/**
+ * Write value in decimal, returns the end of the digits
+ */
+static char *PutInt(char *p, int value)
+{
+	char digits[12];
+	int n = 0;
+	unsigned int v = (unsigned int)value;
+
+	if (value < 0)
+	{
+		*p++ = '-';
+		v = 0u - v;
+	}
+
+	do
+	{
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v != 0);
+
+	while (n > 0)
+		*p++ = digits[--n];
+
+	return p;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * xorshift64*, never returns 0 for a non-zero state
+ */
+static uint64_t NextRandom(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Random number in [0, n), for n > 0
+ */
+static int RandomBelow(uint64_t *state, int n)
+{
+	return (int)(((NextRandom(state) >> 32) * (uint64_t)n) >> 32);
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+	while (b != 0)
+	{
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [-n ops] [-l load inserts] [-k keyspace] [-s seed]\n"
+			"       [-d distribution] [-z zipf theta] [-w sawtooth width]\n"
+			"       [-m range span] [-K max k] [-r op=weight,...]\n"
+			"       [-o text|binary] [-f file]\n"
+			"   or: %s N MAX\n"
+			"Distributions: uniform (the default) zipf sequential reverse\n"
+			"               sawtooth adversarial\n"
+			"Operations: insert delete search floor ceiling kth between lca\n",
+			name, name);
+}
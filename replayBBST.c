@@ -0,0 +1,409 @@
+// Replayer for binary operation traces (see trace.h).
+// Maps the trace into memory and applies each record to a Tree through
+// the bBST.h API, with no text parsing in between. Time is measured per
+// phase of the trace, between TRACE_PHASE records, so the load and run
+// phases of a captured workload can be compared across engine changes.
+//
+// With -v the result of every record that carries an expectation is
+// checked. With -w a copy of the trace is written with the results of
+// this run recorded as expectations, which can then be verified against
+// later builds. Writing the copy is included in the timings.
+//
+// The result of a between record is the number of keys in the List that
+// TreeSearchBetween returned, read back through ListShow (see
+// listCapture.h). A List that is out of order, or holds a key outside
+// the range or not in the tree, has the result -1 and never matches.
+// Reading the List back is included in the timings too.
+//
+// Messages printed by the tree (e.g. for duplicate inserts) are
+// discarded while replaying.
+//
+// Usage: ./replayBBST [-v] [-w output trace] [-j] trace
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "List.h"
+#include "listCapture.h"
+#include "trace.h"
+
+// Mismatches printed in full before only counting them
+#define MAX_REPORTED 10
+
+typedef struct phase
+{
+	int number;
+	long ops;
+	long opsByType[TRACE_NUM_OPS];
+	uint64_t ns;
+} Phase;
+
+typedef struct replay
+{
+	bool verify;
+	bool json;
+	TraceWriter out;
+	Phase *phases;
+	int nphases;
+	int capacity;
+	long checked;
+	long mismatches;
+} Replay;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool Run(Replay *rp, Tree t, TraceReader *r);
+static int Apply(Tree t, TraceRecord *rec, bool wantResult);
+static void Check(Replay *rp, long index, TraceRecord *rec, int result);
+static Phase *StartPhase(Replay *rp, int number);
+static void Report(Replay *rp);
+static int CountList(Tree t, List l, int lower, int upper);
+static uint64_t Now(void);
+static void PrintUsage(const char *name);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	Replay rp = {0};
+	const char *input = NULL;
+	const char *output = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-v") == 0)
+			rp.verify = true;
+		else if (strcmp(argv[i], "-j") == 0)
+			rp.json = true;
+		else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (argv[i][0] != '-' && input == NULL)
+			input = argv[i];
+		else
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (input == NULL)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int fd = open(input, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0)
+	{
+		perror(input);
+		return EXIT_FAILURE;
+	}
+
+	size_t size = st.st_size;
+	const uint8_t *data = (size == 0) ? NULL : mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		perror(input);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	if (data != NULL)
+		madvise((void *)data, size, MADV_SEQUENTIAL);
+
+	TraceReader r;
+	if (data == NULL || !TraceReaderInit(&r, data, size))
+	{
+		fprintf(stderr, "%s: not a trace\n", input);
+		return EXIT_FAILURE;
+	}
+
+	FILE *fp = NULL;
+	if (output != NULL)
+	{
+		if ((fp = fopen(output, "wb")) == NULL)
+		{
+			perror(output);
+			return EXIT_FAILURE;
+		}
+		rp.out = TraceWriterNew(fp, TRACE_LZ);
+	}
+
+	Tree t = TreeNew();
+	bool ok = Run(&rp, t, &r);
+	TreeFree(t);
+
+	if (!ok)
+		fprintf(stderr, "%s: %s\n", input, r.error);
+
+	if (rp.out != NULL)
+	{
+		TraceWriterFree(rp.out);
+		if (fclose(fp) != 0)
+		{
+			perror(output);
+			ok = false;
+		}
+	}
+
+	Report(&rp);
+
+	TraceReaderFree(&r);
+	munmap((void *)data, size);
+	free(rp.phases);
+
+	return (ok && rp.mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Replay every record, returns false if the trace is malformed
+ */
+static bool Run(Replay *rp, Tree t, TraceReader *r)
+{
+	// Keep the tree quiet, it reports every rejected insert or delete
+	fflush(stderr);
+	int savedStderr = dup(STDERR_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (savedStderr >= 0 && devNull >= 0)
+		dup2(devNull, STDERR_FILENO);
+
+	bool wantResult = rp->verify || rp->out != NULL;
+	Phase *phase = NULL;
+	uint64_t start = Now();
+	TraceRecord rec;
+	long index = 0;
+
+	for (; TraceNext(r, &rec); index++)
+	{
+		if (rec.op == TRACE_PHASE)
+		{
+			uint64_t now = Now();
+			if (phase != NULL)
+				phase->ns += now - start;
+			phase = StartPhase(rp, rec.args[0]);
+			start = now;
+
+			if (rp->out != NULL)
+				TraceWrite(rp->out, TRACE_PHASE, rec.args[0], 0);
+			continue;
+		}
+
+		// Records before the first phase marker are phase 0
+		if (phase == NULL)
+			phase = StartPhase(rp, 0);
+
+		int result = Apply(t, &rec, wantResult);
+		phase->ops++;
+		phase->opsByType[rec.op]++;
+
+		if (rp->verify && rec.expected)
+			Check(rp, index, &rec, result);
+		if (rp->out != NULL)
+			TraceWriteExpected(rp->out, rec.op, rec.args[0], rec.args[1], result);
+	}
+
+	if (phase != NULL)
+		phase->ns += Now() - start;
+
+	if (savedStderr >= 0)
+	{
+		dup2(savedStderr, STDERR_FILENO);
+		close(savedStderr);
+	}
+	if (devNull >= 0)
+		close(devNull);
+
+	return r->error == NULL;
+}
+
+/**
+ * Apply one record to the tree and return its result in the encoding of
+ * trace.h. The List of a range is only read back if wantResult is set.
+ */
+static int Apply(Tree t, TraceRecord *rec, bool wantResult)
+{
+	int a = rec->args[0];
+	int b = rec->args[1];
+	List l;
+
+	switch (rec->op)
+	{
+	case TRACE_INSERT:
+		return TreeInsert(t, a);
+	case TRACE_DELETE:
+		return TreeDelete(t, a);
+	case TRACE_SEARCH:
+		return TreeSearch(t, a);
+	case TRACE_FLOOR:
+		return TreeFloor(t, a);
+	case TRACE_CEILING:
+		return TreeCeiling(t, a);
+	case TRACE_KTH:
+		return TreeKthSmallest(t, a);
+	case TRACE_LCA:
+		return TreeLCA(t, a, b);
+	case TRACE_BETWEEN:
+	{
+		l = TreeSearchBetween(t, a, b);
+		int count = wantResult ? CountList(t, l, a, b) : 0;
+		ListFree(l);
+		return count;
+	}
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Compare a result with the expectation recorded in the trace
+ */
+static void Check(Replay *rp, long index, TraceRecord *rec, int result)
+{
+	rp->checked++;
+	if (result == rec->result)
+		return;
+
+	if (rp->mismatches++ < MAX_REPORTED)
+	{
+		printf("Record %ld: %s %d", index, TraceOpName(rec->op), rec->args[0]);
+		if (TraceOpArgs(rec->op) == 2)
+			printf(" %d", rec->args[1]);
+		printf(" returned %d, expected %d\n", result, rec->result);
+	}
+}
+
+/**
+ * Returns the timings for a phase, adding it the first time it is seen
+ */
+static Phase *StartPhase(Replay *rp, int number)
+{
+	for (int i = 0; i < rp->nphases; i++)
+		if (rp->phases[i].number == number)
+			return &rp->phases[i];
+
+	if (rp->nphases == rp->capacity)
+	{
+		rp->capacity = (rp->capacity == 0) ? 4 : rp->capacity * 2;
+		rp->phases = realloc(rp->phases, rp->capacity * sizeof(Phase));
+
+		if (rp->phases == NULL)
+		{
+			fprintf(stderr, "Could not grow Phases\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	Phase *p = &rp->phases[rp->nphases++];
+	memset(p, 0, sizeof(*p));
+	p->number = number;
+	return p;
+}
+
+/**
+ * Print the timings of each phase and the total, and the verification
+ * summary
+ */
+static void Report(Replay *rp)
+{
+	Phase total = {0};
+
+	for (int i = 0; i <= rp->nphases; i++)
+	{
+		bool last = i == rp->nphases;
+		Phase *p = last ? &total : &rp->phases[i];
+		double seconds = p->ns / 1e9;
+		double rate = (seconds > 0) ? p->ops / seconds : 0;
+		double perOp = (p->ops > 0) ? (double)p->ns / p->ops : 0;
+
+		if (rp->json)
+		{
+			if (last)
+				printf("{\"phase\": \"total\"");
+			else
+				printf("{\"phase\": %d", p->number);
+			printf(", \"ops\": %ld, \"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+				   "\"ns_per_op\": %.1f",
+				   p->ops, seconds, rate, perOp);
+			for (TraceOp op = TRACE_INSERT; op < TRACE_PHASE; op++)
+				printf(", \"%s\": %ld", TraceOpName(op), p->opsByType[op]);
+			printf("}\n");
+		}
+		else
+		{
+			if (i == 0)
+				printf("%-8s %12s %12s %14s %10s\n", "phase", "ops", "seconds", "ops/sec", "ns/op");
+			if (last)
+				printf("%-8s", "total");
+			else
+				printf("%-8d", p->number);
+			printf(" %12ld %12.6f %14.0f %10.1f\n", p->ops, seconds, rate, perOp);
+		}
+
+		if (last)
+			break;
+
+		total.ops += p->ops;
+		total.ns += p->ns;
+		for (TraceOp op = TRACE_INSERT; op < TRACE_PHASE; op++)
+			total.opsByType[op] += p->opsByType[op];
+	}
+
+	if (rp->verify)
+	{
+		if (rp->mismatches > MAX_REPORTED)
+			printf("... and %ld more\n", rp->mismatches - MAX_REPORTED);
+		printf("Verified %ld results, %ld mismatches\n", rp->checked, rp->mismatches);
+		if (rp->checked == 0)
+			printf("The trace records no expected results, write one with -w\n");
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Number of keys in a List returned by TreeSearchBetween, or -1 unless
+ * they are in increasing order, between lower and upper inclusive and
+ * all in the tree
+ */
+static int CountList(Tree t, List l, int lower, int upper)
+{
+	int *keys;
+	int n = ListCapture(l, &keys);
+
+	for (int i = 0; i < n; i++)
+	{
+		if (keys[i] < lower || keys[i] > upper || (i > 0 && keys[i] <= keys[i - 1]) ||
+			!TreeSearch(t, keys[i]))
+		{
+			n = -1;
+			break;
+		}
+	}
+
+	free(keys);
+	return n;
+}
+
+static uint64_t Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-v] [-w output trace] [-j] trace\n", name);
+}
@@ -0,0 +1,616 @@
+// Differential checker for Roaring Sets.
+// Runs the same updates through a RoaringSet and a Tree from bBST.h and
+// compares every answer: the return of each insert, delete and range
+// insert, and the size, keys, search, floor, ceiling, rank, k-th keys
+// and SearchBetween Lists after them. Lists are read back with
+// ListCapture.
+//
+// Three passes aim at the places where the containers change:
+// - threshold drives single chunks across ARRAY_MAX (4096) keys in both
+//   directions, by single keys and by ranges, at chunk 0 (which holds
+//   INT_MIN + 1), the chunks either side of 0 and the chunk of INT_MAX
+// - ranges inserts ranges that start, end and cross at chunk edges,
+//   whole chunks that become runs, and deletes single keys from them
+// - random mixes all of it with RunOptimize, on keys either side of 0
+//   and at the ends of int
+//
+// Usage: ./roaringCheck [-o operations] [-s seed]
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "List.h"
+#include "listCapture.h"
+#include "roaringSet.h"
+
+#define DEFAULT_OPS 100000
+// Operations between two full comparisons
+#define BATCH 4000
+#define CHUNK_SIZE 65536
+#define ARRAY_MAX 4096
+// Random keys fall within WINDOW of a chunk edge
+#define WINDOW 6144
+// Single updates around ARRAY_MAX for each chunk in the threshold pass
+#define HOVER_OPS 400
+
+// First keys of the chunks the threshold pass fills
+static const int ThresholdChunks[] = {INT_MIN, -CHUNK_SIZE, 0, INT_MAX - CHUNK_SIZE + 1};
+#define NUM_THRESHOLD_CHUNKS (int)(sizeof(ThresholdChunks) / sizeof(ThresholdChunks[0]))
+
+// Chunk edges the random keys and probes gather around
+static const int Edges[] = {INT_MIN, 0, INT_MAX};
+#define NUM_EDGES (int)(sizeof(Edges) / sizeof(Edges[0]))
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkThreshold(unsigned int seed);
+static bool checkRanges(unsigned int seed);
+static bool checkRandom(int ops, unsigned int seed);
+static bool checkUpdate(RoaringSet s, Tree t, int key, bool insert);
+static bool checkRange(RoaringSet s, Tree t, int lower, int upper);
+static bool checkKey(RoaringSet s, Tree t, int key);
+static bool checkQueries(RoaringSet s, Tree t, unsigned int *state);
+static bool checkLists(const char *what, List got, List want);
+static int randomKey(unsigned int *state);
+static int randomProbe(unsigned int *state, int *keys, int size);
+static int Rank(int *keys, int size, int key);
+static int ChunkSize(RoaringSet s, int base);
+static int Silence(void);
+static void Restore(int saved);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkThreshold(seed);
+	failures += !checkRanges(seed);
+	failures += !checkRandom(ops, seed);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Fill chunks to ARRAY_MAX keys one at a time, step over it and back,
+ * hover around it, and cross it again by range inserts. The chunks fill
+ * up together, so the queries run across arrays and bitmaps side by
+ * side.
+ */
+static bool checkThreshold(unsigned int seed)
+{
+	RoaringSet s = RoaringSetNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	// The low 16 bits of each chunk in a random order
+	int *lows = malloc(CHUNK_SIZE * sizeof(int));
+	if (lows == NULL)
+	{
+		fprintf(stderr, "Could not malloc Lows\n");
+		exit(EXIT_FAILURE);
+	}
+	for (int i = 0; i < CHUNK_SIZE; i++)
+		lows[i] = i;
+	for (int i = CHUNK_SIZE - 1; i > 0; i--)
+	{
+		int j = (int)(NextRandom(&state) % (unsigned int)(i + 1));
+		int tmp = lows[i];
+		lows[i] = lows[j];
+		lows[j] = tmp;
+	}
+
+	// Up to ARRAY_MAX keys, then one more, then back
+	for (int i = 0; i <= ARRAY_MAX && ok; i++)
+		for (int c = 0; c < NUM_THRESHOLD_CHUNKS && ok; c++)
+			ok = checkUpdate(s, t, ThresholdChunks[c] + lows[i], true);
+	ok = ok && checkQueries(s, t, &state);
+
+	for (int c = 0; c < NUM_THRESHOLD_CHUNKS && ok; c++)
+		ok = checkUpdate(s, t, ThresholdChunks[c] + lows[0], false) &&
+			 checkKey(s, t, ThresholdChunks[c] + lows[0]);
+	ok = ok && checkQueries(s, t, &state);
+
+	// Single inserts and deletes of the first 2 * ARRAY_MAX lows keep
+	// each chunk within a few keys of ARRAY_MAX
+	for (int i = 0; i < HOVER_OPS && ok; i++)
+	{
+		for (int c = 0; c < NUM_THRESHOLD_CHUNKS && ok; c++)
+		{
+			int key = ThresholdChunks[c] + lows[NextRandom(&state) % (2 * ARRAY_MAX)];
+			int inChunk = ChunkSize(s, ThresholdChunks[c]);
+			bool insert = (inChunk == ARRAY_MAX) ? NextRandom(&state) % 2 == 0
+												 : inChunk < ARRAY_MAX;
+			ok = checkUpdate(s, t, key, insert) && checkKey(s, t, key);
+		}
+	}
+	ok = ok && checkQueries(s, t, &state);
+
+	// Ranges that stay under ARRAY_MAX after merging, and ranges that go
+	// over it
+	for (int c = 0; c < NUM_THRESHOLD_CHUNKS && ok; c++)
+	{
+		int base = ThresholdChunks[c];
+		int start = (int)(NextRandom(&state) % (CHUNK_SIZE - 512));
+		ok = checkRange(s, t, base + start, base + start + 7) &&
+			 checkRange(s, t, base + start, base + start + 511);
+	}
+	ok = ok && checkQueries(s, t, &state);
+
+	// And down below ARRAY_MAX again, out of the bitmaps
+	for (int i = 0; i < 2 * ARRAY_MAX && ok; i++)
+		for (int c = 0; c < NUM_THRESHOLD_CHUNKS && ok; c++)
+			ok = checkUpdate(s, t, ThresholdChunks[c] + lows[i], false);
+	ok = ok && checkQueries(s, t, &state);
+
+	printf("%s threshold          %d chunks, %d keys left\n", ok ? "PASS" : "FAIL",
+		   NUM_THRESHOLD_CHUNKS, RoaringSetSize(s));
+	free(lows);
+	RoaringSetFree(s);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Ranges on and across chunk edges, including both ends of int, whole
+ * chunks, and single deletes and inserts in the runs they leave. List.c
+ * frees its nodes recursively, so every List stays well under a few
+ * hundred thousand keys: each part starts from an empty set.
+ */
+static bool checkRanges(unsigned int seed)
+{
+	RoaringSet s = RoaringSetNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+
+	// Both ends of int, UNDEFINED is skipped
+	bool ok = checkRange(s, t, INT_MIN, INT_MIN + 99) &&
+			  checkRange(s, t, INT_MAX - 99, INT_MAX) && checkRange(s, t, INT_MIN, INT_MIN) &&
+			  checkQueries(s, t, &state);
+
+	// A whole chunk, then a range covering one with a few keys either side
+	for (int part = 0; part < 2 && ok; part++)
+	{
+		RoaringSetFree(s);
+		TreeFree(t);
+		s = RoaringSetNew();
+		t = TreeNew();
+
+		ok = (part == 0) ? checkRange(s, t, 0, CHUNK_SIZE - 1)
+						 : checkRange(s, t, -CHUNK_SIZE - 100, 100) &&
+							   checkRange(s, t, -CHUNK_SIZE - 200, -CHUNK_SIZE + 200);
+		ok = ok && checkQueries(s, t, &state);
+
+		// Single keys out of and back into the runs and next to them
+		for (int i = 0; i < 2000 && ok; i++)
+		{
+			int key = (int)(NextRandom(&state) % (3 * CHUNK_SIZE)) - CHUNK_SIZE - 1000;
+			if (i % 4 == 0)
+				key = ((int)(NextRandom(&state) % 4) - 1) * CHUNK_SIZE -
+					  (int)(NextRandom(&state) % 2);
+			ok = checkUpdate(s, t, key, i % 3 == 0) && checkKey(s, t, key);
+		}
+		ok = ok && checkQueries(s, t, &state);
+	}
+
+	// Short ranges crossing an edge, and overlapping each other
+	RoaringSetFree(s);
+	TreeFree(t);
+	s = RoaringSetNew();
+	t = TreeNew();
+	for (int i = 0; i < 256 && ok; i++)
+	{
+		int edge = ((int)(NextRandom(&state) % 8) - 2) * CHUNK_SIZE;
+		int lower = edge - (int)(NextRandom(&state) % 300);
+		ok = checkRange(s, t, lower, edge + (int)(NextRandom(&state) % 300));
+	}
+	ok = ok && checkQueries(s, t, &state);
+
+	// Consecutive keys inserted one at a time stay in an array until
+	// RunOptimize turns it into a single run
+	for (int key = 6 * CHUNK_SIZE + 10; key < 6 * CHUNK_SIZE + 3010 && ok; key++)
+		ok = checkUpdate(s, t, key, true);
+
+	size_t before = RoaringSetMemory(s);
+	RoaringSetRunOptimize(s);
+	ok = ok && checkQueries(s, t, &state);
+	if (ok && RoaringSetMemory(s) >= before)
+	{
+		printf("FAIL run optimize took the set from %zu to %zu bytes\n", before,
+			   RoaringSetMemory(s));
+		ok = false;
+	}
+
+	printf("%s ranges             %d keys, %zu bytes\n", ok ? "PASS" : "FAIL",
+		   RoaringSetSize(s), RoaringSetMemory(s));
+	RoaringSetFree(s);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Random inserts, deletes and short ranges near the chunk edges, growing
+ * and shrinking the set in turns, with RunOptimize now and then and
+ * every query compared after each batch
+ */
+static bool checkRandom(int ops, unsigned int seed)
+{
+	RoaringSet s = RoaringSetNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int insertPct = (i / (4 * BATCH) % 2 == 0) ? 75 : 25;
+		int key = randomKey(&state);
+		unsigned int action = NextRandom(&state) % 100;
+
+		if (action == 0)
+			RoaringSetRunOptimize(s);
+		else if (action < 4)
+		{
+			int span = (int)(NextRandom(&state) % 64);
+			ok = checkRange(s, t, key, (key > INT_MAX - span) ? INT_MAX : key + span);
+		}
+		else
+			ok = checkUpdate(s, t, key, (int)(NextRandom(&state) % 100) < insertPct);
+
+		if (ok && i % BATCH == BATCH - 1)
+			ok = checkQueries(s, t, &state);
+	}
+
+	if (ok)
+		ok = checkQueries(s, t, &state);
+
+	printf("%s random operations  %d operations, %d keys\n", ok ? "PASS" : "FAIL", ops,
+		   RoaringSetSize(s));
+	RoaringSetFree(s);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Insert or delete a key in both and compare what they return. The
+ * trees complain about duplicates and missing keys on stderr, which is
+ * silenced for the updates that are expected to be refused.
+ */
+static bool checkUpdate(RoaringSet s, Tree t, int key, bool insert)
+{
+	bool refused = (key == UNDEFINED) || (TreeSearch(t, key) == insert);
+	int saved = refused ? Silence() : -1;
+
+	bool got = insert ? RoaringSetInsert(s, key) : RoaringSetDelete(s, key);
+	bool want = insert ? TreeInsert(t, key) : TreeDelete(t, key);
+
+	if (refused)
+		Restore(saved);
+
+	if (got != want)
+	{
+		printf("FAIL %s %d returned %d, expected %d\n", insert ? "insert" : "delete", key, got,
+			   want);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Insert a range into both and compare the number of new keys
+ */
+static bool checkRange(RoaringSet s, Tree t, int lower, int upper)
+{
+	int got = RoaringSetInsertRange(s, lower, upper);
+
+	int want = 0;
+	int saved = Silence();
+	for (long long key = lower; key <= upper; key++)
+		if (key != UNDEFINED)
+			want += TreeInsert(t, (int)key);
+	Restore(saved);
+
+	if (got != want)
+	{
+		printf("FAIL insert range [%d, %d] added %d keys, expected %d\n", lower, upper, got,
+			   want);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the queries around one key, which is cheaper than all of
+ * checkQueries after every single update
+ */
+static bool checkKey(RoaringSet s, Tree t, int key)
+{
+	for (long long probe = (long long)key - 1; probe <= (long long)key + 1; probe++)
+	{
+		int k = (int)probe;
+		if (probe < INT_MIN || probe > INT_MAX)
+			continue;
+
+		if (RoaringSetSearch(s, k) != TreeSearch(t, k) ||
+			RoaringSetFloor(s, k) != TreeFloor(t, k) ||
+			RoaringSetCeiling(s, k) != TreeCeiling(t, k))
+		{
+			printf("FAIL probe %d: search %d, floor %d, ceiling %d; expected %d, %d, %d\n", k,
+				   RoaringSetSearch(s, k), RoaringSetFloor(s, k), RoaringSetCeiling(s, k),
+				   TreeSearch(t, k), TreeFloor(t, k), TreeCeiling(t, k));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Compare the keys, and every query on random probes, the ends of k and
+ * a sample of k in between, and random ranges. The ranks and k-th keys
+ * are compared with the keys of TreeToList.
+ */
+static bool checkQueries(RoaringSet s, Tree t, unsigned int *state)
+{
+	List got = RoaringSetToList(s);
+	List want = TreeToList(t);
+	int *keys;
+	int size = ListCapture(want, &keys);
+	bool ok = checkLists("to list", got, want);
+	ListFree(got);
+	ListFree(want);
+
+	if (ok && RoaringSetSize(s) != size)
+	{
+		printf("FAIL size is %d, expected %d\n", RoaringSetSize(s), size);
+		ok = false;
+	}
+
+	int *array = malloc((size > 0 ? size : 1) * sizeof(int));
+	if (array == NULL)
+	{
+		fprintf(stderr, "Could not malloc Array\n");
+		exit(EXIT_FAILURE);
+	}
+	if (ok && (RoaringSetToArray(s, array) != size ||
+			   (size > 0 && memcmp(array, keys, size * sizeof(int)) != 0)))
+	{
+		printf("FAIL to array differs from the keys\n");
+		ok = false;
+	}
+	free(array);
+
+	for (int i = 0; i < 128 && ok; i++)
+	{
+		int key = randomProbe(state, keys, size);
+		ok = checkKey(s, t, key);
+		if (ok && RoaringSetRank(s, key) != Rank(keys, size, key))
+		{
+			printf("FAIL rank of %d is %d, expected %d\n", key, RoaringSetRank(s, key),
+				   Rank(keys, size, key));
+			ok = false;
+		}
+	}
+
+	for (int i = 0; i < 64 && ok; i++)
+	{
+		int k;
+		if (i < 8)
+			k = (i < 4) ? i - 1 : size - 5 + i;
+		else
+			k = 1 + (int)(NextRandom(state) % (unsigned int)(size > 0 ? size : 1));
+
+		bool inRange = k >= 1 && k <= size;
+		int smallest = inRange ? keys[k - 1] : UNDEFINED;
+		int largest = inRange ? keys[size - k] : UNDEFINED;
+		if (RoaringSetKthSmallest(s, k) != smallest || RoaringSetKthLargest(s, k) != largest)
+		{
+			printf("FAIL k = %d: smallest %d, largest %d; expected %d, %d\n", k,
+				   RoaringSetKthSmallest(s, k), RoaringSetKthLargest(s, k), smallest,
+				   largest);
+			ok = false;
+		}
+	}
+
+	for (int i = 0; i < 24 && ok; i++)
+	{
+		// Mostly ranges within a chunk or two, otherwise between two
+		// probes, which may be inverted and are then empty
+		int lower = randomProbe(state, keys, size);
+		int upper = randomProbe(state, keys, size);
+		if (NextRandom(state) % 4 != 0)
+		{
+			long long span = NextRandom(state) % (2 * CHUNK_SIZE);
+			upper = ((long long)lower + span > INT_MAX) ? INT_MAX : (int)(lower + span);
+		}
+
+		got = RoaringSetSearchBetween(s, lower, upper);
+		want = TreeSearchBetween(t, lower, upper);
+		ok = checkLists("search between", got, want);
+		if (!ok)
+			printf("     range [%d, %d]\n", lower, upper);
+		ListFree(got);
+		ListFree(want);
+	}
+
+	free(keys);
+	return ok;
+}
+
+/**
+ * Compare two Lists value by value
+ */
+static bool checkLists(const char *what, List got, List want)
+{
+	int *gotKeys, *wantKeys;
+	int gotSize = ListCapture(got, &gotKeys);
+	int wantSize = ListCapture(want, &wantKeys);
+
+	bool ok = gotSize >= 0 && gotSize == wantSize;
+	int i = 0;
+	while (ok && i < gotSize && gotKeys[i] == wantKeys[i])
+		i++;
+	ok = ok && i == gotSize;
+
+	if (!ok)
+		printf("FAIL %s returned %d keys, expected %d, first difference at %d\n", what, gotSize,
+			   wantSize, i);
+
+	free(gotKeys);
+	free(wantKeys);
+	return ok;
+}
+
+/**
+ * A key within WINDOW of one of the edges, each side of an edge being
+ * its own chunk, or now and then UNDEFINED itself
+ */
+static int randomKey(unsigned int *state)
+{
+	if (NextRandom(state) % 256 == 0)
+		return UNDEFINED;
+
+	long long edge = Edges[NextRandom(state) % NUM_EDGES];
+	long long key = edge + (long long)(NextRandom(state) % (2 * WINDOW)) - WINDOW;
+	if (key < INT_MIN)
+		key += WINDOW;
+	if (key > INT_MAX)
+		key -= WINDOW;
+	return (int)key;
+}
+
+/**
+ * A key of the set or a value next to one, a chunk edge or a value next
+ * to one, or a random key
+ */
+static int randomProbe(unsigned int *state, int *keys, int size)
+{
+	long long probe;
+	switch (NextRandom(state) % 4)
+	{
+	case 0:
+		if (size > 0)
+		{
+			probe = (long long)keys[NextRandom(state) % size] + (int)(NextRandom(state) % 3) - 1;
+			break;
+		}
+		// fallthrough
+	case 1:
+		probe = (long long)((int)(NextRandom(state) % 16) - 8) * CHUNK_SIZE +
+				(int)(NextRandom(state) % 3) - 1;
+		break;
+	case 2:
+		probe = (NextRandom(state) % 2) ? (long long)INT_MIN + NextRandom(state) % 3
+										: (long long)INT_MAX - NextRandom(state) % 3;
+		break;
+	default:
+		probe = randomKey(state);
+		break;
+	}
+
+	if (probe < INT_MIN)
+		probe = INT_MIN;
+	if (probe > INT_MAX)
+		probe = INT_MAX;
+	return (int)probe;
+}
+
+/**
+ * The number of sorted keys less than or equal to key
+ */
+static int Rank(int *keys, int size, int key)
+{
+	int lo = 0;
+	int hi = size;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (keys[mid] <= key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * The number of keys in the chunk starting at base
+ */
+static int ChunkSize(RoaringSet s, int base)
+{
+	int below = (base == INT_MIN) ? 0 : RoaringSetRank(s, base - 1);
+	return RoaringSetRank(s, base + (CHUNK_SIZE - 1)) - below;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Silence(void)
+{
+	fflush(stderr);
+	int saved = dup(STDERR_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0)
+	{
+		dup2(devNull, STDERR_FILENO);
+		close(devNull);
+	}
+	return saved;
+}
+
+static void Restore(int saved)
+{
+	if (saved < 0)
+		return;
+
+	fflush(stderr);
+	dup2(saved, STDERR_FILENO);
+	close(saved);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
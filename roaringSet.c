@@ -0,0 +1,1180 @@
+// Implementation of the Roaring Set.
+//
+// Keys are mapped to unsigned 32-bit values by flipping the sign bit so
+// that unsigned order matches signed order. The top level is a sorted
+// array of the high 16 bits of every chunk that holds at least one key,
+// with a parallel array of containers for the low 16 bits.
+//
+// Array containers hold at most ARRAY_MAX sorted values and become
+// bitmaps when they grow past it. Bitmaps go back to arrays once they
+// shrink to ARRAY_MAX. Run containers are only created by range inserts
+// and RoaringSetRunOptimize, and are expanded back into an array or a
+// bitmap before a single key is added to or removed from them.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roaringSet.h"
+#include "List.h"
+
+#define CHUNK_SIZE 65536
+#define ARRAY_MAX 4096
+#define BITMAP_WORDS (CHUNK_SIZE / 64)
+#define NONE (-1)
+
+enum containerType
+{
+	ARRAY_CONTAINER,
+	BITMAP_CONTAINER,
+	RUN_CONTAINER
+};
+
+// A run covers the values start to start + length inclusive
+struct run
+{
+	uint16_t start;
+	uint16_t length;
+};
+
+typedef struct container
+{
+	enum containerType type;
+	int cardinality;
+	int length;	  // values in an array, runs in a run container
+	int capacity; // allocated values or runs
+	union
+	{
+		uint16_t *values;
+		uint64_t *words;
+		struct run *runs;
+	};
+} *Container;
+
+struct roaringSet
+{
+	uint16_t *keys;
+	struct container *containers;
+	int count;
+	int capacity;
+	int size;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static uint32_t ToUnsigned(int key);
+static int ToSigned(uint32_t u);
+static int FindIndex(RoaringSet s, uint16_t high);
+static Container GetOrCreate(RoaringSet s, uint16_t high);
+static void RemoveAt(RoaringSet s, int i);
+static void *Allocate(size_t size);
+
+static void ContainerFree(Container c);
+static size_t ContainerMemory(Container c);
+static bool ContainerContains(Container c, int low);
+static bool ContainerAdd(Container c, int low);
+static int ContainerAddRange(Container c, int lower, int upper);
+static bool ContainerRemove(Container c, int low);
+static int ContainerRank(Container c, int low);
+static int ContainerSelect(Container c, int i);
+static int ContainerFloor(Container c, int low);
+static int ContainerCeiling(Container c, int low);
+static void ContainerAppend(Container c, int lower, int upper, uint32_t base, List l);
+static int ContainerCopy(Container c, uint32_t base, int *out);
+static void ContainerOptimize(Container c);
+static int ContainerCountRuns(Container c);
+
+static int ArrayLowerBound(Container c, int low);
+static void ArrayReserve(Container c, int capacity);
+static void ToBitmap(Container c);
+static void ToArray(Container c);
+static void ToRun(Container c);
+static void Materialize(Container c);
+static int RunFind(Container c, int low);
+static uint64_t RangeMask(int lower, int upper);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty set.
+ */
+RoaringSet RoaringSetNew(void)
+{
+	RoaringSet s = Allocate(sizeof(*s));
+	s->keys = NULL;
+	s->containers = NULL;
+	s->count = 0;
+	s->capacity = 0;
+	s->size = 0;
+	return s;
+}
+
+/**
+ * Frees all memory allocated for the given set.
+ */
+void RoaringSetFree(RoaringSet s)
+{
+	if (s == NULL)
+		return;
+
+	for (int i = 0; i < s->count; i++)
+		ContainerFree(&s->containers[i]);
+
+	free(s->keys);
+	free(s->containers);
+	free(s);
+}
+
+/**
+ * Returns the number of keys in the set.
+ */
+int RoaringSetSize(RoaringSet s)
+{
+	return (s == NULL) ? 0 : s->size;
+}
+
+/**
+ * Returns the number of bytes allocated for the given set.
+ */
+size_t RoaringSetMemory(RoaringSet s)
+{
+	if (s == NULL)
+		return 0;
+
+	size_t bytes = sizeof(*s);
+	bytes += (size_t)s->capacity * (sizeof(*s->keys) + sizeof(*s->containers));
+	for (int i = 0; i < s->count; i++)
+		bytes += ContainerMemory(&s->containers[i]);
+
+	return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns true if the key is in the set or false otherwise.
+ */
+bool RoaringSetSearch(RoaringSet s, int key)
+{
+	if (s == NULL || key == UNDEFINED)
+		return false;
+
+	uint32_t u = ToUnsigned(key);
+	int i = FindIndex(s, u >> 16);
+	if (i < 0)
+		return false;
+
+	return ContainerContains(&s->containers[i], u & 0xFFFF);
+}
+
+/**
+ * Inserts the given key into the set.
+ */
+bool RoaringSetInsert(RoaringSet s, int key)
+{
+	if (s == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return false;
+	}
+
+	uint32_t u = ToUnsigned(key);
+	Container c = GetOrCreate(s, u >> 16);
+	if (!ContainerAdd(c, u & 0xFFFF))
+		return false;
+
+	s->size++;
+	return true;
+}
+
+/**
+ * Inserts every key between lower and upper (inclusive) into the set.
+ */
+int RoaringSetInsertRange(RoaringSet s, int lower, int upper)
+{
+	if (s == NULL || lower > upper)
+		return 0;
+
+	// UNDEFINED cannot be stored, so a range starting there skips it
+	if (lower == UNDEFINED)
+	{
+		if (upper == UNDEFINED)
+			return 0;
+		lower++;
+	}
+
+	uint32_t uLower = ToUnsigned(lower);
+	uint32_t uUpper = ToUnsigned(upper);
+
+	int added = 0;
+	for (uint32_t high = uLower >> 16; high <= uUpper >> 16; high++)
+	{
+		int a = (high == uLower >> 16) ? (int)(uLower & 0xFFFF) : 0;
+		int b = (high == uUpper >> 16) ? (int)(uUpper & 0xFFFF) : CHUNK_SIZE - 1;
+
+		Container c = GetOrCreate(s, high);
+		added += ContainerAddRange(c, a, b);
+
+		// Range inserts are where runs come from, so re-encode now
+		ContainerOptimize(c);
+	}
+
+	s->size += added;
+	return added;
+}
+
+/**
+ * Deletes the given key from the set if it is present.
+ */
+bool RoaringSetDelete(RoaringSet s, int key)
+{
+	if (s == NULL || key == UNDEFINED)
+		return false;
+
+	uint32_t u = ToUnsigned(key);
+	int i = FindIndex(s, u >> 16);
+	if (i < 0 || !ContainerRemove(&s->containers[i], u & 0xFFFF))
+		return false;
+
+	s->size--;
+	if (s->containers[i].cardinality == 0)
+		RemoveAt(s, i);
+
+	return true;
+}
+
+/**
+ * Converts every container to run encoding where that is smaller.
+ */
+void RoaringSetRunOptimize(RoaringSet s)
+{
+	if (s == NULL)
+		return;
+
+	for (int i = 0; i < s->count; i++)
+		ContainerOptimize(&s->containers[i]);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a list containing all the keys in the set in ascending order.
+ */
+List RoaringSetToList(RoaringSet s)
+{
+	List l = ListNew();
+	if (s == NULL)
+		return l;
+
+	for (int i = 0; i < s->count; i++)
+		ContainerAppend(&s->containers[i], 0, CHUNK_SIZE - 1,
+						(uint32_t)s->keys[i] << 16, l);
+
+	return l;
+}
+
+/**
+ * Copies all the keys in the set into out in ascending order.
+ */
+int RoaringSetToArray(RoaringSet s, int *out)
+{
+	if (s == NULL)
+		return 0;
+
+	int n = 0;
+	for (int i = 0; i < s->count; i++)
+		n += ContainerCopy(&s->containers[i], (uint32_t)s->keys[i] << 16, &out[n]);
+
+	return n;
+}
+
+/**
+ * Returns the number of keys in the set less than or equal to key.
+ * Whole containers are skipped by their cardinality.
+ */
+int RoaringSetRank(RoaringSet s, int key)
+{
+	if (s == NULL)
+		return 0;
+
+	uint32_t u = ToUnsigned(key);
+	uint16_t high = u >> 16;
+
+	int rank = 0;
+	for (int i = 0; i < s->count && s->keys[i] <= high; i++)
+	{
+		if (s->keys[i] < high)
+			rank += s->containers[i].cardinality;
+		else
+			rank += ContainerRank(&s->containers[i], u & 0xFFFF);
+	}
+
+	return rank;
+}
+
+/**
+ * Returns the k-th smallest key in the set.
+ */
+int RoaringSetKthSmallest(RoaringSet s, int k)
+{
+	if (s == NULL || k < 1 || k > s->size)
+		return UNDEFINED;
+
+	for (int i = 0; i < s->count; i++)
+	{
+		Container c = &s->containers[i];
+		if (k <= c->cardinality)
+		{
+			int low = ContainerSelect(c, k - 1);
+			return ToSigned(((uint32_t)s->keys[i] << 16) | (uint32_t)low);
+		}
+
+		k -= c->cardinality;
+	}
+
+	return UNDEFINED;
+}
+
+/**
+ * Returns the k-th largest key in the set.
+ */
+int RoaringSetKthLargest(RoaringSet s, int k)
+{
+	if (s == NULL || k < 1 || k > s->size)
+		return UNDEFINED;
+
+	return RoaringSetKthSmallest(s, s->size - k + 1);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ */
+int RoaringSetFloor(RoaringSet s, int key)
+{
+	if (s == NULL || s->count == 0)
+		return UNDEFINED;
+
+	uint32_t u = ToUnsigned(key);
+	int i = FindIndex(s, u >> 16);
+
+	if (i >= 0)
+	{
+		int low = ContainerFloor(&s->containers[i], u & 0xFFFF);
+		if (low != NONE)
+			return ToSigned((u & 0xFFFF0000u) | (uint32_t)low);
+		i--;
+	}
+	else
+	{
+		i = -i - 2;
+	}
+
+	// Containers are never empty, so the previous one holds the floor
+	if (i < 0)
+		return UNDEFINED;
+
+	int low = ContainerFloor(&s->containers[i], CHUNK_SIZE - 1);
+	return ToSigned(((uint32_t)s->keys[i] << 16) | (uint32_t)low);
+}
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ */
+int RoaringSetCeiling(RoaringSet s, int key)
+{
+	if (s == NULL || s->count == 0)
+		return UNDEFINED;
+
+	uint32_t u = ToUnsigned(key);
+	int i = FindIndex(s, u >> 16);
+
+	if (i >= 0)
+	{
+		int low = ContainerCeiling(&s->containers[i], u & 0xFFFF);
+		if (low != NONE)
+			return ToSigned((u & 0xFFFF0000u) | (uint32_t)low);
+		i++;
+	}
+	else
+	{
+		i = -i - 1;
+	}
+
+	if (i >= s->count)
+		return UNDEFINED;
+
+	int low = ContainerCeiling(&s->containers[i], 0);
+	return ToSigned(((uint32_t)s->keys[i] << 16) | (uint32_t)low);
+}
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in a list in ascending order.
+ */
+List RoaringSetSearchBetween(RoaringSet s, int lower, int upper)
+{
+	List l = ListNew();
+
+	if (s == NULL || lower > upper)
+		return l;
+
+	if (lower == UNDEFINED || upper == UNDEFINED)
+		return l;
+
+	uint32_t uLower = ToUnsigned(lower);
+	uint32_t uUpper = ToUnsigned(upper);
+
+	int i = FindIndex(s, uLower >> 16);
+	if (i < 0)
+		i = -i - 1;
+
+	for (; i < s->count && s->keys[i] <= uUpper >> 16; i++)
+	{
+		uint32_t high = s->keys[i];
+		int a = (high == uLower >> 16) ? (int)(uLower & 0xFFFF) : 0;
+		int b = (high == uUpper >> 16) ? (int)(uUpper & 0xFFFF) : CHUNK_SIZE - 1;
+		ContainerAppend(&s->containers[i], a, b, high << 16, l);
+	}
+
+	return l;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Top Level Helpers */
+
+static uint32_t ToUnsigned(int key)
+{
+	return (uint32_t)key ^ 0x80000000u;
+}
+
+static int ToSigned(uint32_t u)
+{
+	return (int)(u ^ 0x80000000u);
+}
+
+/**
+ * Binary search for the container of a chunk
+ * Returns its index, or -(insertion point) - 1 if there is none
+ */
+static int FindIndex(RoaringSet s, uint16_t high)
+{
+	int lo = 0;
+	int hi = s->count - 1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (s->keys[mid] == high)
+			return mid;
+		if (s->keys[mid] < high)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -lo - 1;
+}
+
+/**
+ * Returns the container of a chunk, adding an empty array container in
+ * order if the chunk has none
+ */
+static Container GetOrCreate(RoaringSet s, uint16_t high)
+{
+	int i = FindIndex(s, high);
+	if (i >= 0)
+		return &s->containers[i];
+
+	i = -i - 1;
+	if (s->count == s->capacity)
+	{
+		s->capacity = (s->capacity == 0) ? 4 : s->capacity * 2;
+		s->keys = realloc(s->keys, sizeof(*s->keys) * s->capacity);
+		s->containers = realloc(s->containers, sizeof(*s->containers) * s->capacity);
+		if (s->keys == NULL || s->containers == NULL)
+		{
+			fprintf(stderr, "Could not grow RoaringSet\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	memmove(&s->keys[i + 1], &s->keys[i], sizeof(*s->keys) * (s->count - i));
+	memmove(&s->containers[i + 1], &s->containers[i],
+			sizeof(*s->containers) * (s->count - i));
+	s->count++;
+
+	s->keys[i] = high;
+	Container c = &s->containers[i];
+	c->type = ARRAY_CONTAINER;
+	c->cardinality = 0;
+	c->length = 0;
+	c->capacity = 0;
+	c->values = NULL;
+	return c;
+}
+
+/**
+ * Free an empty container and close the gap it leaves
+ */
+static void RemoveAt(RoaringSet s, int i)
+{
+	ContainerFree(&s->containers[i]);
+	memmove(&s->keys[i], &s->keys[i + 1], sizeof(*s->keys) * (s->count - i - 1));
+	memmove(&s->containers[i], &s->containers[i + 1],
+			sizeof(*s->containers) * (s->count - i - 1));
+	s->count--;
+}
+
+static void *Allocate(size_t size)
+{
+	void *p = malloc(size);
+	if (p == NULL)
+	{
+		fprintf(stderr, "Could not malloc RoaringSet\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return p;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Container Operations */
+
+static void ContainerFree(Container c)
+{
+	// All three layouts share the same pointer
+	free(c->values);
+	c->values = NULL;
+}
+
+static size_t ContainerMemory(Container c)
+{
+	switch (c->type)
+	{
+	case ARRAY_CONTAINER:
+		return sizeof(uint16_t) * c->capacity;
+	case BITMAP_CONTAINER:
+		return sizeof(uint64_t) * BITMAP_WORDS;
+	default:
+		return sizeof(struct run) * c->capacity;
+	}
+}
+
+static bool ContainerContains(Container c, int low)
+{
+	int i;
+	switch (c->type)
+	{
+	case ARRAY_CONTAINER:
+		i = ArrayLowerBound(c, low);
+		return i < c->length && c->values[i] == low;
+	case BITMAP_CONTAINER:
+		return (c->words[low >> 6] >> (low & 63)) & 1;
+	default:
+		i = RunFind(c, low);
+		return i >= 0 && low <= c->runs[i].start + c->runs[i].length;
+	}
+}
+
+/**
+ * Add a value to a container
+ * Returns false if it was already present
+ */
+static bool ContainerAdd(Container c, int low)
+{
+	if (c->type == RUN_CONTAINER)
+	{
+		if (ContainerContains(c, low))
+			return false;
+		Materialize(c);
+	}
+
+	if (c->type == ARRAY_CONTAINER)
+	{
+		int i = ArrayLowerBound(c, low);
+		if (i < c->length && c->values[i] == low)
+			return false;
+
+		if (c->length < ARRAY_MAX)
+		{
+			ArrayReserve(c, c->length + 1);
+			memmove(&c->values[i + 1], &c->values[i],
+					sizeof(uint16_t) * (c->length - i));
+			c->values[i] = (uint16_t)low;
+			c->length++;
+			c->cardinality++;
+			return true;
+		}
+
+		ToBitmap(c);
+	}
+
+	uint64_t bit = 1ULL << (low & 63);
+	if (c->words[low >> 6] & bit)
+		return false;
+
+	c->words[low >> 6] |= bit;
+	c->cardinality++;
+	return true;
+}
+
+/**
+ * Add every value between lower and upper to a container
+ * Returns the number of values that were not already present
+ */
+static int ContainerAddRange(Container c, int lower, int upper)
+{
+	int before = c->cardinality;
+
+	// A whole chunk is one run no matter what was there before
+	if (lower == 0 && upper == CHUNK_SIZE - 1)
+	{
+		ContainerFree(c);
+		c->type = RUN_CONTAINER;
+		c->runs = Allocate(sizeof(struct run));
+		c->runs[0].start = 0;
+		c->runs[0].length = CHUNK_SIZE - 1;
+		c->length = 1;
+		c->capacity = 1;
+		c->cardinality = CHUNK_SIZE;
+		return CHUNK_SIZE - before;
+	}
+
+	if (c->type == RUN_CONTAINER)
+		Materialize(c);
+
+	if (c->type == ARRAY_CONTAINER && c->cardinality + (upper - lower + 1) > ARRAY_MAX)
+		ToBitmap(c);
+
+	if (c->type == BITMAP_CONTAINER)
+	{
+		// Set a word at a time, counting the bits that were clear
+		for (int w = lower >> 6; w <= upper >> 6; w++)
+		{
+			int a = (w == lower >> 6) ? (lower & 63) : 0;
+			int b = (w == upper >> 6) ? (upper & 63) : 63;
+			uint64_t mask = RangeMask(a, b);
+			c->cardinality += __builtin_popcountll(mask & ~c->words[w]);
+			c->words[w] |= mask;
+		}
+
+		return c->cardinality - before;
+	}
+
+	// Merge the range into the sorted array from the back
+	int start = ArrayLowerBound(c, lower);
+	int end = ArrayLowerBound(c, upper + 1);
+	int present = end - start;
+	int length = c->length + (upper - lower + 1) - present;
+
+	ArrayReserve(c, length);
+	memmove(&c->values[length - (c->length - end)], &c->values[end],
+			sizeof(uint16_t) * (c->length - end));
+	for (int v = lower; v <= upper; v++)
+		c->values[start + (v - lower)] = (uint16_t)v;
+
+	c->length = length;
+	c->cardinality = length;
+	return c->cardinality - before;
+}
+
+/**
+ * Remove a value from a container
+ * Returns false if it was not present
+ */
+static bool ContainerRemove(Container c, int low)
+{
+	if (c->type == RUN_CONTAINER)
+	{
+		if (!ContainerContains(c, low))
+			return false;
+		Materialize(c);
+	}
+
+	if (c->type == ARRAY_CONTAINER)
+	{
+		int i = ArrayLowerBound(c, low);
+		if (i == c->length || c->values[i] != low)
+			return false;
+
+		memmove(&c->values[i], &c->values[i + 1],
+				sizeof(uint16_t) * (c->length - i - 1));
+		c->length--;
+		c->cardinality--;
+		return true;
+	}
+
+	uint64_t bit = 1ULL << (low & 63);
+	if (!(c->words[low >> 6] & bit))
+		return false;
+
+	c->words[low >> 6] &= ~bit;
+	c->cardinality--;
+
+	if (c->cardinality <= ARRAY_MAX)
+		ToArray(c);
+
+	return true;
+}
+
+/**
+ * Returns the number of values in a container less than or equal to low
+ */
+static int ContainerRank(Container c, int low)
+{
+	if (c->type == ARRAY_CONTAINER)
+		return ArrayLowerBound(c, low + 1);
+
+	if (c->type == BITMAP_CONTAINER)
+	{
+		int rank = 0;
+		int w = low >> 6;
+		for (int i = 0; i < w; i++)
+			rank += __builtin_popcountll(c->words[i]);
+		return rank + __builtin_popcountll(c->words[w] & RangeMask(0, low & 63));
+	}
+
+	int rank = 0;
+	for (int i = 0; i < c->length && c->runs[i].start <= low; i++)
+	{
+		int end = c->runs[i].start + c->runs[i].length;
+		rank += ((low < end) ? low : end) - c->runs[i].start + 1;
+	}
+
+	return rank;
+}
+
+/**
+ * Returns the i-th smallest value in a container, counting from 0
+ */
+static int ContainerSelect(Container c, int i)
+{
+	if (c->type == ARRAY_CONTAINER)
+		return c->values[i];
+
+	if (c->type == BITMAP_CONTAINER)
+	{
+		for (int w = 0; w < BITMAP_WORDS; w++)
+		{
+			uint64_t word = c->words[w];
+			int count = __builtin_popcountll(word);
+			if (i < count)
+			{
+				// Drop the lowest i set bits, the answer is the next one
+				for (; i > 0; i--)
+					word &= word - 1;
+				return w * 64 + __builtin_ctzll(word);
+			}
+
+			i -= count;
+		}
+
+		return NONE;
+	}
+
+	for (int r = 0; r < c->length; r++)
+	{
+		if (i <= c->runs[r].length)
+			return c->runs[r].start + i;
+		i -= c->runs[r].length + 1;
+	}
+
+	return NONE;
+}
+
+/**
+ * Returns the largest value in a container less than or equal to low,
+ * or NONE if there is no such value
+ */
+static int ContainerFloor(Container c, int low)
+{
+	if (c->type == ARRAY_CONTAINER)
+	{
+		int i = ArrayLowerBound(c, low + 1);
+		return (i == 0) ? NONE : c->values[i - 1];
+	}
+
+	if (c->type == BITMAP_CONTAINER)
+	{
+		int w = low >> 6;
+		uint64_t word = c->words[w] & RangeMask(0, low & 63);
+		while (word == 0)
+		{
+			if (--w < 0)
+				return NONE;
+			word = c->words[w];
+		}
+
+		return w * 64 + 63 - __builtin_clzll(word);
+	}
+
+	int i = RunFind(c, low);
+	if (i < 0)
+		return NONE;
+
+	int end = c->runs[i].start + c->runs[i].length;
+	return (low < end) ? low : end;
+}
+
+/**
+ * Returns the smallest value in a container greater than or equal to
+ * low, or NONE if there is no such value
+ */
+static int ContainerCeiling(Container c, int low)
+{
+	if (c->type == ARRAY_CONTAINER)
+	{
+		int i = ArrayLowerBound(c, low);
+		return (i == c->length) ? NONE : c->values[i];
+	}
+
+	if (c->type == BITMAP_CONTAINER)
+	{
+		int w = low >> 6;
+		uint64_t word = c->words[w] & RangeMask(low & 63, 63);
+		while (word == 0)
+		{
+			if (++w == BITMAP_WORDS)
+				return NONE;
+			word = c->words[w];
+		}
+
+		return w * 64 + __builtin_ctzll(word);
+	}
+
+	int i = RunFind(c, low);
+	if (i >= 0 && low <= c->runs[i].start + c->runs[i].length)
+		return low;
+
+	return (i + 1 < c->length) ? c->runs[i + 1].start : NONE;
+}
+
+/**
+ * Append every value of a container between lower and upper to a list
+ */
+static void ContainerAppend(Container c, int lower, int upper, uint32_t base, List l)
+{
+	if (c->type == ARRAY_CONTAINER)
+	{
+		for (int i = ArrayLowerBound(c, lower); i < c->length && c->values[i] <= upper; i++)
+			ListAppend(l, ToSigned(base | c->values[i]));
+		return;
+	}
+
+	if (c->type == BITMAP_CONTAINER)
+	{
+		for (int w = lower >> 6; w <= upper >> 6; w++)
+		{
+			int a = (w == lower >> 6) ? (lower & 63) : 0;
+			int b = (w == upper >> 6) ? (upper & 63) : 63;
+			uint64_t word = c->words[w] & RangeMask(a, b);
+			while (word != 0)
+			{
+				ListAppend(l, ToSigned(base | (uint32_t)(w * 64 + __builtin_ctzll(word))));
+				word &= word - 1;
+			}
+		}
+		return;
+	}
+
+	int i = RunFind(c, lower);
+	for (i = (i < 0) ? 0 : i; i < c->length && c->runs[i].start <= upper; i++)
+	{
+		int start = c->runs[i].start;
+		int end = start + c->runs[i].length;
+		for (int v = (start > lower) ? start : lower; v <= end && v <= upper; v++)
+			ListAppend(l, ToSigned(base | (uint32_t)v));
+	}
+}
+
+/**
+ * Copy every value of a container into out, returns how many
+ */
+static int ContainerCopy(Container c, uint32_t base, int *out)
+{
+	int n = 0;
+
+	if (c->type == ARRAY_CONTAINER)
+	{
+		for (int i = 0; i < c->length; i++)
+			out[n++] = ToSigned(base | c->values[i]);
+	}
+	else if (c->type == BITMAP_CONTAINER)
+	{
+		for (int w = 0; w < BITMAP_WORDS; w++)
+			for (uint64_t word = c->words[w]; word != 0; word &= word - 1)
+				out[n++] = ToSigned(base | (uint32_t)(w * 64 + __builtin_ctzll(word)));
+	}
+	else
+	{
+		for (int i = 0; i < c->length; i++)
+			for (int v = c->runs[i].start; v <= c->runs[i].start + c->runs[i].length; v++)
+				out[n++] = ToSigned(base | (uint32_t)v);
+	}
+
+	return n;
+}
+
+/**
+ * Re-encode a container in whichever layout is smallest
+ */
+static void ContainerOptimize(Container c)
+{
+	size_t runBytes = sizeof(struct run) * ContainerCountRuns(c);
+	size_t arrayBytes = (c->cardinality <= ARRAY_MAX)
+							? sizeof(uint16_t) * c->cardinality
+							: SIZE_MAX;
+	size_t bitmapBytes = sizeof(uint64_t) * BITMAP_WORDS;
+
+	if (runBytes < arrayBytes && runBytes < bitmapBytes)
+	{
+		if (c->type != RUN_CONTAINER)
+			ToRun(c);
+	}
+	else if (c->type == RUN_CONTAINER)
+	{
+		Materialize(c);
+	}
+	else if (c->type == BITMAP_CONTAINER && c->cardinality <= ARRAY_MAX)
+	{
+		ToArray(c);
+	}
+}
+
+/**
+ * Count the runs of consecutive values in a container
+ */
+static int ContainerCountRuns(Container c)
+{
+	if (c->type == RUN_CONTAINER)
+		return c->length;
+
+	int runs = 0;
+	if (c->type == ARRAY_CONTAINER)
+	{
+		for (int i = 0; i < c->length; i++)
+			if (i == 0 || c->values[i] != c->values[i - 1] + 1)
+				runs++;
+		return runs;
+	}
+
+	// A run starts at every set bit whose lower neighbour is clear
+	uint64_t carry = 0;
+	for (int w = 0; w < BITMAP_WORDS; w++)
+	{
+		uint64_t word = c->words[w];
+		runs += __builtin_popcountll(word & ~((word << 1) | carry));
+		carry = word >> 63;
+	}
+
+	return runs;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Layout Helpers */
+
+/**
+ * Returns the position of the first array value greater than or equal
+ * to low
+ */
+static int ArrayLowerBound(Container c, int low)
+{
+	int lo = 0;
+	int hi = c->length;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (c->values[mid] < low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void ArrayReserve(Container c, int capacity)
+{
+	if (capacity <= c->capacity)
+		return;
+
+	int grown = (c->capacity == 0) ? 4 : c->capacity * 2;
+	if (grown < capacity)
+		grown = capacity;
+	if (grown > ARRAY_MAX)
+		grown = ARRAY_MAX;
+
+	c->values = realloc(c->values, sizeof(uint16_t) * grown);
+	if (c->values == NULL)
+	{
+		fprintf(stderr, "Could not grow Array Container\n");
+		exit(EXIT_FAILURE);
+	}
+
+	c->capacity = grown;
+}
+
+static void ToBitmap(Container c)
+{
+	uint64_t *words = calloc(BITMAP_WORDS, sizeof(uint64_t));
+	if (words == NULL)
+	{
+		fprintf(stderr, "Could not malloc Bitmap Container\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (c->type == ARRAY_CONTAINER)
+	{
+		for (int i = 0; i < c->length; i++)
+			words[c->values[i] >> 6] |= 1ULL << (c->values[i] & 63);
+	}
+	else if (c->type == RUN_CONTAINER)
+	{
+		for (int i = 0; i < c->length; i++)
+		{
+			int start = c->runs[i].start;
+			int end = start + c->runs[i].length;
+			for (int w = start >> 6; w <= end >> 6; w++)
+			{
+				int a = (w == start >> 6) ? (start & 63) : 0;
+				int b = (w == end >> 6) ? (end & 63) : 63;
+				words[w] |= RangeMask(a, b);
+			}
+		}
+	}
+
+	ContainerFree(c);
+	c->type = BITMAP_CONTAINER;
+	c->words = words;
+	c->length = 0;
+	c->capacity = 0;
+}
+
+static void ToArray(Container c)
+{
+	uint16_t *values = Allocate(sizeof(uint16_t) * (c->cardinality ? c->cardinality : 1));
+
+	int n = 0;
+	if (c->type == BITMAP_CONTAINER)
+	{
+		for (int w = 0; w < BITMAP_WORDS; w++)
+		{
+			for (uint64_t word = c->words[w]; word != 0; word &= word - 1)
+				values[n++] = (uint16_t)(w * 64 + __builtin_ctzll(word));
+		}
+	}
+	else if (c->type == RUN_CONTAINER)
+	{
+		for (int i = 0; i < c->length; i++)
+			for (int v = c->runs[i].start; v <= c->runs[i].start + c->runs[i].length; v++)
+				values[n++] = (uint16_t)v;
+	}
+
+	ContainerFree(c);
+	c->type = ARRAY_CONTAINER;
+	c->values = values;
+	c->length = n;
+	c->capacity = c->cardinality ? c->cardinality : 1;
+}
+
+static void ToRun(Container c)
+{
+	int nruns = ContainerCountRuns(c);
+	struct run *runs = Allocate(sizeof(struct run) * (nruns ? nruns : 1));
+
+	int r = -1;
+	int prev = NONE - 1;
+	if (c->type == ARRAY_CONTAINER)
+	{
+		for (int i = 0; i < c->length; i++)
+		{
+			int v = c->values[i];
+			if (v == prev + 1)
+			{
+				runs[r].length++;
+			}
+			else
+			{
+				runs[++r].start = (uint16_t)v;
+				runs[r].length = 0;
+			}
+			prev = v;
+		}
+	}
+	else
+	{
+		for (int w = 0; w < BITMAP_WORDS; w++)
+		{
+			for (uint64_t word = c->words[w]; word != 0; word &= word - 1)
+			{
+				int v = w * 64 + __builtin_ctzll(word);
+				if (v == prev + 1)
+				{
+					runs[r].length++;
+				}
+				else
+				{
+					runs[++r].start = (uint16_t)v;
+					runs[r].length = 0;
+				}
+				prev = v;
+			}
+		}
+	}
+
+	ContainerFree(c);
+	c->type = RUN_CONTAINER;
+	c->runs = runs;
+	c->length = nruns;
+	c->capacity = nruns ? nruns : 1;
+}
+
+/**
+ * Expand a run container into an array or a bitmap so that single
+ * values can be added and removed
+ */
+static void Materialize(Container c)
+{
+	if (c->cardinality <= ARRAY_MAX)
+		ToArray(c);
+	else
+		ToBitmap(c);
+}
+
+/**
+ * Returns the index of the last run starting at or before low, or -1
+ */
+static int RunFind(Container c, int low)
+{
+	int lo = 0;
+	int hi = c->length;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (c->runs[mid].start <= low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo - 1;
+}
+
+/**
+ * Returns a word with bits lower to upper (inclusive) set
+ */
+static uint64_t RangeMask(int lower, int upper)
+{
+	uint64_t high = (upper == 63) ? ~0ULL : (1ULL << (upper + 1)) - 1;
+	return high & (~0ULL << lower);
+}
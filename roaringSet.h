@@ -0,0 +1,142 @@
+// Operations on Roaring Sets of integers.
+// Keys are split on their high 16 bits into chunks of up to 65536 keys.
+// Each chunk is stored in whichever container is smallest for it: a
+// sorted array for sparse chunks, a 65536-bit bitmap for dense chunks,
+// or a list of runs for chunks made of contiguous ranges. Dense keysets
+// use a few bits per key instead of a 48 byte tree node, and range
+// operations work a 64-bit word at a time.
+
+#ifndef ROARING_SET_H
+#define ROARING_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bBST.h"
+#include "List.h"
+
+typedef struct roaringSet *RoaringSet;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of keys in the
+// set, and c, the number of containers (at most the smaller of n and
+// 65536).
+
+/**
+ * Creates a new empty set.
+ * The time complexity of this function is O(1).
+ */
+RoaringSet RoaringSetNew(void);
+
+/**
+ * Frees all memory allocated for the given set.
+ * The time complexity of this function is O(c).
+ */
+void RoaringSetFree(RoaringSet s);
+
+/**
+ * Returns the number of keys in the set.
+ * The time complexity of this function is O(1).
+ */
+int RoaringSetSize(RoaringSet s);
+
+/**
+ * Returns the number of bytes allocated for the given set.
+ * The time complexity of this function is O(c).
+ */
+size_t RoaringSetMemory(RoaringSet s);
+
+/**
+ * Returns true if the key is in the set or false otherwise.
+ * The time complexity of this function is O(log c + log 65536).
+ */
+bool RoaringSetSearch(RoaringSet s, int key);
+
+/**
+ * Inserts the given key into the set.
+ * Returns true if the key was inserted, or false if the key was already
+ * present in the set or is UNDEFINED.
+ * The time complexity of this function is O(c + 4096).
+ */
+bool RoaringSetInsert(RoaringSet s, int key);
+
+/**
+ * Inserts every key between lower and upper (inclusive) into the set,
+ * a whole 64-bit word or run at a time.
+ * Returns the number of keys that were not already present.
+ * The time complexity of this function is O(c + (upper - lower) / 64).
+ */
+int RoaringSetInsertRange(RoaringSet s, int lower, int upper);
+
+/**
+ * Deletes the given key from the set if it is present.
+ * Returns true if the key was deleted, or false if it was not present.
+ * The time complexity of this function is O(c + 4096).
+ */
+bool RoaringSetDelete(RoaringSet s, int key);
+
+/**
+ * Converts every container to run encoding where that is smaller.
+ * Call after bulk loading clustered keys.
+ * The time complexity of this function is O(c + n).
+ */
+void RoaringSetRunOptimize(RoaringSet s);
+
+/**
+ * Creates a list containing all the keys in the set in ascending order.
+ * The time complexity of this function is O(n + c).
+ */
+List RoaringSetToList(RoaringSet s);
+
+/**
+ * Copies all the keys in the set into out in ascending order and
+ * returns how many were copied. out must have room for
+ * RoaringSetSize(s) keys.
+ * The time complexity of this function is O(n + c).
+ */
+int RoaringSetToArray(RoaringSet s, int *out);
+
+/**
+ * Returns the number of keys in the set that are less than or equal to
+ * the given key.
+ * The time complexity of this function is O(c + 1024).
+ */
+int RoaringSetRank(RoaringSet s, int key);
+
+/**
+ * Returns the k-th smallest key in the set, or UNDEFINED if k is not
+ * between 1 and the number of keys in the set.
+ * The time complexity of this function is O(c + 1024).
+ */
+int RoaringSetKthSmallest(RoaringSet s, int k);
+
+/**
+ * Returns the k-th largest key in the set, or UNDEFINED if k is not
+ * between 1 and the number of keys in the set.
+ * The time complexity of this function is O(c + 1024).
+ */
+int RoaringSetKthLargest(RoaringSet s, int k);
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log c + 1024).
+ */
+int RoaringSetFloor(RoaringSet s, int key);
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log c + 1024).
+ */
+int RoaringSetCeiling(RoaringSet s, int key);
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in order in a list.
+ * The time complexity of this function is O(log c + m + (upper - lower) / 64),
+ * where m is the length of the returned list.
+ */
+List RoaringSetSearchBetween(RoaringSet s, int lower, int upper);
+
+#endif
@@ -0,0 +1,941 @@
+// Implementation of the Shared Memory Balanced Binary Search Tree.
+//
+// The segment is a header followed by the node array. Index 0 is never
+// handed out so it can stand in for NULL, and freed nodes are kept on a
+// free list threaded through their left index, as in the compact tree.
+//
+// The header's sequence number is a seqlock. The writer makes it odd,
+// changes the tree and makes it even again; a reader notes it before a
+// query and checks it is unchanged afterwards. A reader can see a tree
+// halfway through a rotation, so it only follows indices inside the
+// array and gives up on a path longer than any AVL tree of this size
+// can have, then retries. Readers load anything the writer changes,
+// and the writer stores anything a reader can load, with relaxed
+// atomics, so the two never race in the C11 sense.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shmBST.h"
+#include "List.h"
+
+#define NIL 0
+#define SHM_MAGIC "BBSTSHM1"
+// An AVL tree of 2^32 nodes is at most 1.44 * 32 levels deep
+#define MAX_PATH 48
+// Spins on an odd sequence number before yielding to the writer
+#define SPIN_LIMIT 64
+
+#define READ(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+typedef uint32_t Index;
+
+struct shmNode
+{
+	int key;
+	Index left;
+	Index right;
+	uint8_t height;
+	uint8_t spare[3];
+};
+
+// Written by create, then only changed by the writer between the two
+// increments of seq
+struct shmHeader
+{
+	char magic[8];
+	Index capacity;
+	Index used;
+	uint64_t seq;
+	Index freeList;
+	Index root;
+	Index size;
+	uint32_t spare;
+};
+
+struct shmTree
+{
+	struct shmHeader *hdr;
+	struct shmNode *pool;
+	size_t length;
+	bool writer;
+	uint64_t retries;
+	// Keys found by a range query before it is known to be consistent
+	int *scratch;
+	int scratchCap;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static ShmTree Map(int fd, size_t length, bool writer);
+static size_t SegmentLength(Index capacity);
+static uint64_t ReadBegin(ShmTree t);
+static bool ReadRetry(ShmTree t, uint64_t seq);
+static void WriteBegin(ShmTree t);
+static void WriteEnd(ShmTree t);
+static bool Bounded(ShmTree t, Index n, int *steps);
+static bool Collect(ShmTree t, int lower, int upper, int *count);
+static const char *VerifySnapshot(ShmTree t, uint8_t *seen, Index *where);
+static const char *VerifyNode(ShmTree t, Index n, long long lower, long long upper,
+							  uint8_t *seen, int depth, int *height, Index *where);
+static Index Build(ShmTree t, const int *keys, int lo, int hi);
+static Index NodeCreate(ShmTree t, int k);
+static void NodeRelease(ShmTree t, Index n);
+static Index NodeInsert(ShmTree t, Index curr, Index n);
+static Index NodeDelete(ShmTree t, Index curr, int key);
+static Index Rebalance(ShmTree t, Index n);
+static Index RotateLeft(ShmTree t, Index n);
+static Index RotateRight(ShmTree t, Index n);
+static void UpdateHeight(ShmTree t, Index n);
+static int Height(ShmTree t, Index n);
+static int GetBalance(ShmTree t, Index n);
+static int max(int a, int b);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty tree in a new segment
+ */
+ShmTree ShmTreeCreate(const char *name, uint32_t capacity)
+{
+	if (capacity > SHM_MAX_NODES)
+	{
+		fprintf(stderr, "ShmTree capacity too large\n");
+		return NULL;
+	}
+
+	// Unlink rather than truncate, readers of the old segment would
+	// fault on the pages taken away under them
+	shm_unlink(name);
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	size_t length = SegmentLength(capacity);
+	if (fd < 0 || ftruncate(fd, length) != 0)
+	{
+		fprintf(stderr, "Could not create shared tree %s: %s\n", name, strerror(errno));
+		if (fd >= 0)
+		{
+			close(fd);
+			shm_unlink(name);
+		}
+		return NULL;
+	}
+
+	ShmTree t = Map(fd, length, true);
+	if (t == NULL)
+	{
+		shm_unlink(name);
+		return NULL;
+	}
+
+	// Slot 0 is the null node and is never used
+	struct shmHeader *hdr = t->hdr;
+	hdr->capacity = capacity;
+	hdr->used = 1;
+	hdr->freeList = NIL;
+	hdr->root = NIL;
+	hdr->size = 0;
+	hdr->seq = 0;
+
+	// Readers check the magic, so it goes in last
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(hdr->magic, SHM_MAGIC, sizeof(hdr->magic));
+	return t;
+}
+
+/**
+ * Opens an existing segment read-only
+ */
+ShmTree ShmTreeOpen(const char *name)
+{
+	int fd = shm_open(name, O_RDONLY, 0);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0)
+	{
+		fprintf(stderr, "Could not open shared tree %s: %s\n", name, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	if ((size_t)st.st_size < sizeof(struct shmHeader))
+	{
+		fprintf(stderr, "Could not open shared tree %s: not a tree\n", name);
+		close(fd);
+		return NULL;
+	}
+
+	ShmTree t = Map(fd, st.st_size, false);
+	if (t == NULL)
+		return NULL;
+
+	if (memcmp(t->hdr->magic, SHM_MAGIC, sizeof(t->hdr->magic)) != 0 ||
+		SegmentLength(t->hdr->capacity) > t->length)
+	{
+		fprintf(stderr, "Could not open shared tree %s: not a tree\n", name);
+		ShmTreeClose(t);
+		return NULL;
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return t;
+}
+
+/**
+ * Map a segment and make a handle for it, closes fd
+ */
+static ShmTree Map(int fd, size_t length, bool writer)
+{
+	int prot = writer ? PROT_READ | PROT_WRITE : PROT_READ;
+	void *base = mmap(NULL, length, prot, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		fprintf(stderr, "Could not map shared tree: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	ShmTree t = calloc(1, sizeof(*t));
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc ShmTree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t->hdr = base;
+	t->pool = (struct shmNode *)((char *)base + sizeof(struct shmHeader));
+	t->length = length;
+	t->writer = writer;
+	return t;
+}
+
+/**
+ * Unmaps the segment
+ */
+void ShmTreeClose(ShmTree t)
+{
+	if (t == NULL)
+		return;
+
+	munmap(t->hdr, t->length);
+	free(t->scratch);
+	free(t);
+}
+
+/**
+ * Removes a segment
+ */
+bool ShmTreeUnlink(const char *name)
+{
+	return shm_unlink(name) == 0;
+}
+
+int ShmTreeSize(ShmTree t)
+{
+	return (t == NULL) ? 0 : (int)READ(t->hdr->size);
+}
+
+uint64_t ShmTreeVersion(ShmTree t)
+{
+	return (t == NULL) ? 0 : READ(t->hdr->seq) / 2;
+}
+
+uint64_t ShmTreeRetries(ShmTree t)
+{
+	return (t == NULL) ? 0 : t->retries;
+}
+
+size_t ShmTreeMemory(ShmTree t)
+{
+	return (t == NULL) ? 0 : t->length;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Wait for the writer to finish an update, and return the sequence
+ * number a query starts from
+ */
+static uint64_t ReadBegin(ShmTree t)
+{
+	for (int spins = 0;; spins++)
+	{
+		uint64_t seq = __atomic_load_n(&t->hdr->seq, __ATOMIC_ACQUIRE);
+		if ((seq & 1) == 0)
+			return seq;
+
+		if (spins >= SPIN_LIMIT)
+			sched_yield();
+	}
+}
+
+/**
+ * Whether the tree changed since ReadBegin returned seq, so that what
+ * the query read cannot be trusted
+ */
+static bool ReadRetry(ShmTree t, uint64_t seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&t->hdr->seq, __ATOMIC_RELAXED) == seq)
+		return false;
+
+	t->retries++;
+	return true;
+}
+
+static void WriteBegin(ShmTree t)
+{
+	STORE(t->hdr->seq, t->hdr->seq + 1);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void WriteEnd(ShmTree t)
+{
+	__atomic_store_n(&t->hdr->seq, t->hdr->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Whether a reader can follow n: it is inside the array and the path to
+ * it is no longer than a real one
+ */
+static bool Bounded(ShmTree t, Index n, int *steps)
+{
+	return n <= t->hdr->capacity && ++*steps <= MAX_PATH;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ */
+bool ShmTreeSearch(ShmTree t, int key)
+{
+	if (t == NULL || key == UNDEFINED)
+		return false;
+
+	const struct shmNode *pool = t->pool;
+	for (;;)
+	{
+		uint64_t seq = ReadBegin(t);
+		bool found = false;
+		bool valid = true;
+		int steps = 0;
+
+		Index curr = READ(t->hdr->root);
+		while (curr != NIL)
+		{
+			if (!Bounded(t, curr, &steps))
+			{
+				valid = false;
+				break;
+			}
+
+			int k = READ(pool[curr].key);
+			if (k == key)
+			{
+				found = true;
+				break;
+			}
+			curr = (key > k) ? READ(pool[curr].right) : READ(pool[curr].left);
+		}
+
+		if (!ReadRetry(t, seq) && valid)
+			return found;
+	}
+}
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ */
+int ShmTreeFloor(ShmTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	const struct shmNode *pool = t->pool;
+	for (;;)
+	{
+		uint64_t seq = ReadBegin(t);
+		int result = UNDEFINED;
+		bool valid = true;
+		int steps = 0;
+
+		Index curr = READ(t->hdr->root);
+		while (curr != NIL)
+		{
+			if (!Bounded(t, curr, &steps))
+			{
+				valid = false;
+				break;
+			}
+
+			int k = READ(pool[curr].key);
+			if (k == key)
+			{
+				result = k;
+				break;
+			}
+
+			if (k < key)
+			{
+				result = k;
+				curr = READ(pool[curr].right);
+			}
+			else
+				curr = READ(pool[curr].left);
+		}
+
+		if (!ReadRetry(t, seq) && valid)
+			return result;
+	}
+}
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ */
+int ShmTreeCeiling(ShmTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	const struct shmNode *pool = t->pool;
+	for (;;)
+	{
+		uint64_t seq = ReadBegin(t);
+		int result = UNDEFINED;
+		bool valid = true;
+		int steps = 0;
+
+		Index curr = READ(t->hdr->root);
+		while (curr != NIL)
+		{
+			if (!Bounded(t, curr, &steps))
+			{
+				valid = false;
+				break;
+			}
+
+			int k = READ(pool[curr].key);
+			if (k == key)
+			{
+				result = k;
+				break;
+			}
+
+			if (k > key)
+			{
+				result = k;
+				curr = READ(pool[curr].left);
+			}
+			else
+				curr = READ(pool[curr].right);
+		}
+
+		if (!ReadRetry(t, seq) && valid)
+			return result;
+	}
+}
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in order in a list.
+ */
+List ShmTreeSearchBetween(ShmTree t, int lower, int upper)
+{
+	List l = ListNew();
+	if (t == NULL || lower > upper)
+		return l;
+
+	if (lower == UNDEFINED || upper == UNDEFINED)
+		return l;
+
+	// The keys are collected on the side and only go in the list once
+	// the query is known to have seen a stable tree
+	int count;
+	for (;;)
+	{
+		uint64_t seq = ReadBegin(t);
+		bool valid = Collect(t, lower, upper, &count);
+		if (!ReadRetry(t, seq) && valid)
+			break;
+	}
+
+	for (int i = 0; i < count; i++)
+		ListAppend(l, t->scratch[i]);
+	return l;
+}
+
+/**
+ * Walk the keys between lower and upper in order into t->scratch, with
+ * a stack instead of recursion so a bad path is caught by its length.
+ * Returns false if the tree was seen in an inconsistent state.
+ */
+static bool Collect(ShmTree t, int lower, int upper, int *count)
+{
+	const struct shmNode *pool = t->pool;
+	Index stack[MAX_PATH];
+	int top = 0;
+	// A torn tree can hold a cycle, a real one has no more nodes than
+	// the array
+	uint64_t visits = 0;
+	*count = 0;
+
+	Index curr = READ(t->hdr->root);
+	while (curr != NIL || top > 0)
+	{
+		// Go left while the left subtree can hold keys in range
+		while (curr != NIL)
+		{
+			if (curr > t->hdr->capacity || top == MAX_PATH)
+				return false;
+
+			stack[top++] = curr;
+			curr = (READ(pool[curr].key) > lower) ? READ(pool[curr].left) : NIL;
+		}
+
+		if (++visits > t->hdr->capacity)
+			return false;
+
+		curr = stack[--top];
+		int k = READ(pool[curr].key);
+		if (k > upper)
+			break;
+
+		if (k >= lower)
+		{
+			if (*count == t->scratchCap)
+			{
+				t->scratchCap = (t->scratchCap == 0) ? 64 : t->scratchCap * 2;
+				t->scratch = realloc(t->scratch, t->scratchCap * sizeof(int));
+				if (t->scratch == NULL)
+				{
+					fprintf(stderr, "Could not grow ShmTree scratch\n");
+					exit(EXIT_FAILURE);
+				}
+			}
+			t->scratch[(*count)++] = k;
+		}
+
+		curr = READ(pool[curr].right);
+	}
+
+	return true;
+}
+
+/**
+ * Checks the tree is a valid AVL tree and every node is accounted for
+ */
+bool ShmTreeVerify(ShmTree t)
+{
+	if (t == NULL)
+		return false;
+
+	uint8_t *seen = malloc((size_t)t->hdr->capacity + 1);
+	if (seen == NULL)
+	{
+		fprintf(stderr, "Could not malloc ShmTree verify marks\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// A snapshot is only judged once it is known to be consistent
+	const char *problem;
+	Index where;
+	for (;;)
+	{
+		uint64_t seq = ReadBegin(t);
+		memset(seen, 0, (size_t)t->hdr->capacity + 1);
+		problem = VerifySnapshot(t, seen, &where);
+		if (!ReadRetry(t, seq))
+			break;
+	}
+
+	free(seen);
+	if (problem != NULL)
+		fprintf(stderr, "ShmTree is invalid at node %u: %s\n", where, problem);
+	return problem == NULL;
+}
+
+/**
+ * Check the tree and the free list in the segment as it is now.
+ * Returns what is wrong, with the node it was found at in where, or
+ * NULL if nothing is.
+ */
+static const char *VerifySnapshot(ShmTree t, uint8_t *seen, Index *where)
+{
+	const struct shmHeader *hdr = t->hdr;
+	Index used = READ(hdr->used);
+	*where = NIL;
+
+	if (used < 1 || used - 1 > hdr->capacity)
+		return "more nodes used than the segment holds";
+
+	int height;
+	const char *problem = VerifyNode(t, READ(hdr->root), (long long)INT_MIN - 1,
+									 (long long)INT_MAX + 1, seen, 0, &height, where);
+	if (problem != NULL)
+		return problem;
+
+	Index inTree = 0;
+	for (Index n = 1; n < used; n++)
+		inTree += seen[n];
+	if (inTree != READ(hdr->size))
+		return "size differs from the nodes in the tree";
+
+	// Every other node below the high-water mark is on the free list
+	Index onList = 0;
+	for (Index n = READ(hdr->freeList); n != NIL; n = READ(t->pool[n].left))
+	{
+		*where = n;
+		if (n >= used || seen[n])
+			return "free list holds a node in the tree, twice or past the used ones";
+		seen[n] = 1;
+		onList++;
+	}
+
+	*where = NIL;
+	if (inTree + onList != used - 1)
+		return "nodes are neither in the tree nor on the free list";
+	return NULL;
+}
+
+/**
+ * Check the subtree at n holds keys strictly between lower and upper,
+ * with the right heights and balance, and set its height
+ */
+static const char *VerifyNode(ShmTree t, Index n, long long lower, long long upper,
+							  uint8_t *seen, int depth, int *height, Index *where)
+{
+	if (n == NIL)
+	{
+		*height = -1;
+		return NULL;
+	}
+
+	*where = n;
+	if (n >= READ(t->hdr->used) || depth == MAX_PATH)
+		return "link past the used nodes or path too long";
+	if (seen[n])
+		return "node reached twice";
+	seen[n] = 1;
+
+	const struct shmNode *node = &t->pool[n];
+	int key = READ(node->key);
+	if (key <= lower || key >= upper || key == UNDEFINED)
+		return "key out of order";
+
+	int left, right;
+	const char *problem = VerifyNode(t, READ(node->left), lower, key, seen, depth + 1, &left,
+									 where);
+	if (problem == NULL)
+		problem = VerifyNode(t, READ(node->right), key, upper, seen, depth + 1, &right, where);
+	if (problem != NULL)
+		return problem;
+
+	*where = n;
+	*height = 1 + max(left, right);
+	if (READ(node->height) != *height)
+		return "stored height is wrong";
+	if (left - right > 1 || right - left > 1)
+		return "out of balance";
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Replaces the contents of the tree with the given sorted keys
+ */
+bool ShmTreeBuild(ShmTree t, const int *keys, int n)
+{
+	if (t == NULL || !t->writer)
+		return false;
+
+	if (n < 0 || (uint64_t)n > t->hdr->capacity)
+	{
+		fprintf(stderr, "Keys do not fit in ShmTree\n");
+		return false;
+	}
+
+	for (int i = 1; i < n; i++)
+	{
+		if (keys[i - 1] >= keys[i])
+		{
+			fprintf(stderr, "Keys to build ShmTree from are not ascending\n");
+			return false;
+		}
+	}
+
+	WriteBegin(t);
+	STORE(t->hdr->used, 1);
+	STORE(t->hdr->freeList, NIL);
+	STORE(t->hdr->root, Build(t, keys, 0, n - 1));
+	STORE(t->hdr->size, n);
+	WriteEnd(t);
+	return true;
+}
+
+/**
+ * Build a perfectly balanced subtree from keys[lo..hi]
+ */
+static Index Build(ShmTree t, const int *keys, int lo, int hi)
+{
+	if (lo > hi)
+		return NIL;
+
+	int mid = lo + (hi - lo) / 2;
+	Index n = NodeCreate(t, keys[mid]);
+	STORE(t->pool[n].left, Build(t, keys, lo, mid - 1));
+	STORE(t->pool[n].right, Build(t, keys, mid + 1, hi));
+	UpdateHeight(t, n);
+	return n;
+}
+
+/**
+ * Inserts the given key into the tree.
+ */
+bool ShmTreeInsert(ShmTree t, int key)
+{
+	if (t == NULL || !t->writer)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return false;
+	}
+
+	if (ShmTreeSearch(t, key))
+	{
+		fprintf(stderr, "Value %d already Exists in Tree\n", key);
+		return false;
+	}
+
+	if (t->hdr->freeList == NIL && t->hdr->used > t->hdr->capacity)
+	{
+		fprintf(stderr, "ShmTree is full\n");
+		return false;
+	}
+
+	WriteBegin(t);
+	Index n = NodeCreate(t, key);
+	STORE(t->hdr->root, NodeInsert(t, t->hdr->root, n));
+	STORE(t->hdr->size, t->hdr->size + 1);
+	WriteEnd(t);
+	return true;
+}
+
+/**
+ * Search for correct position to insert new node
+ * Balance tree if necessary
+ */
+static Index NodeInsert(ShmTree t, Index curr, Index n)
+{
+	if (curr == NIL)
+		return n;
+
+	struct shmNode *node = &t->pool[curr];
+	if (node->key > t->pool[n].key)
+		STORE(node->left, NodeInsert(t, node->left, n));
+	else
+		STORE(node->right, NodeInsert(t, node->right, n));
+
+	return Rebalance(t, curr);
+}
+
+/**
+ * Deletes the given key from the tree if it is present.
+ */
+bool ShmTreeDelete(ShmTree t, int key)
+{
+	if (t == NULL || !t->writer)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't accept UNDEFINED as input\n");
+		return false;
+	}
+
+	if (!ShmTreeSearch(t, key))
+	{
+		fprintf(stderr, "Value to Delete not in Tree\n");
+		return false;
+	}
+
+	WriteBegin(t);
+	STORE(t->hdr->root, NodeDelete(t, t->hdr->root, key));
+	STORE(t->hdr->size, t->hdr->size - 1);
+	WriteEnd(t);
+	return true;
+}
+
+/**
+ * Search for the node to delete
+ * Balance the tree if necessary
+ */
+static Index NodeDelete(ShmTree t, Index curr, int key)
+{
+	if (curr == NIL)
+		return NIL;
+
+	struct shmNode *node = &t->pool[curr];
+
+	if (key > node->key)
+	{
+		STORE(node->right, NodeDelete(t, node->right, key));
+	}
+	else if (key < node->key)
+	{
+		STORE(node->left, NodeDelete(t, node->left, key));
+	}
+	else if (node->left == NIL || node->right == NIL)
+	{
+		// Zero or one child, splice the node out
+		Index child = (node->left == NIL) ? node->right : node->left;
+		NodeRelease(t, curr);
+		return child;
+	}
+	else
+	{
+		// Two children, replace with the smallest key on the right
+		Index min = node->right;
+		while (t->pool[min].left != NIL)
+			min = t->pool[min].left;
+
+		STORE(node->key, t->pool[min].key);
+		STORE(node->right, NodeDelete(t, node->right, node->key));
+	}
+
+	return Rebalance(t, curr);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Take a node from the free list, or the next unused one. The caller
+ * has checked there is room.
+ */
+static Index NodeCreate(ShmTree t, int k)
+{
+	struct shmHeader *hdr = t->hdr;
+	Index n = hdr->freeList;
+
+	if (n != NIL)
+		STORE(hdr->freeList, t->pool[n].left);
+	else
+	{
+		n = hdr->used;
+		STORE(hdr->used, n + 1);
+	}
+
+	STORE(t->pool[n].key, k);
+	STORE(t->pool[n].left, NIL);
+	STORE(t->pool[n].right, NIL);
+	STORE(t->pool[n].height, 0);
+	return n;
+}
+
+/**
+ * Return a node to the free list
+ */
+static void NodeRelease(ShmTree t, Index n)
+{
+	STORE(t->pool[n].left, t->hdr->freeList);
+	STORE(t->hdr->freeList, n);
+}
+
+/**
+ * Update the height of a node and rotate it if it is unbalanced
+ */
+static Index Rebalance(ShmTree t, Index n)
+{
+	UpdateHeight(t, n);
+	int balance = GetBalance(t, n);
+
+	// Left Left and Left Right cases
+	if (balance > 1)
+	{
+		if (GetBalance(t, t->pool[n].left) < 0)
+			STORE(t->pool[n].left, RotateLeft(t, t->pool[n].left));
+		return RotateRight(t, n);
+	}
+
+	// Right Right and Right Left cases
+	if (balance < -1)
+	{
+		if (GetBalance(t, t->pool[n].right) > 0)
+			STORE(t->pool[n].right, RotateRight(t, t->pool[n].right));
+		return RotateLeft(t, n);
+	}
+
+	return n;
+}
+
+static Index RotateLeft(ShmTree t, Index n)
+{
+	Index y = t->pool[n].right;
+	STORE(t->pool[n].right, t->pool[y].left);
+	STORE(t->pool[y].left, n);
+
+	UpdateHeight(t, n);
+	UpdateHeight(t, y);
+	return y;
+}
+
+static Index RotateRight(ShmTree t, Index n)
+{
+	Index y = t->pool[n].left;
+	STORE(t->pool[n].left, t->pool[y].right);
+	STORE(t->pool[y].right, n);
+
+	UpdateHeight(t, n);
+	UpdateHeight(t, y);
+	return y;
+}
+
+static void UpdateHeight(ShmTree t, Index n)
+{
+	struct shmNode *node = &t->pool[n];
+	STORE(node->height, 1 + max(Height(t, node->left), Height(t, node->right)));
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Bytes in a segment for capacity nodes, plus the null node
+ */
+static size_t SegmentLength(Index capacity)
+{
+	return sizeof(struct shmHeader) + ((size_t)capacity + 1) * sizeof(struct shmNode);
+}
+
+static int Height(ShmTree t, Index n)
+{
+	return (n == NIL) ? -1 : t->pool[n].height;
+}
+
+static int GetBalance(ShmTree t, Index n)
+{
+	return Height(t, t->pool[n].left) - Height(t, t->pool[n].right);
+}
+
+static int max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
@@ -0,0 +1,157 @@
+// Operations on Shared Memory Balanced Binary Search Trees.
+// An AVL tree that lives in a POSIX shared memory segment, so that many
+// processes on a host can query one copy of a keyset instead of each
+// building its own. Like the compact tree, nodes are kept in one array
+// and link to each other with 32-bit indices, which mean the same thing
+// wherever the segment is mapped.
+//
+// One process creates the segment and is the only writer. Any number of
+// processes open it read-only and query it without locks: the segment
+// holds a sequence number that the writer makes odd while it changes the
+// tree and even again when it is done, and a reader that sees it change
+// under a query runs the query again. Reads never block the writer, and
+// a query always sees the tree as it was between two updates.
+//
+// The segment is sized when it is created and does not grow.
+
+#ifndef SHM_TREE_H
+#define SHM_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bBST.h"
+#include "List.h"
+
+// Index 0 is reserved as the null child
+#define SHM_MAX_NODES (UINT32_MAX - 1)
+
+typedef struct shmTree *ShmTree;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of n, the number of nodes in the
+// tree, unless otherwise specified. Queries take longer if the writer
+// updates the tree while they run, as they are retried.
+
+/**
+ * Creates a new empty tree with room for capacity keys in the shared
+ * memory segment with the given name (e.g. "/bbst"), and opens it for
+ * writing. A segment of the same name is replaced, processes that have
+ * it open keep the old one.
+ * Returns NULL if the segment cannot be created.
+ * The time complexity of this function is O(capacity), to map the
+ * segment.
+ */
+ShmTree ShmTreeCreate(const char *name, uint32_t capacity);
+
+/**
+ * Opens the segment with the given name for reading.
+ * Returns NULL if it does not exist or does not hold a tree.
+ * The time complexity of this function is O(1).
+ */
+ShmTree ShmTreeOpen(const char *name);
+
+/**
+ * Unmaps the segment. The segment itself lives on until it is unlinked.
+ * The time complexity of this function is O(1).
+ */
+void ShmTreeClose(ShmTree t);
+
+/**
+ * Removes the segment with the given name, once every process has
+ * closed it. Returns false if there is no such segment.
+ */
+bool ShmTreeUnlink(const char *name);
+
+/**
+ * Returns the number of keys in the tree.
+ * The time complexity of this function is O(1).
+ */
+int ShmTreeSize(ShmTree t);
+
+/**
+ * Returns the number of updates the writer has made to the tree.
+ * The time complexity of this function is O(1).
+ */
+uint64_t ShmTreeVersion(ShmTree t);
+
+/**
+ * Returns how many times queries through this handle have been run
+ * again because the writer changed the tree under them.
+ */
+uint64_t ShmTreeRetries(ShmTree t);
+
+/**
+ * Returns the size of the segment in bytes.
+ * The time complexity of this function is O(1).
+ */
+size_t ShmTreeMemory(ShmTree t);
+
+/**
+ * Replaces the contents of the tree with the given keys, which must be
+ * in strictly ascending order, as one update. The tree is built
+ * perfectly balanced.
+ * Returns false if the tree was opened for reading or the keys do not
+ * fit.
+ * The time complexity of this function is O(n).
+ */
+bool ShmTreeBuild(ShmTree t, const int *keys, int n);
+
+/**
+ * Inserts the given key into the tree.
+ * Returns true if the key was inserted successfully, or false if the
+ * key was already present, the tree is full or it was opened for
+ * reading.
+ * The time complexity of this function is O(log n).
+ */
+bool ShmTreeInsert(ShmTree t, int key);
+
+/**
+ * Deletes the given key from the tree if it is present.
+ * Returns true if the key was deleted successfully, or false if the key
+ * was not present or the tree was opened for reading.
+ * The time complexity of this function is O(log n).
+ */
+bool ShmTreeDelete(ShmTree t, int key);
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ * The time complexity of this function is O(log n).
+ */
+bool ShmTreeSearch(ShmTree t, int key);
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int ShmTreeFloor(ShmTree t, int key);
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log n).
+ */
+int ShmTreeCeiling(ShmTree t, int key);
+
+/**
+ * Searches for all keys between the two given keys (inclusive) and
+ * returns the keys in order in a list.
+ * The time complexity of this function is O(log n + m), where m is the
+ * length of the returned list.
+ */
+List ShmTreeSearchBetween(ShmTree t, int lower, int upper);
+
+/**
+ * Checks that the tree is a valid AVL tree: keys in ascending order,
+ * every stored height right and no node out of balance, and that every
+ * node handed out is either in the tree or on the free list. Prints
+ * what is wrong to stderr and returns false otherwise. A reader checks
+ * a consistent snapshot, as with any other query.
+ * The time complexity of this function is O(capacity).
+ */
+bool ShmTreeVerify(ShmTree t);
+
+#endif
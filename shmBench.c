@@ -0,0 +1,484 @@
+// Multi-process benchmark for the shared memory tree (shmBST.h).
+// The parent loads a keyset into a segment, either from a testBBST save
+// file (-f, read the way runLoad reads data.bst) or as -n random keys,
+// then forks -r reader processes. Each reader opens the segment and runs
+// searches, floors, ceilings and ranges on random keys for -d seconds,
+// while the parent keeps updating the tree at -u inserts and deletes a
+// second. The parent only deletes keys it inserted itself, so every key
+// of the keyset must be found by every query, and the readers check it.
+//
+// For comparison the parent also loads the keyset into a private Tree,
+// as each worker would otherwise have to, and reports the time and
+// memory that takes next to the startup time and proportional memory
+// (Pss) of each reader.
+//
+// Usage: ./shmBench [-n keys | -f file] [-k keyspace] [-r readers]
+//                   [-d seconds] [-u updates per second] [-s name]
+//                   [-x seed]
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "List.h"
+#include "shmBST.h"
+
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_KEYSPACE (1 << 30)
+#define DEFAULT_READERS 4
+#define DEFAULT_SECONDS 3
+#define DEFAULT_UPDATES 10000
+#define DEFAULT_NAME "/bbst-shmBench"
+#define MAX_READERS 256
+#define RANGE_SPAN 16
+
+typedef struct config
+{
+	int keys;
+	const char *file;
+	int keyspace;
+	int readers;
+	int seconds;
+	int updates;
+	const char *name;
+	uint64_t seed;
+} Config;
+
+// Sent by each reader to the parent through a pipe
+typedef struct readerResult
+{
+	int id;
+	long ops;
+	long retries;
+	long errors;
+	double startupUs;
+	long pssKb;
+} ReaderResult;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static int *LoadKeys(Config *c, int *n);
+static void PrivateLoad(int *keys, int n);
+static void Reader(Config *c, int id, int *keys, int n, int fd);
+static long Writer(Config *c, ShmTree t, int n);
+static int *SortedCopy(int *keys, int *n);
+static long ReadStatus(const char *file, const char *field);
+static int OrderIncreasing(const void *a, const void *b);
+static uint64_t NextRandom(uint64_t *state);
+static double Now(void);
+static void PrintUsage(const char *name);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	Config c = {
+		.keys = DEFAULT_KEYS,
+		.keyspace = DEFAULT_KEYSPACE,
+		.readers = DEFAULT_READERS,
+		.seconds = DEFAULT_SECONDS,
+		.updates = DEFAULT_UPDATES,
+		.name = DEFAULT_NAME,
+		.seed = 1,
+	};
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-n") == 0 && hasValue)
+			c.keys = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-f") == 0 && hasValue)
+			c.file = argv[++i];
+		else if (strcmp(argv[i], "-k") == 0 && hasValue)
+			c.keyspace = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && hasValue)
+			c.readers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-d") == 0 && hasValue)
+			c.seconds = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-u") == 0 && hasValue)
+			c.updates = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && hasValue)
+			c.name = argv[++i];
+		else if (strcmp(argv[i], "-x") == 0 && hasValue)
+			c.seed = strtoull(argv[++i], NULL, 10);
+		else
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (c.keys < 0 || c.keyspace < 1 || c.readers < 0 || c.readers > MAX_READERS ||
+		c.seconds < 1 || c.updates < 0)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int n;
+	int *keys = LoadKeys(&c, &n);
+	PrivateLoad(keys, n);
+
+	// Room for the keyset and every key the writer could insert
+	int distinct = n;
+	int *sorted = SortedCopy(keys, &distinct);
+	uint64_t capacity = (uint64_t)distinct + (uint64_t)c.updates * c.seconds / 2 + 1024;
+	ShmTree t = ShmTreeCreate(c.name, capacity > SHM_MAX_NODES ? SHM_MAX_NODES : capacity);
+	if (t == NULL)
+		return EXIT_FAILURE;
+
+	double start = Now();
+	ShmTreeBuild(t, sorted, distinct);
+	printf("Shared tree: %d keys built in %.3f s, segment of %.1f MiB\n", distinct,
+		   Now() - start, ShmTreeMemory(t) / 1048576.0);
+	free(sorted);
+
+	int fds[2];
+	if (pipe(fds) != 0)
+	{
+		perror("pipe");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < c.readers; i++)
+	{
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+		if (pid == 0)
+		{
+			close(fds[0]);
+			ShmTreeClose(t);
+			Reader(&c, i, keys, n, fds[1]);
+			_exit(EXIT_SUCCESS);
+		}
+	}
+	close(fds[1]);
+
+	long updates = Writer(&c, t, n);
+
+	long totalOps = 0;
+	long errors = 0;
+	ReaderResult r;
+	printf("%-6s %12s %12s %10s %12s %10s\n", "reader", "ops/s", "retries", "errors",
+		   "startup us", "Pss KiB");
+	while (read(fds[0], &r, sizeof(r)) == sizeof(r))
+	{
+		printf("%-6d %12.0f %12ld %10ld %12.1f %10ld\n", r.id, (double)r.ops / c.seconds,
+			   r.retries, r.errors, r.startupUs, r.pssKb);
+		totalOps += r.ops;
+		errors += r.errors;
+	}
+	close(fds[0]);
+	while (wait(NULL) > 0)
+		;
+
+	printf("Readers: %.0f queries/s in total; writer: %ld updates, %d keys at the end\n",
+		   (double)totalOps / c.seconds, updates, ShmTreeSize(t));
+
+	ShmTreeClose(t);
+	ShmTreeUnlink(c.name);
+	free(keys);
+	return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * The keyset, from the file if one was given, in the order it is to be
+ * inserted
+ */
+static int *LoadKeys(Config *c, int *n)
+{
+	int capacity = (c->file == NULL) ? c->keys : 1024;
+	int *keys = malloc((capacity > 0 ? capacity : 1) * sizeof(int));
+	if (keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	*n = 0;
+	if (c->file == NULL)
+	{
+		uint64_t state = c->seed;
+		for (; *n < c->keys; (*n)++)
+			keys[*n] = NextRandom(&state) % c->keyspace;
+		return keys;
+	}
+
+	FILE *fp = fopen(c->file, "r");
+	if (fp == NULL)
+	{
+		perror(c->file);
+		exit(EXIT_FAILURE);
+	}
+
+	int key;
+	while (fscanf(fp, " %d", &key) == 1)
+	{
+		if (*n == capacity)
+		{
+			capacity *= 2;
+			keys = realloc(keys, capacity * sizeof(int));
+			if (keys == NULL)
+			{
+				fprintf(stderr, "Could not grow Keys\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		keys[(*n)++] = key;
+	}
+
+	fclose(fp);
+	return keys;
+}
+
+/**
+ * Load the keyset into a private Tree the way runLoad does, and report
+ * what it costs each process that does so
+ */
+static void PrivateLoad(int *keys, int n)
+{
+	// The tree reports every duplicate key
+	fflush(stderr);
+	int savedStderr = dup(STDERR_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (savedStderr >= 0 && devNull >= 0)
+		dup2(devNull, STDERR_FILENO);
+
+	long before = ReadStatus("/proc/self/status", "VmRSS:");
+	double start = Now();
+	Tree t = TreeNew();
+	for (int i = 0; i < n; i++)
+		TreeInsert(t, keys[i]);
+	double seconds = Now() - start;
+	long after = ReadStatus("/proc/self/status", "VmRSS:");
+	TreeFree(t);
+
+	if (savedStderr >= 0)
+	{
+		dup2(savedStderr, STDERR_FILENO);
+		close(savedStderr);
+	}
+	if (devNull >= 0)
+		close(devNull);
+
+	printf("Private tree: %d keys loaded in %.3f s, %.1f MiB per process\n", n, seconds,
+		   (after - before) / 1024.0);
+}
+
+/**
+ * Run queries on the shared tree until the time is up, then send the
+ * results to the parent
+ */
+static void Reader(Config *c, int id, int *keys, int n, int fd)
+{
+	ReaderResult r = {.id = id};
+	uint64_t state = c->seed * 1000003 + id + 1;
+
+	double start = Now();
+	ShmTree t = ShmTreeOpen(c->name);
+	if (t == NULL)
+		_exit(EXIT_FAILURE);
+	if (n > 0)
+		ShmTreeSearch(t, keys[0]);
+	r.startupUs = (Now() - start) * 1e6;
+
+	double end = start + c->seconds;
+	while (n > 0)
+	{
+		// Check the clock every so often, it costs as much as a query
+		for (int i = 0; i < 256; i++)
+		{
+			uint64_t x = NextRandom(&state);
+			int key = keys[(x >> 32) % n];
+			int probe = (int)((x & 0xffffffff) % c->keyspace);
+			int result;
+			List l;
+
+			switch (x % 5)
+			{
+			case 0:
+			case 1:
+				r.errors += !ShmTreeSearch(t, key);
+				break;
+			case 2:
+				r.errors += ShmTreeFloor(t, key) != key;
+				result = ShmTreeFloor(t, probe);
+				r.errors += result != UNDEFINED && result > probe;
+				break;
+			case 3:
+				r.errors += ShmTreeCeiling(t, key) != key;
+				result = ShmTreeCeiling(t, probe);
+				r.errors += result != UNDEFINED && result < probe;
+				break;
+			default:
+				l = ShmTreeSearchBetween(t, probe, probe + RANGE_SPAN);
+				ListFree(l);
+			}
+			r.ops++;
+		}
+
+		if (Now() >= end)
+			break;
+	}
+
+	r.retries = ShmTreeRetries(t);
+	r.pssKb = ReadStatus("/proc/self/smaps_rollup", "Pss:");
+	ShmTreeClose(t);
+
+	if (write(fd, &r, sizeof(r)) != sizeof(r))
+		perror("write");
+	close(fd);
+}
+
+/**
+ * Insert keys that are not in the keyset and delete them again, at the
+ * configured rate, until the readers are done. Returns the number of
+ * updates.
+ */
+static long Writer(Config *c, ShmTree t, int n)
+{
+	int capacity = c->updates * c->seconds / 2 + 1;
+	int *added = malloc(capacity * sizeof(int));
+	if (added == NULL)
+	{
+		fprintf(stderr, "Could not malloc Added Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t state = c->seed ^ 0x5bd1e995;
+	int count = 0;
+	long updates = 0;
+	double start = Now();
+	double end = start + c->seconds;
+
+	for (double now = start; now < end; now = Now())
+	{
+		if (updates >= c->updates * (now - start))
+		{
+			struct timespec pause = {0, 100000};
+			nanosleep(&pause, NULL);
+			continue;
+		}
+
+		// Grow the set of added keys to about half the updates, then
+		// delete and insert in turn
+		uint64_t x = NextRandom(&state);
+		if (count > 0 && (count == capacity || x % 2 == 0))
+		{
+			int i = (x >> 32) % count;
+			ShmTreeDelete(t, added[i]);
+			added[i] = added[--count];
+			updates++;
+		}
+		else
+		{
+			int key = (x >> 32) % c->keyspace;
+			if (!ShmTreeSearch(t, key) && ShmTreeInsert(t, key))
+			{
+				added[count++] = key;
+				updates++;
+			}
+		}
+	}
+
+	free(added);
+	return updates;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * The distinct keys in ascending order, n is updated to their number
+ */
+static int *SortedCopy(int *keys, int *n)
+{
+	int *sorted = malloc((*n > 0 ? *n : 1) * sizeof(int));
+	if (sorted == NULL)
+	{
+		fprintf(stderr, "Could not malloc Sorted Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(sorted, keys, *n * sizeof(int));
+	qsort(sorted, *n, sizeof(int), OrderIncreasing);
+
+	int distinct = 0;
+	for (int i = 0; i < *n; i++)
+		if (distinct == 0 || sorted[distinct - 1] != sorted[i])
+			sorted[distinct++] = sorted[i];
+
+	*n = distinct;
+	return sorted;
+}
+
+/**
+ * Value in KiB of a "Field:   123 kB" line of a /proc file, or -1
+ */
+static long ReadStatus(const char *file, const char *field)
+{
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+		return -1;
+
+	char line[256];
+	long value = -1;
+	size_t length = strlen(field);
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (strncmp(line, field, length) == 0)
+		{
+			value = atol(line + length);
+			break;
+		}
+	}
+
+	fclose(fp);
+	return value;
+}
+
+static int OrderIncreasing(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * splitmix64
+ */
+static uint64_t NextRandom(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static double Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [-n keys | -f file] [-k keyspace] [-r readers]\n"
+			"       [-d seconds] [-u updates per second] [-s name] [-x seed]\n",
+			name);
+}
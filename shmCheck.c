@@ -0,0 +1,636 @@
+// Checker for Shared Memory Balanced Binary Search Trees.
+// The first passes run in one process. Random inserts and deletes go
+// through the writer's handle and a sorted array of the same keys. After
+// every batch the checker compares search, floor, ceiling and the Lists
+// of SearchBetween, read back with ListCapture, through the writer's
+// handle and a second, read-only handle. ShmTreeVerify checks the AVL
+// shape and the free list, after every update in the early batches
+// while the tree is small and rotations reach the root, and after every
+// batch from then on. A tree filled to its capacity must refuse one
+// more key and, once half its keys are deleted, take as many new ones,
+// as it can only do by reusing the deleted nodes.
+//
+// The last pass forks readers that query the segment while the parent
+// slides a window of consecutive keys upwards, inserting one above it
+// and deleting the lowest, in a tree with only two nodes to spare, so
+// that nodes are freed and reused all the time. Any consistent snapshot
+// holds W or W + 1 consecutive keys whose lowest never goes down, and
+// the readers check every answer against that.
+//
+// Usage: ./shmCheck [-o operations] [-r readers] [-s seed]
+
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "List.h"
+#include "listCapture.h"
+#include "shmBST.h"
+
+#define DEFAULT_OPS 100000
+#define DEFAULT_READERS 2
+#define MAX_READERS 64
+// Operations between two full comparisons
+#define BATCH 2000
+// Batches verified after every update
+#define EARLY_BATCHES 2
+// Keys are drawn from [-KEYSPACE, KEYSPACE), plus the ends of int
+#define KEYSPACE 4096
+#define CAPACITY (2 * KEYSPACE + 2)
+#define REUSE_CAPACITY 4096
+// Keys in the window of the reader pass, and slides of the window
+#define WINDOW 512
+#define SLIDES 200000
+
+typedef struct reference
+{
+	int keys[CAPACITY];
+	int size;
+} Reference;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkRandom(const char *name, int ops, unsigned int seed);
+static bool checkReuse(const char *name, unsigned int seed);
+static bool checkReaders(const char *name, int readers, unsigned int seed);
+static bool runReader(const char *name, unsigned int seed);
+static bool checkSnapshot(List l, int *lowest);
+static bool checkUpdate(ShmTree t, Reference *ref, int key, bool insert);
+static bool checkQueries(ShmTree t, ShmTree r, Reference *ref, unsigned int *state);
+static bool checkProbe(ShmTree t, Reference *ref, int key);
+static bool checkBetween(ShmTree t, Reference *ref, int lower, int upper);
+static int LowerBound(Reference *ref, int key);
+static int randomKey(unsigned int *state);
+static int randomProbe(unsigned int *state);
+static int Silence(void);
+static void Restore(int saved);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	int readers = DEFAULT_READERS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			readers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-r readers] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (readers < 1 || readers > MAX_READERS)
+	{
+		fprintf(stderr, "Need 1 to %d readers\n", MAX_READERS);
+		return EXIT_FAILURE;
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	// One segment per run, so that runs in parallel do not meet
+	char name[64];
+	snprintf(name, sizeof(name), "/bbst-shmCheck-%d", (int)getpid());
+
+	int failures = 0;
+	failures += !checkRandom(name, ops, seed);
+	failures += !checkReuse(name, seed);
+	failures += !checkReaders(name, readers, seed);
+	ShmTreeUnlink(name);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Random inserts and deletes through the writer, growing and shrinking
+ * the tree in turns, with every query compared after each batch
+ */
+static bool checkRandom(const char *name, int ops, unsigned int seed)
+{
+	static Reference ref;
+	ShmTree t = ShmTreeCreate(name, CAPACITY);
+	ShmTree r = ShmTreeOpen(name);
+	if (t == NULL || r == NULL)
+	{
+		printf("FAIL random operations  could not create and open %s\n", name);
+		ShmTreeClose(t);
+		ShmTreeClose(r);
+		return false;
+	}
+
+	unsigned int state = seed;
+	ref.size = 0;
+	bool ok = true;
+
+	// The reader's handle cannot change the tree
+	int saved = Silence();
+	if (ShmTreeInsert(r, 1) || ShmTreeDelete(r, 1) || ShmTreeBuild(r, NULL, 0))
+	{
+		Restore(saved);
+		printf("FAIL a read-only handle changed the tree\n");
+		ok = false;
+	}
+	else
+		Restore(saved);
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int insertPct = (i / (4 * BATCH) % 2 == 0) ? 65 : 35;
+		int key = randomKey(&state);
+		ok = checkUpdate(t, &ref, key, (int)(NextRandom(&state) % 100) < insertPct);
+
+		if (ok && i < EARLY_BATCHES * BATCH)
+			ok = ShmTreeVerify(t);
+		if (ok && i % BATCH == BATCH - 1)
+			ok = checkQueries(t, r, &ref, &state);
+	}
+
+	if (ok)
+		ok = checkQueries(t, r, &ref, &state);
+
+	// Rebuilding from the same keys gives a tree with the same answers
+	if (ok && !ShmTreeBuild(t, ref.keys, ref.size))
+	{
+		printf("FAIL build from %d keys\n", ref.size);
+		ok = false;
+	}
+	ok = ok && checkQueries(t, r, &ref, &state);
+
+	printf("%s random operations  %d operations, %d keys, version %llu\n",
+		   ok ? "PASS" : "FAIL", ops, ShmTreeSize(t), (unsigned long long)ShmTreeVersion(t));
+	ShmTreeClose(r);
+	ShmTreeClose(t);
+	return ok;
+}
+
+/**
+ * Fill a tree to its capacity, check it refuses another key, then in
+ * each round delete half of its keys and insert as many new ones, which
+ * only fit in the deleted nodes
+ */
+static bool checkReuse(const char *name, unsigned int seed)
+{
+	static Reference ref;
+	ShmTree t = ShmTreeCreate(name, REUSE_CAPACITY);
+	if (t == NULL)
+	{
+		printf("FAIL node reuse         could not create %s\n", name);
+		return false;
+	}
+
+	unsigned int state = seed;
+	ref.size = 0;
+	bool ok = true;
+
+	for (int key = 0; key < 2 * REUSE_CAPACITY && ok; key += 2)
+		ok = checkUpdate(t, &ref, key, true);
+
+	int saved = Silence();
+	bool full = ok && !ShmTreeInsert(t, -1);
+	Restore(saved);
+	if (ok && !full)
+	{
+		printf("FAIL a full tree took another key\n");
+		ok = false;
+	}
+
+	// New keys go in next to the deleted ones, in their nodes
+	for (int round = 0; round < 8 && ok; round++)
+	{
+		int deleted[REUSE_CAPACITY / 2];
+		for (int i = 0; i < REUSE_CAPACITY / 2 && ok; i++)
+		{
+			deleted[i] = ref.keys[NextRandom(&state) % ref.size];
+			ok = checkUpdate(t, &ref, deleted[i], false);
+		}
+
+		for (int i = 0; i < REUSE_CAPACITY / 2 && ok; i++)
+		{
+			int key = deleted[i] + 1;
+			int pos = LowerBound(&ref, key);
+			while (pos < ref.size && ref.keys[pos] == key)
+			{
+				key = (int)(NextRandom(&state) % (4 * REUSE_CAPACITY));
+				pos = LowerBound(&ref, key);
+			}
+			ok = checkUpdate(t, &ref, key, true);
+		}
+
+		saved = Silence();
+		full = ok && !ShmTreeInsert(t, -1);
+		Restore(saved);
+		if (ok && !full)
+		{
+			printf("FAIL a full tree took another key in round %d\n", round);
+			ok = false;
+		}
+
+		ok = ok && ShmTreeVerify(t) && checkQueries(t, NULL, &ref, &state);
+	}
+
+	printf("%s node reuse         8 rounds of %d deletes and inserts in %d nodes\n",
+		   ok ? "PASS" : "FAIL", REUSE_CAPACITY / 2, REUSE_CAPACITY);
+	ShmTreeClose(t);
+	return ok;
+}
+
+/**
+ * Fork readers that check every snapshot they see while the parent
+ * slides the window of keys upwards
+ */
+static bool checkReaders(const char *name, int readers, unsigned int seed)
+{
+	ShmTree t = ShmTreeCreate(name, WINDOW + 2);
+	if (t == NULL)
+	{
+		printf("FAIL readers            could not create %s\n", name);
+		return false;
+	}
+
+	int keys[WINDOW];
+	for (int i = 0; i < WINDOW; i++)
+		keys[i] = i;
+	bool ok = ShmTreeBuild(t, keys, WINDOW);
+
+	// Flush before forking, or the children print the parent's output
+	fflush(stdout);
+	pid_t pids[MAX_READERS];
+	int started = 0;
+	for (int i = 0; i < readers && ok; i++)
+	{
+		pids[i] = fork();
+		if (pids[i] < 0)
+		{
+			printf("FAIL could not fork reader %d\n", i);
+			ok = false;
+			break;
+		}
+		if (pids[i] == 0)
+		{
+			ShmTreeClose(t);
+			exit(runReader(name, seed + i) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		started++;
+	}
+
+	for (int lowest = 0; lowest < SLIDES && ok; lowest++)
+	{
+		ok = ShmTreeInsert(t, lowest + WINDOW) && ShmTreeDelete(t, lowest);
+		if (!ok)
+			printf("FAIL slide %d of the window\n", lowest);
+	}
+
+	// The key past the end tells the readers to stop, and if the tree
+	// cannot take it they are stopped by force
+	if (!ShmTreeInsert(t, INT_MAX))
+	{
+		for (int i = 0; i < started; i++)
+			kill(pids[i], SIGKILL);
+		ok = false;
+	}
+
+	for (int i = 0; i < started; i++)
+	{
+		int status;
+		if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) ||
+			WEXITSTATUS(status) != EXIT_SUCCESS)
+			ok = false;
+	}
+
+	ok = ok && ShmTreeVerify(t);
+	printf("%s readers            %d readers, %d slides of %d keys\n", ok ? "PASS" : "FAIL",
+		   started, SLIDES, WINDOW);
+	ShmTreeClose(t);
+	return ok;
+}
+
+/**
+ * Query the window until the parent inserts INT_MAX. Returns false after
+ * printing the first answer no consistent snapshot could give.
+ */
+static bool runReader(const char *name, unsigned int seed)
+{
+	ShmTree t = ShmTreeOpen(name);
+	if (t == NULL)
+		return false;
+
+	unsigned int state = seed;
+	int lowest = 0;
+	long snapshots = 0;
+	bool ok = true;
+
+	while (ok && !ShmTreeSearch(t, INT_MAX))
+	{
+		// All the keys, W or W + 1 of them in a row
+		List l = ShmTreeSearchBetween(t, INT_MIN + 1, INT_MAX - 1);
+		ok = checkSnapshot(l, &lowest);
+		ListFree(l);
+		snapshots++;
+
+		// Each query sees a window no lower than the last. Below it
+		// nothing is left and the ceiling is its lowest key, and the floor
+		// of a key inside or above it is in it, unless it has moved past.
+		int below = lowest - 1 - (int)(NextRandom(&state) % 64);
+		bool found = ShmTreeSearch(t, below);
+		int ceiling = ShmTreeCeiling(t, below);
+		if (ok && (found || ceiling < lowest || ceiling == INT_MAX))
+		{
+			printf("FAIL reader found %d %d, ceiling %d below lowest %d\n", below, found,
+				   ceiling, lowest);
+			ok = false;
+		}
+		else
+			lowest = ceiling;
+
+		int above = lowest + (int)(NextRandom(&state) % (2 * WINDOW));
+		int floor = ShmTreeFloor(t, above);
+		if (ok && floor != UNDEFINED && (floor < lowest || floor > above))
+		{
+			printf("FAIL reader floor %d of %d, lowest %d\n", floor, above, lowest);
+			ok = false;
+		}
+		else if (floor == UNDEFINED)
+			lowest = above + 1;
+	}
+
+	if (ok && ShmTreeVerify(t) == false)
+		ok = false;
+
+	if (!ok)
+		printf("FAIL reader %d after %ld snapshots, %llu retries\n", (int)getpid(), snapshots,
+			   (unsigned long long)ShmTreeRetries(t));
+	fflush(stdout);
+	ShmTreeClose(t);
+	return ok;
+}
+
+/**
+ * Check the keys of one snapshot are W or W + 1 keys in a row, starting
+ * no lower than the last one
+ */
+static bool checkSnapshot(List l, int *lowest)
+{
+	int *keys;
+	int size = ListCapture(l, &keys);
+
+	bool ok = (size == WINDOW || size == WINDOW + 1) && keys[0] >= *lowest;
+	for (int i = 1; ok && i < size; i++)
+		ok = keys[i] == keys[i - 1] + 1;
+
+	if (!ok)
+		printf("FAIL reader snapshot of %d keys from %d, lowest seen %d\n", size,
+			   size > 0 ? keys[0] : UNDEFINED, *lowest);
+	else
+		*lowest = keys[0];
+
+	free(keys);
+	return ok;
+}
+
+/**
+ * Insert or delete a key through the writer and in the array, and
+ * compare what they return. The tree complains about duplicates and
+ * missing keys on stderr, which is silenced for the updates that are
+ * expected to be refused.
+ */
+static bool checkUpdate(ShmTree t, Reference *ref, int key, bool insert)
+{
+	int pos = LowerBound(ref, key);
+	bool present = pos < ref->size && ref->keys[pos] == key;
+	bool want = (key != UNDEFINED) && (insert ? !present : present);
+
+	int saved = want ? -1 : Silence();
+	bool got = insert ? ShmTreeInsert(t, key) : ShmTreeDelete(t, key);
+	if (!want)
+		Restore(saved);
+
+	if (want && insert)
+	{
+		memmove(&ref->keys[pos + 1], &ref->keys[pos], (ref->size - pos) * sizeof(int));
+		ref->keys[pos] = key;
+		ref->size++;
+	}
+	else if (want)
+	{
+		memmove(&ref->keys[pos], &ref->keys[pos + 1], (ref->size - pos - 1) * sizeof(int));
+		ref->size--;
+	}
+
+	if (got != want)
+	{
+		printf("FAIL %s %d returned %d, expected %d\n", insert ? "insert" : "delete", key, got,
+			   want);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the size, the shape and every query on random probes and
+ * ranges, through the writer's handle and the reader's if there is one
+ */
+static bool checkQueries(ShmTree t, ShmTree r, Reference *ref, unsigned int *state)
+{
+	bool ok = ShmTreeVerify(t);
+	if (ok && ShmTreeSize(t) != ref->size)
+	{
+		printf("FAIL size is %d, expected %d\n", ShmTreeSize(t), ref->size);
+		ok = false;
+	}
+
+	for (int i = 0; i < 128 && ok; i++)
+	{
+		// Half the probes land on or next to a key
+		int key = randomProbe(state);
+		if (ref->size > 0 && i % 2 == 0)
+		{
+			long long near = (long long)ref->keys[NextRandom(state) % ref->size] +
+							 (int)(NextRandom(state) % 3) - 1;
+			key = (near < INT_MIN || near > INT_MAX) ? key : (int)near;
+		}
+		ok = checkProbe(t, ref, key) && (r == NULL || checkProbe(r, ref, key));
+	}
+
+	ok = ok && checkBetween(t, ref, INT_MIN, INT_MAX) && checkBetween(t, ref, INT_MIN + 1, INT_MAX);
+	for (int i = 0; i < 16 && ok; i++)
+	{
+		int lower = randomProbe(state);
+		int upper = randomProbe(state);
+		// Ordered three times in four, inverted ranges are empty
+		if (NextRandom(state) % 4 != 0 && lower > upper)
+		{
+			int tmp = lower;
+			lower = upper;
+			upper = tmp;
+		}
+		ok = checkBetween(t, ref, lower, upper) && (r == NULL || checkBetween(r, ref, lower, upper));
+	}
+
+	return ok;
+}
+
+/**
+ * Compare search, floor and ceiling at a key
+ */
+static bool checkProbe(ShmTree t, Reference *ref, int key)
+{
+	int pos = LowerBound(ref, key);
+	bool present = key != UNDEFINED && pos < ref->size && ref->keys[pos] == key;
+	int floor = present ? key : (pos > 0 ? ref->keys[pos - 1] : UNDEFINED);
+	int ceiling = (pos < ref->size) ? ref->keys[pos] : UNDEFINED;
+
+	if (ShmTreeSearch(t, key) != present || ShmTreeFloor(t, key) != floor ||
+		ShmTreeCeiling(t, key) != ceiling)
+	{
+		printf("FAIL probe %d: search %d, floor %d, ceiling %d; expected %d, %d, %d\n", key,
+			   ShmTreeSearch(t, key), ShmTreeFloor(t, key), ShmTreeCeiling(t, key), present,
+			   floor, ceiling);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the List of SearchBetween with the keys of the array in the
+ * range, which is empty if it is inverted or either bound is UNDEFINED
+ */
+static bool checkBetween(ShmTree t, Reference *ref, int lower, int upper)
+{
+	int start = LowerBound(ref, lower);
+	int end = start;
+	if (lower <= upper && lower != UNDEFINED && upper != UNDEFINED)
+		while (end < ref->size && ref->keys[end] <= upper)
+			end++;
+
+	List l = ShmTreeSearchBetween(t, lower, upper);
+	int *keys;
+	int size = ListCapture(l, &keys);
+	ListFree(l);
+
+	bool ok = size == end - start &&
+			  (size == 0 || memcmp(keys, &ref->keys[start], size * sizeof(int)) == 0);
+	if (!ok)
+		printf("FAIL search between %d and %d returned %d keys, expected %d\n", lower, upper,
+			   size, end - start);
+
+	free(keys);
+	return ok;
+}
+
+/**
+ * The position of the first key of the array not less than key
+ */
+static int LowerBound(Reference *ref, int key)
+{
+	int lo = 0;
+	int hi = ref->size;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (ref->keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * A key from the keyspace, or now and then one of the ends of int or
+ * UNDEFINED itself
+ */
+static int randomKey(unsigned int *state)
+{
+	switch (NextRandom(state) % 64)
+	{
+	case 0:
+		return INT_MAX;
+	case 1:
+		return INT_MIN + 1;
+	case 2:
+		return UNDEFINED;
+	default:
+		return (int)(NextRandom(state) % (2 * KEYSPACE)) - KEYSPACE;
+	}
+}
+
+/**
+ * A value in or just outside the keyspace, or at the ends of int
+ */
+static int randomProbe(unsigned int *state)
+{
+	switch (NextRandom(state) % 8)
+	{
+	case 0:
+		return INT_MAX - (int)(NextRandom(state) % 2);
+	case 1:
+		return INT_MIN + (int)(NextRandom(state) % 3);
+	default:
+		return (int)(NextRandom(state) % (2 * KEYSPACE + 20)) - KEYSPACE - 10;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Silence(void)
+{
+	fflush(stderr);
+	int saved = dup(STDERR_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0)
+	{
+		dup2(devNull, STDERR_FILENO);
+		close(devNull);
+	}
+	return saved;
+}
+
+static void Restore(int saved)
+{
+	if (saved < 0)
+		return;
+
+	fflush(stderr);
+	dup2(saved, STDERR_FILENO);
+	close(saved);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,962 @@
+// Parallel differential stress tester for Balanced Binary Search Trees.
+// Each worker thread runs a stream of independent cases. A case is a
+// random sequence of operations applied both to a Tree and to a sorted
+// array holding the same keys, and every result is compared with the
+// array. After each insert or delete the AVL invariants are checked on
+// the nodes the update can have changed, the search path of the key and
+// the children of the nodes on it, and the whole tree is checked at the
+// end of every case, so a case costs O(ops * log n + n).
+//
+// Every case has its own seed, derived from the run seed, the worker and
+// the case number, so any case can be rerun on its own with -c. When a
+// case fails, its operations are minimized with delta debugging (ddmin)
+// to a short sequence that still fails, and written as a testBBST script
+// to stress-w<worker>-<case seed>.txt.
+//
+// The List returned by TreeSearchBetween is read back through ListShow
+// (see listCapture.h) and compared with the keys of the reference in the
+// range. Workers take StdoutLock around these captures and their own
+// output, since stdout is redirected while a List is read.
+//
+// Usage: ./stressBBST [-t threads] [-n ops per worker] [-s seed]
+//                     [-k keyspace] [-l case length] [-o directory]
+//                     [-c case seed]
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "List.h"
+#include "listCapture.h"
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) && !defined(__SANITIZE_ADDRESS__)
+#define __SANITIZE_ADDRESS__
+#endif
+#endif
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#define DEFAULT_OPS 10000000L
+#define DEFAULT_KEYSPACE 1024
+#define DEFAULT_CASE_LENGTH 2000
+// A worker stops after this many failing cases
+#define MAX_FAILURES 5
+#define MAX_THREADS 256
+
+typedef enum opType
+{
+	OP_INSERT,
+	OP_DELETE,
+	OP_SEARCH,
+	OP_FLOOR,
+	OP_CEILING,
+	OP_KTH_SMALLEST,
+	OP_KTH_LARGEST,
+	OP_LCA,
+	OP_BETWEEN,
+	NUM_OP_TYPES,
+} OpType;
+
+static const char *OpNames[NUM_OP_TYPES] = {
+	"insert", "delete", "search", "floor", "ceiling", "kth smallest",
+	"kth largest", "lca", "between"};
+
+// Relative weight of each operation, updates first so the tree grows
+static const int Mix[NUM_OP_TYPES] = {30, 25, 10, 10, 10, 5, 5, 3, 2};
+
+typedef struct op
+{
+	OpType type;
+	int a;
+	int b;
+} Op;
+
+typedef struct config
+{
+	int threads;
+	long ops;
+	uint64_t seed;
+	int keyspace;
+	int length;
+	const char *dir;
+} Config;
+
+// Keys in the tree, sorted
+typedef struct reference
+{
+	int *keys;
+	int size;
+} Reference;
+
+typedef struct worker
+{
+	pthread_t thread;
+	int id;
+	Config *c;
+	uint64_t state;
+	// Operations of the current case
+	Op *ops;
+	Reference ref;
+	// Why the last failing case failed
+	char reason[256];
+	long opsRun;
+	long cases;
+	int failures;
+} Worker;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void *RunWorker(void *arg);
+static bool RunCase(Worker *w, uint64_t caseSeed, bool report);
+static void Generate(Worker *w, Op *op);
+static bool Replay(Worker *w, Op *ops, int n, int *failedAt);
+static bool Apply(Worker *w, Tree t, Op *op);
+static bool CheckBetween(Worker *w, List l, int lower, int upper);
+static int Minimize(Worker *w, Op *ops, int n);
+static void WriteFailure(Worker *w, uint64_t caseSeed, Op *ops, int n);
+static bool CheckPath(Worker *w, Node root, int key);
+static bool CheckNode(Worker *w, Node n);
+static bool CheckTree(Worker *w, Tree t);
+static int CheckSubtree(Worker *w, Node n, long lower, long upper, int *index);
+static int ReferenceFind(Reference *ref, int key);
+static int NodeLCA(Node n, int a, int b);
+static void ReportCrash(void);
+#ifdef __SANITIZE_ADDRESS__
+static void OnSanitizerError(void);
+#else
+static void OnCrash(int sig);
+#endif
+static uint64_t CaseSeed(uint64_t seed, int worker, long index);
+static uint64_t NextRandom(uint64_t *state);
+static int RandomBelow(uint64_t *state, int n);
+static int Height(Node n);
+static void PrintUsage(const char *name);
+
+// The case each thread is running, reported if it crashes
+static __thread volatile uint64_t CurrentCase;
+static __thread volatile int CurrentWorker = -1;
+// The real stderr, once the tree's messages are sent to /dev/null
+static int ErrorFd = STDERR_FILENO;
+// Held while a List is captured or a worker prints to stdout
+static pthread_mutex_t StdoutLock = PTHREAD_MUTEX_INITIALIZER;
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	Config c = {
+		.threads = (cpus > 0 && cpus <= MAX_THREADS) ? (int)cpus : 1,
+		.ops = DEFAULT_OPS,
+		.seed = 1,
+		.keyspace = DEFAULT_KEYSPACE,
+		.length = DEFAULT_CASE_LENGTH,
+		.dir = ".",
+	};
+	bool single = false;
+	uint64_t caseSeed = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		char *opt = argv[i];
+		if (opt[0] != '-' || opt[1] == '\0' || opt[2] != '\0' || i + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+
+		char *arg = argv[++i];
+		switch (opt[1])
+		{
+		case 't':
+			c.threads = atoi(arg);
+			break;
+		case 'n':
+			c.ops = atol(arg);
+			break;
+		case 's':
+			c.seed = strtoull(arg, NULL, 0);
+			break;
+		case 'k':
+			c.keyspace = atoi(arg);
+			break;
+		case 'l':
+			c.length = atoi(arg);
+			break;
+		case 'o':
+			c.dir = arg;
+			break;
+		case 'c':
+			single = true;
+			caseSeed = strtoull(arg, NULL, 0);
+			break;
+		default:
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (c.threads < 1 || c.threads > MAX_THREADS || c.ops < 0 ||
+		c.keyspace < 1 || c.length < 1)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// The tree reports every rejected insert or delete on stderr, which
+	// happens all the time here. Send those messages nowhere and keep
+	// the real stderr for crash reports
+	fflush(stderr);
+	int devNull = open("/dev/null", O_WRONLY);
+	ErrorFd = dup(STDERR_FILENO);
+	if (devNull < 0 || ErrorFd < 0 || dup2(devNull, STDERR_FILENO) < 0)
+	{
+		perror("/dev/null");
+		return EXIT_FAILURE;
+	}
+	close(devNull);
+
+#ifdef __SANITIZE_ADDRESS__
+	// The sanitizer catches the crashes itself and reports them first
+	__sanitizer_set_report_fd((void *)(intptr_t)ErrorFd);
+	__asan_set_death_callback(OnSanitizerError);
+#else
+	signal(SIGSEGV, OnCrash);
+	signal(SIGBUS, OnCrash);
+	signal(SIGFPE, OnCrash);
+	signal(SIGABRT, OnCrash);
+#endif
+
+	Worker *workers = calloc(c.threads, sizeof(Worker));
+	if (workers == NULL)
+	{
+		dprintf(ErrorFd, "Could not malloc Workers\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < c.threads; i++)
+	{
+		Worker *w = &workers[i];
+		w->id = i;
+		w->c = &c;
+		w->ops = malloc(c.length * sizeof(Op));
+		w->ref.keys = malloc(c.keyspace * sizeof(int));
+
+		if (w->ops == NULL || w->ref.keys == NULL)
+		{
+			dprintf(ErrorFd, "Could not malloc Worker\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (single)
+	{
+		// Rerun one case on this thread, as worker 0
+		CurrentWorker = 0;
+		bool ok = RunCase(&workers[0], caseSeed, true);
+		printf("Case %#llx %s\n", (unsigned long long)caseSeed, ok ? "passed" : "failed");
+	}
+	else
+	{
+		for (int i = 0; i < c.threads; i++)
+		{
+			if (pthread_create(&workers[i].thread, NULL, RunWorker, &workers[i]) != 0)
+			{
+				dprintf(ErrorFd, "Could not start worker %d\n", i);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		for (int i = 0; i < c.threads; i++)
+			pthread_join(workers[i].thread, NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	long ops = 0, cases = 0;
+	int failures = 0;
+	for (int i = 0; i < c.threads; i++)
+	{
+		ops += workers[i].opsRun;
+		cases += workers[i].cases;
+		failures += workers[i].failures;
+		free(workers[i].ops);
+		free(workers[i].ref.keys);
+	}
+	free(workers);
+
+	if (!single)
+		printf("%d workers, seed %llu: %ld ops in %ld cases, %.2f s, %.0f ops/sec, %d failed cases\n",
+			   c.threads, (unsigned long long)c.seed, ops, cases, seconds,
+			   (seconds > 0) ? ops / seconds : 0, failures);
+
+	return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Run cases until the worker has run its share of operations
+ */
+static void *RunWorker(void *arg)
+{
+	Worker *w = arg;
+	CurrentWorker = w->id;
+
+	while (w->opsRun < w->c->ops && w->failures < MAX_FAILURES)
+	{
+		uint64_t caseSeed = CaseSeed(w->c->seed, w->id, w->cases);
+		if (!RunCase(w, caseSeed, true))
+			w->failures++;
+		w->cases++;
+	}
+
+	return NULL;
+}
+
+/**
+ * Run one case, and if it fails minimize it and write it out.
+ * Returns true if the case passed.
+ */
+static bool RunCase(Worker *w, uint64_t caseSeed, bool report)
+{
+	CurrentCase = caseSeed;
+	w->state = caseSeed | 1;
+
+	// The last case of a worker is cut short to run exactly c->ops
+	int length = w->c->length;
+	long remaining = w->c->ops - w->opsRun;
+	if (remaining > 0 && remaining < length)
+		length = (int)remaining;
+
+	// Generating needs the reference as it is before each operation, so
+	// the case is generated and run in one pass
+	Tree t = TreeNew();
+	w->ref.size = 0;
+	int failedAt = -1;
+
+	for (int i = 0; i < length; i++)
+	{
+		Generate(w, &w->ops[i]);
+		w->opsRun++;
+		if (!Apply(w, t, &w->ops[i]))
+		{
+			failedAt = i;
+			break;
+		}
+	}
+
+	if (failedAt < 0 && !CheckTree(w, t))
+		failedAt = length - 1;
+	TreeFree(t);
+
+	if (failedAt < 0)
+		return true;
+
+	if (report)
+	{
+		char reason[sizeof(w->reason)];
+		memcpy(reason, w->reason, sizeof(reason));
+
+		int n = Minimize(w, w->ops, failedAt + 1);
+		WriteFailure(w, caseSeed, w->ops, n);
+		pthread_mutex_lock(&StdoutLock);
+		printf("Worker %d: case %#llx failed at op %d of %d: %s\n"
+			   "    minimized to %d ops: %s/stress-w%d-%llx.txt\n",
+			   w->id, (unsigned long long)caseSeed, failedAt + 1, length, reason,
+			   n, w->c->dir, w->id, (unsigned long long)caseSeed);
+		fflush(stdout);
+		pthread_mutex_unlock(&StdoutLock);
+	}
+
+	return false;
+}
+
+/**
+ * Pick the next operation with arguments that make sense for the keys in
+ * the tree: deletes and LCA queries usually name present keys, and k is
+ * always in range
+ */
+static void Generate(Worker *w, Op *op)
+{
+	Reference *ref = &w->ref;
+	int keyspace = w->c->keyspace;
+	int total = 0;
+	for (int i = 0; i < NUM_OP_TYPES; i++)
+		total += Mix[i];
+
+	int r = RandomBelow(&w->state, total);
+	OpType type = 0;
+	while (r >= Mix[type])
+		r -= Mix[type++];
+
+	// An empty tree has no k-th key
+	if ((type == OP_KTH_SMALLEST || type == OP_KTH_LARGEST) && ref->size == 0)
+		type = OP_INSERT;
+
+	op->type = type;
+	op->a = RandomBelow(&w->state, keyspace);
+	op->b = 0;
+
+	switch (type)
+	{
+	case OP_DELETE:
+		if (ref->size > 0 && RandomBelow(&w->state, 4) != 0)
+			op->a = ref->keys[RandomBelow(&w->state, ref->size)];
+		break;
+	case OP_KTH_SMALLEST:
+	case OP_KTH_LARGEST:
+		op->a = 1 + RandomBelow(&w->state, ref->size);
+		break;
+	case OP_LCA:
+		if (ref->size > 0 && RandomBelow(&w->state, 4) != 0)
+			op->a = ref->keys[RandomBelow(&w->state, ref->size)];
+		op->b = RandomBelow(&w->state, keyspace);
+		if (ref->size > 0 && RandomBelow(&w->state, 4) != 0)
+			op->b = ref->keys[RandomBelow(&w->state, ref->size)];
+		break;
+	case OP_BETWEEN:
+		op->b = op->a + RandomBelow(&w->state, keyspace / 8 + 1);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Run a sequence of operations on a fresh tree, returns true if they all
+ * pass. Operations whose k is out of range for the tree at that point
+ * are skipped, which happens once a sequence has been cut down.
+ */
+static bool Replay(Worker *w, Op *ops, int n, int *failedAt)
+{
+	Tree t = TreeNew();
+	w->ref.size = 0;
+	bool ok = true;
+
+	for (int i = 0; i < n && ok; i++)
+	{
+		if (!Apply(w, t, &ops[i]))
+		{
+			ok = false;
+			if (failedAt != NULL)
+				*failedAt = i;
+		}
+	}
+
+	ok = ok && CheckTree(w, t);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Apply an operation to the tree and the reference and compare the
+ * results. Returns false, with the reason in w->reason, on a mismatch
+ */
+static bool Apply(Worker *w, Tree t, Op *op)
+{
+	Reference *ref = &w->ref;
+	int i = ReferenceFind(ref, op->a);
+	bool present = i < ref->size && ref->keys[i] == op->a;
+	int expected, got;
+	List l;
+
+	switch (op->type)
+	{
+	case OP_INSERT:
+		got = TreeInsert(t, op->a);
+		expected = !present;
+		if (!present)
+		{
+			memmove(&ref->keys[i + 1], &ref->keys[i], (ref->size - i) * sizeof(int));
+			ref->keys[i] = op->a;
+			ref->size++;
+		}
+		if (got == expected && !CheckPath(w, t->root, op->a))
+			return false;
+		break;
+	case OP_DELETE:
+		got = TreeDelete(t, op->a);
+		expected = present;
+		if (present)
+		{
+			memmove(&ref->keys[i], &ref->keys[i + 1], (ref->size - i - 1) * sizeof(int));
+			ref->size--;
+		}
+		// A node with two children is replaced by its successor, which
+		// is removed from the bottom of the right subtree
+		if (got == expected && !CheckPath(w, t->root, op->a))
+			return false;
+		if (got == expected && present && i < ref->size && !CheckPath(w, t->root, ref->keys[i]))
+			return false;
+		break;
+	case OP_SEARCH:
+		got = TreeSearch(t, op->a);
+		expected = present;
+		break;
+	case OP_FLOOR:
+		got = TreeFloor(t, op->a);
+		expected = present ? op->a : (i > 0) ? ref->keys[i - 1] : UNDEFINED;
+		break;
+	case OP_CEILING:
+		got = TreeCeiling(t, op->a);
+		expected = (i < ref->size) ? ref->keys[i] : UNDEFINED;
+		break;
+	case OP_KTH_SMALLEST:
+	case OP_KTH_LARGEST:
+		if (op->a < 1 || op->a > ref->size)
+			return true;
+		got = (op->type == OP_KTH_SMALLEST) ? TreeKthSmallest(t, op->a) : TreeKthLargest(t, op->a);
+		expected = (op->type == OP_KTH_SMALLEST) ? ref->keys[op->a - 1] : ref->keys[ref->size - op->a];
+		break;
+	case OP_LCA:
+		got = TreeLCA(t, op->a, op->b);
+		i = ReferenceFind(ref, op->b);
+		// The LCA is the first node on the way down that lies between the
+		// two keys
+		expected = (present && i < ref->size && ref->keys[i] == op->b)
+					   ? NodeLCA(t->root, op->a, op->b)
+					   : UNDEFINED;
+		break;
+	case OP_BETWEEN:
+	{
+		l = TreeSearchBetween(t, op->a, op->b);
+		bool ok = CheckBetween(w, l, op->a, op->b);
+		ListFree(l);
+		return ok;
+	}
+	default:
+		return true;
+	}
+
+	if (got != expected)
+	{
+		snprintf(w->reason, sizeof(w->reason), "%s %d%s returned %d, expected %d",
+				 OpNames[op->type], op->a, (op->type == OP_LCA) ? " .." : "",
+				 got, expected);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the keys of a TreeSearchBetween List with the reference keys
+ * between lower and upper
+ */
+static bool CheckBetween(Worker *w, List l, int lower, int upper)
+{
+	int *keys;
+	pthread_mutex_lock(&StdoutLock);
+	int n = ListCapture(l, &keys);
+	pthread_mutex_unlock(&StdoutLock);
+
+	if (n < 0)
+	{
+		snprintf(w->reason, sizeof(w->reason), "between %d .. %d: could not read the List",
+				 lower, upper);
+		return false;
+	}
+
+	Reference *ref = &w->ref;
+	int first = ReferenceFind(ref, lower);
+	int last = ReferenceFind(ref, upper);
+	if (last < ref->size && ref->keys[last] == upper)
+		last++;
+	int expected = last - first;
+
+	bool ok = n == expected;
+	for (int i = 0; ok && i < n; i++)
+		ok = keys[i] == ref->keys[first + i];
+	free(keys);
+
+	if (!ok)
+		snprintf(w->reason, sizeof(w->reason),
+				 "between %d .. %d returned %d keys, expected %d in order", lower, upper, n,
+				 expected);
+	return ok;
+}
+
+/**
+ * Delta debugging: find a short subsequence of ops that still fails by
+ * repeatedly trying to remove chunks of it. Rewrites ops in place and
+ * returns the length of the subsequence.
+ */
+static int Minimize(Worker *w, Op *ops, int n)
+{
+	Op *candidate = malloc(n * sizeof(Op));
+	if (candidate == NULL)
+	{
+		dprintf(ErrorFd, "Could not malloc Candidate\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int granularity = 2;
+	while (n >= 2)
+	{
+		int chunk = (n + granularity - 1) / granularity;
+		bool reduced = false;
+
+		// Try the sequence with each chunk removed
+		for (int start = 0; start < n && !reduced; start += chunk)
+		{
+			int end = (start + chunk < n) ? start + chunk : n;
+			int m = 0;
+			for (int i = 0; i < n; i++)
+				if (i < start || i >= end)
+					candidate[m++] = ops[i];
+
+			int failedAt = m - 1;
+			if (m > 0 && !Replay(w, candidate, m, &failedAt))
+			{
+				// Anything after the failing op is not needed either
+				n = failedAt + 1;
+				memcpy(ops, candidate, n * sizeof(Op));
+				granularity = (granularity > 2) ? granularity - 1 : 2;
+				reduced = true;
+			}
+		}
+
+		if (!reduced)
+		{
+			if (granularity >= n)
+				break;
+			granularity = (granularity * 2 < n) ? granularity * 2 : n;
+		}
+	}
+
+	free(candidate);
+	return n;
+}
+
+/**
+ * Write a failing sequence as a testBBST script
+ */
+static void WriteFailure(Worker *w, uint64_t caseSeed, Op *ops, int n)
+{
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/stress-w%d-%llx.txt", w->c->dir, w->id,
+			 (unsigned long long)caseSeed);
+
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL)
+	{
+		pthread_mutex_lock(&StdoutLock);
+		printf("Could not write %s\n", path);
+		pthread_mutex_unlock(&StdoutLock);
+		return;
+	}
+
+	// The script has no k-th largest command, write it as a k-th smallest
+	// on the number of keys at that point
+	w->ref.size = 0;
+	Tree t = TreeNew();
+	for (int i = 0; i < n; i++)
+	{
+		Op *op = &ops[i];
+		switch (op->type)
+		{
+		case OP_INSERT:
+			fprintf(fp, "+ %d\n", op->a);
+			break;
+		case OP_DELETE:
+			fprintf(fp, "- %d\n", op->a);
+			break;
+		case OP_SEARCH:
+			fprintf(fp, "s %d\n", op->a);
+			break;
+		case OP_FLOOR:
+			fprintf(fp, "f %d\n", op->a);
+			break;
+		case OP_CEILING:
+			fprintf(fp, "C %d\n", op->a);
+			break;
+		case OP_KTH_SMALLEST:
+			fprintf(fp, "k %d\n", op->a);
+			break;
+		case OP_KTH_LARGEST:
+			fprintf(fp, "k %d\n", w->ref.size - op->a + 1);
+			break;
+		case OP_LCA:
+			fprintf(fp, "a %d %d\n", op->a, op->b);
+			break;
+		case OP_BETWEEN:
+			fprintf(fp, "sb %d %d\n", op->a, op->b);
+			break;
+		default:
+			break;
+		}
+		Apply(w, t, op);
+	}
+	fprintf(fp, "b\np\n");
+
+	TreeFree(t);
+	fclose(fp);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Invariants
+
+/**
+ * Check the nodes an insert or delete of key can have changed: the
+ * nodes on the search path for key, going right on equal keys, and
+ * their children. Rotations only move nodes on the path, and a rotated
+ * node ends up on the path or as a child of a node on it.
+ */
+static bool CheckPath(Worker *w, Node root, int key)
+{
+	long lower = (long)INT_MIN - 1;
+	long upper = (long)INT_MAX + 1;
+
+	for (Node n = root; n != NULL; n = (key < n->key) ? n->left : n->right)
+	{
+		if (n->key <= lower || n->key >= upper)
+		{
+			snprintf(w->reason, sizeof(w->reason), "node %d is out of order", n->key);
+			return false;
+		}
+
+		if (!CheckNode(w, n) || !CheckNode(w, n->left) || !CheckNode(w, n->right))
+			return false;
+
+		if (key < n->key)
+			upper = n->key;
+		else
+			lower = n->key;
+	}
+
+	return true;
+}
+
+/**
+ * Check the stored height and the balance of a node from the stored
+ * heights of its children
+ */
+static bool CheckNode(Worker *w, Node n)
+{
+	if (n == NULL)
+		return true;
+
+	int left = Height(n->left);
+	int right = Height(n->right);
+	int height = 1 + ((left > right) ? left : right);
+
+	if (n->height != height)
+	{
+		snprintf(w->reason, sizeof(w->reason), "node %d has height %d, should be %d",
+				 n->key, n->height, height);
+		return false;
+	}
+
+	if (left - right > 1 || right - left > 1)
+	{
+		snprintf(w->reason, sizeof(w->reason),
+				 "node %d is unbalanced, left height %d, right height %d",
+				 n->key, left, right);
+		return false;
+	}
+
+	if ((n->left != NULL && n->left->key >= n->key) ||
+		(n->right != NULL && n->right->key <= n->key))
+	{
+		snprintf(w->reason, sizeof(w->reason), "children of node %d are out of order", n->key);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Check every node, and that the tree holds exactly the reference keys
+ */
+static bool CheckTree(Worker *w, Tree t)
+{
+	int index = 0;
+	if (CheckSubtree(w, t->root, (long)INT_MIN - 1, (long)INT_MAX + 1, &index) < -1)
+		return false;
+
+	if (index != w->ref.size)
+	{
+		snprintf(w->reason, sizeof(w->reason), "tree has %d keys, expected %d",
+				 index, w->ref.size);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Check a subtree in order against the reference, returns its height,
+ * or -2 if it is broken
+ */
+static int CheckSubtree(Worker *w, Node n, long lower, long upper, int *index)
+{
+	if (n == NULL)
+		return -1;
+
+	if (n->key <= lower || n->key >= upper)
+	{
+		snprintf(w->reason, sizeof(w->reason), "node %d is out of order", n->key);
+		return -2;
+	}
+
+	int left = CheckSubtree(w, n->left, lower, n->key, index);
+	if (left < -1)
+		return -2;
+
+	if (*index >= w->ref.size || w->ref.keys[*index] != n->key)
+	{
+		snprintf(w->reason, sizeof(w->reason), "tree holds %d, which was never inserted or was deleted",
+				 n->key);
+		return -2;
+	}
+	(*index)++;
+
+	int right = CheckSubtree(w, n->right, n->key, upper, index);
+	if (right < -1 || !CheckNode(w, n))
+		return -2;
+
+	return n->height;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Index of the first reference key not less than key
+ */
+static int ReferenceFind(Reference *ref, int key)
+{
+	int lo = 0, hi = ref->size;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		if (ref->keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int NodeLCA(Node n, int a, int b)
+{
+	int lower = (a < b) ? a : b;
+	int upper = (a < b) ? b : a;
+
+	while (n != NULL && (n->key < lower || n->key > upper))
+		n = (n->key < lower) ? n->right : n->left;
+
+	return (n == NULL) ? UNDEFINED : n->key;
+}
+
+#ifdef __SANITIZE_ADDRESS__
+static void OnSanitizerError(void)
+{
+	ReportCrash();
+}
+#else
+static void OnCrash(int sig)
+{
+	ReportCrash();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+#endif
+
+/**
+ * Say which case crashed, using only async-signal-safe calls
+ */
+static void ReportCrash(void)
+{
+	char buf[96] = "stressBBST: crashed in worker ";
+	size_t len = strlen(buf);
+	char digits[24];
+	int n;
+
+	unsigned long long v = (CurrentWorker < 0) ? 0 : (unsigned long long)CurrentWorker;
+	n = 0;
+	do
+		digits[n++] = (char)('0' + v % 10);
+	while ((v /= 10) != 0);
+	while (n > 0)
+		buf[len++] = digits[--n];
+
+	const char *mid = ", rerun with -c 0x";
+	for (; *mid != '\0'; mid++)
+		buf[len++] = *mid;
+
+	v = CurrentCase;
+	n = 0;
+	do
+		digits[n++] = "0123456789abcdef"[v % 16];
+	while ((v /= 16) != 0);
+	while (n > 0)
+		buf[len++] = digits[--n];
+	buf[len++] = '\n';
+
+	if (write(ErrorFd, buf, len) < 0)
+		return;
+}
+
+/**
+ * splitmix64 of the run seed, worker and case number
+ */
+static uint64_t CaseSeed(uint64_t seed, int worker, long index)
+{
+	uint64_t z = seed + 0x9E3779B97F4A7C15ULL * ((uint64_t)worker << 40 ^ (uint64_t)index);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * xorshift64*, never returns 0 for a non-zero state
+ */
+static uint64_t NextRandom(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Random number in [0, n), for n > 0
+ */
+static int RandomBelow(uint64_t *state, int n)
+{
+	return (int)(((NextRandom(state) >> 32) * (uint64_t)n) >> 32);
+}
+
+static int Height(Node n)
+{
+	return (n == NULL) ? -1 : n->height;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [-t threads] [-n ops per worker] [-s seed] [-k keyspace]\n"
+			"       [-l case length] [-o directory] [-c case seed]\n",
+			name);
+}
@@ -8,6 +8,8 @@
 #include <time.h>
 
 #include "bBST.h"
+#include "bBSTStats.h"
+#include "bench.h"
 
 typedef struct balance
 {
@@ -17,11 +19,15 @@ typedef struct balance
 } Balance;
 
 typedef char *String;
-static bool getCommand(String buf);
+static bool getCommand(String buf, FILE *in, bool prompt);
 static String *tokenize(String s, int *ntokens, String seperators);
-static void freeTokens(char **tokens);
-
-static void printCurrentLevel(Node root, int level, bool full, FILE *fp);
+static void buildDispatch(void);
+static void freeDispatch(void);
+static int compareAlias(const void *a, const void *b);
+static bool executeLine(Tree t, String line);
+static int splitLine(String s, char **argv, int maxArgs);
+static int parseInt(String s);
+static void runBatch(Tree t, String path);
 
 static void runInsert(Tree t, int argc, char **argv);
 static void runInsertRange(Tree t, int argc, char **argv);
@@ -30,20 +36,21 @@ static void runInsertNormal(Tree t, int argc, char **argv);
 
 static void runDelete(Tree t, int argc, char **argv);
 static void runPrint(Tree t, int argc, char **argv);
-static void executePrint(Tree t, FILE *fp);
+static void executePrint(Tree t, FILE *fp, int maxDepth, int maxWidth);
+static int CountLevels(Node root);
 static void runQuit(Tree t, int argc, char **argv);
 static void runSearch(Tree t, int argc, char **argv);
 static void InOrderDetailedPrint(Node n, int parent);
-static void InOrderNewPrint(Node n, int maxTab, int trueHeight, char ***InOrderString, int *counter);
 static void runClear(Tree t, int argc, char **argv);
 static void runHelp();
 static void runSave(Tree t, int argc, char **argv);
 static void runLoad(Tree t, int argc, char **argv);
 static void runCheckBalanced(Tree t, int argc, char **argv);
 static Balance TreeCheckBalanced(Node n);
+static Balance CheckPathBalanced(Node n, int key);
+static void reportUnbalanced(Tree t, Balance balance);
 static bool FileExists(String filename);
 static int max(int a, int b);
-static int height(struct node *node);
 static void runKthSmallest(Tree t, int argc, char **argv);
 static void runLCA(Tree t, int argc, char **argv);
 static void runToList(Tree t, int argc, char **argv);
@@ -51,6 +58,8 @@ static void runFloor(Tree t, int argc, char **argv);
 static void runCeiling(Tree t, int argc, char **argv);
 static void runTests(Tree t, int argc, char **argv);
 static void runSearchBetween(Tree t, int argc, char **argv);
+static void runBench(Tree t, int argc, char **argv);
+static void runStats(Tree t, int argc, char **argv);
 static void runInsertTests(Tree t, bool output);
 static void runDeleteTests(Tree t, bool output);
 static void runBalanceTests(Tree t, bool output);
@@ -62,7 +71,7 @@ static int numNodes(Tree t);
 static int NodeCount(Node n);
 static void runClearTree(Tree t, int argc, char **argv);
 static void executeTests(Tree t, int numTimes, bool output);
-static void createDotFile(Node curr, FILE *fp, int *nullCounter);
+static int CountAtMost(Node n, int limit);
 
 static int GetHeight(Node n);
 
@@ -70,6 +79,25 @@ static int GetHeight(Node n);
 #define CHAR_COL_MAX 100
 #define MAX 8192
 #define PRINT_STRING_SIZE 5
+#define MAX_ARGS (MAX / 2 + 1)
+#define BATCH_BUFFER (1 << 20)
+#define DOT_BUFFER (1 << 16)
+
+// The Makefile builds testBBST with AddressSanitizer, which the bench
+// command warns about. GCC defines the first macro, clang has the feature.
+#if defined(__SANITIZE_ADDRESS__)
+#define BUILT_WITH_SANITIZERS true
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer)
+#define BUILT_WITH_SANITIZERS true
+#endif
+#endif
+#ifndef BUILT_WITH_SANITIZERS
+#define BUILT_WITH_SANITIZERS false
+#endif
+
+// Seed of the random numbers used by the test command
+static unsigned int TestSeed;
 
 typedef struct command
 {
@@ -79,17 +107,48 @@ typedef struct command
 	String help;
 } Command;
 
-typedef struct size
+// What the DOT export draws in full, the rest is collapsed into summary
+// boxes. 0 means no limit.
+typedef struct dotOptions
 {
-	int width;
-	int height;
-} Size;
+	int maxDepth;
+	int collapseSize;
+	bool focus;
+	int focusKey;
+	bool skipNulls;
+} DotOptions;
+
+typedef struct dotWriter
+{
+	FILE *fp;
+	char *buf;
+	size_t len;
+	DotOptions *opt;
+	long nodes;
+	long summaries;
+	long nulls;
+} DotWriter;
+
+static void createDotFile(Tree t, FILE *fp, DotOptions *opt);
+static void DotNode(DotWriter *w, Node n, int below, bool onPath);
+static void DotSummary(DotWriter *w, Node parent, Node child, int size);
+static void DotFlush(DotWriter *w);
+static void DotPut(DotWriter *w, const char *s);
+static void DotPutInt(DotWriter *w, int value);
+
+// A node placed by the pretty-printer: its row is its depth and its
+// column is its position in order
+typedef struct printCell
+{
+	Node node;
+	int depth;
+} PrintCell;
 
 // Scan through file, each command has one letter associated to it, add that letter and its corresponding function and a fitting help message to the Commands array
 static Command Commands[] = {
 	{"+,add", runInsert, "-[r, R] ", "Insert a new node into the tree"},
 	{"-,d,remove", runDelete, "", "Delete a node from the tree"},
-	{"p,print", runPrint, "-[l, L, i] ",
+	{"p,print", runPrint, "-[l, L, i, d depth, w width] -g [-d depth, c size, k key, n] [file] ",
 	 "Print the tree"},
 	{"q,quit,exit", runQuit, "", "Quit the program"},
 	{"s,search", runSearch, "", "Search for a node in the tree"},
@@ -102,42 +161,58 @@ static Command Commands[] = {
 	{"f,floor", runFloor, "", "Find the floor of a node in the tree"},
 	{"t,list", runToList, "", "Convert the tree to a list"},
 	{"C,ceiling", runCeiling, "", "Find the ceiling of a node in the tree"},
-	{"test", runTests, "-[b, i, d, k, K] ", "Run tests on Balance, floor, ceiling"},
+	{"test", runTests, "-[s seed] -[b, i, d, k, K] ", "Run tests on Balance, floor, ceiling"},
 	{"delete", runClearTree, "", "Clears Tree"},
 	{"sb", runSearchBetween, "", "Search Between Upper and Lower Value"},
+	{"bench", runBench, "[workload] -[n, o, s, m, k, r, j, p] ", "Benchmark tree operations on a separate tree"},
+	{"stats", runStats, "-r ", "Show (or reset) the instrumentation counters"},
 	{NULL, NULL, NULL, NULL}};
 
+// Every alias of every command, sorted by name so a command can be
+// found with one binary search instead of re-splitting Commands[i].name
+typedef struct alias
+{
+	String name;
+	Command *command;
+} Alias;
+
+static Alias *Aliases = NULL;
+static int NumAliases = 0;
+
 /**
  * Prints the BST in Level Order
- * From: https://www.geeksforgeeks.org/level-order-tree-traversal/
+ * Nodes are taken from a queue, so each node is visited once
  */
-
 static void PrintLevelOrder(Node root, bool full, FILE *fp)
 {
-	int h = height(root);
-	int i;
-	for (i = 1; i <= h; i++)
-		printCurrentLevel(root, i, full, fp);
-	fprintf(fp, "\n");
-}
+	int n = NodeCount(root);
+	Node *queue = malloc((n > 0 ? n : 1) * sizeof(Node));
+	if (queue == NULL)
+	{
+		fprintf(stderr, "Could not malloc Queue\n");
+		exit(EXIT_FAILURE);
+	}
 
-/* Print nodes at a current level */
-static void printCurrentLevel(Node root, int level, bool full, FILE *fp)
-{
-	if (root == NULL)
-		return;
-	if (level == 1)
+	int head = 0, tail = 0;
+	if (root != NULL)
+		queue[tail++] = root;
+
+	while (head < tail)
 	{
+		Node curr = queue[head++];
 		if (!full)
-			fprintf(fp, "%d ", root->key);
+			fprintf(fp, "%d ", curr->key);
 		else
-			fprintf(fp, "{\n\tElement: %d\n\tLevel: %d\n}\n", root->key, root->height);
-	}
-	else if (level > 1)
-	{
-		printCurrentLevel(root->left, level - 1, full, fp);
-		printCurrentLevel(root->right, level - 1, full, fp);
+			fprintf(fp, "{\n\tElement: %d\n\tLevel: %d\n}\n", curr->key, curr->height);
+
+		if (curr->left != NULL)
+			queue[tail++] = curr->left;
+		if (curr->right != NULL)
+			queue[tail++] = curr->right;
 	}
+
+	free(queue);
+	fprintf(fp, "\n");
 }
 
 static void InOrderPrint(Node n, int maxTab, int trueHeight)
@@ -157,32 +232,6 @@ static void InOrderPrint(Node n, int maxTab, int trueHeight)
 	InOrderPrint(n->right, maxTab, trueHeight + 1);
 }
 
-static void InOrderNewPrint(Node n, int maxTab, int trueHeight, char ***InOrderString, int *counter)
-{
-	if (n == NULL)
-		return;
-
-	InOrderNewPrint(n->left, maxTab, trueHeight + 1, InOrderString, counter);
-
-	String key = malloc(sizeof(char) * 10);
-	sprintf(key, "%d", n->key);
-
-	char *str = InOrderString[trueHeight][*counter];
-	int totalPad = PRINT_STRING_SIZE - strlen(key);
-
-	if (totalPad > 0)
-	{
-		char *startPos = &str[totalPad / 2];
-		snprintf(startPos, strlen(key) + 1, "%s", key);
-		for (int i = 0; i < totalPad / 2; i++)
-			strncat(startPos + strlen(key), " ", totalPad - (totalPad / 2));
-	}
-
-	*counter += 1;
-	free(key);
-	InOrderNewPrint(n->right, maxTab, trueHeight + 1, InOrderString, counter);
-}
-
 static void InOrderDetailedPrint(Node n, int parent)
 {
 	if (n == NULL)
@@ -195,61 +244,101 @@ static void InOrderDetailedPrint(Node n, int parent)
 	InOrderDetailedPrint(n->right, n->key);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
 	Tree t = TreeNew();
-	String buf = malloc(sizeof(char) * MAX + 1);
-	memset(buf, '\0', MAX + 1);
+	buildDispatch();
 
-	while (getCommand(buf))
+	if (argc > 1)
 	{
-		int ntokens = 0;
-		char **tokens = tokenize(buf, &ntokens, " \t\r\n");
-		if (ntokens == 0)
+		if (argc != 3 || strcmp(argv[1], "--batch") != 0)
 		{
-			free(tokens);
-			continue;
+			fprintf(stderr, "Usage: %s [--batch FILE|-]\n", argv[0]);
+			exit(EXIT_FAILURE);
 		}
 
-		if (strcmp(tokens[0], "q") == 0)
-			break;
-		else if (strcmp(tokens[0], "?") == 0)
-			runHelp();
-		else
-		{
-			bool found = false;
-			for (int i = 0; Commands[i].name != NULL; i++)
-			{
-				int nnames = 0;
-				String *names = tokenize(Commands[i].name, &nnames, ",");
-
-				for (int j = 0; j < nnames; j++)
-				{
-					if (strcmp(tokens[0], names[j]) == 0)
-					{
-						Commands[i].func(t, ntokens, tokens);
-						found = true;
-						break;
-					}
-				}
+		runBatch(t, argv[2]);
+		runQuit(t, 0, NULL);
+	}
 
-				freeTokens(names);
-			}
-			if (!found)
-				printf("Unknown command: %s\n", tokens[0]);
-		}
+	String buf = malloc(sizeof(char) * MAX + 1);
+	memset(buf, '\0', MAX + 1);
 
-		freeTokens(tokens);
+	while (getCommand(buf, stdin, true))
+	{
+		if (!executeLine(t, buf))
+			break;
 	}
 
 	free(buf);
 	runQuit(t, 0, NULL);
 }
 
-static bool getCommand(String buf)
+/**
+ * Run every command in a file (or stdin for "-") with no prompt and
+ * fully buffered output. stdout and stderr are buffered separately, so
+ * error messages are no longer interleaved with results line by line.
+ */
+static void runBatch(Tree t, String path)
+{
+	FILE *in = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+	if (in == NULL)
+	{
+		fprintf(stderr, "Could not open %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	setvbuf(in, NULL, _IOFBF, BATCH_BUFFER);
+	setvbuf(stdout, NULL, _IOFBF, BATCH_BUFFER);
+	setvbuf(stderr, NULL, _IOFBF, BATCH_BUFFER);
+
+	char buf[MAX + 2];
+	while (getCommand(buf, in, false))
+	{
+		if (!executeLine(t, buf))
+			break;
+	}
+
+	if (in != stdin)
+		fclose(in);
+	fflush(stdout);
+	fflush(stderr);
+}
+
+/**
+ * Run a single command line, returns false if it asked to quit
+ */
+static bool executeLine(Tree t, String line)
+{
+	static char *tokens[MAX_ARGS];
+	int ntokens = splitLine(line, tokens, MAX_ARGS);
+	if (ntokens == 0)
+		return true;
+
+	if (strcmp(tokens[0], "q") == 0)
+		return false;
+
+	if (strcmp(tokens[0], "?") == 0)
+	{
+		runHelp();
+		return true;
+	}
+
+	Alias key = {tokens[0], NULL};
+	Alias *alias = bsearch(&key, Aliases, NumAliases, sizeof(Alias), compareAlias);
+	if (alias != NULL)
+		alias->command->func(t, ntokens, tokens);
+	else
+		printf("Unknown command: %s\n", tokens[0]);
+
+	return true;
+}
+
+static bool getCommand(String buf, FILE *in, bool prompt)
 {
-	printf("> ");
-	if (fgets(buf, MAX, stdin) != NULL)
+	if (prompt)
+		printf("> ");
+	if (fgets(buf, MAX, in) != NULL)
 	{
 		int len = strlen(buf);
 		if (len > 0 && buf[len - 1] != '\n')
@@ -265,6 +354,99 @@ static bool getCommand(String buf)
 	}
 }
 
+/**
+ * Split the names of every command into one sorted alias table
+ */
+static void buildDispatch(void)
+{
+	int capacity = 0;
+	for (int i = 0; Commands[i].name != NULL; i++)
+		capacity += strlen(Commands[i].name);
+
+	Aliases = malloc(capacity * sizeof(Alias));
+	assert(Aliases != NULL);
+
+	for (int i = 0; Commands[i].name != NULL; i++)
+	{
+		int nnames = 0;
+		String *names = tokenize(Commands[i].name, &nnames, ",");
+
+		for (int j = 0; j < nnames; j++)
+		{
+			Aliases[NumAliases].name = names[j];
+			Aliases[NumAliases].command = &Commands[i];
+			NumAliases++;
+		}
+
+		// The alias table now owns the strings
+		free(names);
+	}
+
+	qsort(Aliases, NumAliases, sizeof(Alias), compareAlias);
+	atexit(freeDispatch);
+}
+
+static void freeDispatch(void)
+{
+	for (int i = 0; i < NumAliases; i++)
+		free(Aliases[i].name);
+	free(Aliases);
+}
+
+static int compareAlias(const void *a, const void *b)
+{
+	return strcmp(((const Alias *)a)->name, ((const Alias *)b)->name);
+}
+
+/**
+ * Split a line into tokens in place, without allocating
+ */
+static int splitLine(String s, char **argv, int maxArgs)
+{
+	int argc = 0;
+
+	while (argc < maxArgs - 1)
+	{
+		while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+			s++;
+
+		if (*s == '\0')
+			break;
+
+		argv[argc++] = s;
+
+		while (*s != '\0' && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n')
+			s++;
+
+		if (*s == '\0')
+			break;
+
+		*s++ = '\0';
+	}
+
+	argv[argc] = NULL;
+	return argc;
+}
+
+/**
+ * Parse a decimal integer the way atoi does, without locale lookups
+ */
+static int parseInt(String s)
+{
+	while (isspace((unsigned char)*s))
+		s++;
+
+	bool negative = (*s == '-');
+	if (*s == '-' || *s == '+')
+		s++;
+
+	unsigned int value = 0;
+	while (*s >= '0' && *s <= '9')
+		value = value * 10 + (unsigned int)(*s++ - '0');
+
+	return negative ? (int)(0u - value) : (int)value;
+}
+
 static char **tokenize(String s, int *ntokens, String separators)
 {
 	*ntokens = 0;
@@ -299,15 +481,6 @@ static char **tokenize(String s, int *ntokens, String separators)
 	return tokens;
 }
 
-static void freeTokens(char **tokens)
-{
-	for (int i = 0; tokens[i] != NULL; i++)
-	{
-		free(tokens[i]);
-	}
-	free(tokens);
-}
-
 static void runInsert(Tree t, int argc, char **argv)
 {
 	if (argc > 1 && argv[1][0] == '-')
@@ -335,7 +508,7 @@ static void runInsertNormal(Tree t, int argc, char **argv)
 {
 	for (int i = 1; i < argc; i++)
 	{
-		if (!TreeInsert(t, atoi(argv[i])))
+		if (!TreeInsert(t, parseInt(argv[i])))
 			return;
 	}
 }
@@ -344,7 +517,7 @@ static void runInsertRandom(Tree t, int argc, char **argv)
 {
 	int n = 10;
 	if (argc > 2)
-		n = atoi(argv[2]);
+		n = parseInt(argv[2]);
 
 	for (int i = 0; i < n; i++)
 	{
@@ -362,8 +535,8 @@ static void runInsertRange(Tree t, int argc, char **argv)
 		return;
 	}
 
-	int start = atoi(argv[2]);
-	int end = atoi(argv[3]);
+	int start = parseInt(argv[2]);
+	int end = parseInt(argv[3]);
 
 	if (end <= start)
 	{
@@ -388,7 +561,7 @@ static void runDelete(Tree t, int argc, char **argv)
 {
 	for (int i = 1; i < argc; i++)
 	{
-		if (!TreeDelete(t, atoi(argv[i])))
+		if (!TreeDelete(t, parseInt(argv[i])))
 			return;
 	}
 }
@@ -397,7 +570,17 @@ static void runPrint(Tree t, int argc, char **argv)
 {
 	printf("Running Print:\n");
 	FILE *fp;
-	int nullCounter = 0;
+	int maxDepth = 0;
+	int maxWidth = 0;
+
+	// Depth and width limits for the pretty-printer, e.g. p -d 4 -w 120
+	while (argc > 2 && (strcmp(argv[1], "-d") == 0 || strcmp(argv[1], "-w") == 0))
+	{
+		*(argv[1][1] == 'd' ? &maxDepth : &maxWidth) = parseInt(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+
 	if (argc > 1 && argv[1][0] == '-')
 	{
 		switch (argv[1][1])
@@ -413,27 +596,53 @@ static void runPrint(Tree t, int argc, char **argv)
 			printf("Num Nodes: %d\n", numNodes(t));
 			break;
 		case 'I':
-			InOrderPrint(t->root, (t->root == NULL) ? 0 : t->root->height, 0);
+			InOrderPrint(t->root, max(CountLevels(t->root) - 1, 0), 0);
 			break;
 		case 'f':
 			fp = fopen("tree.bst", "w");
 			if (fp == NULL)
 				printf("Error opening file\n");
 			else
-				executePrint(t, fp);
+			{
+				executePrint(t, fp, 0, 0);
+				fclose(fp);
+			}
 			break;
 		case 'g':
-			fp = fopen("tree.dot", "w");
+		{
+			// p -g [-d depth] [-c size] [-k key] [-n] [file]
+			DotOptions opt = {.maxDepth = maxDepth};
+			String path = "tree.dot";
+			for (int i = 2; i < argc; i++)
+			{
+				if (strcmp(argv[i], "-n") == 0)
+					opt.skipNulls = true;
+				else if (i + 1 < argc && strcmp(argv[i], "-d") == 0)
+					opt.maxDepth = parseInt(argv[++i]);
+				else if (i + 1 < argc && strcmp(argv[i], "-c") == 0)
+					opt.collapseSize = parseInt(argv[++i]);
+				else if (i + 1 < argc && strcmp(argv[i], "-k") == 0)
+				{
+					opt.focus = true;
+					opt.focusKey = parseInt(argv[++i]);
+					// The path is still drawn down to where the key would be
+					if (!TreeSearch(t, opt.focusKey))
+						printf("Key %d is not in the tree\n", opt.focusKey);
+				}
+				else
+					path = argv[i];
+			}
+
+			fp = fopen(path, "w");
 			if (fp == NULL)
 				printf("Error opening file\n");
 			else
 			{
-				fprintf(fp, "digraph BST {\n");
-				createDotFile(t->root, fp, &nullCounter);
-				fprintf(fp, "}");
+				createDotFile(t, fp, &opt);
+				fclose(fp);
 			}
-			fclose(fp);
 			break;
+		}
 		default:
 			printf("Unknown option: %s\n", argv[1]);
 		}
@@ -441,77 +650,365 @@ static void runPrint(Tree t, int argc, char **argv)
 		return;
 	}
 
-	executePrint(t, stdout);
+	executePrint(t, stdout, maxDepth, maxWidth);
 }
 
-static void executePrint(Tree t, FILE *fp)
+/**
+ * Print the tree with one row per level and one column per key, keys in
+ * order from left to right. Rows are written one at a time from a list
+ * of the nodes that are shown, so memory is proportional to n.
+ * Only the top maxDepth levels are shown, and fewer if they would be
+ * wider than maxWidth characters; 0 means no limit.
+ */
+static void executePrint(Tree t, FILE *fp, int maxDepth, int maxWidth)
 {
-	Size size;
-	size.height = (t->root == NULL) ? 0 : t->root->height + 1;
-	size.width = 2 * (size.height * size.height) - 1;
+	int levels = CountLevels(t->root);
+	int *perLevel = calloc(levels + 1, sizeof(int));
+	int *levelStart = malloc((levels + 1) * sizeof(int));
+	Node *stack = malloc((levels + 1) * sizeof(Node));
+	int *stackDepth = malloc((levels + 1) * sizeof(int));
+	if (perLevel == NULL || levelStart == NULL || stack == NULL || stackDepth == NULL)
+	{
+		fprintf(stderr, "Could not malloc Print Levels\n");
+		exit(EXIT_FAILURE);
+	}
 
-	int counter = 0;
-	int maxHeight = (t->root == NULL) ? 0 : t->root->height;
+	// Count the nodes on each level and find the widest key, with an
+	// in-order walk whose stack is never deeper than the tree
+	char key[16];
+	int cellWidth = PRINT_STRING_SIZE;
+	int top = 0;
+	int depth = 0;
+	Node curr = t->root;
+	while (curr != NULL || top > 0)
+	{
+		for (; curr != NULL; curr = curr->left)
+		{
+			stack[top] = curr;
+			stackDepth[top++] = depth++;
+		}
+		curr = stack[--top];
+		depth = stackDepth[top];
+		perLevel[depth]++;
+
+		int length = snprintf(key, sizeof(key), "%d", curr->key);
+		if (length + 1 > cellWidth)
+			cellWidth = length + 1;
+
+		curr = curr->right;
+		depth++;
+	}
 
-	char ***InOrderString = malloc(sizeof(char **) * size.height);
-	for (int i = 0; i < size.height; i++)
+	int rows = (maxDepth > 0 && maxDepth < levels) ? maxDepth : levels;
+	int shown = 0;
+	for (int i = 0; i < rows; i++)
+		shown += perLevel[i];
+	while (maxWidth > 0 && rows > 1 && (long)shown * cellWidth > maxWidth)
+		shown -= perLevel[--rows];
+
+	// The shown nodes in order, and their positions grouped by level
+	PrintCell *cells = malloc((shown > 0 ? shown : 1) * sizeof(PrintCell));
+	int *byLevel = malloc((shown > 0 ? shown : 1) * sizeof(int));
+	if (cells == NULL || byLevel == NULL)
 	{
-		InOrderString[i] = malloc(sizeof(char *) * size.width);
-		for (int j = 0; j < size.width; j++)
+		fprintf(stderr, "Could not malloc Print Cells\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int count = 0;
+	depth = 0;
+	curr = (rows > 0) ? t->root : NULL;
+	while (curr != NULL || top > 0)
+	{
+		for (; curr != NULL; curr = (depth < rows) ? curr->left : NULL)
 		{
-			InOrderString[i][j] = malloc(sizeof(char) * 10);
-			strcpy(InOrderString[i][j], "     ");
+			stack[top] = curr;
+			stackDepth[top++] = depth++;
 		}
+		curr = stack[--top];
+		depth = stackDepth[top];
+		cells[count++] = (PrintCell){curr, depth};
+
+		depth++;
+		curr = (depth < rows) ? curr->right : NULL;
 	}
 
-	InOrderNewPrint(t->root, maxHeight, 0, InOrderString, &counter);
+	for (int i = 0, sum = 0; i < rows; i++)
+	{
+		levelStart[i] = sum;
+		sum += perLevel[i];
+	}
+	for (int i = 0; i < count; i++)
+		byLevel[levelStart[cells[i].depth]++] = i;
 
-	for (int i = 0; i < size.height; i++)
+	for (int row = 0, i = 0; row < rows; row++)
 	{
-		for (int j = 0; j < size.width; j++)
+		int column = 0;
+		for (int end = i + perLevel[row]; i < end; i++)
 		{
-			fprintf(fp, "%s", InOrderString[i][j]);
-			free(InOrderString[i][j]);
+			int index = byLevel[i];
+			int length = snprintf(key, sizeof(key), "%d", cells[index].node->key);
+			int pad = cellWidth - length;
+			fprintf(fp, "%*s%*s%s%*s", (index - column) * cellWidth, "", pad / 2, "",
+					key, pad - pad / 2, "");
+			column = index + 1;
 		}
 		fprintf(fp, "\n");
-		free(InOrderString[i]);
 	}
-	free(InOrderString);
+
+	if (rows < levels)
+	{
+		int hidden = 0;
+		for (int i = rows; i < levels; i++)
+			hidden += perLevel[i];
+		fprintf(fp, "(%d more level%s with %d node%s not shown)\n", levels - rows,
+				(levels - rows == 1) ? "" : "s", hidden, (hidden == 1) ? "" : "s");
+	}
+
+	free(cells);
+	free(byLevel);
+	free(perLevel);
+	free(levelStart);
+	free(stack);
+	free(stackDepth);
 }
 
-static void createDotFile(Node curr, FILE *fp, int *nullCounter)
+/**
+ * Count the levels of a tree by walking it rather than trusting the
+ * stored heights, which are wrong in exactly the trees reportUnbalanced
+ * prints. The stack grows as needed, so a degenerate tree is walked
+ * without recursion
+ */
+static int CountLevels(Node root)
 {
-	if (curr == NULL)
-		return;
+	int capacity = 64;
+	Node *stack = malloc(capacity * sizeof(Node));
+	int *stackDepth = malloc(capacity * sizeof(int));
+	if (stack == NULL || stackDepth == NULL)
+	{
+		fprintf(stderr, "Could not malloc Print Levels\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int levels = 0;
+	int top = 0;
+	if (root != NULL)
+	{
+		stack[top] = root;
+		stackDepth[top++] = 1;
+	}
+	while (top > 0)
+	{
+		Node n = stack[--top];
+		int depth = stackDepth[top];
+		levels = max(levels, depth);
+
+		if (top + 2 > capacity)
+		{
+			capacity *= 2;
+			stack = realloc(stack, capacity * sizeof(Node));
+			stackDepth = realloc(stackDepth, capacity * sizeof(int));
+			if (stack == NULL || stackDepth == NULL)
+			{
+				fprintf(stderr, "Could not realloc Print Levels\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		if (n->left != NULL)
+		{
+			stack[top] = n->left;
+			stackDepth[top++] = depth + 1;
+		}
+		if (n->right != NULL)
+		{
+			stack[top] = n->right;
+			stackDepth[top++] = depth + 1;
+		}
+	}
+
+	free(stack);
+	free(stackDepth);
+	return levels;
+}
 
-	createDotFile(curr->left, fp, nullCounter);
+/**
+ * Write the tree in Graphviz DOT format. Only part of the tree is drawn
+ * in full: below opt->maxDepth levels, off the path to opt->focusKey, or
+ * with at most opt->collapseSize nodes, a subtree is drawn as a single
+ * box with its key range, size and height. Output goes through a buffer
+ * and integers are formatted by hand so that even a full export of a
+ * very large tree is bound by the disk.
+ */
+static void createDotFile(Tree t, FILE *fp, DotOptions *opt)
+{
+	DotWriter w = {.fp = fp, .opt = opt};
+	w.buf = malloc(DOT_BUFFER);
+	if (w.buf == NULL)
+	{
+		fprintf(stderr, "Could not malloc Dot Buffer\n");
+		exit(EXIT_FAILURE);
+	}
 
-	if (curr->left == NULL)
+	DotPut(&w, "digraph BST {\ngraph [ordering=out];\n");
+	if (t->root != NULL)
 	{
-		(*nullCounter)++;
-		fprintf(fp, "null%d [shape=point];\n", *nullCounter);
-		fprintf(fp, "%d -> null%d;\n", curr->key, *nullCounter);
+		// The root is declared on its own so that a single node tree
+		// still shows up, path nodes are declared as they are drawn
+		if (!opt->focus)
+		{
+			DotPutInt(&w, t->root->key);
+			DotPut(&w, ";\n");
+		}
+
+		int below = (opt->maxDepth > 0) ? opt->maxDepth - 1 : INT_MAX;
+		DotNode(&w, t->root, below, opt->focus);
 	}
-	else
-		fprintf(fp, "%d -> %d;\n", curr->key, curr->left->key);
+	DotPut(&w, "}\n");
+	fwrite(w.buf, 1, w.len, fp);
+	free(w.buf);
 
-	if (curr->right == NULL)
+	printf("Wrote %ld nodes, %ld summaries and %ld null leaves\n", w.nodes, w.summaries,
+		   w.nulls);
+}
+
+/**
+ * Draw n and the edges to its children. below is the number of levels
+ * under n that are still drawn in full, and onPath is set while n is on
+ * the path from the root to the focus key.
+ */
+static void DotNode(DotWriter *w, Node n, int below, bool onPath)
+{
+	DotOptions *opt = w->opt;
+	w->nodes++;
+
+	if (onPath)
 	{
-		(*nullCounter)++;
-		fprintf(fp, "null%d [shape=point];\n", *nullCounter);
-		fprintf(fp, "%d -> null%d;\n", curr->key, *nullCounter);
+		DotPutInt(w, n->key);
+		if (n->key == opt->focusKey)
+		{
+			// The focus key gets maxDepth levels of its own
+			DotPut(w, " [style=filled, fillcolor=lightblue];\n");
+			onPath = false;
+			below = (opt->maxDepth > 0) ? opt->maxDepth - 1 : INT_MAX;
+		}
+		else
+			DotPut(w, " [color=blue];\n");
 	}
-	else
-		fprintf(fp, "%d -> %d;\n", curr->key, curr->right->key);
 
-	createDotFile(curr->right, fp, nullCounter);
+	// Side of n that the path to the focus key carries on down
+	int next = (opt->focusKey < n->key) ? 0 : 1;
+	Node children[2] = {n->left, n->right};
+
+	for (int i = 0; i < 2; i++)
+	{
+		Node child = children[i];
+		bool childOnPath = onPath && i == next;
+		if (child == NULL)
+		{
+			if (!opt->skipNulls)
+			{
+				w->nulls++;
+				DotPut(w, "null");
+				DotPutInt(w, (int)w->nulls);
+				DotPut(w, " [shape=point];\n");
+				DotPutInt(w, n->key);
+				DotPut(w, " -> null");
+				DotPutInt(w, (int)w->nulls);
+				DotPut(w, ";\n");
+			}
+			continue;
+		}
+
+		bool expand = childOnPath || (!onPath && below > 0);
+		int size = 0;
+
+		// A leaf is no bigger than its summary, so it is always drawn
+		if (!childOnPath && child->height > 0)
+		{
+			if (!expand)
+				size = NodeCount(child);
+			else if (opt->collapseSize > 0)
+			{
+				size = CountAtMost(child, opt->collapseSize);
+				expand = size > opt->collapseSize;
+			}
+		}
+
+		if (expand || child->height == 0)
+		{
+			DotPutInt(w, n->key);
+			DotPut(w, " -> ");
+			DotPutInt(w, child->key);
+			DotPut(w, ";\n");
+			DotNode(w, child, (below == INT_MAX) ? below : below - 1, childOnPath);
+		}
+		else
+			DotSummary(w, n, child, size);
+	}
+}
+
+/**
+ * Draw the subtree under parent as one box
+ */
+static void DotSummary(DotWriter *w, Node parent, Node child, int size)
+{
+	Node min = child;
+	Node max = child;
+	while (min->left != NULL)
+		min = min->left;
+	while (max->right != NULL)
+		max = max->right;
+
+	w->summaries++;
+	if (w->len + 256 > DOT_BUFFER)
+		DotFlush(w);
+	w->len += snprintf(w->buf + w->len, 256,
+					   "sub%ld [shape=box, style=dashed, label=\"%d..%d\\n%d nodes, height %d\"];\n"
+					   "%d -> sub%ld;\n",
+					   w->summaries, min->key, max->key, size, child->height + 1, parent->key,
+					   w->summaries);
+}
+
+static void DotFlush(DotWriter *w)
+{
+	fwrite(w->buf, 1, w->len, w->fp);
+	w->len = 0;
+}
+
+static void DotPut(DotWriter *w, const char *s)
+{
+	size_t length = strlen(s);
+	if (w->len + length > DOT_BUFFER)
+		DotFlush(w);
+	memcpy(w->buf + w->len, s, length);
+	w->len += length;
+}
+
+static void DotPutInt(DotWriter *w, int value)
+{
+	if (w->len + 12 > DOT_BUFFER)
+		DotFlush(w);
+
+	char digits[12];
+	int count = 0;
+	unsigned int v = (value < 0) ? -(unsigned int)value : (unsigned int)value;
+	do
+	{
+		digits[count++] = '0' + v % 10;
+		v /= 10;
+	} while (v > 0);
+
+	if (value < 0)
+		w->buf[w->len++] = '-';
+	while (count > 0)
+		w->buf[w->len++] = digits[--count];
 }
 
 static void runSearch(Tree t, int argc, char **argv)
 {
 	for (int i = 1; i < argc; i++)
 	{
-		int num = atoi(argv[i]);
+		int num = parseInt(argv[i]);
 		bool search = TreeSearch(t, num);
 		printf("Element %d was %s.\n", num, (search) ? "found" : "not found");
 	}
@@ -584,6 +1081,40 @@ static Balance TreeCheckBalanced(Node n)
 		max(left.height, right.height) + 1, true};
 }
 
+/**
+ * Check the nodes an insert or delete of key can change: the search path
+ * for key, going right on equal keys, and the children of the nodes on
+ * it, using their stored heights
+ */
+static Balance CheckPathBalanced(Node n, int key)
+{
+	for (; n != NULL; n = (key < n->key) ? n->left : n->right)
+	{
+		Node check[3] = {n, n->left, n->right};
+		for (int i = 0; i < 3; i++)
+		{
+			Node c = check[i];
+			if (c == NULL)
+				continue;
+
+			int left = GetHeight(c->left);
+			int right = GetHeight(c->right);
+			if (abs(left - right) > 1 || c->height != 1 + max(left, right))
+				return (Balance){c->height, false, c};
+		}
+	}
+
+	return (Balance){0, true, NULL};
+}
+
+static void reportUnbalanced(Tree t, Balance balance)
+{
+	runSave(t, 0, NULL);
+	runPrint(t, 0, NULL);
+	printf("Unbalanced node: %d\n", balance.unbalancedNode->key);
+	printf("Left Height: %d\nRight Height: %d\n", GetHeight(balance.unbalancedNode->left), GetHeight(balance.unbalancedNode->right));
+}
+
 static void runKthSmallest(Tree t, int argc, char **argv)
 {
 	if (argc < 2)
@@ -592,7 +1123,7 @@ static void runKthSmallest(Tree t, int argc, char **argv)
 		return;
 	}
 
-	int k = atoi(argv[1]);
+	int k = parseInt(argv[1]);
 	int kth = TreeKthSmallest(t, k);
 	printf("The %dth smallest element is ", k);
 	if (kth == UNDEFINED)
@@ -609,8 +1140,8 @@ static void runLCA(Tree t, int argc, char **argv)
 		return;
 	}
 
-	int a = atoi(argv[1]);
-	int b = atoi(argv[2]);
+	int a = parseInt(argv[1]);
+	int b = parseInt(argv[2]);
 	int lca = TreeLCA(t, a, b);
 	printf("The LCA of %d and %d is ", a, b);
 	if (lca == UNDEFINED)
@@ -629,7 +1160,7 @@ static void runFloor(Tree t, int argc, char **argv)
 
 	for (int i = 1; i < argc; i++)
 	{
-		int x = atoi(argv[i]);
+		int x = parseInt(argv[i]);
 		int floor = TreeFloor(t, x);
 		printf("The floor of %d is ", x);
 		if (floor == UNDEFINED)
@@ -649,7 +1180,7 @@ static void runCeiling(Tree t, int argc, char **argv)
 
 	for (int i = 1; i < argc; i++)
 	{
-		int x = atoi(argv[i]);
+		int x = parseInt(argv[i]);
 		int ceiling = TreeCeiling(t, x);
 		printf("The ceiling of %d is ", x);
 		if (ceiling == UNDEFINED)
@@ -670,6 +1201,18 @@ static void runToList(Tree t, int argc, char **argv)
 static void runTests(Tree t, int argc, char **argv)
 {
 	int numTimes = 1;
+
+	// The tests are repeatable with test -s <seed> and the same options
+	TestSeed = (unsigned int)time(NULL);
+	if (argc > 2 && strcmp(argv[1], "-s") == 0)
+	{
+		TestSeed = (unsigned int)parseInt(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	printf("Test seed: %u\n", TestSeed);
+	srand(TestSeed);
+
 	if (argc > 1 && argv[1][0] == '-')
 	{
 		switch (argv[1][1])
@@ -691,7 +1234,7 @@ static void runTests(Tree t, int argc, char **argv)
 			break;
 		case 'q':
 			if (argc > 2)
-				numTimes = atoi(argv[2]);
+				numTimes = parseInt(argv[2]);
 
 			executeTests(t, numTimes, false);
 			break;
@@ -704,7 +1247,7 @@ static void runTests(Tree t, int argc, char **argv)
 	}
 
 	if (argc > 1)
-		numTimes = atoi(argv[1]);
+		numTimes = parseInt(argv[1]);
 
 	executeTests(t, numTimes, true);
 }
@@ -726,7 +1269,6 @@ static void runBalanceTests(Tree t, bool output)
 	runClearTree(t, 0, NULL);
 	for (int X = 1; X <= 2500; X++)
 	{
-		srand(time(NULL));
 		int bstSize = rand() % 100 + 1;
 		int numbers[bstSize];
 		int *removed = calloc(bstSize, sizeof(int));
@@ -740,18 +1282,25 @@ static void runBalanceTests(Tree t, bool output)
 
 			TreeInsert(t, num);
 			numbers[i] = num;
-			Balance balance = TreeCheckBalanced(t->root);
+			Balance balance = CheckPathBalanced(t->root, num);
 			if (!balance.balanced)
 			{
-				runSave(t, 0, NULL);
-				runPrint(t, 0, NULL);
-				printf("Unbalanced node: %d\n", balance.unbalancedNode->key);
-				printf("Left Height: %d\nRight Height: %d\n", GetHeight(balance.unbalancedNode->left), GetHeight(balance.unbalancedNode->right));
+				reportUnbalanced(t, balance);
 				free(removed);
 				return;
 			}
 		}
 
+		// Only the nodes an update touches are checked after it, so check
+		// the whole tree once per run
+		Balance balance = TreeCheckBalanced(t->root);
+		if (!balance.balanced)
+		{
+			reportUnbalanced(t, balance);
+			free(removed);
+			return;
+		}
+
 		for (int i = 0; i < bstSize; i++)
 		{
 			int index = rand() % bstSize;
@@ -762,13 +1311,16 @@ static void runBalanceTests(Tree t, bool output)
 			removed[index] = 1;
 
 			TreeDelete(t, numbers[index]);
-			Balance balance = TreeCheckBalanced(t->root);
+
+			// A node with two children is replaced by its successor, which
+			// is removed from further down
+			Balance balance = CheckPathBalanced(t->root, numbers[index]);
+			int successor = TreeCeiling(t, numbers[index]);
+			if (balance.balanced && successor != UNDEFINED)
+				balance = CheckPathBalanced(t->root, successor);
 			if (!balance.balanced)
 			{
-				runSave(t, 0, NULL);
-				runPrint(t, 0, NULL);
-				printf("Unbalanced node: %d\n", balance.unbalancedNode->key);
-				printf("Left Height: %d\nRight Height: %d\n", GetHeight(balance.unbalancedNode->left), GetHeight(balance.unbalancedNode->right));
+				reportUnbalanced(t, balance);
 				free(removed);
 				return;
 			}
@@ -785,7 +1337,6 @@ static void runInsertTests(Tree t, bool output)
 	runClearTree(t, 0, NULL);
 	for (int X = 1; X <= 2500; X++)
 	{
-		srand(time(NULL));
 		int bstSize = rand() % 100 + 1;
 
 		for (int i = 0; i < bstSize; i++)
@@ -816,7 +1367,6 @@ static void runDeleteTests(Tree t, bool output)
 	runClearTree(t, 0, NULL);
 	for (int X = 1; X <= 2500; X++)
 	{
-		srand(time(NULL));
 		int bstSize = rand() % 100 + 1;
 		int numbers[bstSize];
 		int *removed = calloc(bstSize, sizeof(int));
@@ -863,7 +1413,6 @@ static void runKthSmallestTests(Tree t, bool output)
 	runClearTree(t, 0, NULL);
 	for (int X = 1; X <= 2500; X++)
 	{
-		srand(time(NULL));
 		int bstSize = rand() % 250 + 1;
 		int numbers[bstSize];
 
@@ -904,7 +1453,6 @@ static void runKthLargestTests(Tree t, bool output)
 	runClearTree(t, 0, NULL);
 	for (int X = 1; X <= 2500; X++)
 	{
-		srand(time(NULL));
 		int bstSize = rand() % 250 + 1;
 		int numbers[bstSize];
 
@@ -966,6 +1514,20 @@ static int NodeCount(Node t)
 	return 1 + NodeCount(t->left) + NodeCount(t->right);
 }
 
+/**
+ * Number of nodes in t, but stops counting once it is past limit
+ */
+static int CountAtMost(Node t, int limit)
+{
+	if (t == NULL || limit < 0)
+		return 0;
+
+	int left = CountAtMost(t->left, limit - 1);
+	if (left >= limit)
+		return left + 1;
+	return 1 + left + CountAtMost(t->right, limit - 1 - left);
+}
+
 static void runClearTree(Tree t, int argc, char **argv)
 {
 	while (t->root != NULL)
@@ -980,8 +1542,8 @@ static void runSearchBetween(Tree t, int argc, char **argv)
 		return;
 	}
 
-	int min = atoi(argv[1]);
-	int max = atoi(argv[2]);
+	int min = parseInt(argv[1]);
+	int max = parseInt(argv[2]);
 	List l = TreeSearchBetween(t, min, max);
 	printf("Search Between %d and %d: ", min, max);
 	ListShow(l);
@@ -989,6 +1551,50 @@ static void runSearchBetween(Tree t, int argc, char **argv)
 	printf("\n");
 }
 
+/**
+ * The benchmark builds and times its own trees from the workload in
+ * argv, so the tree being edited is left as it was
+ */
+static void runBench(Tree t, int argc, char **argv)
+{
+	(void)t;
+	if (BUILT_WITH_SANITIZERS)
+		printf("testBBST is built with sanitizers, which inflate every timing below.\n"
+			   "Use benchBBST, built with -O2 and the same options, for real numbers.\n");
+	BenchMain(argc, argv);
+	fflush(stdout);
+}
+
+static void runStats(Tree t, int argc, char **argv)
+{
+	if (!TreeStatsEnabled())
+	{
+		printf("Counters are not compiled in, use testBBSTStats\n");
+		return;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "-r") == 0)
+	{
+		TreeStatsReset();
+		printf("Counters reset.\n");
+		return;
+	}
+
+	TreeStats stats;
+	TreeStatsGet(&stats);
+
+	unsigned long updates = stats.inserts - stats.duplicates + stats.deletes - stats.misses;
+	printf("Nodes visited: %lu\n", stats.visits);
+	printf("Inserts: %lu (%lu duplicates rejected)\n", stats.inserts, stats.duplicates);
+	printf("Deletes: %lu (%lu misses rejected)\n", stats.deletes, stats.misses);
+	printf("Rotations: LL %lu, LR %lu, RR %lu, RL %lu\n",
+		   stats.rotations[ROTATE_LEFT_LEFT], stats.rotations[ROTATE_LEFT_RIGHT],
+		   stats.rotations[ROTATE_RIGHT_RIGHT], stats.rotations[ROTATE_RIGHT_LEFT]);
+	printf("Retrace: %lu steps, %.2f per update, deepest %lu\n", stats.retraceSteps,
+		   (updates == 0) ? 0.0 : (double)stats.retraceSteps / updates, stats.maxRetrace);
+	printf("Node allocs: %lu, frees: %lu\n", stats.allocs, stats.frees);
+}
+
 static void runQuit(Tree t, int argc, char **argv)
 {
 	TreeFree(t);
@@ -1008,25 +1614,6 @@ static int max(int a, int b)
 	return (a > b) ? a : b;
 }
 
-/* For Level Order Print from GeeksforGeeks */
-static int height(struct node *node)
-{
-	if (node == NULL)
-		return 0;
-	else
-	{
-		/* compute the height of each subtree */
-		int lheight = height(node->left);
-		int rheight = height(node->right);
-
-		/* use the larger one */
-		if (lheight > rheight)
-			return (lheight + 1);
-		else
-			return (rheight + 1);
-	}
-}
-
 static int GetHeight(Node n)
 {
 	if (n == NULL)
@@ -0,0 +1,577 @@
+// Implementation of binary operation traces.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+// Longest encoding of a record: opcode, two arguments and a result, each
+// a 5 byte varint
+#define MAX_RECORD 16
+
+// LZ77 parameters: the shortest match, the number of bytes at the end of
+// a block that are always literals so a match never reads past the end,
+// and the size of the match finder's hash table
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define HASH_BITS 12
+#define MAX_OFFSET 65535
+
+struct traceWriter
+{
+	FILE *fp;
+	TraceCodec codec;
+	uint8_t block[TRACE_BLOCK_SIZE];
+	size_t used;
+	int prevKey;
+	// Compressed copy of block
+	uint8_t packed[TRACE_BLOCK_SIZE];
+	int32_t hash[1 << HASH_BITS];
+};
+
+static const char *OpNames[TRACE_NUM_OPS] = {
+	NULL, "insert", "delete", "search", "floor", "ceiling", "kth",
+	"between", "lca", "phase"};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static void WriteRecord(TraceWriter w, TraceOp op, int a, int b, bool expected, int result);
+static void FlushBlock(TraceWriter w);
+static size_t PutVarint(uint8_t *out, int value);
+static bool GetVarint(TraceReader *r, int *value);
+static bool NextBlock(TraceReader *r);
+static size_t Compress(TraceWriter w, const uint8_t *in, size_t size, uint8_t *out, size_t capacity);
+static size_t PutLength(uint8_t *out, size_t length);
+static size_t Decompress(const uint8_t *in, size_t size, uint8_t *out, size_t capacity);
+static bool IsKeyOp(TraceOp op);
+static int ResultBase(TraceOp op, int a);
+static void PutU32(uint8_t *out, uint32_t value);
+static uint32_t GetU32(const uint8_t *in);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the number of arguments an operation takes.
+ */
+int TraceOpArgs(TraceOp op)
+{
+	switch (op)
+	{
+	case TRACE_BETWEEN:
+	case TRACE_LCA:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+/**
+ * Returns the name of an operation.
+ */
+const char *TraceOpName(TraceOp op)
+{
+	return (op > 0 && op < TRACE_NUM_OPS) ? OpNames[op] : "unknown";
+}
+
+////////////////////////////////////////////////////////////////////////
+// Writing
+
+/**
+ * Creates a writer and writes the trace header.
+ */
+TraceWriter TraceWriterNew(FILE *fp, TraceCodec codec)
+{
+	TraceWriter w = malloc(sizeof(*w));
+
+	if (w == NULL)
+	{
+		fprintf(stderr, "Could not malloc TraceWriter\n");
+		exit(EXIT_FAILURE);
+	}
+
+	w->fp = fp;
+	w->codec = codec;
+	w->used = 0;
+	w->prevKey = 0;
+	fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, fp);
+
+	return w;
+}
+
+/**
+ * Appends a record.
+ */
+void TraceWrite(TraceWriter w, TraceOp op, int a, int b)
+{
+	WriteRecord(w, op, a, b, false, 0);
+}
+
+/**
+ * Appends a record and its expected result.
+ */
+void TraceWriteExpected(TraceWriter w, TraceOp op, int a, int b, int result)
+{
+	WriteRecord(w, op, a, b, true, result);
+}
+
+static void WriteRecord(TraceWriter w, TraceOp op, int a, int b, bool expected, int result)
+{
+	if (w->used + MAX_RECORD > TRACE_BLOCK_SIZE)
+		FlushBlock(w);
+
+	uint8_t *out = &w->block[w->used];
+	size_t n = 0;
+	out[n++] = (uint8_t)op | (expected ? TRACE_EXPECTED : 0);
+
+	if (!IsKeyOp(op))
+		n += PutVarint(&out[n], a);
+	else
+	{
+		// Keys are stored relative to the key before them
+		n += PutVarint(&out[n], (int)((unsigned int)a - (unsigned int)w->prevKey));
+		w->prevKey = a;
+
+		if (TraceOpArgs(op) == 2)
+		{
+			n += PutVarint(&out[n], (int)((unsigned int)b - (unsigned int)a));
+			w->prevKey = b;
+		}
+	}
+
+	if (expected)
+		n += PutVarint(&out[n], (int)((unsigned int)result - (unsigned int)ResultBase(op, a)));
+
+	w->used += n;
+}
+
+/**
+ * Writes the remaining records and the end block, then frees the writer.
+ */
+void TraceWriterFree(TraceWriter w)
+{
+	if (w == NULL)
+		return;
+
+	FlushBlock(w);
+
+	uint8_t end[TRACE_BLOCK_HEADER] = {0};
+	fwrite(end, 1, sizeof(end), w->fp);
+	free(w);
+}
+
+/**
+ * Write the buffered records as one block
+ */
+static void FlushBlock(TraceWriter w)
+{
+	if (w->used == 0)
+		return;
+
+	// Keep the block raw unless compressing saves space
+	size_t stored = 0;
+	if (w->codec == TRACE_LZ)
+		stored = Compress(w, w->block, w->used, w->packed, w->used - 1);
+
+	uint8_t header[TRACE_BLOCK_HEADER];
+	PutU32(&header[0], (uint32_t)w->used);
+	PutU32(&header[4], (uint32_t)(stored > 0 ? stored : w->used));
+	header[8] = (stored > 0) ? TRACE_LZ : TRACE_RAW;
+
+	fwrite(header, 1, sizeof(header), w->fp);
+	if (stored > 0)
+		fwrite(w->packed, 1, stored, w->fp);
+	else
+		fwrite(w->block, 1, w->used, w->fp);
+
+	w->used = 0;
+	w->prevKey = 0;
+}
+
+/**
+ * Zigzag encode a value as a little endian base 128 varint
+ */
+static size_t PutVarint(uint8_t *out, int value)
+{
+	uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	size_t n = 0;
+
+	while (v >= 0x80)
+	{
+		out[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	out[n++] = (uint8_t)v;
+
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Reading
+
+/**
+ * Starts reading a trace held in memory.
+ */
+bool TraceReaderInit(TraceReader *r, const uint8_t *data, size_t size)
+{
+	memset(r, 0, sizeof(*r));
+	r->data = data;
+	r->size = size;
+
+	if (size < TRACE_MAGIC_SIZE || memcmp(data, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0)
+	{
+		r->error = "not a trace";
+		return false;
+	}
+
+	r->next = TRACE_MAGIC_SIZE;
+	return true;
+}
+
+/**
+ * Decodes the next record.
+ */
+bool TraceNext(TraceReader *r, TraceRecord *rec)
+{
+	if (r->pos == r->blockSize && !NextBlock(r))
+		return false;
+
+	uint8_t byte = r->block[r->pos++];
+	TraceOp op = byte & ~TRACE_EXPECTED;
+	if (op < TRACE_INSERT || op >= TRACE_NUM_OPS)
+	{
+		r->error = "unknown opcode";
+		return false;
+	}
+
+	rec->op = op;
+	rec->args[1] = 0;
+	rec->expected = (byte & TRACE_EXPECTED) != 0;
+	rec->result = 0;
+
+	int delta;
+	if (!GetVarint(r, &delta))
+		return false;
+
+	if (!IsKeyOp(op))
+		rec->args[0] = delta;
+	else
+	{
+		rec->args[0] = (int)((unsigned int)r->prevKey + (unsigned int)delta);
+		r->prevKey = rec->args[0];
+
+		if (TraceOpArgs(op) == 2)
+		{
+			if (!GetVarint(r, &delta))
+				return false;
+			rec->args[1] = (int)((unsigned int)rec->args[0] + (unsigned int)delta);
+			r->prevKey = rec->args[1];
+		}
+	}
+
+	if (rec->expected)
+	{
+		if (!GetVarint(r, &delta))
+			return false;
+		rec->result = (int)((unsigned int)ResultBase(op, rec->args[0]) + (unsigned int)delta);
+	}
+
+	return true;
+}
+
+/**
+ * Frees the decompression buffer.
+ */
+void TraceReaderFree(TraceReader *r)
+{
+	free(r->buffer);
+	r->buffer = NULL;
+}
+
+/**
+ * Move on to the next block, returns false at the end of the trace
+ */
+static bool NextBlock(TraceReader *r)
+{
+	if (r->ended)
+		return false;
+
+	if (r->size - r->next < TRACE_BLOCK_HEADER)
+	{
+		r->error = "truncated block header";
+		return false;
+	}
+
+	const uint8_t *header = &r->data[r->next];
+	uint32_t raw = GetU32(&header[0]);
+	uint32_t stored = GetU32(&header[4]);
+	r->next += TRACE_BLOCK_HEADER;
+
+	if (raw == 0)
+	{
+		r->ended = true;
+		return false;
+	}
+
+	if (raw > TRACE_BLOCK_SIZE || stored > r->size - r->next)
+	{
+		r->error = "truncated block";
+		return false;
+	}
+
+	const uint8_t *records = &r->data[r->next];
+	switch (header[8])
+	{
+	case TRACE_RAW:
+		if (stored != raw)
+		{
+			r->error = "raw block length mismatch";
+			return false;
+		}
+		r->block = records;
+		break;
+	case TRACE_LZ:
+		if (r->buffer == NULL && (r->buffer = malloc(TRACE_BLOCK_SIZE)) == NULL)
+		{
+			fprintf(stderr, "Could not malloc Trace Buffer\n");
+			exit(EXIT_FAILURE);
+		}
+		if (Decompress(records, stored, r->buffer, raw) != raw)
+		{
+			r->error = "corrupt compressed block";
+			return false;
+		}
+		r->block = r->buffer;
+		break;
+	default:
+		r->error = "unknown block codec";
+		return false;
+	}
+
+	r->blockSize = raw;
+	r->pos = 0;
+	r->prevKey = 0;
+	r->next += stored;
+
+	return true;
+}
+
+/**
+ * Decode a zigzag varint from the current block
+ */
+static bool GetVarint(TraceReader *r, int *value)
+{
+	uint32_t v = 0;
+
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (r->pos == r->blockSize)
+			break;
+
+		uint8_t byte = r->block[r->pos++];
+		v |= (uint32_t)(byte & 0x7f) << shift;
+
+		if (byte < 0x80)
+		{
+			*value = (int)((v >> 1) ^ (0u - (v & 1)));
+			return true;
+		}
+	}
+
+	r->error = "truncated record";
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////
+// LZ77 block codec
+
+/**
+ * Compress size bytes of in, returns the compressed size, or 0 if it
+ * would be more than capacity
+ */
+static size_t Compress(TraceWriter w, const uint8_t *in, size_t size, uint8_t *out, size_t capacity)
+{
+	size_t ip = 0, anchor = 0, op = 0;
+
+	memset(w->hash, -1, sizeof(w->hash));
+
+	while (size >= LAST_LITERALS + MIN_MATCH && ip <= size - LAST_LITERALS - MIN_MATCH)
+	{
+		uint32_t sequence;
+		memcpy(&sequence, &in[ip], sizeof(sequence));
+		uint32_t h = (sequence * 2654435761u) >> (32 - HASH_BITS);
+		int32_t ref = w->hash[h];
+		w->hash[h] = (int32_t)ip;
+
+		if (ref < 0 || ip - ref > MAX_OFFSET || memcmp(&in[ref], &in[ip], MIN_MATCH) != 0)
+		{
+			ip++;
+			continue;
+		}
+
+		size_t length = MIN_MATCH;
+		while (ip + length < size - LAST_LITERALS && in[ref + length] == in[ip + length])
+			length++;
+
+		// Token, literal length, literals, offset and match length
+		size_t literals = ip - anchor;
+		if (op + 1 + literals / 255 + 1 + literals + 2 + (length - MIN_MATCH) / 255 + 1 > capacity)
+			return 0;
+
+		uint8_t *token = &out[op++];
+		*token = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+		if (literals >= 15)
+			op += PutLength(&out[op], literals - 15);
+		memcpy(&out[op], &in[anchor], literals);
+		op += literals;
+
+		out[op++] = (uint8_t)(ip - ref);
+		out[op++] = (uint8_t)((ip - ref) >> 8);
+
+		size_t extra = length - MIN_MATCH;
+		*token |= (uint8_t)((extra < 15) ? extra : 15);
+		if (extra >= 15)
+			op += PutLength(&out[op], extra - 15);
+
+		ip += length;
+		anchor = ip;
+	}
+
+	// The last sequence is literals only
+	size_t literals = size - anchor;
+	if (op + 1 + literals / 255 + 1 + literals > capacity)
+		return 0;
+
+	out[op++] = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+	if (literals >= 15)
+		op += PutLength(&out[op], literals - 15);
+	memcpy(&out[op], &in[anchor], literals);
+
+	return op + literals;
+}
+
+/**
+ * Write the part of a length that did not fit in its token nibble
+ */
+static size_t PutLength(uint8_t *out, size_t length)
+{
+	size_t n = 0;
+
+	for (; length >= 255; length -= 255)
+		out[n++] = 255;
+	out[n++] = (uint8_t)length;
+
+	return n;
+}
+
+/**
+ * Decompress a block into out, returns the decompressed size, or
+ * (size_t)-1 if the block is corrupt or decompresses to more than
+ * capacity
+ */
+static size_t Decompress(const uint8_t *in, size_t size, uint8_t *out, size_t capacity)
+{
+	size_t ip = 0, op = 0;
+
+	while (ip < size)
+	{
+		uint8_t token = in[ip++];
+
+		size_t literals = token >> 4;
+		if (literals == 15)
+		{
+			uint8_t byte;
+			do
+			{
+				if (ip == size)
+					return (size_t)-1;
+				byte = in[ip++];
+				literals += byte;
+			} while (byte == 255);
+		}
+
+		if (literals > size - ip || literals > capacity - op)
+			return (size_t)-1;
+		memcpy(&out[op], &in[ip], literals);
+		ip += literals;
+		op += literals;
+
+		if (ip == size)
+			break;
+
+		if (size - ip < 2)
+			return (size_t)-1;
+		size_t offset = in[ip] | (size_t)in[ip + 1] << 8;
+		ip += 2;
+
+		size_t length = (token & 15) + MIN_MATCH;
+		if ((token & 15) == 15)
+		{
+			uint8_t byte;
+			do
+			{
+				if (ip == size)
+					return (size_t)-1;
+				byte = in[ip++];
+				length += byte;
+			} while (byte == 255);
+		}
+
+		if (offset == 0 || offset > op || length > capacity - op)
+			return (size_t)-1;
+
+		// Byte by byte, the match may overlap the bytes being written
+		const uint8_t *from = &out[op - offset];
+		for (size_t i = 0; i < length; i++)
+			out[op + i] = from[i];
+		op += length;
+	}
+
+	return op;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+/**
+ * Returns true if the arguments of an operation are keys
+ */
+static bool IsKeyOp(TraceOp op)
+{
+	return op != TRACE_KTH && op != TRACE_PHASE;
+}
+
+/**
+ * Expected results of operations that return a key near their first
+ * argument are stored relative to it
+ */
+static int ResultBase(TraceOp op, int a)
+{
+	switch (op)
+	{
+	case TRACE_FLOOR:
+	case TRACE_CEILING:
+	case TRACE_LCA:
+		return a;
+	default:
+		return 0;
+	}
+}
+
+static void PutU32(uint8_t *out, uint32_t value)
+{
+	out[0] = (uint8_t)value;
+	out[1] = (uint8_t)(value >> 8);
+	out[2] = (uint8_t)(value >> 16);
+	out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t GetU32(const uint8_t *in)
+{
+	return in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
@@ -0,0 +1,147 @@
+// Binary operation traces for Balanced Binary Search Trees.
+//
+// A trace is the 8 byte magic TRACE_MAGIC followed by blocks. Each block
+// has a 9 byte header: the length of the records once decoded and the
+// length stored in the file (both 32-bit little endian), and the codec
+// the records are stored with. A block with a decoded length of 0 ends
+// the trace. Records never straddle blocks, so each block can be
+// decoded on its own.
+//
+// A record is an opcode byte followed by its arguments as zigzag
+// varints. Key arguments are stored as the difference from the previous
+// key in the block, so sequential and clustered keys take one byte.
+// If the opcode has TRACE_EXPECTED set, the result the operation is
+// expected to return follows as one more varint:
+//   insert, delete, search  1 if the call returned true, else 0
+//   floor, ceiling, lca     the key returned (UNDEFINED if none), stored
+//                           as the difference from the first argument
+//   kth                     the key returned, or UNDEFINED
+//   between                 the number of keys in the range
+//
+// Blocks are stored either as is (TRACE_RAW) or compressed with a byte
+// oriented LZ77 (TRACE_LZ) in the LZ4 block layout: each sequence is a
+// token byte holding the literal length and match length - 4 in its high
+// and low nibble (15 meaning more length bytes of up to 255 follow), the
+// literals, and a 16-bit little endian match offset. The last sequence
+// has literals only.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "BBSTTRC1"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_BLOCK_HEADER 9
+// Decoded records per block are at most this many bytes
+#define TRACE_BLOCK_SIZE (1 << 16)
+
+typedef enum traceOp
+{
+	TRACE_INSERT = 1,
+	TRACE_DELETE,
+	TRACE_SEARCH,
+	TRACE_FLOOR,
+	TRACE_CEILING,
+	// Argument is k, not a key
+	TRACE_KTH,
+	// Arguments are lower and upper
+	TRACE_BETWEEN,
+	TRACE_LCA,
+	// Argument is a phase number; starts a new phase of the workload
+	TRACE_PHASE,
+	TRACE_NUM_OPS,
+} TraceOp;
+
+// Set on an opcode byte if an expected result follows the arguments
+#define TRACE_EXPECTED 0x80
+
+typedef enum traceCodec
+{
+	TRACE_RAW,
+	TRACE_LZ,
+} TraceCodec;
+
+typedef struct traceRecord
+{
+	TraceOp op;
+	int args[2];
+	// Whether the trace records what the operation should return
+	bool expected;
+	int result;
+} TraceRecord;
+
+typedef struct traceWriter *TraceWriter;
+
+typedef struct traceReader
+{
+	const uint8_t *data;
+	size_t size;
+	// Offset of the next block header
+	size_t next;
+	// Records of the current block, which points into data for raw
+	// blocks and into buffer for compressed ones
+	const uint8_t *block;
+	uint8_t *buffer;
+	size_t blockSize;
+	size_t pos;
+	int prevKey;
+	bool ended;
+	const char *error;
+} TraceReader;
+
+/**
+ * Returns the number of arguments an operation takes.
+ */
+int TraceOpArgs(TraceOp op);
+
+/**
+ * Returns the name of an operation, e.g. "insert".
+ */
+const char *TraceOpName(TraceOp op);
+
+/**
+ * Creates a writer that writes the trace header and then buffers
+ * records into blocks written to fp. With TRACE_LZ, blocks that do not
+ * get smaller when compressed are stored raw.
+ */
+TraceWriter TraceWriterNew(FILE *fp, TraceCodec codec);
+
+/**
+ * Appends a record. Arguments the operation does not take are ignored.
+ */
+void TraceWrite(TraceWriter w, TraceOp op, int a, int b);
+
+/**
+ * Appends a record along with the result the operation is expected to
+ * return, see the encoding above.
+ */
+void TraceWriteExpected(TraceWriter w, TraceOp op, int a, int b, int result);
+
+/**
+ * Writes any buffered records and the end of trace block, then frees
+ * the writer. Does not close the file.
+ */
+void TraceWriterFree(TraceWriter w);
+
+/**
+ * Starts reading a trace held in memory.
+ * Returns false and sets r->error if the header is not a trace header.
+ */
+bool TraceReaderInit(TraceReader *r, const uint8_t *data, size_t size);
+
+/**
+ * Decodes the next record. Returns false at the end of the trace, or if
+ * the trace is malformed, in which case r->error is set.
+ */
+bool TraceNext(TraceReader *r, TraceRecord *rec);
+
+/**
+ * Frees the memory the reader allocated. Does not free the trace.
+ */
+void TraceReaderFree(TraceReader *r);
+
+#endif
@@ -0,0 +1,476 @@
+// Checker for Balanced Binary Search Trees of 64-bit keys.
+// Runs random inserts and deletes through a Tree64 and a sorted array of
+// the same keys, and compares the return of every update, and after
+// every batch the size, the keys, search, floor and ceiling of probes,
+// k-th keys and SearchBetween. Keys come from the whole int64 range,
+// with INT64_MIN, INT64_MAX and the values at the ends of int stored as
+// ordinary keys.
+//
+// Every query that finds nothing must return false and leave its result
+// alone, which is checked by passing it a result set to a marker value.
+// LCA depends on the shape of the tree, so its answers are checked for
+// what any LCA must be: a key of the tree between a and b that is the
+// LCA of itself with either of them.
+//
+// Usage: ./tree64Check [-o operations] [-s seed]
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bBST64.h"
+
+#define DEFAULT_OPS 100000
+// Operations between two full comparisons
+#define BATCH 2000
+#define MAX_KEYS 32768
+// Keys spread over the whole range, on top of those near 0 and the edges
+#define SPREAD_KEYS 4096
+// Written to results before every query, to see whether it was touched
+#define MARKER INT64_C(0x5EC0DE5EC0DE5EC0)
+
+// Keys that come up now and then in every run
+static const int64_t Edges[] = {
+	INT64_MIN, INT64_MIN + 1, INT64_MAX - 1, INT64_MAX, -1, 0, 1,
+	(int64_t)INT_MIN - 1, INT_MIN, INT_MAX, (int64_t)INT_MAX + 1,
+};
+#define NUM_EDGES (int)(sizeof(Edges) / sizeof(Edges[0]))
+
+// The sorted array the tree is compared with
+typedef struct reference
+{
+	int64_t keys[MAX_KEYS];
+	size_t size;
+} Reference;
+
+// Where a SearchBetween visitor writes the keys it is given
+typedef struct visit
+{
+	int64_t *keys;
+	size_t count;
+	size_t stopAfter;
+} Visit;
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkRandom(int ops, unsigned int seed);
+static bool checkEmpty(void);
+static bool checkUpdate(Tree64 t, Reference *ref, int64_t key, bool insert);
+static bool checkQueries(Tree64 t, Reference *ref, unsigned int *state);
+static bool checkProbe(Tree64 t, Reference *ref, int64_t key);
+static bool checkKth(Tree64 t, Reference *ref, size_t k);
+static bool checkLCA(Tree64 t, Reference *ref, int64_t a, int64_t b);
+static bool checkBetween(Tree64 t, Reference *ref, int64_t lower, int64_t upper,
+						 size_t stopAfter);
+static bool Collect(int64_t key, void *arg);
+static size_t LowerBound(Reference *ref, int64_t key);
+static bool Contains(Reference *ref, int64_t key);
+static int64_t randomKey(unsigned int *state);
+static int64_t randomProbe(unsigned int *state, Reference *ref);
+static uint64_t NextRandom64(unsigned int *state);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkEmpty();
+	failures += !checkRandom(ops, seed);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Every query on an empty tree, and on a tree holding only INT64_MIN
+ * or only INT64_MAX
+ */
+static bool checkEmpty(void)
+{
+	static Reference ref;
+	unsigned int state = 1;
+	Tree64 t = Tree64New();
+	ref.size = 0;
+
+	bool ok = checkQueries(t, &ref, &state);
+	for (int i = 0; i < NUM_EDGES && ok; i++)
+		ok = checkProbe(t, &ref, Edges[i]) && checkUpdate(t, &ref, Edges[i], false);
+
+	ok = ok && checkUpdate(t, &ref, INT64_MIN, true) && checkQueries(t, &ref, &state) &&
+		 checkUpdate(t, &ref, INT64_MIN, false) && checkUpdate(t, &ref, INT64_MAX, true) &&
+		 checkQueries(t, &ref, &state) && checkUpdate(t, &ref, INT64_MAX, false) &&
+		 checkQueries(t, &ref, &state);
+
+	printf("%s empty and single   %d edge keys\n", ok ? "PASS" : "FAIL", NUM_EDGES);
+	Tree64Free(t);
+	return ok;
+}
+
+/**
+ * Random inserts and deletes, growing and shrinking the tree in turns,
+ * with every query compared after each batch
+ */
+static bool checkRandom(int ops, unsigned int seed)
+{
+	static Reference ref;
+	unsigned int state = seed;
+	Tree64 t = Tree64New();
+	ref.size = 0;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int insertPct = (i / (4 * BATCH) % 2 == 0) ? 65 : 35;
+		int64_t key = randomKey(&state);
+		bool insert = (int)(NextRandom(&state) % 100) < insertPct;
+		if (insert && ref.size == MAX_KEYS)
+			insert = false;
+		ok = checkUpdate(t, &ref, key, insert);
+
+		if (ok && i % BATCH == BATCH - 1)
+			ok = checkQueries(t, &ref, &state);
+	}
+
+	if (ok)
+		ok = checkQueries(t, &ref, &state);
+
+	printf("%s random operations  %d operations, %zu keys\n", ok ? "PASS" : "FAIL", ops,
+		   Tree64Size(t));
+	Tree64Free(t);
+	return ok;
+}
+
+/**
+ * Insert or delete a key in the tree and the array and compare what
+ * they return
+ */
+static bool checkUpdate(Tree64 t, Reference *ref, int64_t key, bool insert)
+{
+	size_t pos = LowerBound(ref, key);
+	bool present = pos < ref->size && ref->keys[pos] == key;
+
+	bool got = insert ? Tree64Insert(t, key) : Tree64Delete(t, key);
+	bool want = insert ? !present : present;
+
+	if (want && insert)
+	{
+		memmove(&ref->keys[pos + 1], &ref->keys[pos], (ref->size - pos) * sizeof(int64_t));
+		ref->keys[pos] = key;
+		ref->size++;
+	}
+	else if (want)
+	{
+		memmove(&ref->keys[pos], &ref->keys[pos + 1], (ref->size - pos - 1) * sizeof(int64_t));
+		ref->size--;
+	}
+
+	if (got != want)
+	{
+		printf("FAIL %s %" PRId64 " returned %d, expected %d\n", insert ? "insert" : "delete",
+			   key, got, want);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the size and keys, and every query on random probes, the ends
+ * of k and a sample of k in between, LCAs and random ranges
+ */
+static bool checkQueries(Tree64 t, Reference *ref, unsigned int *state)
+{
+	static int64_t keys[MAX_KEYS];
+
+	if (Tree64Size(t) != ref->size || Tree64ToArray(t, keys) != ref->size ||
+		(ref->size > 0 && memcmp(keys, ref->keys, ref->size * sizeof(int64_t)) != 0))
+	{
+		printf("FAIL size %zu or keys differ from the %zu expected\n", Tree64Size(t),
+			   ref->size);
+		return false;
+	}
+
+	bool ok = true;
+	for (int i = 0; i < NUM_EDGES && ok; i++)
+		ok = checkProbe(t, ref, Edges[i]);
+	for (int i = 0; i < 128 && ok; i++)
+		ok = checkProbe(t, ref, randomProbe(state, ref));
+
+	// k-th keys are found in order, so only the ends and a sample
+	for (size_t k = 0; k <= 2 && ok; k++)
+		ok = checkKth(t, ref, k) && checkKth(t, ref, ref->size - k + 1);
+	for (int i = 0; i < 16 && ok && ref->size > 0; i++)
+		ok = checkKth(t, ref, 1 + NextRandom64(state) % ref->size);
+
+	for (int i = 0; i < 64 && ok; i++)
+	{
+		// Mostly keys of the tree, which have an LCA, otherwise probes
+		int64_t a = (ref->size > 0 && i % 4 != 0) ? ref->keys[NextRandom(state) % ref->size]
+												  : randomProbe(state, ref);
+		int64_t b = (ref->size > 0 && i % 8 != 0) ? ref->keys[NextRandom(state) % ref->size]
+												  : randomProbe(state, ref);
+		ok = checkLCA(t, ref, a, b);
+	}
+
+	// The whole range, inverted ones, random ones and ones that stop early
+	ok = ok && checkBetween(t, ref, INT64_MIN, INT64_MAX, SIZE_MAX) &&
+		 checkBetween(t, ref, INT64_MAX, INT64_MIN, SIZE_MAX);
+	for (int i = 0; i < 32 && ok; i++)
+	{
+		int64_t lower = randomProbe(state, ref);
+		int64_t upper = randomProbe(state, ref);
+		if (NextRandom(state) % 4 != 0 && lower > upper)
+		{
+			int64_t tmp = lower;
+			lower = upper;
+			upper = tmp;
+		}
+		size_t stopAfter = (i % 4 == 0) ? NextRandom(state) % 8 + 1 : SIZE_MAX;
+		ok = checkBetween(t, ref, lower, upper, stopAfter);
+	}
+
+	return ok;
+}
+
+/**
+ * Compare search, floor and ceiling at a key
+ */
+static bool checkProbe(Tree64 t, Reference *ref, int64_t key)
+{
+	size_t pos = LowerBound(ref, key);
+	bool present = pos < ref->size && ref->keys[pos] == key;
+	bool hasFloor = present || pos > 0;
+	bool hasCeiling = pos < ref->size;
+	int64_t wantFloor = present ? key : (hasFloor ? ref->keys[pos - 1] : MARKER);
+	int64_t wantCeiling = hasCeiling ? ref->keys[pos] : MARKER;
+
+	int64_t floor = MARKER, ceiling = MARKER;
+	bool gotFloor = Tree64Floor(t, key, &floor);
+	bool gotCeiling = Tree64Ceiling(t, key, &ceiling);
+
+	if (Tree64Search(t, key) != present || gotFloor != hasFloor || floor != wantFloor ||
+		gotCeiling != hasCeiling || ceiling != wantCeiling)
+	{
+		printf("FAIL probe %" PRId64 ": search %d, floor %d %" PRId64 ", ceiling %d %" PRId64
+			   "; expected %d, %d %" PRId64 ", %d %" PRId64 "\n",
+			   key, Tree64Search(t, key), gotFloor, floor, gotCeiling, ceiling, present,
+			   hasFloor, wantFloor, hasCeiling, wantCeiling);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the k-th smallest and largest keys, or that there are none
+ */
+static bool checkKth(Tree64 t, Reference *ref, size_t k)
+{
+	bool inRange = k >= 1 && k <= ref->size;
+	int64_t wantSmallest = inRange ? ref->keys[k - 1] : MARKER;
+	int64_t wantLargest = inRange ? ref->keys[ref->size - k] : MARKER;
+
+	int64_t smallest = MARKER, largest = MARKER;
+	bool gotSmallest = Tree64KthSmallest(t, k, &smallest);
+	bool gotLargest = Tree64KthLargest(t, k, &largest);
+
+	if (gotSmallest != inRange || gotLargest != inRange || smallest != wantSmallest ||
+		largest != wantLargest)
+	{
+		printf("FAIL k = %zu: smallest %d %" PRId64 ", largest %d %" PRId64
+			   "; expected %d %" PRId64 ", %" PRId64 "\n",
+			   k, gotSmallest, smallest, gotLargest, largest, inRange, wantSmallest,
+			   wantLargest);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * An LCA exists only when both keys are in the tree, lies between them,
+ * is the same either way round, and is its own LCA with each of them
+ */
+static bool checkLCA(Tree64 t, Reference *ref, int64_t a, int64_t b)
+{
+	bool want = Contains(ref, a) && Contains(ref, b);
+	int64_t lca = MARKER, swapped = MARKER;
+	bool got = Tree64LCA(t, a, b, &lca);
+	bool gotSwapped = Tree64LCA(t, b, a, &swapped);
+
+	bool ok = got == want && gotSwapped == want && lca == swapped;
+	if (ok && !want)
+		ok = lca == MARKER;
+	if (ok && want)
+	{
+		int64_t lower = (a < b) ? a : b;
+		int64_t upper = (a < b) ? b : a;
+		int64_t withA = MARKER, withB = MARKER;
+		ok = Contains(ref, lca) && lca >= lower && lca <= upper &&
+			 Tree64LCA(t, a, lca, &withA) && withA == lca && Tree64LCA(t, lca, b, &withB) &&
+			 withB == lca;
+	}
+
+	if (!ok)
+		printf("FAIL lca of %" PRId64 " and %" PRId64 " is %d %" PRId64 ", swapped %d %" PRId64
+			   ", expected %d\n",
+			   a, b, got, lca, gotSwapped, swapped, want);
+	return ok;
+}
+
+/**
+ * Compare the keys visited between two bounds with the array, with a
+ * visitor that asks to stop after stopAfter keys
+ */
+static bool checkBetween(Tree64 t, Reference *ref, int64_t lower, int64_t upper,
+						 size_t stopAfter)
+{
+	static int64_t keys[MAX_KEYS];
+	Visit v = {keys, 0, stopAfter};
+
+	size_t start = LowerBound(ref, lower);
+	size_t end = start;
+	if (lower <= upper)
+		while (end < ref->size && ref->keys[end] <= upper)
+			end++;
+	size_t want = (end - start < stopAfter) ? end - start : stopAfter;
+
+	size_t got = Tree64SearchBetween(t, lower, upper, Collect, &v);
+	bool ok = got == want && v.count == want &&
+			  (want == 0 || memcmp(keys, &ref->keys[start], want * sizeof(int64_t)) == 0);
+
+	if (!ok)
+		printf("FAIL search between %" PRId64 " and %" PRId64 " visited %zu keys (%zu"
+			   " returned), expected %zu\n",
+			   lower, upper, v.count, got, want);
+	return ok;
+}
+
+static bool Collect(int64_t key, void *arg)
+{
+	Visit *v = arg;
+	v->keys[v->count++] = key;
+	return v->count < v->stopAfter;
+}
+
+/**
+ * The position of the first key of the array not less than key
+ */
+static size_t LowerBound(Reference *ref, int64_t key)
+{
+	size_t lo = 0;
+	size_t hi = ref->size;
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (ref->keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static bool Contains(Reference *ref, int64_t key)
+{
+	size_t pos = LowerBound(ref, key);
+	return pos < ref->size && ref->keys[pos] == key;
+}
+
+/**
+ * A key from a pool spread over int64, near 0, near one of the edges,
+ * or an edge itself
+ */
+static int64_t randomKey(unsigned int *state)
+{
+	switch (NextRandom(state) % 8)
+	{
+	case 0:
+		return Edges[NextRandom(state) % NUM_EDGES];
+	case 1:
+	{
+		// Step off an edge towards the middle, so there is no overflow
+		int64_t edge = Edges[NextRandom(state) % NUM_EDGES];
+		int64_t step = NextRandom(state) % 64;
+		return (edge < 0) ? edge + step : edge - step;
+	}
+	case 2:
+	case 3:
+		// A pool spread over all of int64 by Fibonacci hashing
+		return (int64_t)((NextRandom(state) % SPREAD_KEYS) * UINT64_C(0x9E3779B97F4A7C15));
+	default:
+		return (int64_t)(NextRandom(state) % 4096) - 2048;
+	}
+}
+
+/**
+ * A key of the tree or a value next to one, or a random key
+ */
+static int64_t randomProbe(unsigned int *state, Reference *ref)
+{
+	if (ref->size == 0 || NextRandom(state) % 2 == 0)
+		return randomKey(state);
+
+	int64_t key = ref->keys[NextRandom(state) % ref->size];
+	switch (NextRandom(state) % 3)
+	{
+	case 0:
+		return (key == INT64_MIN) ? key : key - 1;
+	case 1:
+		return (key == INT64_MAX) ? key : key + 1;
+	default:
+		return key;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static uint64_t NextRandom64(unsigned int *state)
+{
+	uint64_t high = NextRandom(state);
+	return (high << 32) | NextRandom(state);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
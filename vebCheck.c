@@ -0,0 +1,437 @@
+// Differential checker for van Emde Boas Trees.
+// Runs the same inserts and deletes through a VebTree and a Tree from
+// bBST.h and compares the return of every update, and after every batch
+// the size, a walk over all keys by Ceiling from INT_MIN up and by Floor
+// from INT_MAX down, and search, floor and ceiling on random probes.
+//
+// The passes aim at the parts of the structure:
+// - base fills and empties 256-value bitmaps at INT_MIN, either side of
+//   0 (which crosses a root cluster) and at INT_MAX, probing every value
+//   and the 64-bit word edges within them
+// - random mixes dense keys, keys next to root cluster edges, a fixed
+//   pool of keys spread over the whole universe, which grows the root's
+//   cluster table, and keys at the ends of int
+// - release deletes every key again and checks that the tree gives back
+//   its summaries, tables and clusters, down to the memory of an empty
+//   tree
+//
+// Usage: ./vebCheck [-o operations] [-s seed]
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bBST.h"
+#include "List.h"
+#include "listCapture.h"
+#include "vebTree.h"
+
+#define DEFAULT_OPS 200000
+// Operations between two full comparisons
+#define BATCH 4000
+#define BASE_SIZE 256
+// Keys spread over the universe, enough to grow the root's table a few
+// times over
+#define SPREAD_KEYS 4096
+#define RELEASE_KEYS 20000
+
+// First keys of the bitmaps the base pass fills
+static const int BaseBlocks[] = {INT_MIN, -BASE_SIZE / 2, INT_MAX - BASE_SIZE + 1};
+#define NUM_BASE_BLOCKS (int)(sizeof(BaseBlocks) / sizeof(BaseBlocks[0]))
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static bool checkBase(unsigned int seed);
+static bool checkRandom(int ops, unsigned int seed);
+static bool checkRelease(unsigned int seed);
+static bool checkUpdate(VebTree v, Tree t, int key, bool insert);
+static bool checkKey(VebTree v, Tree t, int key);
+static bool checkQueries(VebTree v, Tree t, unsigned int *state);
+static bool checkWalk(VebTree v, int *keys, int size);
+static int randomKey(unsigned int *state);
+static int Silence(void);
+static void Restore(int saved);
+static unsigned int NextRandom(unsigned int *state);
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	int ops = DEFAULT_OPS;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-o operations] [-s seed]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seed == 0)
+		seed = 1;
+
+	int failures = 0;
+	failures += !checkBase(seed);
+	failures += !checkRandom(ops, seed);
+	failures += !checkRelease(seed);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("All checks passed\n");
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Fill the bitmaps in a random order, probing every value of a block
+ * after each quarter, then empty them the same way
+ */
+static bool checkBase(unsigned int seed)
+{
+	VebTree v = VebTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	int order[BASE_SIZE];
+	for (int i = 0; i < BASE_SIZE; i++)
+		order[i] = i;
+	for (int i = BASE_SIZE - 1; i > 0; i--)
+	{
+		int j = (int)(NextRandom(&state) % (unsigned int)(i + 1));
+		int tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	for (int pass = 0; pass < 2 && ok; pass++)
+	{
+		bool insert = (pass == 0);
+		for (int i = 0; i < BASE_SIZE && ok; i++)
+		{
+			for (int b = 0; b < NUM_BASE_BLOCKS && ok; b++)
+				ok = checkUpdate(v, t, BaseBlocks[b] + order[i], insert);
+
+			if (i % (BASE_SIZE / 4) != BASE_SIZE / 4 - 1 && i != 0)
+				continue;
+
+			// Every value of every block, and the values either side
+			for (int b = 0; b < NUM_BASE_BLOCKS && ok; b++)
+				for (int low = 0; low < BASE_SIZE && ok; low++)
+					ok = checkKey(v, t, BaseBlocks[b] + low);
+			ok = ok && checkQueries(v, t, &state);
+		}
+	}
+
+	printf("%s base bitmaps       %d blocks of %d values\n", ok ? "PASS" : "FAIL",
+		   NUM_BASE_BLOCKS, BASE_SIZE);
+	VebTreeFree(v);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Random inserts and deletes, growing and shrinking the tree in turns,
+ * with every query compared after each batch
+ */
+static bool checkRandom(int ops, unsigned int seed)
+{
+	VebTree v = VebTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	for (int i = 0; i < ops && ok; i++)
+	{
+		int insertPct = (i / (4 * BATCH) % 2 == 0) ? 65 : 35;
+		int key = randomKey(&state);
+		bool insert = (int)(NextRandom(&state) % 100) < insertPct;
+		ok = checkUpdate(v, t, key, insert);
+
+		if (ok && i % BATCH == BATCH - 1)
+			ok = checkQueries(v, t, &state);
+	}
+
+	if (ok)
+		ok = checkQueries(v, t, &state);
+
+	printf("%s random operations  %d operations, %d keys\n", ok ? "PASS" : "FAIL", ops,
+		   VebTreeSize(v));
+	VebTreeFree(v);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Fill a tree, delete every key in a random order, and check that it
+ * then takes no more memory than a new tree. Summaries and cluster
+ * tables are freed as their nodes go down to one key, so the last
+ * deletes go through those paths at every level.
+ */
+static bool checkRelease(unsigned int seed)
+{
+	VebTree v = VebTreeNew();
+	Tree t = TreeNew();
+	unsigned int state = seed;
+	bool ok = true;
+
+	VebTree empty = VebTreeNew();
+	size_t baseline = VebTreeMemory(empty);
+	VebTreeFree(empty);
+
+	int *keys = malloc(RELEASE_KEYS * sizeof(int));
+	if (keys == NULL)
+	{
+		fprintf(stderr, "Could not malloc Keys\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int size = 0;
+	while (size < RELEASE_KEYS && ok)
+	{
+		int key = randomKey(&state);
+		if (key == UNDEFINED || TreeSearch(t, key))
+			continue;
+		ok = checkUpdate(v, t, key, true);
+		keys[size++] = key;
+	}
+	size_t filled = VebTreeMemory(v);
+	ok = ok && checkQueries(v, t, &state);
+
+	for (int i = size - 1; i > 0; i--)
+	{
+		int j = (int)(NextRandom(&state) % (unsigned int)(i + 1));
+		int tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+
+	for (int i = 0; i < size && ok; i++)
+	{
+		ok = checkUpdate(v, t, keys[i], false) && checkKey(v, t, keys[i]);
+		if (ok && (i % (RELEASE_KEYS / 8) == 0 || size - i < 64))
+			ok = checkQueries(v, t, &state);
+	}
+
+	if (ok && VebTreeMemory(v) != baseline)
+	{
+		printf("FAIL the emptied tree takes %zu bytes, a new one %zu\n", VebTreeMemory(v),
+			   baseline);
+		ok = false;
+	}
+
+	// And it still works after being emptied
+	for (int i = 0; i < 1000 && ok; i++)
+		ok = checkUpdate(v, t, keys[i], true);
+	ok = ok && checkQueries(v, t, &state);
+
+	printf("%s release            %d keys, %zu bytes filled, %zu empty\n", ok ? "PASS" : "FAIL",
+		   size, filled, baseline);
+	free(keys);
+	VebTreeFree(v);
+	TreeFree(t);
+	return ok;
+}
+
+/**
+ * Insert or delete a key in both trees and compare what they return.
+ * The trees complain about duplicates and missing keys on stderr, which
+ * is silenced for the updates that are expected to be refused.
+ */
+static bool checkUpdate(VebTree v, Tree t, int key, bool insert)
+{
+	bool refused = (key == UNDEFINED) || (TreeSearch(t, key) == insert);
+	int saved = refused ? Silence() : -1;
+
+	bool got = insert ? VebTreeInsert(v, key) : VebTreeDelete(v, key);
+	bool want = insert ? TreeInsert(t, key) : TreeDelete(t, key);
+
+	if (refused)
+		Restore(saved);
+
+	if (got != want)
+	{
+		printf("FAIL %s %d returned %d, expected %d\n", insert ? "insert" : "delete", key, got,
+			   want);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare the queries at a key and either side of it
+ */
+static bool checkKey(VebTree v, Tree t, int key)
+{
+	for (long long probe = (long long)key - 1; probe <= (long long)key + 1; probe++)
+	{
+		if (probe < INT_MIN || probe > INT_MAX)
+			continue;
+
+		int k = (int)probe;
+		if (VebTreeSearch(v, k) != TreeSearch(t, k) || VebTreeFloor(v, k) != TreeFloor(t, k) ||
+			VebTreeCeiling(v, k) != TreeCeiling(t, k))
+		{
+			printf("FAIL probe %d: search %d, floor %d, ceiling %d; expected %d, %d, %d\n", k,
+				   VebTreeSearch(v, k), VebTreeFloor(v, k), VebTreeCeiling(v, k),
+				   TreeSearch(t, k), TreeFloor(t, k), TreeCeiling(t, k));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Compare the size, walk every key both ways, and probe keys of the
+ * tree, random keys and the ends of int
+ */
+static bool checkQueries(VebTree v, Tree t, unsigned int *state)
+{
+	List l = TreeToList(t);
+	int *keys;
+	int size = ListCapture(l, &keys);
+	ListFree(l);
+
+	bool ok = size >= 0;
+	if (ok && VebTreeSize(v) != size)
+	{
+		printf("FAIL size is %d, expected %d\n", VebTreeSize(v), size);
+		ok = false;
+	}
+
+	ok = ok && checkWalk(v, keys, size) && checkKey(v, t, INT_MIN) && checkKey(v, t, INT_MAX);
+
+	for (int i = 0; i < 256 && ok; i++)
+	{
+		int key = (size > 0 && i % 2 == 0) ? keys[NextRandom(state) % size] : randomKey(state);
+		ok = checkKey(v, t, key);
+	}
+
+	free(keys);
+	return ok;
+}
+
+/**
+ * Step through the tree by Ceiling from INT_MIN and by Floor from
+ * INT_MAX, which must meet the sorted keys one by one
+ */
+static bool checkWalk(VebTree v, int *keys, int size)
+{
+	int i = 0;
+	long long next = INT_MIN;
+	while (next <= INT_MAX)
+	{
+		int key = VebTreeCeiling(v, (int)next);
+		if (key == UNDEFINED)
+			break;
+		if (i == size || key != keys[i])
+		{
+			printf("FAIL ceiling walk found %d as key %d, expected %d\n", key, i,
+				   (i < size) ? keys[i] : UNDEFINED);
+			return false;
+		}
+		i++;
+		next = (long long)key + 1;
+	}
+
+	int j = size - 1;
+	long long prev = INT_MAX;
+	while (prev > INT_MIN)
+	{
+		int key = VebTreeFloor(v, (int)prev);
+		if (key == UNDEFINED)
+			break;
+		if (j < 0 || key != keys[j])
+		{
+			printf("FAIL floor walk found %d as key %d, expected %d\n", key, j,
+				   (j >= 0) ? keys[j] : UNDEFINED);
+			return false;
+		}
+		j--;
+		prev = (long long)key - 1;
+	}
+
+	if (i != size || j != -1)
+	{
+		printf("FAIL walks found %d and %d keys, expected %d\n", i, size - 1 - j, size);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * A dense key near 0, a key next to a root cluster edge, one of the
+ * spread keys, or a key at either end of int, which now and then is
+ * UNDEFINED itself
+ */
+static int randomKey(unsigned int *state)
+{
+	unsigned int r = NextRandom(state);
+	switch (r % 8)
+	{
+	case 0:
+		// Fibonacci hashing spreads the pool over the whole universe
+		return (int)((NextRandom(state) % SPREAD_KEYS) * 2654435769u);
+	case 1:
+		return (NextRandom(state) % 2) ? INT_MIN + (int)(NextRandom(state) % 512)
+									   : INT_MAX - (int)(NextRandom(state) % 512);
+	case 2:
+		return ((int)(NextRandom(state) % 64) - 32) * 65536 + (int)(NextRandom(state) % 5) - 2;
+	default:
+		return (int)(NextRandom(state) % 20000) - 10000;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int Silence(void)
+{
+	fflush(stderr);
+	int saved = dup(STDERR_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0)
+	{
+		dup2(devNull, STDERR_FILENO);
+		close(devNull);
+	}
+	return saved;
+}
+
+static void Restore(int saved)
+{
+	if (saved < 0)
+		return;
+
+	fflush(stderr);
+	dup2(saved, STDERR_FILENO);
+	close(saved);
+}
+
+static unsigned int NextRandom(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,702 @@
+// Implementation of the van Emde Boas Tree.
+//
+// Keys are mapped to unsigned 32-bit values by flipping the sign bit so
+// that unsigned order matches signed order. The 32-bit root splits keys
+// 16/16 and its clusters split 8/8. Universes of 256 or fewer values
+// are the base case and are a plain 256-bit bitmap, answered with a
+// handful of ctz/clz instructions.
+//
+// As in the textbook structure, a recursive node keeps its minimum out
+// of its clusters. That is what makes insertion into an empty cluster
+// O(1) and keeps every operation to one real recursive call per level.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vebTree.h"
+
+#define BASE_LG 8
+#define BASE_WORDS ((1 << BASE_LG) / 64)
+#define ROOT_LG 32
+#define INITIAL_SLOTS 4
+
+typedef struct veb *Veb;
+
+struct slot
+{
+	uint32_t key;
+	Veb cluster;
+};
+
+struct veb
+{
+	int lg;
+	bool empty;
+	uint32_t min;
+	uint32_t max;
+	union
+	{
+		// Recursive nodes
+		struct
+		{
+			Veb summary;
+			struct slot *slots;
+			uint32_t capacity;
+			uint32_t count;
+		};
+		// Base case nodes
+		uint64_t words[BASE_WORDS];
+	};
+};
+
+struct vebTree
+{
+	Veb root;
+	int size;
+};
+
+////////////////////////////////////////////////////////////////////////
+
+// Auxiliary function prototypes
+static Veb VebCreate(int lg);
+static void VebDestroy(Veb v);
+static size_t VebMemory(Veb v);
+static bool Member(Veb v, uint32_t x);
+static void Insert(Veb v, uint32_t x);
+static void Remove(Veb v, uint32_t x);
+static bool Successor(Veb v, uint32_t x, uint32_t *out);
+static bool Predecessor(Veb v, uint32_t x, uint32_t *out);
+static bool Empty(Veb v);
+static uint32_t Min(Veb v);
+static uint32_t Max(Veb v);
+
+static bool BaseSuccessor(Veb v, uint32_t x, uint32_t *out);
+static bool BasePredecessor(Veb v, uint32_t x, uint32_t *out);
+
+static Veb ClusterGet(Veb v, uint32_t key);
+static void ClusterPut(Veb v, uint32_t key, Veb cluster);
+static void ClusterDelete(Veb v, uint32_t key);
+static uint32_t SlotOf(uint32_t key, uint32_t capacity);
+
+static int LowBits(Veb v);
+static uint32_t High(Veb v, uint32_t x);
+static uint32_t Low(Veb v, uint32_t x);
+static uint32_t Index(Veb v, uint32_t high, uint32_t low);
+static uint32_t ToUnsigned(int key);
+static int ToSigned(uint32_t u);
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Creates a new empty tree.
+ */
+VebTree VebTreeNew(void)
+{
+	VebTree t = malloc(sizeof(*t));
+
+	if (t == NULL)
+	{
+		fprintf(stderr, "Could not malloc VebTree\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t->root = VebCreate(ROOT_LG);
+	t->size = 0;
+	return t;
+}
+
+/**
+ * Frees all memory allocated for the given tree.
+ */
+void VebTreeFree(VebTree t)
+{
+	if (t == NULL)
+		return;
+
+	VebDestroy(t->root);
+	free(t);
+}
+
+/**
+ * Returns the number of keys in the tree.
+ */
+int VebTreeSize(VebTree t)
+{
+	return (t == NULL) ? 0 : t->size;
+}
+
+/**
+ * Returns the number of bytes allocated for the given tree.
+ */
+size_t VebTreeMemory(VebTree t)
+{
+	if (t == NULL)
+		return 0;
+
+	return sizeof(*t) + VebMemory(t->root);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ */
+bool VebTreeSearch(VebTree t, int key)
+{
+	if (t == NULL || key == UNDEFINED)
+		return false;
+
+	return Member(t->root, ToUnsigned(key));
+}
+
+/**
+ * Inserts the given key into the tree.
+ */
+bool VebTreeInsert(VebTree t, int key)
+{
+	if (t == NULL)
+		return false;
+
+	if (key == UNDEFINED)
+	{
+		fprintf(stderr, "Can't Insert Undefined Value\n");
+		return false;
+	}
+
+	// The recursive insert assumes the key is new
+	uint32_t x = ToUnsigned(key);
+	if (Member(t->root, x))
+	{
+		fprintf(stderr, "Value %d already Exists in Tree\n", key);
+		return false;
+	}
+
+	Insert(t->root, x);
+	t->size++;
+	return true;
+}
+
+/**
+ * Deletes the given key from the tree if it is present.
+ */
+bool VebTreeDelete(VebTree t, int key)
+{
+	if (t == NULL || key == UNDEFINED)
+		return false;
+
+	uint32_t x = ToUnsigned(key);
+	if (!Member(t->root, x))
+	{
+		fprintf(stderr, "Value to Delete not in Tree\n");
+		return false;
+	}
+
+	Remove(t->root, x);
+	t->size--;
+	return true;
+}
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ */
+int VebTreeFloor(VebTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	uint32_t x = ToUnsigned(key);
+	if (Member(t->root, x))
+		return key;
+
+	uint32_t result;
+	return Predecessor(t->root, x, &result) ? ToSigned(result) : UNDEFINED;
+}
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ */
+int VebTreeCeiling(VebTree t, int key)
+{
+	if (t == NULL)
+		return UNDEFINED;
+
+	uint32_t x = ToUnsigned(key);
+	if (Member(t->root, x))
+		return key;
+
+	uint32_t result;
+	return Successor(t->root, x, &result) ? ToSigned(result) : UNDEFINED;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Create an empty node over a universe of 2^lg values
+ */
+static Veb VebCreate(int lg)
+{
+	Veb v = calloc(1, sizeof(*v));
+
+	if (v == NULL)
+	{
+		fprintf(stderr, "Could not malloc Veb Node\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// The summary and cluster table are only created once a second key
+	// arrives and are freed when the node is down to one key again, a
+	// node holding one key stores it as its min and max
+	v->lg = lg;
+	v->empty = true;
+	return v;
+}
+
+static void VebDestroy(Veb v)
+{
+	if (v == NULL)
+		return;
+
+	if (v->lg > BASE_LG)
+	{
+		for (uint32_t i = 0; i < v->capacity; i++)
+			VebDestroy(v->slots[i].cluster);
+		free(v->slots);
+		VebDestroy(v->summary);
+	}
+
+	free(v);
+}
+
+static size_t VebMemory(Veb v)
+{
+	if (v == NULL)
+		return 0;
+
+	size_t bytes = sizeof(*v);
+	if (v->lg > BASE_LG)
+	{
+		bytes += sizeof(*v->slots) * v->capacity + VebMemory(v->summary);
+		for (uint32_t i = 0; i < v->capacity; i++)
+			bytes += VebMemory(v->slots[i].cluster);
+	}
+
+	return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+static bool Member(Veb v, uint32_t x)
+{
+	if (v->lg <= BASE_LG)
+		return (v->words[x >> 6] >> (x & 63)) & 1;
+
+	if (v->empty)
+		return false;
+
+	if (x == v->min || x == v->max)
+		return true;
+
+	Veb c = ClusterGet(v, High(v, x));
+	return c != NULL && Member(c, Low(v, x));
+}
+
+/**
+ * Insert a value that is not already present
+ */
+static void Insert(Veb v, uint32_t x)
+{
+	if (v->lg <= BASE_LG)
+	{
+		v->words[x >> 6] |= 1ULL << (x & 63);
+		return;
+	}
+
+	if (v->empty)
+	{
+		v->min = v->max = x;
+		v->empty = false;
+		return;
+	}
+
+	// The minimum is never stored in a cluster, so a new minimum pushes
+	// the old one down instead
+	if (x < v->min)
+	{
+		uint32_t tmp = v->min;
+		v->min = x;
+		x = tmp;
+	}
+
+	if (x > v->max)
+		v->max = x;
+
+	if (v->summary == NULL)
+	{
+		v->summary = VebCreate(v->lg - LowBits(v));
+		v->capacity = INITIAL_SLOTS;
+		v->slots = calloc(v->capacity, sizeof(*v->slots));
+		if (v->slots == NULL)
+		{
+			fprintf(stderr, "Could not malloc Cluster Table\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	uint32_t high = High(v, x);
+	Veb c = ClusterGet(v, high);
+	if (c == NULL)
+	{
+		// Only one of these two inserts recurses beyond O(1) work
+		c = VebCreate(LowBits(v));
+		ClusterPut(v, high, c);
+		Insert(v->summary, high);
+	}
+
+	Insert(c, Low(v, x));
+}
+
+/**
+ * Remove a value that is present
+ */
+static void Remove(Veb v, uint32_t x)
+{
+	if (v->lg <= BASE_LG)
+	{
+		v->words[x >> 6] &= ~(1ULL << (x & 63));
+		return;
+	}
+
+	if (v->min == v->max)
+	{
+		v->empty = true;
+		return;
+	}
+
+	// Pull the smallest clustered value up to be the new minimum, then
+	// remove it from its cluster instead
+	if (x == v->min)
+	{
+		uint32_t first = Min(v->summary);
+		x = Index(v, first, Min(ClusterGet(v, first)));
+		v->min = x;
+	}
+
+	uint32_t high = High(v, x);
+	Veb c = ClusterGet(v, high);
+	Remove(c, Low(v, x));
+
+	if (Empty(c))
+	{
+		ClusterDelete(v, high);
+		VebDestroy(c);
+		Remove(v->summary, high);
+
+		if (Empty(v->summary))
+		{
+			// x was the only clustered value, so the node is back to a
+			// single key and gives up its summary and table
+			VebDestroy(v->summary);
+			free(v->slots);
+			v->summary = NULL;
+			v->slots = NULL;
+			v->capacity = 0;
+			v->count = 0;
+			v->max = v->min;
+		}
+		else if (x == v->max)
+		{
+			uint32_t last = Max(v->summary);
+			v->max = Index(v, last, Max(ClusterGet(v, last)));
+		}
+	}
+	else if (x == v->max)
+	{
+		v->max = Index(v, high, Max(c));
+	}
+}
+
+/**
+ * Find the smallest value greater than x
+ */
+static bool Successor(Veb v, uint32_t x, uint32_t *out)
+{
+	if (v->lg <= BASE_LG)
+		return BaseSuccessor(v, x, out);
+
+	if (v->empty)
+		return false;
+
+	if (x < v->min)
+	{
+		*out = v->min;
+		return true;
+	}
+
+	uint32_t high = High(v, x);
+	uint32_t low = Low(v, x);
+	Veb c = ClusterGet(v, high);
+
+	// Stay in x's own cluster if it holds anything larger
+	if (c != NULL && low < Max(c))
+	{
+		uint32_t next;
+		Successor(c, low, &next);
+		*out = Index(v, high, next);
+		return true;
+	}
+
+	// Otherwise the answer is the minimum of the next cluster
+	uint32_t nextHigh;
+	if (v->summary == NULL || !Successor(v->summary, high, &nextHigh))
+		return false;
+
+	*out = Index(v, nextHigh, Min(ClusterGet(v, nextHigh)));
+	return true;
+}
+
+/**
+ * Find the largest value less than x
+ */
+static bool Predecessor(Veb v, uint32_t x, uint32_t *out)
+{
+	if (v->lg <= BASE_LG)
+		return BasePredecessor(v, x, out);
+
+	if (v->empty)
+		return false;
+
+	if (x > v->max)
+	{
+		*out = v->max;
+		return true;
+	}
+
+	uint32_t high = High(v, x);
+	uint32_t low = Low(v, x);
+	Veb c = ClusterGet(v, high);
+
+	if (c != NULL && low > Min(c))
+	{
+		uint32_t prev;
+		Predecessor(c, low, &prev);
+		*out = Index(v, high, prev);
+		return true;
+	}
+
+	uint32_t prevHigh;
+	if (v->summary != NULL && Predecessor(v->summary, high, &prevHigh))
+	{
+		*out = Index(v, prevHigh, Max(ClusterGet(v, prevHigh)));
+		return true;
+	}
+
+	// The minimum lives outside the clusters so check it last
+	if (x > v->min)
+	{
+		*out = v->min;
+		return true;
+	}
+
+	return false;
+}
+
+static bool Empty(Veb v)
+{
+	if (v->lg > BASE_LG)
+		return v->empty;
+
+	for (int i = 0; i < BASE_WORDS; i++)
+		if (v->words[i] != 0)
+			return false;
+	return true;
+}
+
+static uint32_t Min(Veb v)
+{
+	if (v->lg > BASE_LG)
+		return v->min;
+
+	for (int i = 0; i < BASE_WORDS; i++)
+		if (v->words[i] != 0)
+			return i * 64 + __builtin_ctzll(v->words[i]);
+	return 0;
+}
+
+static uint32_t Max(Veb v)
+{
+	if (v->lg > BASE_LG)
+		return v->max;
+
+	for (int i = BASE_WORDS - 1; i >= 0; i--)
+		if (v->words[i] != 0)
+			return i * 64 + 63 - __builtin_clzll(v->words[i]);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Base Case Bitmaps */
+
+static bool BaseSuccessor(Veb v, uint32_t x, uint32_t *out)
+{
+	uint32_t next = x + 1;
+	if (next >= (1u << BASE_LG))
+		return false;
+
+	int w = next >> 6;
+	uint64_t word = v->words[w] & (~0ULL << (next & 63));
+	while (word == 0)
+	{
+		if (++w == BASE_WORDS)
+			return false;
+		word = v->words[w];
+	}
+
+	*out = w * 64 + __builtin_ctzll(word);
+	return true;
+}
+
+static bool BasePredecessor(Veb v, uint32_t x, uint32_t *out)
+{
+	if (x == 0)
+		return false;
+
+	uint32_t prev = x - 1;
+	int w = prev >> 6;
+	int bit = prev & 63;
+	uint64_t word = v->words[w] & ((bit == 63) ? ~0ULL : (1ULL << (bit + 1)) - 1);
+	while (word == 0)
+	{
+		if (--w < 0)
+			return false;
+		word = v->words[w];
+	}
+
+	*out = w * 64 + 63 - __builtin_clzll(word);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Cluster Hash Tables */
+
+// Linear probing over a power of two sized table of (key, cluster)
+// slots. A NULL cluster marks an empty slot. Deletion shifts later
+// entries back instead of leaving tombstones.
+
+static Veb ClusterGet(Veb v, uint32_t key)
+{
+	if (v->slots == NULL)
+		return NULL;
+
+	uint32_t mask = v->capacity - 1;
+	for (uint32_t i = SlotOf(key, v->capacity);; i = (i + 1) & mask)
+	{
+		if (v->slots[i].cluster == NULL)
+			return NULL;
+		if (v->slots[i].key == key)
+			return v->slots[i].cluster;
+	}
+}
+
+static void ClusterPut(Veb v, uint32_t key, Veb cluster)
+{
+	// Keep the table at most half full
+	if (2 * (v->count + 1) > v->capacity)
+	{
+		struct slot *old = v->slots;
+		uint32_t oldCapacity = v->capacity;
+
+		v->capacity *= 2;
+		v->slots = calloc(v->capacity, sizeof(*v->slots));
+		if (v->slots == NULL)
+		{
+			fprintf(stderr, "Could not grow Cluster Table\n");
+			exit(EXIT_FAILURE);
+		}
+
+		v->count = 0;
+		for (uint32_t i = 0; i < oldCapacity; i++)
+			if (old[i].cluster != NULL)
+				ClusterPut(v, old[i].key, old[i].cluster);
+		free(old);
+	}
+
+	uint32_t mask = v->capacity - 1;
+	uint32_t i = SlotOf(key, v->capacity);
+	while (v->slots[i].cluster != NULL)
+		i = (i + 1) & mask;
+
+	v->slots[i].key = key;
+	v->slots[i].cluster = cluster;
+	v->count++;
+}
+
+static void ClusterDelete(Veb v, uint32_t key)
+{
+	uint32_t mask = v->capacity - 1;
+	uint32_t i = SlotOf(key, v->capacity);
+	while (v->slots[i].key != key || v->slots[i].cluster == NULL)
+		i = (i + 1) & mask;
+
+	// Move back any later entry whose home slot is at or before the gap
+	uint32_t gap = i;
+	for (uint32_t j = (gap + 1) & mask; v->slots[j].cluster != NULL; j = (j + 1) & mask)
+	{
+		uint32_t home = SlotOf(v->slots[j].key, v->capacity);
+		if (((j - home) & mask) >= ((j - gap) & mask))
+		{
+			v->slots[gap] = v->slots[j];
+			gap = j;
+		}
+	}
+
+	v->slots[gap].cluster = NULL;
+	v->count--;
+}
+
+/**
+ * Fibonacci hashing onto a power of two table, taking the top bits of
+ * the product since they depend on every bit of the key
+ */
+static uint32_t SlotOf(uint32_t key, uint32_t capacity)
+{
+	return (key * 2654435769u) >> (32 - __builtin_ctz(capacity));
+}
+
+////////////////////////////////////////////////////////////////////////
+
+/* Helper Functions */
+
+static int LowBits(Veb v)
+{
+	return v->lg / 2;
+}
+
+static uint32_t High(Veb v, uint32_t x)
+{
+	return x >> LowBits(v);
+}
+
+static uint32_t Low(Veb v, uint32_t x)
+{
+	return x & ((1u << LowBits(v)) - 1);
+}
+
+static uint32_t Index(Veb v, uint32_t high, uint32_t low)
+{
+	return (high << LowBits(v)) | low;
+}
+
+static uint32_t ToUnsigned(int key)
+{
+	return (uint32_t)key ^ 0x80000000u;
+}
+
+static int ToSigned(uint32_t u)
+{
+	return (int)(u ^ 0x80000000u);
+}
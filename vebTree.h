@@ -0,0 +1,84 @@
+// Operations on van Emde Boas Trees of integers.
+// An integer-only predecessor structure over the 32-bit universe. Each
+// level splits a key into a cluster number (high half) and a position
+// in that cluster (low half), so floor, ceiling, search, insert and
+// delete walk O(log log U) levels no matter how many keys are stored.
+// Clusters are kept in per-node hash tables so memory is proportional
+// to the number of keys rather than to the universe: under a byte per
+// key for dense keysets, around 115 bytes per key for sparse ones.
+
+#ifndef VEB_TREE_H
+#define VEB_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bBST.h"
+
+typedef struct vebTree *VebTree;
+
+////////////////////////////////////////////////////////////////////////
+// All complexities below are in terms of U = 2^32, the size of the key
+// universe. Hash table operations are counted as expected O(1).
+
+/**
+ * Creates a new empty tree.
+ * The time complexity of this function is O(1).
+ */
+VebTree VebTreeNew(void);
+
+/**
+ * Frees all memory allocated for the given tree.
+ * The time complexity of this function is O(n).
+ */
+void VebTreeFree(VebTree t);
+
+/**
+ * Returns the number of keys in the tree.
+ * The time complexity of this function is O(1).
+ */
+int VebTreeSize(VebTree t);
+
+/**
+ * Returns the number of bytes allocated for the given tree.
+ * The time complexity of this function is O(n).
+ */
+size_t VebTreeMemory(VebTree t);
+
+/**
+ * Searches the tree for a given key and returns true if the key is in
+ * the tree or false otherwise.
+ * The time complexity of this function is O(log log U).
+ */
+bool VebTreeSearch(VebTree t, int key);
+
+/**
+ * Inserts the given key into the tree.
+ * Returns true if the key was inserted, or false if the key was already
+ * present in the tree or is UNDEFINED.
+ * The time complexity of this function is O(log log U).
+ */
+bool VebTreeInsert(VebTree t, int key);
+
+/**
+ * Deletes the given key from the tree if it is present.
+ * Returns true if the key was deleted, or false if it was not present.
+ * The time complexity of this function is O(log log U).
+ */
+bool VebTreeDelete(VebTree t, int key);
+
+/**
+ * Returns the largest key less than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log log U).
+ */
+int VebTreeFloor(VebTree t, int key);
+
+/**
+ * Returns the smallest key greater than or equal to the given value.
+ * Returns UNDEFINED if there is no such key.
+ * The time complexity of this function is O(log log U).
+ */
+int VebTreeCeiling(VebTree t, int key);
+
+#endif